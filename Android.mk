@@ -54,7 +54,10 @@ LOCAL_SRC_FILES := \
 	gme/Gb_Cpu.cpp \
 	gme/Gb_Oscs.cpp \
 	gme/Gbs_Emu.cpp \
+	gme/Gme_Alloc.cpp \
 	gme/Gme_File.cpp \
+	gme/Gme_Lookahead.cpp \
+	gme/Gme_Playlist.cpp \
 	gme/Gym_Emu.cpp \
 	gme/Hes_Apu.cpp \
 	gme/Hes_Cpu.cpp \
@@ -0,0 +1,368 @@
+// Renders one file per format for a fixed emulated duration and reports
+// throughput, peak memory and allocation counts
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_bench [-s seconds] [-r repeats] [-R rate] [-L msec] [-j out.json] [file ...]
+
+Renders the built-in synthetic fixtures (see test/Fixtures.h), then any files
+given, each for the same emulated duration. Reports for each:
+
+realtime_factor  emulated seconds rendered per wall-clock second
+ns_per_sample    wall-clock nanoseconds per stereo output sample
+peak_rss_kb      peak resident memory of process rendering it
+allocs           heap allocations from creating emulator to deleting it
+render_allocs    heap allocations while rendering, after warm-up
+
+With -L, each emulator has gme_set_max_latency() set to msec, to measure the
+cost of generating sound in smaller pieces. Timing is the best of the repeats. On POSIX each file is rendered in its own
+child process so that peak memory isn't shared between formats. The YM2612
+emulator used by VGM and GYM is chosen at build time with GME_YM2612_EMU, so
+configure a separate build for each one to compare them. */
+
+#include "gme/gme.h"
+#include "test/Fixtures.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+	#include <sys/resource.h>
+	#include <sys/time.h>
+	#include <sys/types.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+	#define BENCH_FORK 1
+#endif
+
+#ifndef GME_BENCH_YM2612
+	#define GME_BENCH_YM2612 "unknown"
+#endif
+
+// Allocation counting
+
+static std::atomic<long> alloc_count( 0 );
+
+#if defined (__GLIBC__)
+// Count everything, including realloc() by blargg_vector
+extern "C" {
+	void* __libc_malloc( size_t );
+	void* __libc_calloc( size_t, size_t );
+	void* __libc_realloc( void*, size_t );
+
+	void* malloc( size_t n )
+	{
+		alloc_count++;
+		return __libc_malloc( n );
+	}
+
+	void* calloc( size_t n, size_t size )
+	{
+		alloc_count++;
+		return __libc_calloc( n, size );
+	}
+
+	void* realloc( void* p, size_t n )
+	{
+		alloc_count++;
+		return __libc_realloc( p, n );
+	}
+}
+#else
+// Only counts operator new, which misses blargg_vector
+void* operator new ( size_t n )
+{
+	alloc_count++;
+	if ( void* p = malloc( n ? n : 1 ) )
+		return p;
+	abort();
+}
+
+void* operator new ( size_t n, std::nothrow_t const& ) noexcept
+{
+	alloc_count++;
+	return malloc( n ? n : 1 );
+}
+
+void operator delete ( void* p ) noexcept { free( p ); }
+
+void operator delete ( void* p, std::nothrow_t const& ) noexcept { free( p ); }
+#endif
+
+// Benchmark
+
+struct config_t
+{
+	double seconds;
+	int repeats;
+	int rate;
+	int max_latency; // msec, or 0 for default
+};
+
+struct result_t
+{
+	char error [128];
+	double best_wall;   // seconds
+	double realtime_factor;
+	double ns_per_sample;
+	long peak_rss_kb;
+	long allocs;
+	long render_allocs;
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char* open_emu( Fixture const* fx, const char* path, int rate, Music_Emu** out )
+{
+	if ( path )
+		return gme_open_file( path, out, rate );
+
+	gme_type_t type = gme_identify_extension( fx->ext );
+	if ( !type )
+		return "Format disabled at build time";
+	Music_Emu* emu = gme_new_emu( type, rate );
+	if ( !emu )
+		return "Out of memory";
+	gme_err_t err = gme_load_data( emu, &fx->data [0], (long) fx->data.size() );
+	if ( err )
+	{
+		gme_delete( emu );
+		return err;
+	}
+	*out = emu;
+	return 0;
+}
+
+static void run( config_t const& cfg, Fixture const* fx, const char* path, result_t* r )
+{
+	memset( r, 0, sizeof *r );
+	r->peak_rss_kb = -1;
+	long const start_allocs = alloc_count;
+
+	Music_Emu* emu = 0;
+	const char* err = open_emu( fx, path, cfg.rate, &emu );
+	if ( err )
+	{
+		snprintf( r->error, sizeof r->error, "%s", err );
+		return;
+	}
+	gme_ignore_silence( emu, 1 );
+	gme_set_autoload_playback_limit( emu, 0 );
+	gme_set_max_latency( emu, cfg.max_latency );
+
+	enum { buf_size = 4096 };
+	static short buf [buf_size];
+	long const total = (long) (cfg.seconds * cfg.rate) * 2;
+
+	r->best_wall = 1e300;
+	for ( int i = 0; i < cfg.repeats && !err; i++ )
+	{
+		err = gme_start_track( emu, 0 );
+		for ( int n = 0; n < 8 && !err; n++ ) // warm-up
+			err = gme_play( emu, buf_size, buf );
+
+		long const before = alloc_count;
+		bench_clock::time_point start = bench_clock::now();
+		for ( long remain = total; remain > 0 && !err; remain -= buf_size )
+			err = gme_play( emu, remain < buf_size ? (int) remain : buf_size, buf );
+		double wall = std::chrono::duration<double>( bench_clock::now() - start ).count();
+		r->render_allocs = alloc_count - before;
+
+		if ( wall < r->best_wall )
+			r->best_wall = wall;
+	}
+	gme_delete( emu );
+	r->allocs = alloc_count - start_allocs;
+
+	if ( err )
+	{
+		snprintf( r->error, sizeof r->error, "%s", err );
+		return;
+	}
+	if ( r->best_wall <= 0 )
+		r->best_wall = 1e-9;
+	r->realtime_factor = cfg.seconds / r->best_wall;
+	r->ns_per_sample = r->best_wall * 1e9 / (total / 2);
+}
+
+// Runs in child process so that peak memory is only that of this file
+static void run_isolated( config_t const& cfg, Fixture const* fx, const char* path, result_t* r )
+{
+#if BENCH_FORK
+	int fds [2];
+	if ( pipe( fds ) == 0 )
+	{
+		fflush( stdout );
+		pid_t pid = fork();
+		if ( pid == 0 )
+		{
+			close( fds [0] );
+			run( cfg, fx, path, r );
+			ssize_t written = write( fds [1], r, sizeof *r );
+			_exit( written == (ssize_t) sizeof *r ? 0 : 1 );
+		}
+		close( fds [1] );
+		if ( pid > 0 )
+		{
+			ssize_t got = read( fds [0], r, sizeof *r );
+			close( fds [0] );
+			int status = 0;
+			struct rusage usage;
+			if ( wait4( pid, &status, 0, &usage ) == pid && got == (ssize_t) sizeof *r )
+			{
+				r->peak_rss_kb = usage.ru_maxrss;
+				#ifdef __APPLE__
+					r->peak_rss_kb /= 1024; // bytes on macOS
+				#endif
+				return;
+			}
+			memset( r, 0, sizeof *r );
+			snprintf( r->error, sizeof r->error, "Benchmark process failed" );
+			return;
+		}
+		close( fds [0] );
+	}
+#endif
+	run( cfg, fx, path, r );
+}
+
+static void json_string( FILE* out, const char* s )
+{
+	fputc( '"', out );
+	for ( ; *s; s++ )
+	{
+		unsigned char c = (unsigned char) *s;
+		if ( c == '"' || c == '\\' )
+			fprintf( out, "\\%c", c );
+		else if ( c < 0x20 )
+			fprintf( out, "\\u%04x", c );
+		else
+			fputc( c, out );
+	}
+	fputc( '"', out );
+}
+
+static void usage()
+{
+	fprintf( stderr, "Usage: gme_bench [-s seconds] [-r repeats] [-R rate] [-L msec] [-j out.json] [file ...]\n" );
+	exit( EXIT_FAILURE );
+}
+
+int main( int argc, char** argv )
+{
+	config_t cfg;
+	cfg.seconds = 30;
+	cfg.repeats = 3;
+	cfg.rate    = 44100;
+	cfg.max_latency = 0;
+	const char* json_path = 0;
+
+	int i = 1;
+	for ( ; i < argc && argv [i] [0] == '-' && argv [i] [1]; i++ )
+	{
+		const char* opt = argv [i];
+		if ( i + 1 >= argc || opt [2] )
+			usage();
+		const char* arg = argv [++i];
+		switch ( opt [1] )
+		{
+			case 's': cfg.seconds = atof( arg ); break;
+			case 'r': cfg.repeats = atoi( arg ); break;
+			case 'R': cfg.rate    = atoi( arg ); break;
+			case 'L': cfg.max_latency = atoi( arg ); break;
+			case 'j': json_path   = arg; break;
+			default: usage();
+		}
+	}
+	if ( cfg.seconds <= 0 || cfg.repeats < 1 || cfg.rate < 8000 || cfg.max_latency < 0 )
+		usage();
+
+	std::vector<Fixture> fixtures;
+	make_fixtures( fixtures );
+
+	struct entry_t {
+		const char* name;
+		Fixture const* fixture;
+		const char* path;
+		result_t result;
+	};
+	std::vector<entry_t> entries;
+	for ( Fixture const& fx : fixtures )
+	{
+		entry_t e = { fx.name, &fx, 0, result_t() };
+		entries.push_back( e );
+	}
+	for ( ; i < argc; i++ )
+	{
+		entry_t e = { argv [i], 0, argv [i], result_t() };
+		entries.push_back( e );
+	}
+
+	printf( "%g seconds at %d Hz, best of %d, YM2612: %s", cfg.seconds, cfg.rate,
+			cfg.repeats, GME_BENCH_YM2612 );
+	if ( cfg.max_latency )
+		printf( ", max latency %d ms", cfg.max_latency );
+	printf( "\n\n" );
+	printf( "%-12s %10s %10s %10s %8s %8s\n",
+			"format", "realtime", "ns/sample", "peak KB", "allocs", "render" );
+	bool failed = false;
+	for ( entry_t& e : entries )
+	{
+		result_t& r = e.result;
+		run_isolated( cfg, e.fixture, e.path, &r );
+		if ( *r.error )
+		{
+			printf( "%-12s %s\n", e.name, r.error );
+			failed = true;
+			continue;
+		}
+		printf( "%-12s %9.1fx %10.1f %10ld %8ld %8ld\n", e.name, r.realtime_factor,
+				r.ns_per_sample, r.peak_rss_kb, r.allocs, r.render_allocs );
+	}
+
+	if ( json_path )
+	{
+		FILE* out = strcmp( json_path, "-" ) ? fopen( json_path, "w" ) : stdout;
+		if ( !out )
+		{
+			perror( json_path );
+			return EXIT_FAILURE;
+		}
+		fprintf( out, "{\n  \"gme_version\": \"%d.%d.%d\",\n", GME_VERSION >> 16,
+				GME_VERSION >> 8 & 0xFF, GME_VERSION & 0xFF );
+		fprintf( out, "  \"ym2612_core\": \"%s\",\n", GME_BENCH_YM2612 );
+		fprintf( out, "  \"seconds\": %g,\n  \"sample_rate\": %d,\n  \"repeats\": %d,\n",
+				cfg.seconds, cfg.rate, cfg.repeats );
+		fprintf( out, "  \"max_latency_ms\": %d,\n", cfg.max_latency );
+		fprintf( out, "  \"results\": [" );
+		for ( size_t n = 0; n < entries.size(); n++ )
+		{
+			entry_t const& e = entries [n];
+			result_t const& r = e.result;
+			fprintf( out, "%s\n    { \"name\": ", n ? "," : "" );
+			json_string( out, e.name );
+			if ( *r.error )
+			{
+				fprintf( out, ", \"error\": " );
+				json_string( out, r.error );
+			}
+			else
+			{
+				fprintf( out, ", \"realtime_factor\": %.3f, \"ns_per_sample\": %.3f"
+						", \"peak_rss_kb\": %ld, \"allocs\": %ld, \"render_allocs\": %ld",
+						r.realtime_factor, r.ns_per_sample, r.peak_rss_kb,
+						r.allocs, r.render_allocs );
+			}
+			fprintf( out, " }" );
+		}
+		fprintf( out, "\n  ]\n}\n" );
+		if ( out != stdout )
+			fclose( out );
+	}
+
+	return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,411 @@
+// Times the sample-level building blocks in isolation, on synthetic input
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_microbench [-r repeats] [name ...]
+
+Runs every benchmark whose name contains one of the given names, or all of
+them. Each benchmark does a fixed block of work per repeat and reports the
+fastest repeat, in CPU timestamp counter ticks where available (x86) and
+nanoseconds otherwise, per unit of work (one delta, one output sample, etc.).
+
+Links against the static library since it uses internal classes. Nothing
+here runs a CPU emulator, so results only move when the kernel being timed
+changes. handle_fade() and count_silence() are private to Music_Emu, so they
+are timed through Music_Emu::play() on a stub emulator that only copies
+samples, minus the same play() without them. */
+
+#include "Blip_Buffer.h"
+#include "Multi_Buffer.h"
+#include "Effects_Buffer.h"
+#include "Fir_Resampler.h"
+#include "Spc_Filter.h"
+#include "Music_Emu.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (__i386__) || defined (__x86_64__)
+	#include <x86intrin.h>
+	typedef unsigned long long ticks_t;
+	static inline ticks_t read_ticks() { return __rdtsc(); }
+	static const char tick_unit [] = "ticks";
+#elif defined (_MSC_VER) && (defined (_M_IX86) || defined (_M_X64))
+	#include <intrin.h>
+	typedef unsigned long long ticks_t;
+	static inline ticks_t read_ticks() { return __rdtsc(); }
+	static const char tick_unit [] = "ticks";
+#else
+	typedef unsigned long long ticks_t;
+	static inline ticks_t read_ticks()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+	static const char tick_unit [] = "ns";
+#endif
+
+// Keeps fastest of timed runs, in ticks per unit of work
+class Timer {
+public:
+	Timer() : best( 1e300 ), begin( 0 ) { }
+	void start() { begin = read_ticks(); }
+	void stop( long units )
+	{
+		double t = double (read_ticks() - begin) / units;
+		if ( t < best )
+			best = t;
+	}
+	double best;
+private:
+	ticks_t begin;
+};
+
+static int repeats = 200;
+
+// Keeps results from being optimized away
+static volatile int sink;
+
+long const clock_rate  = 1789773;
+long const sample_rate = 44100;
+int  const frame_clocks = 29830; // 1/60 second
+
+// Adds count deltas spread evenly over frame to each buffer
+template<int quality, int range>
+static void add_deltas( Blip_Synth<quality,range>& synth, Blip_Buffer* const* bufs, int buf_count, int count )
+{
+	int const step = frame_clocks / count;
+	for ( int b = 0; b < buf_count; b++ )
+		for ( int i = 0; i < count; i++ )
+			synth.offset( i * step + b, (i & 1) ? -(b + 100) : b + 100, bufs [b] );
+}
+
+// Blip_Buffer and Blip_Synth
+
+template<int quality>
+static void bench_synth_offset( Timer& t )
+{
+	Blip_Buffer buf;
+	if ( buf.set_sample_rate( sample_rate, 1000 / 30 ) )
+		exit( EXIT_FAILURE );
+	buf.clock_rate( clock_rate );
+	Blip_Synth<quality,20> synth;
+	synth.volume( 0.5 );
+	synth.output( &buf );
+
+	int const count = 2000;
+	int const step = frame_clocks / count;
+	for ( int r = 0; r < repeats; r++ )
+	{
+		t.start();
+		for ( int i = 0; i < count; i++ )
+			synth.offset( i * step, (i & 1) ? -5 : 5 );
+		t.stop( count );
+		buf.end_frame( frame_clocks );
+		buf.remove_samples( buf.samples_avail() );
+	}
+}
+
+template<int quality>
+static void bench_synth_offset_resampled( Timer& t )
+{
+	Blip_Buffer buf;
+	if ( buf.set_sample_rate( sample_rate, 1000 / 30 ) )
+		exit( EXIT_FAILURE );
+	buf.clock_rate( clock_rate );
+	Blip_Synth<quality,20> synth;
+	synth.volume( 0.5 );
+
+	int const count = 2000;
+	int const step = frame_clocks / count;
+	std::vector<blip_resampled_time_t> times( count );
+	for ( int r = 0; r < repeats; r++ )
+	{
+		for ( int i = 0; i < count; i++ )
+			times [i] = buf.resampled_time( i * step );
+		t.start();
+		for ( int i = 0; i < count; i++ )
+			synth.offset_resampled( times [i], (i & 1) ? -5 : 5, &buf );
+		t.stop( count );
+		buf.end_frame( frame_clocks );
+		buf.remove_samples( buf.samples_avail() );
+	}
+}
+
+template<int stereo>
+static void bench_blip_read( Timer& t )
+{
+	Blip_Buffer buf;
+	if ( buf.set_sample_rate( sample_rate, 1000 / 30 ) )
+		exit( EXIT_FAILURE );
+	buf.clock_rate( clock_rate );
+	buf.bass_freq( 16 );
+	Blip_Synth<blip_good_quality,20> synth;
+	synth.volume( 0.5 );
+	Blip_Buffer* bufs [1] = { &buf };
+
+	blip_sample_t out [sample_rate / 60 * 2 + 16];
+	for ( int r = 0; r < repeats; r++ )
+	{
+		add_deltas( synth, bufs, 1, 200 );
+		buf.end_frame( frame_clocks );
+		long const count = buf.samples_avail();
+		t.start();
+		buf.read_samples( out, count, stereo );
+		t.stop( count );
+		sink = out [count / 2];
+	}
+}
+
+// Multi_Buffer mixing
+
+static void bench_multi_buffer( Timer& t, Multi_Buffer& mb, int channel_count )
+{
+	if ( mb.set_sample_rate( sample_rate, 1000 / 30 ) )
+		exit( EXIT_FAILURE );
+	mb.clock_rate( clock_rate );
+	mb.bass_freq( 16 );
+	Blip_Synth<blip_good_quality,20> synth;
+	synth.volume( 0.1 );
+
+	// Write to every distinct buffer of every channel
+	std::vector<Blip_Buffer*> bufs;
+	for ( int c = 0; c < channel_count; c++ )
+	{
+		Multi_Buffer::channel_t ch = mb.channel( c, 0 );
+		Blip_Buffer* list [3] = { ch.center, ch.left, ch.right };
+		for ( int i = 0; i < 3; i++ )
+			if ( list [i] && std::find( bufs.begin(), bufs.end(), list [i] ) == bufs.end() )
+				bufs.push_back( list [i] );
+	}
+
+	blip_sample_t out [(sample_rate / 60 + 16) * 2];
+	for ( int r = 0; r < repeats; r++ )
+	{
+		add_deltas( synth, &bufs [0], (int) bufs.size(), 200 );
+		mb.end_frame( frame_clocks );
+		long const count = mb.samples_avail();
+		t.start();
+		mb.read_samples( out, count );
+		t.stop( count / 2 );
+		sink = out [count / 2];
+	}
+}
+
+static void bench_stereo_buffer( Timer& t )
+{
+	Stereo_Buffer buf;
+	bench_multi_buffer( t, buf, 1 );
+}
+
+static void bench_effects_buffer( Timer& t, bool effects )
+{
+	Effects_Buffer buf;
+	if ( buf.set_channel_count( 8 ) )
+		exit( EXIT_FAILURE );
+	Effects_Buffer::config_t c;
+	c.effects_enabled = effects;
+	if ( effects )
+	{
+		c.pan_1        = -0.6;
+		c.pan_2        =  0.6;
+		c.echo_level   =  0.3;
+		c.reverb_level =  0.3;
+	}
+	buf.config( c );
+	bench_multi_buffer( t, buf, 8 );
+}
+
+static void bench_effects_buffer_simple( Timer& t ) { bench_effects_buffer( t, false ); }
+
+static void bench_effects_buffer_echo( Timer& t ) { bench_effects_buffer( t, true ); }
+
+// Resampling and filtering
+
+template<int width>
+static void bench_fir_resampler( Timer& t, double in_rate )
+{
+	Fir_Resampler<width> res;
+	if ( res.buffer_size( 4096 ) )
+		exit( EXIT_FAILURE );
+	res.time_ratio( in_rate / sample_rate, 0.990, 1.0 );
+
+	int const out_size = 8192; // enough for any avail() from upsampling
+	Fir_Resampler_::sample_t out [out_size];
+	int phase = 0;
+	for ( int r = 0; r < repeats; r++ )
+	{
+		Fir_Resampler_::sample_t* in = res.buffer();
+		int const count = res.max_write() & ~1;
+		for ( int i = 0; i < count; i++ )
+			in [i] = (Fir_Resampler_::sample_t) (((phase++ * 37) & 0x3FFF) - 0x2000);
+		res.write( count );
+
+		int const avail = std::min( res.avail(), out_size ) & ~1;
+		t.start();
+		int n = res.read( out, avail );
+		t.stop( n / 2 );
+		sink = out [n / 2];
+	}
+}
+
+// Genesis FM rate to 44100 Hz (Dual_Resampler), and SPC 32000 Hz to 44100 Hz (Spc_Emu)
+static void bench_fir_resampler_12( Timer& t ) { bench_fir_resampler<12>( t, 53693100.0 / 7 / 144 ); }
+
+static void bench_fir_resampler_24( Timer& t ) { bench_fir_resampler<24>( t, 32000.0 ); }
+
+static void bench_spc_filter( Timer& t )
+{
+	SPC_Filter filter;
+	int const count = 4096;
+	SPC_Filter::sample_t in [count];
+	SPC_Filter::sample_t io [count];
+	for ( int i = 0; i < count; i++ )
+		in [i] = (SPC_Filter::sample_t) (sin( i * 0.05 ) * 20000 + ((i * 7919) & 0x7FF));
+	for ( int r = 0; r < repeats; r++ )
+	{
+		memcpy( io, in, sizeof io );
+		t.start();
+		filter.run( io, count );
+		t.stop( count / 2 );
+		sink = io [count / 2];
+	}
+}
+
+// Music_Emu sample loop
+
+static gme_type_t_ const stub_type = { "Stub", 0, 0, 0, "", 0, 0 };
+
+// Emulator whose output is a fixed block of samples
+class Stub_Emu : public Music_Emu {
+public:
+	Stub_Emu()
+	{
+		set_type( &stub_type );
+		// One non-silent sample near the start of each play() call, so that
+		// silence detection scans all of it without ever finding a long enough
+		// silence.
+		memset( pattern, 0, sizeof pattern );
+		pattern [1] = 0x1000;
+	}
+protected:
+	blargg_err_t load_mem_( byte const*, long )
+	{
+		set_track_count( 1 );
+		return 0;
+	}
+	blargg_err_t track_info_( track_info_t*, int ) const { return 0; }
+	blargg_err_t set_sample_rate_( long ) { return 0; }
+	blargg_err_t play_( long count, sample_t* out )
+	{
+		assert( count <= pattern_size );
+		memcpy( out, pattern, count * sizeof *out );
+		return 0;
+	}
+private:
+	enum { pattern_size = 2048 };
+	sample_t pattern [pattern_size];
+};
+
+enum { fade_on = 1, silence_on = 2 };
+
+static double time_emu_play( int flags )
+{
+	Stub_Emu emu;
+	if ( emu.set_sample_rate( sample_rate ) || emu.load_mem( "", 1 ) )
+		exit( EXIT_FAILURE );
+	emu.ignore_silence( !(flags & silence_on) );
+
+	int const count = 2048;
+	int const calls = 16;
+	Music_Emu::sample_t out [count];
+	Timer t;
+	for ( int r = 0; r < repeats; r++ )
+	{
+		if ( emu.start_track( 0 ) )
+			exit( EXIT_FAILURE );
+		if ( flags & fade_on )
+			emu.set_fade( 0, 40000 );
+		emu.play( count, out ); // fade starts after first call
+
+		t.start();
+		for ( int n = calls; n--; )
+			emu.play( count, out );
+		t.stop( count * calls );
+		sink = out [count / 2];
+	}
+	return t.best;
+}
+
+static void bench_emu_play( Timer& t ) { t.best = time_emu_play( 0 ); }
+
+// play() also checks for silence while fading
+static void bench_handle_fade( Timer& t )
+{
+	t.best = time_emu_play( fade_on ) - time_emu_play( silence_on );
+}
+
+static void bench_count_silence( Timer& t )
+{
+	t.best = time_emu_play( silence_on ) - time_emu_play( 0 );
+}
+
+struct bench_t {
+	const char* name;
+	const char* unit;
+	void (*run)( Timer& );
+};
+
+static bench_t const benches [] = {
+	{ "Blip_Synth<8>::offset",              "delta",  bench_synth_offset<blip_med_quality> },
+	{ "Blip_Synth<12>::offset",             "delta",  bench_synth_offset<blip_good_quality> },
+	{ "Blip_Synth<8>::offset_resampled",    "delta",  bench_synth_offset_resampled<blip_med_quality> },
+	{ "Blip_Synth<12>::offset_resampled",   "delta",  bench_synth_offset_resampled<blip_good_quality> },
+	{ "Blip_Buffer::read_samples",          "sample", bench_blip_read<0> },
+	{ "Blip_Buffer::read_samples/stereo",   "sample", bench_blip_read<1> },
+	{ "Stereo_Buffer::read_samples",        "frame",  bench_stereo_buffer },
+	{ "Effects_Buffer::read_samples",       "frame",  bench_effects_buffer_simple },
+	{ "Effects_Buffer::read_samples/echo",  "frame",  bench_effects_buffer_echo },
+	{ "Fir_Resampler<12>::read",            "frame",  bench_fir_resampler_12 },
+	{ "Fir_Resampler<24>::read",            "frame",  bench_fir_resampler_24 },
+	{ "SPC_Filter::run",                    "frame",  bench_spc_filter },
+	{ "Music_Emu::play/copy",               "sample", bench_emu_play },
+	{ "Music_Emu::handle_fade",             "sample", bench_handle_fade },
+	{ "Music_Emu::count_silence",           "sample", bench_count_silence },
+};
+
+int main( int argc, char** argv )
+{
+	int i = 1;
+	if ( i + 1 < argc && !strcmp( argv [i], "-r" ) )
+	{
+		repeats = atoi( argv [i + 1] );
+		i += 2;
+	}
+	if ( repeats < 1 || (i < argc && argv [i] [0] == '-') )
+	{
+		fprintf( stderr, "Usage: gme_microbench [-r repeats] [name ...]\n" );
+		return EXIT_FAILURE;
+	}
+
+	printf( "%-36s %10s  %s\n", "benchmark", tick_unit, "per" );
+	for ( bench_t const& b : benches )
+	{
+		bool selected = (i >= argc);
+		for ( int n = i; n < argc; n++ )
+			if ( strstr( b.name, argv [n] ) )
+				selected = true;
+		if ( !selected )
+			continue;
+
+		Timer t;
+		b.run( t );
+		printf( "%-36s %10.2f  %s\n", b.name, t.best, b.unit );
+	}
+	return 0;
+}
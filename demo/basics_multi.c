@@ -46,16 +46,15 @@ int main( int argc, char *argv[] )
 	wave_open( sample_rate, "out.wav" );
 	wave_enable_stereo();
 
-	const int frames = 64;
-	const int voices = 8;
-	const int channels = 2;
+	enum { frames = 64, max_voices = 32, channels = 2 };
+	const int voices = gme_channel_count( emu ) / channels; /* at least 8 */
 	const int buf_size = frames * voices * channels;
 
 	/* Record 10 seconds of track */
 	while ( gme_tell( emu ) < 10 * 1000L )
 	{
 		/* Sample buffer */
-		short buf [buf_size], *in = buf, *out = buf;
+		short buf [frames * max_voices * channels], *in = buf, *out = buf;
 
 		/* Fill sample buffer */
 		handle_error( gme_play( emu, buf_size, buf ) );
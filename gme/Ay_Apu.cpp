@@ -117,6 +117,24 @@ void Ay_Apu::reset()
 	write_data_( 13, 0 );
 }
 
+void Ay_Apu::copy_state( Ay_Apu const& in )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		oscs [i].period   = in.oscs [i].period;
+		oscs [i].delay    = in.oscs [i].delay;
+		oscs [i].last_amp = in.oscs [i].last_amp;
+		oscs [i].phase    = in.oscs [i].phase;
+	}
+	last_time = in.last_time;
+	memcpy( regs, in.regs, sizeof regs );
+	noise     = in.noise;
+	env.delay = in.env.delay;
+	env.wave  = env.modes [0] + (in.env.wave - in.env.modes [0]);
+	env.pos   = in.env.pos;
+	synth_.copy_config( in.synth_ );
+}
+
 void Ay_Apu::write_data_( int addr, int data )
 {
 	assert( (unsigned) addr < reg_count );
@@ -163,6 +181,7 @@ static int const tone_off  = 0x01;
 
 void Ay_Apu::run_until( blip_time_t final_end_time )
 {
+	GME_STAT_TIME( apu_time );
 	require( final_end_time >= last_time );
 
 	// noise period and initial values
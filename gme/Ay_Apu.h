@@ -6,6 +6,7 @@
 
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
+#include "Gme_Stats.h"
 
 class Ay_Apu {
 public:
@@ -37,6 +38,9 @@ public:
 	// Set treble equalization (see documentation)
 	void treble_eq( blip_eq_t const& );
 
+	// Copy emulation state and volume of other sound chip, keeping own outputs
+	void copy_state( Ay_Apu const& );
+
 public:
 	Ay_Apu();
 	typedef unsigned char byte;
@@ -77,6 +81,7 @@ inline void Ay_Apu::treble_eq( blip_eq_t const& eq ) { synth_.treble_eq( eq ); }
 
 inline void Ay_Apu::write( blip_time_t time, int addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	run_until( time );
 	write_data_( addr, data );
 }
@@ -9,6 +9,7 @@ Last validated with zexall 2006.11.21 5:26 PM
 #include "Ay_Cpu.h"
 
 #include "blargg_endian.h"
+#include "Gme_Stats.h"
 #include <string.h>
 
 //#include "z80_cpu_log.h"
@@ -87,6 +88,17 @@ void Ay_Cpu::reset( void* m )
 	memset( &r, 0, sizeof r );
 }
 
+void Ay_Cpu::copy_state( Ay_Cpu const& in, void const* in_base, void* base, size_t size )
+{
+	mem = blargg_rebase( in.mem, in_base, base, size );
+
+	check( state == &state_ && in.state == &in.state_ );
+	state_    = in.state_;
+	end_time_ = in.end_time_;
+
+	r = in.r;
+}
+
 #define TIME                        (s_time + s.base)
 #define READ_PROG( addr )           (mem [addr])
 #define INSTR( offset )             READ_PROG( pc + (offset) )
@@ -181,6 +193,8 @@ loop:
 	opcode = READ_PROG( pc );
 	pc++;
 
+	GME_STAT_ADD( instructions, 1 );
+
 	static byte const base_timing [0x100] = {
 	//   0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
 		 4,10, 7, 6, 4, 4, 7, 4, 4,11, 7, 6, 4, 4, 7, 4, // 0
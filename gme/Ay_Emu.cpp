@@ -56,7 +56,8 @@ static byte const* get_data( Ay_Emu::file_t const& file, byte const* ptr, int mi
 	long file_size = file.end - (byte const*) file.header;
 	assert( (unsigned long) pos <= (unsigned long) file_size - 2 );
 	int offset = (int16_t) get_be16( ptr );
-	if ( !offset || uint32_t (pos + offset) > uint32_t (file_size - min_size) )
+	long limit = file_size - min_size; // negative if min_size is larger than file
+	if ( !offset || limit < 0 || uint32_t (pos + offset) > uint32_t (limit) )
 		return 0;
 	return ptr + offset;
 }
@@ -118,10 +119,40 @@ struct Ay_File : Gme_Info_
 	}
 };
 
+static void probe_ay_field( Gme_Probe& out, gme_str_t* field, Ay_Emu::file_t const& file,
+		byte const* ptr )
+{
+	byte const* in = get_data( file, ptr, 1 );
+	if ( in )
+		out.set_field( field, (char const*) in, (int) min( file.end - in, (long) INT_MAX ) );
+}
+
+static blargg_err_t probe_ay( Gme_Probe& out, byte const* in, long size )
+{
+	Ay_Emu::file_t file = Ay_Emu::file_t();
+	RETURN_ERR( parse_header( in, size, &file ) );
+	out.info.track_count = file.header->max_track + 1;
+
+	probe_ay_field( out, &out.info.author,  file, file.header->author );
+	probe_ay_field( out, &out.info.comment, file, file.header->comment );
+	for ( int i = 0; i < out.info.track_count; i++ )
+	{
+		out.info.song = gme_str_t();
+		out.info.length = -1;
+		probe_ay_field( out, &out.info.song, file, file.tracks + i * 4 );
+		byte const* track_info = get_data( file, file.tracks + i * 4 + 2, 6 );
+		if ( track_info )
+			out.info.length = get_be16( track_info + 4 ) * (1000L / 50); // frames to msec
+		if ( out.report( i ) )
+			break;
+	}
+	return 0;
+}
+
 static Music_Emu* new_ay_emu () { return BLARGG_NEW Ay_Emu ; }
 static Music_Emu* new_ay_file() { return BLARGG_NEW Ay_File; }
 
-static gme_type_t_ const gme_ay_type_ = { "ZX Spectrum", 0, &new_ay_emu, &new_ay_file, "AY", 1 };
+static gme_type_t_ const gme_ay_type_ = { "ZX Spectrum", 0, &new_ay_emu, &new_ay_file, "AY", 1, &probe_ay };
 extern gme_type_t const gme_ay_type = &gme_ay_type_;
 
 // Setup
@@ -136,6 +167,19 @@ blargg_err_t Ay_Emu::load_mem_( byte const* in, long size )
 	if ( file.header->vers > 2 )
 		set_warning( "Unknown file version" );
 
+	return init_file();
+}
+
+blargg_err_t Ay_Emu::load_clone_( Gme_File const& other )
+{
+	// file data is shared, so pointers into it remain valid
+	file = STATIC_CAST(Ay_Emu const&,other).file;
+	return init_file();
+}
+
+// Sets up emulator for file data in file
+blargg_err_t Ay_Emu::init_file()
+{
 	set_voice_count( osc_count );
 	apu.volume( gain() );
 
@@ -277,6 +321,23 @@ blargg_err_t Ay_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Ay_Emu::clone_state_( Music_Emu const& other )
+{
+	Ay_Emu const& in = STATIC_CAST(Ay_Emu const&,other);
+	cpu::copy_state( in, &in, this, sizeof *this );
+	play_period   = in.play_period;
+	next_play     = in.next_play;
+	beeper_delta  = in.beeper_delta;
+	last_beeper   = in.last_beeper;
+	apu_addr      = in.apu_addr;
+	cpc_latch     = in.cpc_latch;
+	spectrum_mode = in.spectrum_mode;
+	cpc_mode      = in.cpc_mode;
+	mem           = in.mem;
+	apu.copy_state( in.apu );
+	return Classic_Emu::clone_state_( in );
+}
+
 // Emulation
 
 void Ay_Emu::cpu_out_misc( cpu_time_t time, unsigned addr, int data )
@@ -38,6 +38,8 @@ public:
 protected:
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t load_mem_( byte const*, long );
+	blargg_err_t load_clone_( Gme_File const& );
+	blargg_err_t clone_state_( Music_Emu const& );
 	blargg_err_t start_track_( int );
 	blargg_err_t run_clocks( blip_time_t&, int );
 	void set_tempo_( double );
@@ -45,6 +47,7 @@ protected:
 	void update_eq( blip_eq_t const& );
 private:
 	file_t file;
+	blargg_err_t init_file();
 
 	cpu_time_t play_period;
 	cpu_time_t next_play;
@@ -1,6 +1,7 @@
 // Blip_Buffer 0.4.1. http://www.slack.net/~ant/
 
 #include "Blip_Buffer.h"
+#include "blargg_common.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -53,7 +54,7 @@ Blip_Buffer::Blip_Buffer()
 Blip_Buffer::~Blip_Buffer()
 {
 	if ( buffer_size_ != silent_buf_size )
-		free( buffer_ );
+		blargg_free( buffer_ );
 }
 
 Silent_Blip_Buffer::Silent_Blip_Buffer()
@@ -97,7 +98,7 @@ Blip_Buffer::blargg_err_t Blip_Buffer::set_sample_rate( long new_rate, int msec
 
 	if ( buffer_size_ != new_size )
 	{
-		void* p = realloc( buffer_, (new_size + blip_buffer_extra_) * sizeof *buffer_ );
+		void* p = blargg_realloc( buffer_, (new_size + blip_buffer_extra_) * sizeof *buffer_ );
 		if ( !p )
 			return "Out of memory";
 		buffer_ = (buf_t_*) p;
@@ -186,6 +187,20 @@ void Blip_Buffer::remove_samples( long count )
 	}
 }
 
+void Blip_Buffer::copy_state( Blip_Buffer const& in )
+{
+	assert( buffer_size_ == in.buffer_size_ ); // must have same sample rate and length
+	factor_       = in.factor_;
+	offset_       = in.offset_;
+	reader_accum_ = in.reader_accum_;
+	bass_shift_   = in.bass_shift_;
+	clock_rate_   = in.clock_rate_;
+	bass_freq_    = in.bass_freq_;
+	modified_     = in.modified_;
+	if ( buffer_ )
+		memcpy( buffer_, in.buffer_, (buffer_size_ + blip_buffer_extra_) * sizeof *buffer_ );
+}
+
 // Blip_Synth_
 
 Blip_Synth_Fast_::Blip_Synth_Fast_()
@@ -200,11 +215,17 @@ void Blip_Synth_Fast_::volume_unit( double new_unit )
 	delta_factor = int (new_unit * (1L << blip_sample_bits) + 0.5);
 }
 
+void Blip_Synth_Fast_::copy_config( Blip_Synth_Fast_ const& in )
+{
+	delta_factor = in.delta_factor;
+}
+
 #if !BLIP_BUFFER_FAST
 
 Blip_Synth_::Blip_Synth_( short* p, int w ) :
 	impulses( p ),
-	width( w )
+	width( w ),
+	eq( -8.0 ) // default eq if it hasn't been set yet
 {
 	volume_unit_ = 0.0;
 	kernel_unit = 0;
@@ -303,8 +324,19 @@ void Blip_Synth_::adjust_impulse()
 	//      printf( "%5ld,", impulses [j * blip_res + i + 1] );
 }
 
-void Blip_Synth_::treble_eq( blip_eq_t const& eq )
+void Blip_Synth_::treble_eq( blip_eq_t const& new_eq )
 {
+	eq = new_eq;
+	eq.discard_volume = false;
+	if ( new_eq.discard_volume )
+	{
+		// back to how it was created; kernel is generated when volume is next set
+		volume_unit_ = 0.0;
+		kernel_unit  = 0;
+		delta_factor = 0;
+		return;
+	}
+
 	float fimpulse [blip_res / 2 * (blip_widest_impulse_ - 1) + blip_res * 2];
 
 	int const half_size = blip_res / 2 * (width - 1);
@@ -352,13 +384,23 @@ void Blip_Synth_::treble_eq( blip_eq_t const& eq )
 	}
 }
 
+void Blip_Synth_::copy_config( Blip_Synth_ const& in )
+{
+	assert( width == in.width );
+	volume_unit_ = in.volume_unit_;
+	kernel_unit  = in.kernel_unit;
+	eq           = in.eq;
+	delta_factor = in.delta_factor;
+	memcpy( impulses, in.impulses, impulses_size() * sizeof *impulses );
+}
+
 void Blip_Synth_::volume_unit( double new_unit )
 {
 	if ( new_unit != volume_unit_ )
 	{
-		// use default eq if it hasn't been set yet
+		// generate kernel if it hasn't been yet
 		if ( !kernel_unit )
-			treble_eq( -8.0 );
+			treble_eq( eq );
 
 		volume_unit_ = new_unit;
 		double factor = new_unit * (1L << blip_sample_bits) / kernel_unit;
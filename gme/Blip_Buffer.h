@@ -84,6 +84,9 @@ public:
 	// Mix 'count' samples from 'buf' into buffer.
 	void mix_samples( blip_sample_t const* buf, long count );
 
+	// Copy samples and timing from other buffer of same sample rate and length
+	void copy_state( Blip_Buffer const& );
+
 	// not documented yet
 	void set_modified() { modified_ = 1; }
 	int clear_modified() { int b = modified_; modified_ = 0; return b; }
@@ -140,12 +143,36 @@ private:
 	#endif
 #endif
 
+// Low-pass equalization parameters
+class blip_eq_t {
+public:
+	// Logarithmic rolloff to treble dB at half sampling rate. Negative values reduce
+	// treble, small positive values (0 to 5.0) increase treble.
+	blip_eq_t( double treble_db = 0 );
+
+	// See blip_buffer.txt
+	blip_eq_t( double treble, long rolloff_freq, long sample_rate, long cutoff_freq = 0 );
+
+	// Same eq, except that setting it also discards synth's volume and kernel, as
+	// if synth had just been created. Kernel then only depends on volume changes
+	// made after this, which lets an emulator be reset for reuse.
+	blip_eq_t discarding_volume() const;
+
+private:
+	double treble;
+	long rolloff_freq;
+	long sample_rate;
+	long cutoff_freq;
+	bool discard_volume;
+	void generate( float* out, int count ) const;
+	friend class Blip_Synth_;
+};
+
 	// Internal
 	typedef blip_ulong blip_resampled_time_t;
 	int const blip_widest_impulse_ = 16;
 	int const blip_buffer_extra_ = blip_widest_impulse_ + 2;
 	int const blip_res = 1 << BLIP_PHASE_BITS;
-	class blip_eq_t;
 
 	class Blip_Synth_Fast_ {
 	public:
@@ -154,6 +181,7 @@ private:
 		int delta_factor;
 
 		void volume_unit( double );
+		void copy_config( Blip_Synth_Fast_ const& );
 		Blip_Synth_Fast_();
 		void treble_eq( blip_eq_t const& ) { }
 	};
@@ -165,6 +193,7 @@ private:
 		int delta_factor;
 
 		void volume_unit( double );
+		void copy_config( Blip_Synth_ const& );
 		Blip_Synth_( short* impulses, int width );
 		void treble_eq( blip_eq_t const& );
 	private:
@@ -172,6 +201,7 @@ private:
 		short* const impulses;
 		int const width;
 		blip_long kernel_unit;
+		blip_eq_t eq; // kept so kernel can be generated once volume is set
 		int impulses_size() const { return blip_res / 2 * width + 1; }
 		void adjust_impulse();
 	};
@@ -193,6 +223,10 @@ public:
 	// Configure low-pass filter (see blip_buffer.txt)
 	void treble_eq( blip_eq_t const& eq )       { impl.treble_eq( eq ); }
 
+	// Use same volume and low-pass filter as other synth. Setting these again
+	// doesn't always give an identical kernel, since it depends on earlier settings.
+	void copy_config( Blip_Synth const& other ) { impl.copy_config( other.impl ); }
+
 	// Get/set Blip_Buffer used for output
 	Blip_Buffer* output() const                 { return impl.buf; }
 	void output( Blip_Buffer* b )               { impl.buf = b; impl.last_amp = 0; }
@@ -237,25 +271,6 @@ public:
 	Blip_Synth& operator=(const Blip_Synth  &) = delete;
 };
 
-// Low-pass equalization parameters
-class blip_eq_t {
-public:
-	// Logarithmic rolloff to treble dB at half sampling rate. Negative values reduce
-	// treble, small positive values (0 to 5.0) increase treble.
-	blip_eq_t( double treble_db = 0 );
-
-	// See blip_buffer.txt
-	blip_eq_t( double treble, long rolloff_freq, long sample_rate, long cutoff_freq = 0 );
-
-private:
-	double treble;
-	long rolloff_freq;
-	long sample_rate;
-	long cutoff_freq;
-	void generate( float* out, int count ) const;
-	friend class Blip_Synth_;
-};
-
 int const blip_sample_bits = 30;
 
 // Dummy Blip_Buffer to direct sound output to, for easy muting without
@@ -337,6 +352,7 @@ private:
 // End of public interface
 
 #include <assert.h>
+#include "Gme_Stats.h"
 
 template<int quality,int range>
 inline void Blip_Synth<quality,range>::offset_resampled( blip_resampled_time_t time,
@@ -345,6 +361,7 @@ inline void Blip_Synth<quality,range>::offset_resampled( blip_resampled_time_t t
 	// Fails if time is beyond end of Blip_Buffer, due to a bug in caller code or the
 	// need for a longer buffer as set by set_sample_rate().
 	assert( (blip_long) (time >> BLIP_BUFFER_ACCURACY) < blip_buf->buffer_size_ );
+	GME_STAT_ADD( blip_deltas, 1 );
 	delta *= impl.delta_factor;
 	blip_long* BLIP_RESTRICT buf = blip_buf->buffer_ + (time >> BLIP_BUFFER_ACCURACY);
 	int phase = (int) (time >> (BLIP_BUFFER_ACCURACY - BLIP_PHASE_BITS) & (blip_res - 1));
@@ -469,9 +486,15 @@ void Blip_Synth<quality,range>::update( blip_time_t t, int amp )
 }
 
 inline blip_eq_t::blip_eq_t( double t ) :
-		treble( t ), rolloff_freq( 0 ), sample_rate( 44100 ), cutoff_freq( 0 ) { }
+		treble( t ), rolloff_freq( 0 ), sample_rate( 44100 ), cutoff_freq( 0 ), discard_volume( false ) { }
 inline blip_eq_t::blip_eq_t( double t, long rf, long sr, long cf ) :
-		treble( t ), rolloff_freq( rf ), sample_rate( sr ), cutoff_freq( cf ) { }
+		treble( t ), rolloff_freq( rf ), sample_rate( sr ), cutoff_freq( cf ), discard_volume( false ) { }
+inline blip_eq_t blip_eq_t::discarding_volume() const
+{
+	blip_eq_t eq( *this );
+	eq.discard_volume = true;
+	return eq;
+}
 
 inline int  Blip_Buffer::length() const         { return length_; }
 inline long Blip_Buffer::samples_avail() const
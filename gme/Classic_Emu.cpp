@@ -3,6 +3,7 @@
 #include "Classic_Emu.h"
 
 #include "Multi_Buffer.h"
+#include "Gme_Stats.h"
 #include <string.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -43,6 +44,14 @@ void Classic_Emu::set_equalizer_( equalizer_t const& eq )
 		buf->bass_freq( (int) equalizer().bass );
 }
 
+void Classic_Emu::reset_settings_()
+{
+	// Each lower volume attenuates a synth's kernel further, so it depends on every
+	// volume set since synth was created. Start synths over as a new emulator's are,
+	// keeping eq; loading file sets their volumes again.
+	update_eq( blip_eq_t( equalizer().treble ).discarding_volume() );
+}
+
 blargg_err_t Classic_Emu::set_sample_rate_( long rate )
 {
 	if ( !buf )
@@ -115,15 +124,35 @@ blargg_err_t Classic_Emu::play_( long count, sample_t* out )
 				remute_voices();
 			}
 			int msec = buf->length();
+			if ( max_latency() && max_latency() < msec )
+				msec = max_latency();
 			blip_time_t clocks_emulated = (int32_t) msec * clock_rate_ / 1000;
-			RETURN_ERR( run_clocks( clocks_emulated, msec ) );
+			{
+				GME_STAT_TIME( cpu_time );
+				RETURN_ERR( run_clocks( clocks_emulated, msec ) );
+			}
 			assert( clocks_emulated );
+			GME_STAT_ADD( cpu_clocks, clocks_emulated );
 			buf->end_frame( clocks_emulated );
 		}
 	}
 	return 0;
 }
 
+blargg_err_t Classic_Emu::clone_state_( Music_Emu const& other )
+{
+	Classic_Emu const& in = STATIC_CAST(Classic_Emu const&,other);
+	if ( !stereo_buffer != !in.stereo_buffer )
+		return "Can't clone emulator with different kind of buffer";
+	RETURN_ERR( buf->copy_state( *in.buf ) );
+	clock_rate_ = in.clock_rate_;
+
+	// remute voices if other was going to
+	buf_changed_count = buf->channels_changed_count() -
+			(in.buf->channels_changed_count() - in.buf_changed_count);
+	return Music_Emu::clone_state_( in );
+}
+
 // Rom_Data
 
 blargg_err_t Rom_Data_::load_rom_data_( Data_Reader& in,
@@ -157,6 +186,15 @@ blargg_err_t Rom_Data_::load_rom_data_( Data_Reader& in,
 	return 0;
 }
 
+void Rom_Data_::share_( Rom_Data_ const& in )
+{
+	rom.share( in.rom );
+	file_size_ = in.file_size_;
+	rom_addr   = in.rom_addr;
+	mask       = in.mask;
+	size_      = in.size_;
+}
+
 void Rom_Data_::set_addr_( long addr, int unit )
 {
 	rom_addr = addr - unit - pad_extra;
@@ -32,7 +32,9 @@ protected:
 	blargg_err_t set_sample_rate_( long sample_rate ) override;
 	void mute_voices_( int ) override;
 	void set_equalizer_( equalizer_t const& ) override;
+	void reset_settings_() override;
 	blargg_err_t play_( long, sample_t* ) override;
+	blargg_err_t clone_state_( Music_Emu const& ) override;
 private:
 	Multi_Buffer* buf;
 	Multi_Buffer* stereo_buffer; // NULL if using custom buffer
@@ -56,7 +58,7 @@ public:
 	typedef unsigned char byte;
 protected:
 	enum { pad_extra = 8 };
-	blargg_vector<byte> rom;
+	blargg_shared_vector<byte> rom;
 	long file_size_;
 	int32_t rom_addr;
 	int32_t mask;
@@ -65,6 +67,7 @@ protected:
 	blargg_err_t load_rom_data_( Data_Reader& in, int header_size, void* header_out,
 			int fill, long pad_size );
 	void set_addr_( long addr, int unit );
+	void share_( Rom_Data_ const& );
 };
 
 template<int unit>
@@ -78,6 +81,9 @@ public:
 		return load_rom_data_( in, header_size, header_out, fill, pad_size );
 	}
 
+	// Use same file data and address as other, without copying it
+	void share( Rom_Data const& other ) { share_( other ); }
+
 	// Size of file data read in (excluding header)
 	long file_size() const { return file_size_; }
 
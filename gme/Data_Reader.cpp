@@ -3,6 +3,7 @@
 #include "Data_Reader.h"
 
 #include "blargg_endian.h"
+#include "Gme_Rt_Check.h"
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
@@ -173,7 +174,7 @@ Mem_File_Reader::Mem_File_Reader( const void* p, long s ) :
 Mem_File_Reader::~Mem_File_Reader()
 {
 	if ( m_ownedPtr )
-		free( const_cast<char*>( m_begin ) ); // see gz_compress for the malloc
+		blargg_free( const_cast<char*>( m_begin ) ); // see gz_compress for the malloc
 }
 #endif
 
@@ -202,6 +203,16 @@ blargg_err_t Mem_File_Reader::seek( long n )
 
 #ifdef HAVE_ZLIB_H
 
+// zlib's memory comes from the library's allocator too
+static voidpf zlib_alloc( voidpf, uInt items, uInt size )
+{
+	if ( size && items > (size_t) -1 / size )
+		return Z_NULL;
+	return blargg_malloc( (size_t) items * size );
+}
+
+static void zlib_free( voidpf, voidpf p ) { blargg_free( p ); }
+
 bool Mem_File_Reader::gz_decompress()
 {
 	if ( m_size >= 2 && memcmp(m_begin, gz_magic, 2) != 0 )
@@ -215,7 +226,7 @@ bool Mem_File_Reader::gz_decompress()
 	const vec_size half_length = static_cast<vec_size>( m_size / 2 );
 
 	// We use malloc/friends here so we can realloc to grow buffer if needed
-	char *raw_data = reinterpret_cast<char *> ( malloc( full_length ) );
+	char *raw_data = reinterpret_cast<char *> ( blargg_malloc( full_length ) );
 	size_t raw_data_size = full_length;
 	if ( !raw_data )
 		return false;
@@ -224,8 +235,9 @@ bool Mem_File_Reader::gz_decompress()
 	strm.next_in   = const_cast<Bytef *>( reinterpret_cast<const Bytef *>( m_begin ) );
 	strm.avail_in  = static_cast<uInt>( m_size );
 	strm.total_out = 0;
-	strm.zalloc    = Z_NULL;
-	strm.zfree     = Z_NULL;
+	strm.zalloc    = zlib_alloc;
+	strm.zfree     = zlib_free;
+	strm.opaque    = Z_NULL;
 
 	bool done = false;
 
@@ -233,7 +245,7 @@ bool Mem_File_Reader::gz_decompress()
 	// header.
 	if ( inflateInit2(&strm, (16 + MAX_WBITS)) != Z_OK )
 	{
-		free( raw_data );
+		blargg_free( raw_data );
 		return false;
 	}
 
@@ -243,10 +255,13 @@ bool Mem_File_Reader::gz_decompress()
 		if ( strm.total_out >= raw_data_size )
 		{
 			raw_data_size += half_length;
-			raw_data = reinterpret_cast<char *>( realloc( raw_data, raw_data_size ) );
-			if ( !raw_data ) {
+			char *grown = reinterpret_cast<char *>( blargg_realloc( raw_data, raw_data_size ) );
+			if ( !grown ) {
+				inflateEnd( &strm );
+				blargg_free( raw_data );
 				return false;
 			}
+			raw_data = grown;
 		}
 
 		strm.next_out  = reinterpret_cast<Bytef *>( raw_data + strm.total_out );
@@ -262,7 +277,7 @@ bool Mem_File_Reader::gz_decompress()
 
 	if ( inflateEnd(&strm) != Z_OK )
 	{
-		free( raw_data );
+		blargg_free( raw_data );
 		return false;
 	}
 
@@ -346,6 +361,7 @@ Std_File_Reader::~Std_File_Reader() { close(); }
 
 blargg_err_t Std_File_Reader::open( const char* path )
 {
+	GME_RT_UNSAFE( file_io, "file open" );
 #ifdef HAVE_ZLIB_H
 	// zlib transparently handles uncompressed data if magic header
 	// not present but we still need to grab size
@@ -377,6 +393,7 @@ long Std_File_Reader::size() const
 
 long Std_File_Reader::read_avail( void* p, long s )
 {
+	GME_RT_UNSAFE( file_io, "file read" );
 #ifdef HAVE_ZLIB_H
 	if ( file_ && s > 0 && static_cast<unsigned long>(s) <= UINT_MAX ) {
 		return gzread( reinterpret_cast<gzFile>(file_),
@@ -395,6 +412,7 @@ blargg_err_t Std_File_Reader::read( void* p, long s )
 	if ( !file_ )
 		return "NULL FILE pointer";
 
+	GME_RT_UNSAFE( file_io, "file read" );
 	RETURN_VALIDITY_CHECK( s > 0 && static_cast<unsigned long>(s) <= UINT_MAX );
 #ifdef HAVE_ZLIB_H
 	const auto &gzfile = reinterpret_cast<gzFile>( file_ );
@@ -428,6 +446,7 @@ blargg_err_t Std_File_Reader::seek( long n )
 {
 	if ( !file_ )
 		return "NULL FILE pointer";
+	GME_RT_UNSAFE( file_io, "file seek" );
 #ifdef HAVE_ZLIB_H
 	if ( gzseek( reinterpret_cast<gzFile>( file_ ), n, SEEK_SET ) >= 0 )
 		return nullptr;
@@ -447,6 +466,7 @@ void Std_File_Reader::close()
 {
 	if ( file_ )
 	{
+		GME_RT_UNSAFE( file_io, "file close" );
 #ifdef HAVE_ZLIB_H
 		gzclose( reinterpret_cast<gzFile>( file_ ) );
 #else
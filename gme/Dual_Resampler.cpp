@@ -2,6 +2,7 @@
 
 #include "Dual_Resampler.h"
 
+#include "Gme_Stats.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -22,24 +23,58 @@ Dual_Resampler::Dual_Resampler() :
 	sample_buf_size(0),
 	oversamples_per_frame(-1),
 	buf_pos(-1),
-	resampler_size(0)
+	resampler_size(0),
+	fm_channels(0),
+	buf_count(0),
+	frame_size(2)
 {
 }
 
 Dual_Resampler::~Dual_Resampler() { }
 
+void Dual_Resampler::enable_multi_channel( int fm_count, int bufs )
+{
+	require( fm_count <= max_fm_channels );
+	fm_channels = fm_count;
+	buf_count   = bufs;
+	frame_size  = fm_count ? (fm_count + bufs) * 2 : 2;
+}
+
+double Dual_Resampler::setup( double oversample, double rolloff, double gain )
+{
+	for ( int i = 0; i < fm_channels; i++ )
+		channel_resamplers [i].time_ratio( oversample, rolloff, gain * 0.5 );
+	return resampler.time_ratio( oversample, rolloff, gain * 0.5 );
+}
+
 blargg_err_t Dual_Resampler::reset( int pairs )
 {
 	// expand allocations a bit
-	RETURN_ERR( sample_buf.resize( (pairs + (pairs >> 2)) * 2 ) );
+	RETURN_ERR( sample_buf.resize( (pairs + (pairs >> 2)) * frame_size ) );
+	sample_buf_size = 0; // ratio might have changed, so always recalculate
 	resize( pairs );
 	resampler_size = oversamples_per_frame + (oversamples_per_frame >> 2);
+	if ( fm_channels )
+	{
+		RETURN_ERR( fm_buf.resize( resampler_size * fm_channels ) );
+		RETURN_ERR( channel_buf.resize( (pairs + (pairs >> 2)) * 2 ) );
+		for ( int i = 0; i < fm_channels; i++ )
+			RETURN_ERR( channel_resamplers [i].buffer_size( resampler_size ) );
+	}
 	return resampler.buffer_size( resampler_size );
 }
 
+void Dual_Resampler::clear()
+{
+	buf_pos = sample_buf_size;
+	resampler.clear();
+	for ( int i = 0; i < fm_channels; i++ )
+		channel_resamplers [i].clear();
+}
+
 void Dual_Resampler::resize( int pairs )
 {
-	int new_sample_buf_size = pairs * 2;
+	int new_sample_buf_size = pairs * frame_size;
 	if ( sample_buf_size != new_sample_buf_size )
 	{
 		if ( (unsigned) new_sample_buf_size > sample_buf.size() )
@@ -48,17 +83,32 @@ void Dual_Resampler::resize( int pairs )
 			return;
 		}
 		sample_buf_size = new_sample_buf_size;
-		oversamples_per_frame = int (pairs * resampler.ratio()) * 2 + 2;
+		// When upsampling, input for the last output pair can be past the
+		// truncated count, so that needs an extra pair
+		int extra = (resampler.ratio() < 1.0) ? 2 : 1;
+		oversamples_per_frame = (int (pairs * resampler.ratio()) + extra) * 2;
 		clear();
 	}
 }
 
+void Dual_Resampler::copy_state( Dual_Resampler const& in )
+{
+	assert( sample_buf_size == in.sample_buf_size && fm_channels == in.fm_channels &&
+			oversamples_per_frame == in.oversamples_per_frame );
+	memcpy( sample_buf.begin(), in.sample_buf.begin(), sample_buf_size * sizeof sample_buf [0] );
+	buf_pos = in.buf_pos;
+	resampler.copy_state( in.resampler );
+	for ( int i = 0; i < fm_channels; i++ )
+		channel_resamplers [i].copy_state( in.channel_resamplers [i] );
+}
+
 void Dual_Resampler::play_frame_( Blip_Buffer& blip_buf, dsample_t* out )
 {
 	long pair_count = sample_buf_size >> 1;
 	blip_time_t blip_time = blip_buf.count_clocks( pair_count );
 	int sample_count = oversamples_per_frame - resampler.written();
 
+	GME_STAT_ADD( cpu_clocks, blip_time );
 	int new_count = play_frame( blip_time, sample_count, resampler.buffer() );
 	assert( new_count < resampler_size );
 
@@ -78,7 +128,97 @@ void Dual_Resampler::play_frame_( Blip_Buffer& blip_buf, dsample_t* out )
 	blip_buf.remove_samples( pair_count );
 }
 
+void Dual_Resampler::play_frame_multi( Blip_Buffer* const* bufs, dsample_t* out )
+{
+	long pair_count = sample_buf_size / frame_size;
+	blip_time_t blip_time = bufs [0]->count_clocks( pair_count );
+	int sample_count = oversamples_per_frame - channel_resamplers [0].written();
+
+	GME_STAT_ADD( cpu_clocks, blip_time );
+	int new_count = play_frame( blip_time, sample_count, fm_buf.begin() );
+	assert( new_count < resampler_size );
+
+	// Resample each FM channel separately
+	for ( int i = 0; i < fm_channels; i++ )
+	{
+		Fir_Resampler<12>& r = channel_resamplers [i];
+		dsample_t const* in = &fm_buf [i * 2];
+		dsample_t* p = r.buffer();
+		for ( int n = new_count >> 1; n--; )
+		{
+			p [0] = in [0];
+			p [1] = in [1];
+			p  += 2;
+			in += fm_channels * 2;
+		}
+		r.write( new_count );
+
+	#ifdef	NDEBUG // Avoid warning when asserts are disabled
+		r.read( channel_buf.begin(), pair_count * 2 );
+	#else
+		long count = r.read( channel_buf.begin(), pair_count * 2 );
+		assert( count == pair_count * 2 );
+	#endif
+
+		in = channel_buf.begin();
+		dsample_t* o = &out [i * 2];
+		for ( int n = pair_count; n--; )
+		{
+			int32_t l = (int32_t) in [0] * 2;
+			if ( (int16_t) l != l )
+				l = 0x7FFF - (l >> 24);
+
+			int32_t r = (int32_t) in [1] * 2;
+			if ( (int16_t) r != r )
+				r = 0x7FFF - (r >> 24);
+
+			in += 2;
+			o [0] = l;
+			o [1] = r;
+			o += frame_size;
+		}
+	}
+
+	// Each Blip_Buffer gets its own stereo pair
+	GME_STAT_TIME( synth_time );
+	for ( int i = 0; i < buf_count; i++ )
+	{
+		Blip_Buffer& blip_buf = *bufs [i];
+		blip_buf.end_frame( blip_time );
+		assert( blip_buf.samples_avail() == pair_count );
+
+		Blip_Reader sn;
+		int bass = sn.begin( blip_buf );
+		dsample_t* o = &out [(fm_channels + i) * 2];
+		for ( int n = pair_count; n--; )
+		{
+			int32_t s = sn.read();
+			if ( (int16_t) s != s )
+				s = 0x7FFF - (s >> 24);
+			sn.next( bass );
+
+			o [0] = s;
+			o [1] = s;
+			o += frame_size;
+		}
+		sn.end( blip_buf );
+		blip_buf.remove_samples( pair_count );
+	}
+}
+
 void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_buf )
+{
+	Blip_Buffer* bufs [1] = { &blip_buf };
+	dual_play_( count, out, bufs );
+}
+
+void Dual_Resampler::dual_play_multi( long count, dsample_t* out, Blip_Buffer* const* bufs )
+{
+	require( fm_channels );
+	dual_play_( count, out, bufs );
+}
+
+void Dual_Resampler::dual_play_( long count, dsample_t* out, Blip_Buffer* const* bufs )
 {
 	// empty extra buffer
 	long remain = sample_buf_size - buf_pos;
@@ -95,7 +235,10 @@ void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_bu
 	// entire frames
 	while ( count >= (long) sample_buf_size )
 	{
-		play_frame_( blip_buf, out );
+		if ( fm_channels )
+			play_frame_multi( bufs, out );
+		else
+			play_frame_( *bufs [0], out );
 		out += sample_buf_size;
 		count -= sample_buf_size;
 	}
@@ -103,7 +246,10 @@ void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_bu
 	// extra
 	if ( count )
 	{
-		play_frame_( blip_buf, sample_buf.begin() );
+		if ( fm_channels )
+			play_frame_multi( bufs, sample_buf.begin() );
+		else
+			play_frame_( *bufs [0], sample_buf.begin() );
 		buf_pos = count;
 		memcpy( out, sample_buf.begin(), count * sizeof *out );
 		out += count;
@@ -112,6 +258,7 @@ void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_bu
 
 void Dual_Resampler::mix_samples( Blip_Buffer& blip_buf, dsample_t* out )
 {
+	GME_STAT_TIME( synth_time );
 	Blip_Reader sn;
 	int bass = sn.begin( blip_buf );
 	const dsample_t* in = sample_buf.begin();
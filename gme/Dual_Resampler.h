@@ -21,9 +21,21 @@ public:
 
 	void dual_play( long count, dsample_t* out, Blip_Buffer& );
 
+	// Copy buffered samples of other resampler, which must have the same setup
+	void copy_state( Dual_Resampler const& );
+
+	// Enables multi-channel output, where each output sample holds fm_channels
+	// stereo FM channels followed by a stereo pair for each of buf_count
+	// Blip_Buffers. play_frame() must then write fm_channels stereo pairs for
+	// each sample, though pcm_count and its return value still count one stereo
+	// pair per sample. Must be called before setup().
+	void enable_multi_channel( int fm_channels, int buf_count );
+	void dual_play_multi( long count, dsample_t* out, Blip_Buffer* const* bufs );
+
 protected:
 	virtual int play_frame( blip_time_t, int pcm_count, dsample_t* pcm_out ) = 0;
 private:
+	enum { max_fm_channels = 6 };
 
 	blargg_vector<dsample_t> sample_buf;
 	int sample_buf_size;
@@ -34,17 +46,16 @@ private:
 	Fir_Resampler<12> resampler;
 	void mix_samples( Blip_Buffer&, dsample_t* );
 	void play_frame_( Blip_Buffer&, dsample_t* );
+	void dual_play_( long count, dsample_t* out, Blip_Buffer* const* bufs );
+
+	// multi-channel
+	int fm_channels;
+	int buf_count;
+	int frame_size; // output values per sample
+	Fir_Resampler<12> channel_resamplers [max_fm_channels];
+	blargg_vector<dsample_t> fm_buf;
+	blargg_vector<dsample_t> channel_buf;
+	void play_frame_multi( Blip_Buffer* const*, dsample_t* );
 };
 
-inline double Dual_Resampler::setup( double oversample, double rolloff, double gain )
-{
-	return resampler.time_ratio( oversample, rolloff, gain * 0.5 );
-}
-
-inline void Dual_Resampler::clear()
-{
-	buf_pos = sample_buf_size;
-	resampler.clear();
-}
-
 #endif
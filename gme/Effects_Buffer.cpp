@@ -2,6 +2,7 @@
 
 #include "Effects_Buffer.h"
 
+#include "Gme_Stats.h"
 #include <string.h>
 #include <algorithm>
 
@@ -70,6 +71,9 @@ void Effects_Buffer::set_depth( double d )
 Effects_Buffer::Effects_Buffer( int num_voices, bool center_only )
 	: Multi_Buffer( 2*num_voices )
 	, max_voices(num_voices)
+	, min_voices(num_voices)
+	, clock_rate_(0)
+	, bass_freq_(0)
 	, bufs(max_voices * (center_only ? (max_buf_count - 4) : max_buf_count))
 	, chan_types(max_voices * chan_types_count)
 	, stereo_remain(0)
@@ -77,8 +81,8 @@ Effects_Buffer::Effects_Buffer( int num_voices, bool center_only )
 	// TODO: Reorder buf_count to be initialized before bufs to factor out channel sizing
 	, buf_count(max_voices * (center_only ? (max_buf_count - 4) : max_buf_count))
 	, effects_enabled(false)
-	, reverb_buf(max_voices, std::vector<blip_sample_t>(reverb_size))
-	, echo_buf(max_voices, std::vector<blip_sample_t>(echo_size))
+	, reverb_buf(max_voices, delay_buf_t(reverb_size))
+	, echo_buf(max_voices, delay_buf_t(echo_size))
 	, reverb_pos(max_voices)
 	, echo_pos(max_voices)
 {
@@ -110,21 +114,56 @@ blargg_err_t Effects_Buffer::set_sample_rate( long rate, int msec ) noexcept
 
 	for ( int i = 0; i < buf_count; i++ )
 		RETURN_ERR( bufs [i].set_sample_rate( rate, msec ) );
+	RETURN_ERR( Multi_Buffer::set_sample_rate( bufs [0].sample_rate(), bufs [0].length() ) );
 
-	config( config_ );
+	config( config_ ); // echo and reverb delays depend on new rate
 	clear();
 
-	return Multi_Buffer::set_sample_rate( bufs [0].sample_rate(), bufs [0].length() );
+	return 0;
+}
+
+blargg_err_t Effects_Buffer::set_channel_count( int n )
+{
+	// "mix everything to one" buffers never grow
+	int voices = max( n, min_voices );
+	if ( min_voices > 1 && voices != max_voices )
+	{
+		int buf_count_per_voice = buf_count / max_voices;
+		max_voices = voices;
+		buf_count  = voices * buf_count_per_voice;
+		vector_t<Blip_Buffer>( buf_count ).swap( bufs );
+		chan_types.resize( voices * chan_types_count );
+		reverb_buf.resize( voices, delay_buf_t( reverb_size ) );
+		echo_buf.resize( voices, delay_buf_t( echo_size ) );
+		reverb_pos.resize( voices );
+		echo_pos.resize( voices );
+		set_samples_per_frame( voices * 2 );
+
+		// new buffers need the same setup as the old ones
+		if ( sample_rate() )
+		{
+			RETURN_ERR( set_sample_rate( sample_rate(), length() ) );
+			clock_rate( clock_rate_ );
+			bass_freq( bass_freq_ );
+		}
+		else
+		{
+			config( config_ );
+		}
+	}
+	return Multi_Buffer::set_channel_count( n );
 }
 
 void Effects_Buffer::clock_rate( long rate )
 {
+	clock_rate_ = rate;
 	for ( int i = 0; i < buf_count; i++ )
 		bufs [i].clock_rate( rate );
 }
 
 void Effects_Buffer::bass_freq( int freq )
 {
+	bass_freq_ = freq;
 	for ( int i = 0; i < buf_count; i++ )
 		bufs [i].bass_freq( freq );
 }
@@ -134,6 +173,9 @@ void Effects_Buffer::clear()
 	stereo_remain = 0;
 	effect_remain = 0;
 
+	// no echo left to play out, so effects that were just disabled don't matter
+	effects_enabled = config_.effects_enabled;
+
 	for(int i=0; i<max_voices; i++)
 	{
 		if ( echo_buf[i].size() )
@@ -141,12 +183,36 @@ void Effects_Buffer::clear()
 
 		if ( reverb_buf[i].size() )
 			memset( &reverb_buf[i][0], 0, reverb_size * sizeof reverb_buf[i][0] );
+
+		echo_pos   [i] = 0;
+		reverb_pos [i] = 0;
 	}
 
 	for ( int i = 0; i < buf_count; i++ )
 		bufs [i].clear();
 }
 
+blargg_err_t Effects_Buffer::copy_state( Multi_Buffer const& other )
+{
+	Effects_Buffer const& in = STATIC_CAST(Effects_Buffer const&,other);
+	if ( in.max_voices != max_voices || in.buf_count != buf_count )
+		return "Effects buffer has different channel count";
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].copy_state( in.bufs [i] );
+	stereo_remain   = in.stereo_remain;
+	effect_remain   = in.effect_remain;
+	effects_enabled = in.effects_enabled;
+	for ( int i = 0; i < max_voices; i++ )
+	{
+		// same sizes, so no allocation
+		echo_buf   [i] = in.echo_buf   [i];
+		reverb_buf [i] = in.reverb_buf [i];
+		echo_pos   [i] = in.echo_pos   [i];
+		reverb_pos [i] = in.reverb_pos [i];
+	}
+	return 0;
+}
+
 inline int pin_range( int n, int max, int min = 0 )
 {
 	if ( n < min )
@@ -293,6 +359,7 @@ long Effects_Buffer::samples_avail() const
 
 long Effects_Buffer::read_samples( blip_sample_t* out, long total_samples )
 {
+	GME_STAT_TIME( effects_time );
 	const int n_channels = max_voices * 2;
 	const int buf_count_per_voice = buf_count/max_voices;
 
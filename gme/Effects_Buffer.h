@@ -5,6 +5,7 @@
 #define EFFECTS_BUFFER_H
 
 #include "Multi_Buffer.h"
+#include "Gme_Alloc.h"
 
 #include <vector>
 
@@ -12,7 +13,9 @@
 class Effects_Buffer : public Multi_Buffer {
 public:
 	// nVoices indicates the number of voices for which buffers will be allocated
-	// to make Effects_Buffer work as "mix everything to one", nVoices will be 1
+	// to make Effects_Buffer work as "mix everything to one", nVoices will be 1.
+	// Otherwise set_channel_count() grows it to one voice per channel, so that
+	// each frame holds 2 * max( nVoices, channel count ) samples.
 	// If center_only is true, only center buffers are created and
 	// less memory is used.
 	Effects_Buffer( int nVoices = 1, bool center_only = false );
@@ -40,10 +43,12 @@ public:
 
 	// Set configuration of buffer
 	virtual void config( const config_t& );
+	config_t const& config() const { return config_; }
 	void set_depth( double );
 
 public:
 	~Effects_Buffer();
+	blargg_err_t set_channel_count( int );
 	blargg_err_t set_sample_rate( long samples_per_sec, int msec = blip_default_length ) noexcept;
 	void clock_rate( long );
 	void bass_freq( int );
@@ -52,23 +57,29 @@ public:
 	void end_frame( blip_time_t );
 	long read_samples( blip_sample_t*, long );
 	long samples_avail() const;
+	blargg_err_t copy_state( Multi_Buffer const& );
 private:
 	typedef long fixed_t;
 	int max_voices;
+	int const min_voices;
+	long clock_rate_;
+	int bass_freq_;
 	enum { max_buf_count = 7 };
-	std::vector<Blip_Buffer> bufs;
+	template<class T> using vector_t = std::vector<T, blargg_allocator<T> >;
+	typedef vector_t<blip_sample_t> delay_buf_t;
+	vector_t<Blip_Buffer> bufs;
 	enum { chan_types_count = 3 };
-	std::vector<channel_t> chan_types;
+	vector_t<channel_t> chan_types;
 	config_t config_;
 	long stereo_remain;
 	long effect_remain;
 	int buf_count;
 	bool effects_enabled;
 
-	std::vector<std::vector<blip_sample_t> > reverb_buf;
-	std::vector<std::vector<blip_sample_t> > echo_buf;
-	std::vector<int> reverb_pos;
-	std::vector<int> echo_pos;
+	vector_t<delay_buf_t> reverb_buf;
+	vector_t<delay_buf_t> echo_buf;
+	vector_t<int> reverb_pos;
+	vector_t<int> echo_pos;
 
 	struct {
 		fixed_t pan_1_levels [2];
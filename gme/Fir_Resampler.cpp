@@ -77,6 +77,17 @@ void Fir_Resampler_::clear()
 	}
 }
 
+void Fir_Resampler_::copy_state( Fir_Resampler_ const& in )
+{
+	assert( buf.size() == in.buf.size() && ratio_ == in.ratio_ && width_ == in.width_ );
+	imp_phase = in.imp_phase;
+	if ( buf.size() )
+	{
+		memcpy( buf.begin(), in.buf.begin(), buf.size() * sizeof buf [0] );
+		write_pos = buf.begin() + (in.write_pos - in.buf.begin());
+	}
+}
+
 blargg_err_t Fir_Resampler_::buffer_size( int new_size )
 {
 	RETURN_ERR( buf.resize( new_size + write_offset ) );
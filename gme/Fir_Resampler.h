@@ -5,6 +5,7 @@
 #define FIR_RESAMPLER_H
 
 #include "blargg_common.h"
+#include "Gme_Stats.h"
 #include <string.h>
 
 class Fir_Resampler_ {
@@ -45,6 +46,10 @@ public:
 	// Skip 'count' input samples. Returns number of samples actually skipped.
 	int skip_input( long count );
 
+	// Copy buffered input and position of other resampler, which must have the same
+	// buffer size and ratio
+	void copy_state( Fir_Resampler_ const& );
+
 // Output
 
 	// Number of extra input samples needed until 'count' output samples are available
@@ -99,6 +104,7 @@ inline void Fir_Resampler_::write( long count )
 template<int width>
 int Fir_Resampler<width>::read( sample_t* out_begin, int32_t count )
 {
+	GME_STAT_TIME( resample_time );
 	sample_t* out = out_begin;
 	const sample_t* in = buf.begin();
 	sample_t* end_pos = write_pos;
@@ -180,6 +186,7 @@ int Fir_Resampler<width>::read( sample_t* out_begin, int32_t count )
 	write_pos = &buf [left];
 	memmove( buf.begin(), in, left * sizeof *in );
 
+	GME_STAT_ADD( samples_resampled, out - out_begin );
 	return out - out_begin;
 }
 
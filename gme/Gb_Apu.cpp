@@ -1,6 +1,7 @@
 // Gb_Snd_Emu 0.1.5. http://www.slack.net/~ant/
 
 #include "Gb_Apu.h"
+#include "Gme_Stats.h"
 
 #include <string.h>
 #include <algorithm>
@@ -87,6 +88,47 @@ void Gb_Apu::update_volume()
 	other_synth.volume( vol );
 }
 
+static void copy_osc( Gb_Osc& out, Gb_Osc const& in )
+{
+	out.output_select = in.output_select;
+	out.output        = out.outputs [out.output_select];
+	out.delay         = in.delay;
+	out.last_amp      = in.last_amp;
+	out.volume        = in.volume;
+	out.length        = in.length;
+	out.enabled       = in.enabled;
+}
+
+static void copy_square( Gb_Square& out, Gb_Square const& in )
+{
+	copy_osc( out, in );
+	out.env_delay   = in.env_delay;
+	out.sweep_delay = in.sweep_delay;
+	out.sweep_freq  = in.sweep_freq;
+	out.phase       = in.phase;
+}
+
+void Gb_Apu::copy_state( Gb_Apu const& in )
+{
+	next_frame_time = in.next_frame_time;
+	last_time       = in.last_time;
+	frame_period    = in.frame_period;
+	frame_count     = in.frame_count;
+	memcpy( regs, in.regs, sizeof regs );
+	update_volume();
+
+	copy_square( square1, in.square1 );
+	copy_square( square2, in.square2 );
+
+	copy_osc( wave, in.wave );
+	wave.wave_pos = in.wave.wave_pos;
+	memcpy( wave.wave, in.wave.wave, sizeof wave.wave );
+
+	copy_osc( noise, in.noise );
+	noise.env_delay = in.noise.env_delay;
+	noise.bits      = in.noise.bits;
+}
+
 static unsigned char const powerup_regs [0x20] = {
 	0x80,0x3F,0x00,0xFF,0xBF, // square 1
 	0xFF,0x3F,0x00,0xFF,0xBF, // square 2
@@ -134,6 +176,7 @@ void Gb_Apu::reset()
 
 void Gb_Apu::run_until( blip_time_t end_time )
 {
+	GME_STAT_TIME( apu_time );
 	require( end_time >= last_time ); // end_time must not be before previous time
 	if ( end_time == last_time )
 		return;
@@ -205,6 +248,7 @@ void Gb_Apu::end_frame( blip_time_t end_time )
 
 void Gb_Apu::write_register( blip_time_t time, unsigned addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	require( (unsigned) data < 0x100 );
 
 	int reg = addr - start_addr;
@@ -50,6 +50,9 @@ public:
 
 	void set_tempo( double );
 
+	// Copy emulation state of other APU, keeping own outputs and volume
+	void copy_state( Gb_Apu const& );
+
 public:
 	Gb_Apu();
 private:
@@ -2,6 +2,7 @@
 
 #include "Gb_Cpu.h"
 
+#include "Gme_Stats.h"
 #include <string.h>
 
 //#include "gb_cpu_log.h"
@@ -52,6 +53,19 @@ inline void Gb_Cpu::set_code_page( int i, uint8_t* p )
 	state->code_map [i] = p - PAGE_OFFSET( i * (int32_t) page_size );
 }
 
+void Gb_Cpu::copy_state( Gb_Cpu const& in, void const* in_base, void* base, size_t size )
+{
+	check( state == &state_ && in.state == &in.state_ );
+	r = in.r;
+	rst_base = in.rst_base;
+	state_.remain = in.state_.remain;
+	for ( int i = 0; i < page_count + 1; i++ )
+	{
+		int32_t offset = PAGE_OFFSET( i * (int32_t) page_size );
+		set_code_page( i, blargg_rebase( in.state_.code_map [i] + offset, in_base, base, size ) );
+	}
+}
+
 void Gb_Cpu::reset( void* unmapped )
 {
 	check( state == &state_ );
@@ -142,6 +156,8 @@ loop:
 		pc++;
 	#endif
 
+	GME_STAT_ADD( instructions, 1 );
+
 #define GET_ADDR()  GET_LE16( instr )
 
 	if ( !--s.remain )
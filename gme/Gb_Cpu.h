@@ -60,6 +60,11 @@ public:
 	// Can read this many bytes past end of a page
 	enum { cpu_padding = 8 };
 
+	// Copy registers and state of other CPU. Code mapped to memory within size bytes
+	// at other_base is mapped to the same offset from base instead, so a copy of an
+	// emulator maps its own memory.
+	void copy_state( Gb_Cpu const& other, void const* other_base, void* base, size_t size );
+
 public:
 	Gb_Cpu() : rst_base( 0 ) { state = &state_; }
 	enum { page_shift = 13 };
@@ -97,10 +97,25 @@ struct Gbs_File : Gme_Info_
 	}
 };
 
+static blargg_err_t probe_gbs( Gme_Probe& out, byte const* in, long size )
+{
+	if ( size < Gbs_Emu::header_size )
+		return gme_wrong_file_type;
+
+	Gbs_Emu::header_t const& h = *(Gbs_Emu::header_t const*) in;
+	RETURN_ERR( check_gbs_header( &h ) );
+	out.info.track_count = h.track_count;
+	GME_PROBE_FIELD( h, out, game );
+	GME_PROBE_FIELD( h, out, author );
+	GME_PROBE_FIELD( h, out, copyright );
+	out.report_all();
+	return 0;
+}
+
 static Music_Emu* new_gbs_emu () { return BLARGG_NEW Gbs_Emu ; }
 static Music_Emu* new_gbs_file() { return BLARGG_NEW Gbs_File; }
 
-static gme_type_t_ const gme_gbs_type_ = { "Game Boy", 0, &new_gbs_emu, &new_gbs_file, "GBS", 1 };
+static gme_type_t_ const gme_gbs_type_ = { "Game Boy", 0, &new_gbs_emu, &new_gbs_file, "GBS", 1, &probe_gbs };
 extern gme_type_t const gme_gbs_type = &gme_gbs_type_;
 
 // Setup
@@ -109,7 +124,20 @@ blargg_err_t Gbs_Emu::load_( Data_Reader& in )
 {
 	blaarg_static_assert( offsetof (header_t,copyright [32]) == header_size, "GBS Header layout incorrect!" );
 	RETURN_ERR( rom.load( in, header_size, &header_, 0 ) );
+	return init_file();
+}
 
+blargg_err_t Gbs_Emu::load_clone_( Gme_File const& other )
+{
+	Gbs_Emu const& in = STATIC_CAST(Gbs_Emu const&,other);
+	rom.share( in.rom );
+	header_ = in.header_;
+	return init_file();
+}
+
+// Sets up emulator for file data in rom and header_
+blargg_err_t Gbs_Emu::init_file()
+{
 	set_track_count( header_.track_count );
 	RETURN_ERR( check_gbs_header( &header_ ) );
 
@@ -240,6 +268,18 @@ blargg_err_t Gbs_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Gbs_Emu::clone_state_( Music_Emu const& other )
+{
+	Gbs_Emu const& in = STATIC_CAST(Gbs_Emu const&,other);
+	cpu::copy_state( in, &in, this, sizeof *this );
+	memcpy( ram, in.ram, sizeof ram );
+	cpu_time    = in.cpu_time;
+	play_period = in.play_period;
+	next_play   = in.next_play;
+	apu.copy_state( in.apu );
+	return Classic_Emu::clone_state_( in );
+}
+
 blargg_err_t Gbs_Emu::run_clocks( blip_time_t& duration, int )
 {
 	cpu_time = 0;
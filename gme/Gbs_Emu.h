@@ -51,6 +51,8 @@ public:
 protected:
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t load_( Data_Reader& );
+	blargg_err_t load_clone_( Gme_File const& );
+	blargg_err_t clone_state_( Music_Emu const& );
 	blargg_err_t start_track_( int );
 	blargg_err_t run_clocks( blip_time_t&, int );
 	void set_tempo_( double );
@@ -70,6 +72,7 @@ private:
 	void update_timer();
 
 	header_t header_;
+	blargg_err_t init_file();
 	void cpu_jsr( gb_addr_t );
 
 public: private: friend class Gb_Cpu;
@@ -0,0 +1,281 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Gme_Alloc.h"
+
+#include "Gme_Rt_Check.h"
+#include <new>
+
+/* Copyright (C) 2026 Game_Music_Emu contributors. This module is free software; you
+can redistribute it and/or modify it under the terms of the GNU Lesser
+General Public License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details. You should have received a copy of the GNU Lesser General Public
+License along with this module; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+static void* default_alloc( void*, size_t n ) { return malloc( n ); }
+static void default_free( void*, void* p ) { free( p ); }
+
+static Gme_Heap::alloc_func_t alloc_func = default_alloc;
+static Gme_Heap::free_func_t free_func = default_free;
+static void* alloc_data;
+
+static thread_local Gme_Heap* current_heap;
+
+// Header before contents of each block, which keeps them aligned as malloc() would
+struct block_t {
+	Gme_Heap* heap; // NULL if from global allocator
+	size_t size;    // including header
+};
+size_t const header_size = 16;
+static_assert( sizeof (block_t) <= header_size, "Block header doesn't fit" );
+
+static size_t round_up( size_t n ) { return (n + header_size - 1) & ~(header_size - 1); }
+
+void Gme_Heap::set_allocator( alloc_func_t af, free_func_t ff, void* user_data )
+{
+	alloc_func = af ? af : default_alloc;
+	free_func  = af ? ff : default_free;
+	alloc_data = user_data;
+}
+
+// Arena
+
+// Free memory in arena. Allocated blocks are taken from the start of these.
+struct Gme_Heap::chunk_t {
+	size_t size;
+	chunk_t* next;
+};
+
+// Smallest piece worth leaving free when splitting a chunk
+size_t const min_chunk = header_size * 2;
+
+Gme_Heap::Gme_Heap( size_t arena_size, chunk_t* arena ) :
+	free_list( arena ),
+	arena_size_( arena_size ),
+	used_( 0 ),
+	peak_( 0 ),
+	blocks( 0 ),
+	released( false )
+{
+	if ( arena )
+	{
+		arena->size = arena_size;
+		arena->next = 0;
+	}
+}
+
+Gme_Heap* Gme_Heap::create( size_t arena_size )
+{
+	arena_size &= ~(header_size - 1);
+	size_t const self = round_up( sizeof (Gme_Heap) );
+	if ( arena_size > (size_t) -1 - self )
+		return 0;
+	char* p = (char*) alloc_func( alloc_data, self + arena_size );
+	if ( !p )
+		return 0;
+	return new (p) Gme_Heap( arena_size, arena_size ? (chunk_t*) (p + self) : 0 );
+}
+
+void Gme_Heap::destroy()
+{
+	this->~Gme_Heap();
+	free_func( alloc_data, this );
+}
+
+void Gme_Heap::lock()
+{
+	GME_RT_UNSAFE( locks, "heap lock" );
+	while ( busy.test_and_set( std::memory_order_acquire ) ) { }
+}
+
+void Gme_Heap::release()
+{
+	lock();
+	assert( !released );
+	released = true;
+	bool const unused = !blocks;
+	unlock();
+	if ( unused )
+		destroy();
+}
+
+void* Gme_Heap::alloc( size_t& size )
+{
+	void* p = 0;
+	if ( !arena_size_ )
+	{
+		p = alloc_func( alloc_data, size );
+		if ( !p )
+			return 0;
+		lock();
+	}
+	else
+	{
+		lock();
+		for ( chunk_t** link = &free_list; *link; link = &(*link)->next )
+		{
+			chunk_t* c = *link;
+			if ( c->size >= size )
+			{
+				if ( c->size - size >= min_chunk )
+				{
+					chunk_t* rest = (chunk_t*) ((char*) c + size);
+					rest->size = c->size - size;
+					rest->next = c->next;
+					*link = rest;
+				}
+				else
+				{
+					size = c->size;
+					*link = c->next;
+				}
+				p = c;
+				break;
+			}
+		}
+		if ( !p )
+		{
+			unlock();
+			return 0;
+		}
+	}
+	blocks++;
+	used_ += size;
+	if ( peak_ < used_ )
+		peak_ = used_;
+	unlock();
+	return p;
+}
+
+void Gme_Heap::free( void* block, size_t size )
+{
+	if ( !arena_size_ )
+		free_func( alloc_data, block );
+
+	lock();
+	if ( arena_size_ )
+	{
+		// insert in order, merging with neighbors
+		chunk_t* c = (chunk_t*) block;
+		c->size = size;
+		chunk_t* prev = 0;
+		chunk_t* next = free_list;
+		while ( next && next < c )
+		{
+			prev = next;
+			next = next->next;
+		}
+		if ( next && (char*) c + c->size == (char*) next )
+		{
+			c->size += next->size;
+			next = next->next;
+		}
+		c->next = next;
+		if ( !prev )
+		{
+			free_list = c;
+		}
+		else if ( (char*) prev + prev->size == (char*) c )
+		{
+			prev->size += c->size;
+			prev->next = next;
+		}
+		else
+		{
+			prev->next = c;
+		}
+	}
+	blocks--;
+	used_ -= size;
+	bool const unused = released && !blocks;
+	unlock();
+	if ( unused )
+		destroy();
+}
+
+// Current heap
+
+Gme_Heap* Gme_Heap::current() { return current_heap; }
+
+Gme_Heap_Scope::Gme_Heap_Scope( Gme_Heap* h ) : prev( current_heap ) { current_heap = h; }
+
+Gme_Heap_Scope::~Gme_Heap_Scope() { current_heap = prev; }
+
+// Blocks
+
+void* blargg_malloc( size_t n )
+{
+	GME_RT_UNSAFE( allocs, "memory allocation" );
+	if ( n > (size_t) -1 - header_size * 2 )
+		return 0;
+	size_t size = round_up( header_size + n );
+	Gme_Heap* heap = current_heap;
+	block_t* b = (block_t*) (heap ? heap->alloc( size ) : alloc_func( alloc_data, size ));
+	if ( !b )
+		return 0;
+	b->heap = heap;
+	b->size = size;
+	return (char*) b + header_size;
+}
+
+void blargg_free( void* p )
+{
+	if ( !p )
+		return;
+	GME_RT_UNSAFE( allocs, "memory free" );
+	block_t* b = (block_t*) ((char*) p - header_size);
+	if ( b->heap )
+		b->heap->free( b, b->size );
+	else
+		free_func( alloc_data, b );
+}
+
+void* blargg_realloc( void* p, size_t n )
+{
+	if ( !p )
+		return blargg_malloc( n );
+
+	if ( !n )
+	{
+		blargg_free( p );
+		return 0;
+	}
+
+	// keep block if it doesn't waste much
+	block_t* b = (block_t*) ((char*) p - header_size);
+	size_t const old_size = b->size - header_size;
+	if ( n <= old_size && n >= old_size / 2 )
+		return p;
+
+	// new block comes from same heap as old
+	void* q;
+	{
+		Gme_Heap_Scope scope( b->heap );
+		q = blargg_malloc( n );
+	}
+	if ( q )
+	{
+		memcpy( q, p, n < old_size ? n : old_size );
+		blargg_free( p );
+	}
+	return q;
+}
+
+// For C code in ext/
+extern "C" void* gme_ext_calloc( size_t count, size_t size )
+{
+	if ( size && count > (size_t) -1 / size )
+		return 0;
+	void* p = blargg_malloc( count * size );
+	if ( p )
+		memset( p, 0, count * size );
+	return p;
+}
+
+extern "C" void gme_ext_free( void* p ) { blargg_free( p ); }
@@ -0,0 +1,99 @@
+// Memory allocation through the user's allocator and per-emulator heaps (see
+// gme_set_allocator() and gme_new_emu_arena())
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef GME_ALLOC_H
+#define GME_ALLOC_H
+
+#include "blargg_common.h"
+
+// All memory the library allocates goes through blargg_malloc() etc. (declared in
+// blargg_common.h). Each block has a header recording the heap it came from, or
+// none if it came straight from the global allocator, so it can be freed from
+// anywhere. Blocks come from the current heap of the calling thread, set with
+// Gme_Heap_Scope.
+
+// Memory of one emulator: either an arena allocated once up front, or blocks from
+// the global allocator that are just counted. Stays around until released and
+// every block allocated from it is freed, since blocks can outlive the emulator
+// (file data shared with a clone, for example).
+class Gme_Heap {
+public:
+	// Creates heap using arena of arena_size bytes, or the global allocator if 0.
+	// NULL if out of memory.
+	static Gme_Heap* create( size_t arena_size );
+
+	// Releases heap. It's freed once all its blocks are.
+	void release();
+
+	// Size of arena, or 0 if it doesn't have one
+	size_t arena_size() const { return arena_size_; }
+
+	// Bytes allocated, currently and at most
+	size_t used() const { return used_; }
+	size_t peak() const { return peak_; }
+
+	// Heap of calling thread that blocks are allocated from, or NULL for global allocator
+	static Gme_Heap* current();
+
+	// Sets functions the global allocator uses. Must only be done when no blocks
+	// are allocated.
+	typedef void* (*alloc_func_t)( void* user_data, size_t );
+	typedef void (*free_func_t)( void* user_data, void* );
+	static void set_allocator( alloc_func_t, free_func_t, void* user_data );
+
+private:
+	struct chunk_t;
+	chunk_t* free_list;     // free arena memory, in address order
+	size_t arena_size_;
+	size_t used_;
+	size_t peak_;
+	long blocks;
+	bool released;
+	std::atomic_flag busy = ATOMIC_FLAG_INIT; // blocks can be freed by other threads, rarely
+	void lock();
+	void unlock() { busy.clear( std::memory_order_release ); }
+
+	Gme_Heap( size_t arena_size, chunk_t* arena );
+	void* alloc( size_t& size );
+	void destroy();
+	void free( void* block, size_t size );
+	friend void* blargg_malloc( size_t );
+	friend void* blargg_realloc( void*, size_t );
+	friend void blargg_free( void* );
+};
+
+// Makes heap current for calling thread for rest of scope
+class Gme_Heap_Scope {
+	Gme_Heap* prev;
+public:
+	explicit Gme_Heap_Scope( Gme_Heap* );
+	~Gme_Heap_Scope();
+};
+
+// Allocator for std containers that uses blargg_malloc(). Containers can't handle
+// running out of memory, so if the current heap is an exhausted arena, the global
+// allocator is used instead.
+template<class T>
+struct blargg_allocator {
+	typedef T value_type;
+	blargg_allocator() { }
+	template<class U> blargg_allocator( blargg_allocator<U> const& ) { }
+	T* allocate( size_t n )
+	{
+		void* p = blargg_malloc( n * sizeof (T) );
+		if ( !p && Gme_Heap::current() )
+		{
+			Gme_Heap_Scope global( 0 );
+			p = blargg_malloc( n * sizeof (T) );
+		}
+		if ( !p )
+			abort(); // what std::allocator does when exceptions are disabled
+		return (T*) p;
+	}
+	void deallocate( T* p, size_t ) { blargg_free( p ); }
+	template<class U> bool operator == ( blargg_allocator<U> const& ) const { return true; }
+	template<class U> bool operator != ( blargg_allocator<U> const& ) const { return false; }
+};
+
+#endif
@@ -87,6 +87,36 @@ blargg_err_t Gme_File::post_load( blargg_err_t err )
 	return err;
 }
 
+blargg_err_t Gme_File::load_clone_( Gme_File const& )
+{
+	return "Emulator type doesn't support cloning";
+}
+
+blargg_err_t Gme_File::load_clone( Gme_File const& in )
+{
+	require( type_ == in.type_ );
+	pre_load();
+	file_data.share( in.file_data );
+	blargg_err_t err = tracks.resize( in.tracks.size() );
+	if ( !err )
+	{
+		if ( tracks.size() )
+			memcpy( tracks.begin(), in.tracks.begin(), tracks.size() * sizeof tracks [0] );
+		err = load_clone_( in );
+	}
+	if ( !err )
+		err = playlist.copy( in.playlist );
+	if ( !err )
+	{
+		track_count_     = in.track_count_;
+		raw_track_count_ = in.raw_track_count_;
+		memcpy( playlist_warning, in.playlist_warning, sizeof playlist_warning );
+		warning_ = blargg_rebase( in.warning_, in.playlist_warning, playlist_warning,
+				sizeof playlist_warning );
+	}
+	return post_load( err );
+}
+
 // Public load functions
 
 blargg_err_t Gme_File::load_mem( void const* in, long size )
@@ -133,10 +163,9 @@ blargg_err_t Gme_File::load_remaining_( void const* h, long s, Data_Reader& in )
 
 // Track info
 
-void Gme_File::copy_field_( char* out, const char* in, int in_size )
+int Gme_File::trim_field_( const char** in_io, int in_size )
 {
-	if ( !in || !*in )
-		return;
+	const char* in = *in_io;
 
 	// remove spaces/junk from beginning
 	while ( in_size && unsigned (*in - 1) <= ' ' - 1 )
@@ -158,13 +187,24 @@ void Gme_File::copy_field_( char* out, const char* in, int in_size )
 	while ( len && unsigned (in [len - 1]) <= ' ' )
 		len--;
 
-	// copy
-	out [len] = 0;
-	memcpy( out, in, len );
+	*in_io = in;
 
 	// strip out stupid fields that should have been left blank
-	if ( !strcmp( out, "?" ) || !strcmp( out, "<?>" ) || !strcmp( out, "< ? >" ) )
-		out [0] = 0;
+	if ( (len == 1 && !memcmp( in, "?", 1 )) || (len == 3 && !memcmp( in, "<?>", 3 )) ||
+			(len == 5 && !memcmp( in, "< ? >", 5 )) )
+		len = 0;
+
+	return len;
+}
+
+void Gme_File::copy_field_( char* out, const char* in, int in_size )
+{
+	if ( !in || !*in )
+		return;
+
+	int len = trim_field_( &in, in_size );
+	out [len] = 0;
+	memcpy( out, in, len );
 }
 
 void Gme_File::copy_field_( char* out, const char* in )
@@ -253,3 +293,50 @@ blargg_err_t Gme_File::track_info( track_info_t* out, int track ) const
 	}
 	return 0;
 }
+
+// Gme_Probe
+
+Gme_Probe::Gme_Probe( gme_type_t type, gme_probe_func_t func, void* user_data ) :
+	func( func ),
+	user_data( user_data ),
+	buf_used( 0 )
+{
+	memset( &info, 0, sizeof info );
+	info.type         = type;
+	info.track_count  = type->track_count;
+	info.length       = -1;
+	info.intro_length = -1;
+	info.loop_length  = -1;
+	info.fade_length  = -1;
+	set_field( &info.system, type->system );
+}
+
+void Gme_Probe::set_field( gme_str_t* field, const char* in, int len )
+{
+	if ( !in || len <= 0 || !*in )
+		return;
+
+	field->len = Gme_File::trim_field_( &in, len );
+	field->str = in;
+}
+
+char* Gme_Probe::field_buf( int size )
+{
+	if ( size > (int) sizeof buf - buf_used )
+		return 0;
+	buf_used += size;
+	return &buf [buf_used - size];
+}
+
+bool Gme_Probe::report( int track )
+{
+	info.track = track;
+	return func( user_data, &info ) != 0;
+}
+
+void Gme_Probe::report_all()
+{
+	for ( int i = 0; i < info.track_count; i++ )
+		if ( report( i ) )
+			break;
+}
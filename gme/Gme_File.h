@@ -12,6 +12,8 @@
 // Error returned if file is wrong type
 //extern const char gme_wrong_file_type []; // declared in gme.h
 
+class Gme_Probe;
+
 struct gme_type_t_
 {
 	const char* system;         /* name of system this music file type is generally for */
@@ -22,6 +24,7 @@ struct gme_type_t_
 	/* internal */
 	const char* extension_;
 	int flags_;
+	blargg_err_t (*probe_)( Gme_Probe&, uint8_t const* data, long size ); /* NULL if not supported */
 };
 
 struct track_info_t
@@ -128,6 +131,7 @@ protected:
 	// Services
 	void set_track_count( int n )       { track_count_ = raw_track_count_ = n; }
 	void set_warning( const char* s )   { warning_ = s; }
+	const char* current_warning() const { return warning_; } // doesn't clear it
 	void set_type( gme_type_t t )       { type_ = t; }
 	blargg_err_t load_remaining_( void const* header, long header_size, Data_Reader& remaining );
 
@@ -143,6 +147,11 @@ protected:
 	virtual void post_load_();
 	virtual void clear_playlist_() { }
 
+	// Load same file as other, which is of the same type, sharing its data. Calls
+	// load_clone_() in place of load_().
+	blargg_err_t load_clone( Gme_File const& other );
+	virtual blargg_err_t load_clone_( Gme_File const& other );
+
 public:
 	blargg_err_t remap_track_( int* track_io ) const; // need by Music_Emu
 private:
@@ -158,7 +167,7 @@ private:
 	gme_user_cleanup_t user_cleanup_;
 	M3u_Playlist playlist;
 	char playlist_warning [64];
-	blargg_vector<byte> file_data; // only if loaded into memory using default load
+	blargg_shared_vector<byte> file_data; // only if loaded into memory using default load
 	blargg_vector<long> tracks;    // file start indexes of `file_data`
 
 	blargg_err_t load_m3u_( blargg_err_t );
@@ -168,6 +177,39 @@ public:
 	enum { max_field_ = 255 };
 	static void copy_field_( char* out, const char* in );
 	static void copy_field_( char* out, const char* in, int len );
+
+	// Removes junk around field that copy_field_() removes and returns its length,
+	// with *in adjusted to start of what remains
+	static int trim_field_( const char** in, int len );
+};
+
+// Reports track information parsed straight from file data, for gme_probe_info()
+class Gme_Probe {
+public:
+	Gme_Probe( gme_type_t, gme_probe_func_t, void* user_data );
+
+	// Information reported for each track. Strings start out empty, except system,
+	// and times start out -1.
+	gme_probe_t info;
+
+	// Set field to string in of at most len characters, trimmed as in track_info().
+	// Leaves field unchanged if in is empty.
+	void set_field( gme_str_t* field, const char* in, int len = Gme_File::max_field_ );
+
+	// Temporary storage for field of size characters, or NULL if there's no more
+	char* field_buf( int size );
+
+	// Report info for track to caller. True if caller wants to stop.
+	bool report( int track );
+
+	// Report info for each track from 0 to info.track_count - 1
+	void report_all();
+
+private:
+	gme_probe_func_t func;
+	void* user_data;
+	int buf_used;
+	char buf [8 * (Gme_File::max_field_ + 1)];
 };
 
 Music_Emu* gme_new_( Music_Emu*, long sample_rate );
@@ -175,6 +217,9 @@ Music_Emu* gme_new_( Music_Emu*, long sample_rate );
 #define GME_COPY_FIELD( in, out, name ) \
 	{ Gme_File::copy_field_( out->name, in.name, sizeof in.name ); }
 
+#define GME_PROBE_FIELD( in, out, name ) \
+	{ out.set_field( &out.info.name, in.name, sizeof in.name ); }
+
 #ifndef GME_FILE_READER
 	#define GME_FILE_READER Std_File_Reader
 #elif defined (GME_FILE_READER_INCLUDE)
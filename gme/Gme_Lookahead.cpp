@@ -0,0 +1,82 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Gme_Lookahead.h"
+
+#include "Music_Emu.h"
+#include "Gme_Alloc.h"
+#include <chrono>
+
+/* Copyright (C) 2026 Game_Music_Emu contributors. This module is free software; you
+can redistribute it and/or modify it under the terms of the GNU Lesser
+General Public License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details. You should have received a copy of the GNU Lesser General Public
+License along with this module; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+Gme_Lookahead::Gme_Lookahead() :
+	state( state_idle ),
+	cancel( false ),
+	quit( false ),
+	helper_( 0 ),
+	thread( &Gme_Lookahead::run, this )
+{ }
+
+Gme_Lookahead::~Gme_Lookahead()
+{
+	assert( !helper_ );
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		quit = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+Music_Emu* Gme_Lookahead::set_helper( Music_Emu* h )
+{
+	cancel = true;
+	while ( !idle() )
+		std::this_thread::yield();
+	cancel = false;
+
+	Music_Emu* prev = helper_;
+	helper_ = h;
+	return prev;
+}
+
+void Gme_Lookahead::start()
+{
+	assert( helper_ && idle() );
+	state.store( state_requested, std::memory_order_release );
+
+	// Notifying without holding mutex keeps this from blocking, at the cost of thread
+	// sometimes missing it and not noticing the request until its wait times out
+	wake.notify_one();
+}
+
+void Gme_Lookahead::run()
+{
+	std::unique_lock<std::mutex> lock( mutex );
+	while ( !quit )
+	{
+		if ( state.load( std::memory_order_acquire ) != state_requested )
+		{
+			wake.wait_for( lock, std::chrono::milliseconds( 10 ) );
+			continue;
+		}
+
+		lock.unlock();
+		{
+			Gme_Heap_Scope scope( helper_->heap() );
+			helper_->scan_silence( cancel );
+		}
+		state.store( state_idle, std::memory_order_release );
+		lock.lock();
+	}
+}
@@ -0,0 +1,51 @@
+// Silence lookahead on a helper thread (see gme_set_background_lookahead())
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef GME_LOOKAHEAD_H
+#define GME_LOOKAHEAD_H
+
+#include "blargg_common.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class Music_Emu;
+
+// Thread that runs a helper emulator ahead while its owner plays silence, to find
+// whether the silence lasts long enough to end the track. The owner copies its state
+// into the helper and calls start(), then checks back with idle() on later calls; none
+// of that blocks or allocates, so it's safe on an audio thread.
+class Gme_Lookahead {
+public:
+	// Starts thread
+	Gme_Lookahead();
+	~Gme_Lookahead(); // helper must have been removed with set_helper( NULL )
+
+	// Emulator to run ahead, or NULL if none yet. Waits for thread to stop using
+	// previous helper, then returns it for caller to delete.
+	Music_Emu* set_helper( Music_Emu* );
+	Music_Emu* helper() const       { return helper_; }
+
+	// True if thread isn't using helper, so it can be examined and given a new state
+	bool idle() const               { return state.load( std::memory_order_acquire ) == state_idle; }
+
+	// Has thread run helper until silence ends or lasts long enough to end track, then
+	// become idle. Must be idle.
+	void start();
+
+private:
+	enum { state_idle, state_requested };
+	std::atomic<int> state;
+	std::atomic<bool> cancel;
+	bool quit;
+	Music_Emu* helper_;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread thread;
+	void run();
+public:
+	BLARGG_DISABLE_NOTHROW
+};
+
+#endif
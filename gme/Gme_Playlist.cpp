@@ -0,0 +1,408 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Gme_Playlist.h"
+
+#include "M3u_Playlist.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+/* Copyright (C) 2026 Game_Music_Emu contributors. This module is free software; you
+can redistribute it and/or modify it under the terms of the GNU Lesser
+General Public License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details. You should have received a copy of the GNU Lesser General Public
+License along with this module; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+using std::min;
+using std::max;
+
+Gme_Playlist::Gme_Playlist( long sample_rate ) :
+	sample_rate( sample_rate ),
+	crossfade( 0 ),
+	size_( 0 ),
+	loaded( 0 ),
+	warning_( 0 ),
+	playing( 0 ),
+	incoming( 0 ),
+	current_index( -1 ),
+	next( 0 ),
+	retired( 0 ),
+	quit( false ),
+	thread( &Gme_Playlist::run, this )
+{ }
+
+Gme_Playlist::~Gme_Playlist()
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		quit = true;
+	}
+	wake.notify_one();
+	thread.join();
+
+	delete_track( playing );
+	delete_track( incoming );
+	delete_track( next.load() );
+	for ( track_t* t = retired.load(); t; )
+	{
+		track_t* n = t->next_retired;
+		delete_track( t );
+		t = n;
+	}
+	for ( int i = size(); i--; )
+		free_entry( entries [i] );
+}
+
+void Gme_Playlist::delete_track( track_t* t )
+{
+	if ( t )
+	{
+		gme_delete( t->emu );
+		delete t;
+	}
+}
+
+void Gme_Playlist::free_entry( entry_t& e )
+{
+	blargg_free( e.path );
+	blargg_free( e.data );
+	e.path = 0;
+	e.data = 0;
+}
+
+// Entries
+
+blargg_err_t Gme_Playlist::add( entry_t const& e )
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		int const n = size();
+		if ( (size_t) n >= entries.size() )
+			RETURN_ERR( entries.resize( n ? n * 2 : 16 ) );
+		entries [n] = e;
+		size_.store( n + 1, std::memory_order_release );
+	}
+	wake.notify_one();
+	return 0;
+}
+
+static char* copy_path( const char* dir, size_t dir_len, const char* name )
+{
+	size_t const len = strlen( name );
+	char* p = (char*) blargg_malloc( dir_len + len + 1 );
+	if ( p )
+	{
+		memcpy( p, dir, dir_len );
+		memcpy( p + dir_len, name, len + 1 );
+	}
+	return p;
+}
+
+blargg_err_t Gme_Playlist::add_file( const char* path, int track, int length, int fade )
+{
+	entry_t e = entry_t();
+	e.path   = copy_path( "", 0, path );
+	CHECK_ALLOC( e.path );
+	e.track  = track;
+	e.length = length;
+	e.fade   = fade;
+	e.intro  = -1;
+	e.loop   = -1;
+	blargg_err_t err = add( e );
+	if ( err )
+		free_entry( e );
+	return err;
+}
+
+blargg_err_t Gme_Playlist::add_data( void const* data, long size, int track, int length, int fade )
+{
+	entry_t e = entry_t();
+	e.data   = blargg_malloc( size );
+	CHECK_ALLOC( e.data );
+	memcpy( e.data, data, size );
+	e.size   = size;
+	e.track  = track;
+	e.length = length;
+	e.fade   = fade;
+	e.intro  = -1;
+	e.loop   = -1;
+	blargg_err_t err = add( e );
+	if ( err )
+		free_entry( e );
+	return err;
+}
+
+blargg_err_t Gme_Playlist::load_m3u( const char* path )
+{
+	M3u_Playlist m3u;
+	RETURN_ERR( m3u.load( path ) );
+
+	size_t dir_len = strlen( path );
+	while ( dir_len && path [dir_len - 1] != '/' && path [dir_len - 1] != '\\' )
+		dir_len--;
+
+	for ( int i = 0; i < m3u.size(); i++ )
+	{
+		M3u_Playlist::entry_t const& m = m3u [i];
+		bool const absolute = m.file [0] == '/' || m.file [0] == '\\' ||
+				(m.file [0] && m.file [1] == ':');
+		entry_t e = entry_t();
+		e.path   = copy_path( path, absolute ? 0 : dir_len, m.file );
+		CHECK_ALLOC( e.path );
+		e.track  = m.track;
+		e.decimal_track = m.decimal_track;
+		e.length = m.length;
+		e.fade   = m.fade;
+		e.intro  = m.intro;
+		e.loop   = m.loop;
+		blargg_err_t err = add( e );
+		if ( err )
+		{
+			free_entry( e );
+			return err;
+		}
+	}
+	return 0;
+}
+
+// Loading
+
+blargg_err_t Gme_Playlist::load( entry_t const& e, int index, track_t** out )
+{
+	Music_Emu* emu;
+	RETURN_ERR( e.data ? gme_open_data( e.data, e.size, &emu, (int) sample_rate ) :
+			gme_open_file( e.path, &emu, (int) sample_rate ) );
+
+	int track = max( e.track, 0 );
+	if ( e.decimal_track && !(emu->type()->flags_ & 0x02) )
+		track--;
+
+	// starting track skips initial silence, which is the slow part
+	track_info_t info;
+	blargg_err_t err = emu->track_info( &info, track );
+	if ( !err )
+		err = gme_start_track( emu, track );
+	track_t* t = 0;
+	if ( !err )
+	{
+		t = BLARGG_NEW track_t;
+		if ( !t )
+			err = "Out of memory";
+	}
+	if ( err )
+	{
+		gme_delete( emu );
+		return err;
+	}
+
+	// same defaults as gme_info_t's play_length and gme_set_fade()
+	long length = e.length;
+	if ( length < 0 )
+	{
+		long const loop  = e.loop > 0 ? e.loop : info.loop_length;
+		long const intro = e.loop > 0 ? e.intro : info.intro_length;
+		length = info.length > 0 ? info.length : loop > 0 ? max( intro, 0L ) + loop * 2 : 150000;
+	}
+	long const fade = e.fade >= 0 ? e.fade : info.fade_length >= 0 ? info.fade_length : 8000;
+
+	t->emu          = emu;
+	t->index        = index;
+	t->end          = -1;
+	t->ramp         = 0;
+	t->ended_at     = -1;
+	t->next_retired = 0;
+	if ( length > 0 )
+	{
+		emu->set_fade( length, fade );
+		t->end = msec_to_samples( length + fade );
+	}
+	emu->set_event_func( on_event, t );
+	*out = t;
+	return 0;
+}
+
+void Gme_Playlist::run()
+{
+	std::unique_lock<std::mutex> lock( mutex );
+	while ( !quit )
+	{
+		if ( track_t* t = retired.exchange( 0, std::memory_order_acquire ) )
+		{
+			lock.unlock();
+			while ( t )
+			{
+				track_t* n = t->next_retired;
+				delete_track( t );
+				t = n;
+			}
+			lock.lock();
+			continue;
+		}
+
+		int const index = loaded.load( std::memory_order_relaxed );
+		if ( !next.load( std::memory_order_acquire ) && index < size() )
+		{
+			entry_t const e = entries [index];
+			lock.unlock();
+			track_t* t = 0;
+			blargg_err_t err = load( e, index, &t );
+			lock.lock();
+
+			free_entry( entries [index] );
+			if ( err )
+				warning_.store( err );
+
+			// next is set first, so ended() never sees entry done without it
+			next.store( t, std::memory_order_release );
+			loaded.store( index + 1, std::memory_order_release );
+			ready.notify_all();
+			continue;
+		}
+
+		wake.wait_for( lock, std::chrono::milliseconds( 10 ) );
+	}
+}
+
+void Gme_Playlist::wait()
+{
+	std::unique_lock<std::mutex> lock( mutex );
+	while ( !next.load( std::memory_order_acquire ) && loaded.load( std::memory_order_acquire ) < size() )
+		ready.wait( lock );
+}
+
+bool Gme_Playlist::ended() const
+{
+	// loaded is read first, so next is seen if thread set it before finishing entry
+	return loaded.load( std::memory_order_acquire ) >= size() &&
+			!next.load( std::memory_order_acquire ) && current() < 0;
+}
+
+// Playback
+
+Gme_Playlist::track_t* Gme_Playlist::take_next()
+{
+	track_t* t = next.exchange( 0, std::memory_order_acq_rel );
+	if ( t )
+		wake.notify_one(); // start loading one after it
+	return t;
+}
+
+void Gme_Playlist::retire( track_t* t )
+{
+	// deleting isn't safe here, so thread does it
+	t->next_retired = retired.load( std::memory_order_relaxed );
+	while ( !retired.compare_exchange_weak( t->next_retired, t,
+			std::memory_order_release, std::memory_order_relaxed ) ) { }
+	wake.notify_one();
+}
+
+void Gme_Playlist::on_event( void* track, gme_event_t const* e )
+{
+	if ( e->type == gme_event_track_end )
+		static_cast<track_t*>( track )->ended_at = e->offset;
+}
+
+bool Gme_Playlist::track_ended( track_t const* t )
+{
+	return t->ended_at >= 0 || t->emu->track_ended();
+}
+
+// Plays count samples of track, fading them in if it's still within its ramp
+void Gme_Playlist::play_track( track_t* t, long count, sample_t* out )
+{
+	int64_t const time = t->emu->tell_samples();
+	t->ended_at = -1;
+	if ( t->emu->play( count, out ) )
+		t->ended_at = 0;
+
+	// fade leaves rest of block quiet rather than silent
+	if ( t->ended_at >= 0 )
+		memset( &out [t->ended_at], 0, (count - t->ended_at) * sizeof *out );
+
+	if ( time < t->ramp )
+	{
+		long const n = (long) min( (int64_t) count, t->ramp - time );
+		float const scale = 1.0f / t->ramp;
+		for ( long i = 0; i < n; i++ )
+			out [i] = sample_t (out [i] * (float (time + (i & ~1)) * scale)); // same for both channels
+	}
+}
+
+void Gme_Playlist::play( long count, sample_t* out )
+{
+	require( count % 2 == 0 ); // must be stereo
+	int64_t const xfade = msec_to_samples( crossfade.load( std::memory_order_relaxed ) );
+	long pos = 0;
+	while ( pos < count )
+	{
+		// track that ended in previous call, or as soon as it started
+		if ( playing && playing->emu->track_ended() )
+		{
+			retire( playing );
+			playing = incoming;
+			incoming = 0;
+			continue;
+		}
+
+		if ( !playing )
+		{
+			playing = take_next();
+			if ( !playing )
+			{
+				memset( &out [pos], 0, (count - pos) * sizeof *out );
+				break;
+			}
+			continue;
+		}
+
+		// play up to where crossfade begins, then play next track along with it
+		long n = count - pos;
+		if ( !incoming && xfade > 0 && playing->end >= 0 )
+		{
+			int64_t const time  = playing->emu->tell_samples();
+			int64_t const start = playing->end - min( xfade, playing->end );
+			if ( time < start )
+				n = (long) min( (int64_t) n, start - time );
+			else if ( (incoming = take_next()) != 0 )
+				incoming->ramp = max( playing->end - time, (int64_t) 0 );
+		}
+		if ( incoming )
+			n = min( n, (long) buf_size );
+
+		play_track( playing, n, &out [pos] );
+		if ( incoming )
+		{
+			play_track( incoming, n, buf );
+			sample_t* io = &out [pos];
+			for ( long i = 0; i < n; i++ )
+			{
+				int s = io [i] + buf [i];
+				if ( (sample_t) s != s )
+					s = 0x7FFF - (s >> 24);
+				io [i] = (sample_t) s;
+			}
+		}
+
+		if ( track_ended( playing ) )
+		{
+			// rest of block is played by next track, unless it's already been mixed in
+			long const end = (incoming || playing->ended_at < 0) ? n : playing->ended_at;
+			retire( playing );
+			playing  = incoming;
+			incoming = 0;
+			pos += end;
+		}
+		else
+		{
+			pos += n;
+		}
+	}
+	current_index.store( playing ? playing->index : -1, std::memory_order_release );
+}
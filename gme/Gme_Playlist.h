@@ -0,0 +1,123 @@
+// Gapless playback of a list of tracks, loaded ahead on a helper thread
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef GME_PLAYLIST_H
+#define GME_PLAYLIST_H
+
+#include "Music_Emu.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Plays entries one after another with no gap between them, optionally crossfading.
+// Helper thread opens each entry and starts its track, which skips any initial
+// silence, while the one before it plays, so play() only ever generates sound. Entries
+// can be added while playing, from a thread other than the one calling play().
+class Gme_Playlist {
+public:
+	typedef Music_Emu::sample_t sample_t;
+
+	// Starts thread. Output is stereo at sample_rate.
+	explicit Gme_Playlist( long sample_rate );
+	~Gme_Playlist();
+
+	// Add track to end of list. Length and fade are in msec, where -1 uses track's
+	// length from its info or m3u playlist, or 2.5 minutes if it has none, and fade's
+	// or 8 seconds. Length of 0 plays until track ends by itself. Copies data.
+	blargg_err_t add_file( const char* path, int track, int length, int fade );
+	blargg_err_t add_data( void const* data, long size, int track, int length, int fade );
+
+	// Add each entry of m3u playlist, whose file names are relative to its directory
+	blargg_err_t load_m3u( const char* path );
+
+	// Number of entries added
+	int size() const                { return size_.load( std::memory_order_acquire ); }
+
+	// Start next track while one with a fade has msec left to go, fading it in over
+	// that time, or 0 to start it once the previous one ends
+	void set_crossfade( int msec )  { crossfade.store( msec ); }
+
+	// Generate count samples into out, moving to next entry at the exact sample where
+	// one ends. Output is silent if next one isn't loaded yet. Doesn't block or
+	// allocate, so it can be called from an audio thread.
+	void play( long count, sample_t* out );
+
+	// Wait until entry after one playing has been loaded, or all have been tried. For
+	// rendering faster than real time without play() having to wait for them.
+	void wait();
+
+	// Index of entry playing, or -1 if none
+	int current() const             { return current_index.load( std::memory_order_acquire ); }
+
+	// True if all entries added so far have been played
+	bool ended() const;
+
+	// Most recent error loading an entry, which was skipped, or NULL if none. Clears
+	// it after returning it.
+	const char* warning()           { return warning_.exchange( 0 ); }
+
+private:
+	struct entry_t
+	{
+		char* path;
+		void* data;     // if not NULL, data of size bytes rather than path
+		long size;
+		int track;      // 0-based, or -1 for first
+		bool decimal_track; // m3u track number, which is 1-based for most types
+		int length;
+		int fade;
+		int intro;      // from m3u, or -1
+		int loop;
+	};
+
+	struct track_t
+	{
+		Music_Emu* emu;
+		int index;
+		int64_t end;       // sample where fade ends, or -1 if it doesn't fade
+		int64_t ramp;      // samples at start to fade in over, or 0
+		long ended_at;     // offset of track end in last play, or -1
+		track_t* next_retired; // in list of ones play() is done with
+	};
+
+	long const sample_rate;
+	std::atomic<int> crossfade;
+
+	// entries; mutex guards them, and entry_t fields are only read by thread
+	blargg_vector<entry_t> entries;
+	std::atomic<int> size_;
+	std::atomic<int> loaded;   // number of entries thread is done with
+	std::atomic<const char*> warning_;
+	blargg_err_t add( entry_t const& );
+
+	// playback, used only by play() once thread hands them over
+	enum { buf_size = 2048 };
+	track_t* playing;
+	track_t* incoming;         // next track while crossfading
+	std::atomic<int> current_index;
+	sample_t buf [buf_size];
+	track_t* take_next();
+	void play_track( track_t*, long count, sample_t* out );
+	void retire( track_t* );
+	static bool track_ended( track_t const* );
+	static void on_event( void* track, gme_event_t const* );
+
+	// thread
+	std::atomic<track_t*> next;     // loaded and ready to play, or NULL
+	std::atomic<track_t*> retired;  // list of tracks to delete
+	bool quit;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable ready;  // next was set or all entries were tried
+	std::thread thread;
+	void run();
+	blargg_err_t load( entry_t const&, int index, track_t** out );
+	int64_t msec_to_samples( long msec ) const { return (int64_t) msec * sample_rate / 1000 * 2; }
+	static void delete_track( track_t* );
+	static void free_entry( entry_t& );
+public:
+	BLARGG_DISABLE_NOTHROW
+};
+
+#endif
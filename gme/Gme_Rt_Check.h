@@ -0,0 +1,49 @@
+// Optional checking for things unsafe on a real-time audio thread (see gme_rt_report())
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef GME_RT_CHECK_H
+#define GME_RT_CHECK_H
+
+#include "gme.h"
+
+// Checking only happens if GME_RT_CHECK is defined. Otherwise these macros expand
+// to nothing:
+//
+// GME_RT_SCOPE( gme_rt_report_t* ) - rest of scope must be real-time safe, with
+// anything unsafe done in it on this thread counted in report. NULL turns checking
+// off for rest of scope.
+// GME_RT_UNSAFE( field, what ) - counts one unsafe operation in field of current
+// report, if any. what is a string constant describing it.
+
+#ifdef GME_RT_CHECK
+
+extern thread_local gme_rt_report_t* gme_rt_current;
+
+class Gme_Rt_Scope {
+public:
+	explicit Gme_Rt_Scope( gme_rt_report_t* r ) : prev( gme_rt_current ) { gme_rt_current = r; }
+	~Gme_Rt_Scope() { gme_rt_current = prev; }
+private:
+	gme_rt_report_t* const prev;
+};
+
+inline void gme_rt_unsafe( long gme_rt_report_t::* field, const char* what )
+{
+	if ( gme_rt_report_t* r = gme_rt_current )
+	{
+		++(r->*field);
+		r->last = what;
+	}
+}
+
+#define GME_RT_SCOPE( report )          Gme_Rt_Scope gme_rt_scope_( report )
+#define GME_RT_UNSAFE( field, what )    gme_rt_unsafe( &gme_rt_report_t::field, what )
+
+#else
+
+#define GME_RT_SCOPE( report )          ((void) 0)
+#define GME_RT_UNSAFE( field, what )    ((void) 0)
+
+#endif
+
+#endif
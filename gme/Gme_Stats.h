@@ -0,0 +1,99 @@
+// Optional per-emulator performance counters (see gme_get_stats())
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef GME_STATS_H
+#define GME_STATS_H
+
+#include "gme.h"
+
+// Collection only happens if GME_ENABLE_STATS is defined. Otherwise these
+// macros expand to nothing:
+//
+// GME_STATS_SCOPE( gme_stats_t* ) - counters and timers in rest of scope go to
+// these stats, on this thread only
+// GME_STAT_ADD( field, n ) - adds n to field of current stats, if any
+// GME_STAT_TIME( field ) - adds wall time until end of scope to field of
+// current stats, minus any time charged to stages timed inside this one
+
+#ifdef GME_ENABLE_STATS
+
+#include <chrono>
+
+typedef std::chrono::steady_clock gme_stats_clock;
+
+struct gme_stats_state_t {
+	gme_stats_t* stats;                     // stats of emulator being run, or NULL
+	double gme_stats_t::* stage;            // stage being timed, or NULL
+	gme_stats_clock::time_point stage_start;
+};
+extern thread_local gme_stats_state_t gme_stats_state;
+
+class Gme_Stage_Timer {
+public:
+	explicit Gme_Stage_Timer( double gme_stats_t::* stage ) : prev( gme_stats_state.stage )
+	{
+		if ( gme_stats_state.stats )
+		{
+			charge();
+			gme_stats_state.stage = stage;
+		}
+	}
+
+	~Gme_Stage_Timer()
+	{
+		if ( gme_stats_state.stats )
+		{
+			charge();
+			gme_stats_state.stage = prev;
+		}
+	}
+
+	// Adds time since last charge to current stage
+	static void charge()
+	{
+		gme_stats_state_t& s = gme_stats_state;
+		gme_stats_clock::time_point now = gme_stats_clock::now();
+		if ( s.stage )
+			s.stats->*s.stage += std::chrono::duration<double>( now - s.stage_start ).count();
+		s.stage_start = now;
+	}
+
+private:
+	double gme_stats_t::* const prev;
+};
+
+class Gme_Stats_Scope {
+public:
+	explicit Gme_Stats_Scope( gme_stats_t* stats ) : saved( gme_stats_state )
+	{
+		if ( saved.stats )
+			Gme_Stage_Timer::charge();
+		gme_stats_state.stats = stats;
+		gme_stats_state.stage = 0;
+	}
+
+	~Gme_Stats_Scope()
+	{
+		gme_stats_clock::time_point now = gme_stats_clock::now();
+		gme_stats_state = saved;
+		gme_stats_state.stage_start = now; // don't charge our time to enclosing stage
+	}
+
+private:
+	gme_stats_state_t saved;
+};
+
+#define GME_STATS_SCOPE( stats )    Gme_Stats_Scope gme_stats_scope_( stats )
+#define GME_STAT_TIME( field )      Gme_Stage_Timer gme_stage_timer_( &gme_stats_t::field )
+#define GME_STAT_ADD( field, n ) \
+	do { if ( gme_stats_state.stats ) gme_stats_state.stats->field += (n); } while ( 0 )
+
+#else
+
+#define GME_STATS_SCOPE( stats )    ((void) 0)
+#define GME_STAT_TIME( field )      ((void) 0)
+#define GME_STAT_ADD( field, n )    ((void) 0)
+
+#endif
+
+#endif
@@ -3,6 +3,7 @@
 #include "Gym_Emu.h"
 
 #include "blargg_endian.h"
+#include "Gme_Stats.h"
 #include <string.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -29,6 +30,8 @@ Gym_Emu::Gym_Emu()
 {
 	data = 0;
 	pos  = 0;
+	fm_sample_rate = 0;
+	fm_rate_stale  = false;
 	set_type( gme_gym_type );
 
 	static const char* const names [] = {
@@ -36,29 +39,37 @@ Gym_Emu::Gym_Emu()
 	};
 	set_voice_names( names );
 	set_silence_lookahead( 1 ); // tracks should already be trimmed
+	set_native_rate( long (base_clock / 7.0 / 144 + 0.5) );
 }
 
 Gym_Emu::~Gym_Emu() { }
 
 // Track info
 
+// Info is track_info_t or gme_probe_t
+template<class Info>
+static void get_gym_length( Gym_Emu::header_t const& h, long length, Info* out )
+{
+	length = length * 50 / 3; // 1000 / 60
+	long loop = get_le32( h.loop_start );
+	if ( loop )
+	{
+		out->intro_length = loop * 50 / 3;
+		out->loop_length  = length - out->intro_length;
+	}
+	else
+	{
+		out->length = length;
+		out->intro_length = length; // make it clear that track is no longer than length
+		out->loop_length = 0;
+	}
+}
+
 static void get_gym_info( Gym_Emu::header_t const& h, long length, track_info_t* out )
 {
 	if ( !memcmp( h.tag, "GYMX", 4 ) )
 	{
-		length = length * 50 / 3; // 1000 / 60
-		long loop = get_le32( h.loop_start );
-		if ( loop )
-		{
-			out->intro_length = loop * 50 / 3;
-			out->loop_length  = length - out->intro_length;
-		}
-		else
-		{
-			out->length = length;
-			out->intro_length = length; // make it clear that track is no longer than length
-			out->loop_length = 0;
-		}
+		get_gym_length( h, length, out );
 
 		// more stupidity where the field should have been left
 		if ( strcmp( h.song, "Unknown Song" ) )
@@ -158,10 +169,40 @@ struct Gym_File : Gme_Info_
 	}
 };
 
+static blargg_err_t probe_gym( Gme_Probe& out, byte const* in, long size )
+{
+	int data_offset = 0;
+	RETURN_ERR( check_header( in, size, &data_offset ) );
+
+	Gym_Emu::header_t const& h = *(Gym_Emu::header_t const*) in;
+	if ( data_offset )
+	{
+		get_gym_length( h, gym_track_length( in + data_offset, in + size ), &out.info );
+
+		// fields might not be terminated
+		if ( strncmp( h.song, "Unknown Song", sizeof h.song ) )
+			GME_PROBE_FIELD( h, out, song );
+
+		if ( strncmp( h.game, "Unknown Game", sizeof h.game ) )
+			GME_PROBE_FIELD( h, out, game );
+
+		if ( strncmp( h.copyright, "Unknown Publisher", sizeof h.copyright ) )
+			GME_PROBE_FIELD( h, out, copyright );
+
+		if ( strncmp( h.dumper, "Unknown Person", sizeof h.dumper ) )
+			GME_PROBE_FIELD( h, out, dumper );
+
+		if ( strncmp( h.comment, "Header added by YMAMP", sizeof h.comment ) )
+			GME_PROBE_FIELD( h, out, comment );
+	}
+	out.report_all();
+	return 0;
+}
+
 static Music_Emu* new_gym_emu () { return BLARGG_NEW Gym_Emu ; }
 static Music_Emu* new_gym_file() { return BLARGG_NEW Gym_File; }
 
-static gme_type_t_ const gme_gym_type_ = { "Sega Genesis", 1, &new_gym_emu, &new_gym_file, "GYM", 0 };
+static gme_type_t_ const gme_gym_type_ = { "Sega Genesis", 1, &new_gym_emu, &new_gym_file, "GYM", 0, &probe_gym };
 extern gme_type_t const gme_gym_type = &gme_gym_type_;
 
 // Setup
@@ -173,18 +214,43 @@ blargg_err_t Gym_Emu::set_sample_rate_( long sample_rate )
 	dac_synth.treble_eq( eq );
 	apu.volume( 0.135 * fm_gain * gain() );
 	dac_synth.volume( 0.125 / 256 * fm_gain * gain() );
-	double factor = Dual_Resampler::setup( oversample_factor, 0.990, fm_gain * gain() );
-	fm_sample_rate = sample_rate * factor;
+	Dual_Resampler::enable_multi_channel( multi_channel() ? fm.channel_count : 0, 2 );
 
 	RETURN_ERR( blip_buf.set_sample_rate( sample_rate, int (1000 / 60.0 / min_tempo) ) );
 	blip_buf.clock_rate( clock_rate );
+	if ( multi_channel() )
+	{
+		RETURN_ERR( pcm_buf.set_sample_rate( sample_rate, int (1000 / 60.0 / min_tempo) ) );
+		pcm_buf.clock_rate( clock_rate );
+	}
 
-	RETURN_ERR( fm.set_rate( fm_sample_rate, base_clock / 7.0 ) );
+	if ( current_track() < 0 )
+	{
+		RETURN_ERR( setup_fm( sample_rate ) );
+	}
+	else
+	{
+		// Setting FM chip's rate would reset it, so leave it running at its
+		// current rate and just resample that to the new rate. start_track()
+		// sets it up properly.
+		Dual_Resampler::setup( fm_sample_rate / sample_rate, 0.990, fm_gain * gain() );
+		fm_rate_stale = true;
+	}
 	RETURN_ERR( Dual_Resampler::reset( long (1.0 / 60 / min_tempo * sample_rate) ) );
 
 	return 0;
 }
 
+blargg_err_t Gym_Emu::setup_fm( long sample_rate )
+{
+	// at the native rate, run FM at the output rate so the resampler just copies
+	double oversample = (sample_rate == native_rate()) ? 1.0 : oversample_factor;
+	double factor = Dual_Resampler::setup( oversample, 0.990, fm_gain * gain() );
+	fm_sample_rate = sample_rate * factor;
+	fm_rate_stale = false;
+	return fm.set_rate( fm_sample_rate, base_clock / 7.0 );
+}
+
 void Gym_Emu::set_tempo_( double t )
 {
 	if ( t < min_tempo )
@@ -200,6 +266,11 @@ void Gym_Emu::set_tempo_( double t )
 	}
 }
 
+blargg_err_t Gym_Emu::set_multi_channel( bool is_enabled )
+{
+	return Music_Emu::set_multi_channel_( is_enabled );
+}
+
 void Gym_Emu::mute_voices_( int mask )
 {
 	Music_Emu::mute_voices_( mask );
@@ -227,6 +298,51 @@ blargg_err_t Gym_Emu::load_mem_( byte const* in, long size )
 	return 0;
 }
 
+blargg_err_t Gym_Emu::load_clone_( Gme_File const& other )
+{
+	// file data is shared, so pointers into it remain valid
+	Gym_Emu const& in = STATIC_CAST(Gym_Emu const&,other);
+	set_voice_count( 8 );
+	data       = in.data;
+	data_end   = in.data_end;
+	loop_begin = 0;
+	header_    = in.header_;
+	return 0;
+}
+
+blargg_err_t Gym_Emu::clone_state_( Music_Emu const& other )
+{
+	Gym_Emu const& in = STATIC_CAST(Gym_Emu const&,other);
+	if ( in.fm_rate_stale )
+	{
+		// other's FM chip is still running at rate from before sample rate
+		// changed; copying the chip copies its rate
+		fm_sample_rate = in.fm_sample_rate;
+		fm_rate_stale  = true;
+		Dual_Resampler::setup( fm_sample_rate / sample_rate(), 0.990, fm_gain * gain() );
+		RETURN_ERR( Dual_Resampler::reset( long (1.0 / 60 / min_tempo * sample_rate()) ) );
+		set_tempo_( tempo() );
+	}
+
+	pos              = in.pos;
+	loop_begin       = in.loop_begin;
+	loop_remain      = in.loop_remain;
+	clocks_per_frame = in.clocks_per_frame;
+	dac_amp          = in.dac_amp;
+	prev_dac_count   = in.prev_dac_count;
+	dac_enabled      = in.dac_enabled;
+	memcpy( dac_buf, in.dac_buf, sizeof dac_buf );
+
+	fm.copy_state( in.fm );
+	apu.copy_state( in.apu );
+	dac_synth.copy_config( in.dac_synth );
+	blip_buf.copy_state( in.blip_buf );
+	if ( multi_channel() )
+		pcm_buf.copy_state( in.pcm_buf );
+	Dual_Resampler::copy_state( in );
+	return Music_Emu::clone_state_( in );
+}
+
 // Emulation
 
 blargg_err_t Gym_Emu::start_track_( int track )
@@ -240,9 +356,17 @@ blargg_err_t Gym_Emu::start_track_( int track )
 	dac_enabled    = false;
 	dac_amp        = -1;
 
+	if ( fm_rate_stale )
+	{
+		RETURN_ERR( setup_fm( sample_rate() ) );
+		RETURN_ERR( Dual_Resampler::reset( long (1.0 / 60 / min_tempo * sample_rate()) ) );
+		set_tempo_( tempo() );
+		remute_voices();
+	}
 	fm.reset();
 	apu.reset();
 	blip_buf.clear();
+	pcm_buf.clear();
 	Dual_Resampler::clear();
 	return 0;
 }
@@ -287,11 +411,12 @@ void Gym_Emu::run_dac( int dac_count )
 	if ( dac_amp < 0 )
 		dac_amp = dac_buf [0];
 
+	Blip_Buffer* const out = multi_channel() ? &pcm_buf : &blip_buf;
 	for ( int i = 0; i < dac_count; i++ )
 	{
 		int delta = dac_buf [i] - dac_amp;
 		dac_amp += delta;
-		dac_synth.offset_resampled( time, delta, &blip_buf );
+		dac_synth.offset_resampled( time, delta, out );
 		time += period;
 	}
 	this->dac_amp = dac_amp;
@@ -363,18 +488,37 @@ void Gym_Emu::parse_frame()
 int Gym_Emu::play_frame( blip_time_t blip_time, int sample_count, sample_t* buf )
 {
 	if ( !track_ended() )
+	{
+		GME_STAT_TIME( cpu_time );
 		parse_frame();
+	}
 
 	apu.end_frame( blip_time );
 
-	memset( buf, 0, sample_count * sizeof *buf );
-	fm.run( sample_count >> 1, buf );
+	if ( multi_channel() )
+	{
+		memset( buf, 0, sample_count * fm.channel_count * sizeof *buf );
+		fm.run_channels( sample_count >> 1, buf );
+	}
+	else
+	{
+		memset( buf, 0, sample_count * sizeof *buf );
+		fm.run( sample_count >> 1, buf );
+	}
 
 	return sample_count;
 }
 
 blargg_err_t Gym_Emu::play_( long count, sample_t* out )
 {
-	Dual_Resampler::dual_play( count, out, blip_buf );
+	if ( multi_channel() )
+	{
+		Blip_Buffer* bufs [2] = { &pcm_buf, &blip_buf };
+		Dual_Resampler::dual_play_multi( count, out, bufs );
+	}
+	else
+	{
+		Dual_Resampler::dual_play( count, out, blip_buf );
+	}
 	return 0;
 }
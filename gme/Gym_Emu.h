@@ -30,6 +30,10 @@ public:
 	// Header for currently loaded file
 	header_t const& header() const { return header_; }
 
+	// Multi-channel output gives each of the 6 FM channels, PCM and PSG its
+	// own stereo channel.
+	blargg_err_t set_multi_channel( bool is_enabled ) override;
+
 	static gme_type_t static_type() { return gme_gym_type; }
 
 public:
@@ -45,6 +49,8 @@ public:
 	~Gym_Emu();
 protected:
 	blargg_err_t load_mem_( byte const*, long );
+	blargg_err_t load_clone_( Gme_File const& );
+	blargg_err_t clone_state_( Music_Emu const& );
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t set_sample_rate_( long sample_rate );
 	blargg_err_t start_track_( int );
@@ -61,8 +67,10 @@ private:
 	int32_t loop_remain; // frames remaining until loop beginning has been located
 	header_t header_;
 	double fm_sample_rate;
+	bool fm_rate_stale; // sample rate changed during track, so FM needs setup_fm()
 	int32_t clocks_per_frame;
 	void parse_frame();
+	blargg_err_t setup_fm( long sample_rate );
 
 	// dac (pcm)
 	int dac_amp;
@@ -73,6 +81,7 @@ private:
 
 	// sound
 	Blip_Buffer blip_buf;
+	Blip_Buffer pcm_buf; // PCM in multi-channel mode, when blip_buf only has PSG
 	Ym2612_Emu fm;
 	Blip_Synth<blip_med_quality,1> dac_synth;
 	Sms_Apu apu;
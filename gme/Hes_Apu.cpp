@@ -1,6 +1,7 @@
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
 
 #include "Hes_Apu.h"
+#include "Gme_Stats.h"
 
 #include <string.h>
 
@@ -69,8 +70,32 @@ void Hes_Apu::osc_output( int index, Blip_Buffer* center, Blip_Buffer* left, Bli
 	while ( osc != oscs );
 }
 
+void Hes_Apu::copy_state( Hes_Apu const& in )
+{
+	latch   = in.latch;
+	balance = in.balance;
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Hes_Osc& osc = oscs [i];
+		Hes_Osc const& from = in.oscs [i];
+		memcpy( &osc, &from, offsetof (Hes_Osc,outputs) );
+		osc.noise_lfsr = from.noise_lfsr;
+		osc.control    = from.control;
+
+		// same choice of outputs as balance_changed() made for other
+		osc.outputs [0] = osc.chans [0];
+		osc.outputs [1] = 0;
+		if ( osc.volume [0] != osc.volume [1] )
+		{
+			osc.outputs [0] = osc.chans [1];
+			osc.outputs [1] = osc.chans [2];
+		}
+	}
+}
+
 void Hes_Osc::run_until( synth_t& synth_, blip_time_t end_time )
 {
+	GME_STAT_TIME( apu_time );
 	Blip_Buffer* const osc_outputs_0 = outputs [0]; // cache often-used values
 	if ( osc_outputs_0 && control & 0x80 )
 	{
@@ -228,6 +253,7 @@ void Hes_Apu::balance_changed( Hes_Osc& osc )
 
 void Hes_Apu::write_data( blip_time_t time, int addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	if ( addr == 0x800 )
 	{
 		latch = data & 7;
@@ -47,6 +47,9 @@ public:
 
 	void end_frame( blip_time_t );
 
+	// Copy emulation state of other APU, keeping own outputs and volume
+	void copy_state( Hes_Apu const& );
+
 public:
 	Hes_Apu();
 private:
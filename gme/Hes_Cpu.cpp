@@ -3,6 +3,7 @@
 #include "Hes_Cpu.h"
 
 #include "blargg_endian.h"
+#include "Gme_Stats.h"
 
 //#include "hes_cpu_log.h"
 
@@ -68,6 +69,23 @@ void Hes_Cpu::reset()
 	blargg_verify_byte_order();
 }
 
+void Hes_Cpu::copy_state( Hes_Cpu const& in, void const* in_base, void* base, size_t size )
+{
+	check( state == &state_ && in.state == &in.state_ );
+	memcpy( ram, in.ram, sizeof ram );
+	memcpy( mmr, in.mmr, sizeof mmr );
+	r = in.r;
+	state_.base = in.state_.base;
+	state_.time = in.state_.time;
+	for ( int i = 0; i < page_count + 1; i++ )
+	{
+		int32_t offset = PAGE_OFFSET( i << page_shift );
+		state_.code_map [i] = blargg_rebase( in.state_.code_map [i] + offset, in_base, base, size ) - offset;
+	}
+	irq_time_ = in.irq_time_;
+	end_time_ = in.end_time_;
+}
+
 void Hes_Cpu::set_mmr( int reg, int bank )
 {
 	assert( (unsigned) reg <= page_count ); // allow page past end to be set
@@ -168,6 +186,8 @@ loop:
 		pc++;
 	#endif
 
+	GME_STAT_ADD( instructions, 1 );
+
 	// TODO: each reference lists slightly different timing values, ugh
 	static uint8_t const clock_table [256] =
 	{// 0 1 2  3 4 5 6 7 8 9 A B C D E F
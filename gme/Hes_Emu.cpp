@@ -58,25 +58,35 @@ void Hes_Emu::unload()
 
 // Track info
 
-static byte const* copy_field( byte const* in, char* out )
+// Length of text field at in, or 0 if it isn't text
+static int field_len( byte const* in )
 {
-	if ( in )
-	{
-		int len = 0x20;
-		if ( in [0x1F] && !in [0x2F] )
-			len = 0x30; // fields are sometimes 16 bytes longer (ugh)
+	int len = 0x20;
+	if ( in [0x1F] && !in [0x2F] )
+		len = 0x30; // fields are sometimes 16 bytes longer (ugh)
 
-		// since text fields are where any data could be, detect non-text
-		// and fields with data after zero byte terminator
+	// since text fields are where any data could be, detect non-text
+	// and fields with data after zero byte terminator
 
-		int i = 0;
-		for ( i = 0; i < len && in [i]; i++ )
-			if ( ((in [i] + 1) & 0xFF) < ' ' + 1 ) // also treat 0xFF as non-text
-				return 0; // non-ASCII found
+	int i = 0;
+	for ( i = 0; i < len && in [i]; i++ )
+		if ( ((in [i] + 1) & 0xFF) < ' ' + 1 ) // also treat 0xFF as non-text
+			return 0; // non-ASCII found
 
-		for ( ; i < len; i++ )
-			if ( in [i] )
-				return 0; // data after terminator
+	for ( ; i < len; i++ )
+		if ( in [i] )
+			return 0; // data after terminator
+
+	return len;
+}
+
+static byte const* copy_field( byte const* in, char* out )
+{
+	if ( in )
+	{
+		int len = field_len( in );
+		if ( !len )
+			return 0;
 
 		Gme_File::copy_field_( out, (char const*) in, len );
 		in += len;
@@ -94,6 +104,20 @@ static void copy_hes_fields( byte const* in, track_info_t* out )
 	}
 }
 
+static byte const* probe_field( byte const* in, Gme_Probe& out, gme_str_t* field )
+{
+	if ( in )
+	{
+		int len = field_len( in );
+		if ( !len )
+			return 0;
+
+		out.set_field( field, (char const*) in, len );
+		in += len;
+	}
+	return in;
+}
+
 blargg_err_t Hes_Emu::track_info_( track_info_t* out, int ) const
 {
 	copy_hes_fields( rom.begin() + 0x20, out );
@@ -133,10 +157,27 @@ struct Hes_File : Gme_Info_
 	}
 };
 
+static blargg_err_t probe_hes( Gme_Probe& out, byte const* in, long size )
+{
+	if ( size < (long) sizeof (Hes_File::header_t) )
+		return gme_wrong_file_type;
+
+	RETURN_ERR( check_hes_header( in ) );
+	in += offsetof (Hes_File::header_t,fields);
+	if ( *in >= ' ' )
+	{
+		in = probe_field( in, out, &out.info.game );
+		in = probe_field( in, out, &out.info.author );
+		in = probe_field( in, out, &out.info.copyright );
+	}
+	out.report_all();
+	return 0;
+}
+
 static Music_Emu* new_hes_emu () { return BLARGG_NEW Hes_Emu ; }
 static Music_Emu* new_hes_file() { return BLARGG_NEW Hes_File; }
 
-static gme_type_t_ const gme_hes_type_ = { "PC Engine", 256, &new_hes_emu, &new_hes_file, "HES", 1 };
+static gme_type_t_ const gme_hes_type_ = { "PC Engine", 256, &new_hes_emu, &new_hes_file, "HES", 1, &probe_hes };
 extern gme_type_t const gme_hes_type = &gme_hes_type_;
 
 
@@ -146,7 +187,20 @@ blargg_err_t Hes_Emu::load_( Data_Reader& in )
 {
 	blaarg_static_assert( offsetof (header_t,unused [4]) == header_size, "HES header layout is incorrect!" );
 	RETURN_ERR( rom.load( in, header_size, &header_, unmapped ) );
+	return init_file();
+}
+
+blargg_err_t Hes_Emu::load_clone_( Gme_File const& other )
+{
+	Hes_Emu const& in = STATIC_CAST(Hes_Emu const&,other);
+	rom.share( in.rom );
+	header_ = in.header_;
+	return init_file();
+}
 
+// Sets up emulator for file data in rom and header_
+blargg_err_t Hes_Emu::init_file()
+{
 	RETURN_ERR( check_hes_header( header_.tag ) );
 
 	if ( header_.vers != 0 )
@@ -256,6 +310,23 @@ blargg_err_t Hes_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Hes_Emu::clone_state_( Music_Emu const& other )
+{
+	Hes_Emu const& in = STATIC_CAST(Hes_Emu const&,other);
+	cpu::copy_state( in, &in, this, sizeof *this );
+	for ( int i = 0; i < page_count + 1; i++ )
+		write_pages [i] = blargg_rebase( in.write_pages [i], &in, this, sizeof *this );
+	play_period     = in.play_period;
+	last_frame_hook = in.last_frame_hook;
+	timer_base      = in.timer_base;
+	timer           = in.timer;
+	vdp             = in.vdp;
+	irq             = in.irq;
+	apu.copy_state( in.apu );
+	memcpy( sgx, in.sgx, sizeof sgx );
+	return Classic_Emu::clone_state_( in );
+}
+
 // Hardware
 
 void Hes_Emu::cpu_write_vdp( int addr, int data )
@@ -37,6 +37,8 @@ public:
 protected:
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t load_( Data_Reader& );
+	blargg_err_t load_clone_( Gme_File const& );
+	blargg_err_t clone_state_( Music_Emu const& );
 	blargg_err_t start_track_( int );
 	blargg_err_t run_clocks( blip_time_t&, int );
 	void set_tempo_( double );
@@ -60,6 +62,8 @@ private:
 	hes_time_t last_frame_hook;
 	int timer_base;
 
+	blargg_err_t init_file();
+
 	struct {
 		hes_time_t last_time;
 		int32_t count;
@@ -9,6 +9,7 @@ Last validated with zexall 2006.11.14 2:19 PM
 #include "Kss_Cpu.h"
 
 #include "blargg_endian.h"
+#include "Gme_Stats.h"
 #include <string.h>
 
 //#include "z80_cpu_log.h"
@@ -99,6 +100,23 @@ void Kss_Cpu::reset( void* unmapped_write, void const* unmapped_read )
 	memset( &r, 0, sizeof r );
 }
 
+void Kss_Cpu::copy_state( Kss_Cpu const& in, void const* in_base, void* base, size_t size )
+{
+	check( state == &state_ && in.state == &in.state_ );
+	state_.time = in.state_.time;
+	state_.base = in.state_.base;
+	end_time_   = in.end_time_;
+
+	for ( int i = 0; i < page_count + 1; i++ )
+	{
+		int32_t offset = KSS_CPU_PAGE_OFFSET( i * (int32_t) page_size );
+		set_page( i, blargg_rebase( in.state_.write [i] + offset, in_base, base, size ),
+				blargg_rebase( in.state_.read [i] + offset, in_base, base, size ) );
+	}
+
+	r = in.r;
+}
+
 void Kss_Cpu::map_mem( unsigned addr, uint32_t size, void* write, void const* read )
 {
 	// address range must begin and end on page boundaries
@@ -218,6 +236,8 @@ loop:
 		pc++;
 	#endif
 
+	GME_STAT_ADD( instructions, 1 );
+
 	static byte const base_timing [0x100] = {
 	//   0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
 		 4,10, 7, 6, 4, 4, 7, 4, 4,11, 7, 6, 4, 4, 7, 4, // 0
@@ -22,6 +22,11 @@ public:
 	static const unsigned int page_size = 0x2000;
 	void map_mem( unsigned addr, uint32_t size, void* write, void const* read );
 
+	// Copy registers and state of other CPU. Memory mapped within size bytes at
+	// other_base is mapped to the same offset from base instead, so a copy of an
+	// emulator maps its own memory.
+	void copy_state( Kss_Cpu const& other, void const* other_base, void* base, size_t size );
+
 	// Map address to page
 	uint8_t* write( unsigned addr );
 	uint8_t const* read( unsigned addr );
@@ -56,7 +56,7 @@ void Kss_Emu::unload()
 
 // Track info
 
-static void copy_kss_fields( Kss_Emu::header_t const& h, track_info_t* out )
+static const char* kss_system( Kss_Emu::header_t const& h )
 {
 	const char* system = "MSX";
 	if ( h.device_flags & 0x02 )
@@ -65,7 +65,12 @@ static void copy_kss_fields( Kss_Emu::header_t const& h, track_info_t* out )
 		if ( h.device_flags & 0x04 )
 			system = "Game Gear";
 	}
-	Gme_File::copy_field_( out->system, system );
+	return system;
+}
+
+static void copy_kss_fields( Kss_Emu::header_t const& h, track_info_t* out )
+{
+	Gme_File::copy_field_( out->system, kss_system( h ) );
 }
 
 blargg_err_t Kss_Emu::track_info_( track_info_t* out, int ) const
@@ -102,10 +107,22 @@ struct Kss_File : Gme_Info_
 	}
 };
 
+static blargg_err_t probe_kss( Gme_Probe& out, byte const* in, long size )
+{
+	if ( size < Kss_Emu::header_size )
+		return gme_wrong_file_type;
+
+	Kss_Emu::header_t const& h = *(Kss_Emu::header_t const*) in;
+	RETURN_ERR( check_kss_header( &h ) );
+	out.set_field( &out.info.system, kss_system( h ) );
+	out.report_all();
+	return 0;
+}
+
 static Music_Emu* new_kss_emu () { return BLARGG_NEW Kss_Emu ; }
 static Music_Emu* new_kss_file() { return BLARGG_NEW Kss_File; }
 
-static gme_type_t_ const gme_kss_type_ = { "MSX", 256, &new_kss_emu, &new_kss_file, "KSS", 0x03 };
+static gme_type_t_ const gme_kss_type_ = { "MSX", 256, &new_kss_emu, &new_kss_file, "KSS", 0x03, &probe_kss };
 extern gme_type_t const gme_kss_type = &gme_kss_type_;
 
 
@@ -155,6 +172,20 @@ blargg_err_t Kss_Emu::load_( Data_Reader& in )
 	if ( header_.device_flags & 0x09 )
 		set_warning( "FM sound not supported" );
 
+	return init_file();
+}
+
+blargg_err_t Kss_Emu::load_clone_( Gme_File const& other )
+{
+	Kss_Emu const& in = STATIC_CAST(Kss_Emu const&,other);
+	rom.share( in.rom );
+	header_ = in.header_;
+	return init_file();
+}
+
+// Sets up emulator for file data in rom and header_
+blargg_err_t Kss_Emu::init_file()
+{
 	scc_enabled = 0xC000;
 	if ( header_.device_flags & 0x04 )
 		scc_enabled = 0;
@@ -260,6 +291,24 @@ blargg_err_t Kss_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Kss_Emu::clone_state_( Music_Emu const& other )
+{
+	Kss_Emu const& in = STATIC_CAST(Kss_Emu const&,other);
+	cpu::copy_state( in, &in, this, sizeof *this );
+	scc_accessed = in.scc_accessed;
+	gain_updated = in.gain_updated;
+	bank_count   = in.bank_count;
+	play_period  = in.play_period;
+	next_play    = in.next_play;
+	ay_latch     = in.ay_latch;
+	memcpy( ram, in.ram, sizeof ram );
+	ay.copy_state( in.ay );
+	scc.copy_state( in.scc );
+	if ( sn )
+		sn->copy_state( *in.sn );
+	return Classic_Emu::clone_state_( in );
+}
+
 void Kss_Emu::set_bank( int logical, int physical )
 {
 	unsigned const bank_size = this->bank_size();
@@ -23,6 +23,7 @@ static int const wave_size = 0x20;
 
 void Scc_Apu::run_until( blip_time_t end_time )
 {
+	GME_STAT_TIME( apu_time );
 	for ( int index = 0; index < osc_count; index++ )
 	{
 		osc_t& osc = oscs [index];
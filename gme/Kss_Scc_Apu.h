@@ -6,6 +6,7 @@
 
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
+#include "Gme_Stats.h"
 #include <string.h>
 
 class Scc_Apu {
@@ -38,6 +39,9 @@ public:
 	// Set treble equalization (see documentation)
 	void treble_eq( blip_eq_t const& );
 
+	// Copy emulation state and volume of other sound chip, keeping own outputs
+	void copy_state( Scc_Apu const& );
+
 public:
 	Scc_Apu();
 private:
@@ -69,6 +73,7 @@ inline void Scc_Apu::osc_output( int index, Blip_Buffer* b )
 
 inline void Scc_Apu::write( blip_time_t time, int addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	assert( (unsigned) addr < reg_count );
 	run_until( time );
 	regs [addr] = data;
@@ -103,4 +108,15 @@ inline void Scc_Apu::reset()
 	memset( regs, 0, sizeof regs );
 }
 
+inline void Scc_Apu::copy_state( Scc_Apu const& in )
+{
+	last_time = in.last_time;
+
+	for ( int i = 0; i < osc_count; i++ )
+		memcpy( &oscs [i], &in.oscs [i], offsetof (osc_t,output) );
+
+	memcpy( regs, in.regs, sizeof regs );
+	synth.copy_config( in.synth );
+}
+
 #endif
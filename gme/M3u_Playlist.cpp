@@ -2,6 +2,7 @@
 
 #include "M3u_Playlist.h"
 #include "Music_Emu.h"
+#include "Gme_Alloc.h"
 
 #include <string.h>
 
@@ -52,10 +53,15 @@ blargg_err_t Gme_File::load_m3u( const char* path ) { return load_m3u_( playlist
 
 blargg_err_t Gme_File::load_m3u( Data_Reader& in )  { return load_m3u_( playlist.load( in ) ); }
 
-gme_err_t gme_load_m3u( Music_Emu* me, const char* path ) { return me->load_m3u( path ); }
+gme_err_t gme_load_m3u( Music_Emu* me, const char* path )
+{
+	Gme_Heap_Scope scope( me->heap() );
+	return me->load_m3u( path );
+}
 
 gme_err_t gme_load_m3u_data( Music_Emu* me, const void* data, long size )
 {
+	Gme_Heap_Scope scope( me->heap() );
 	Mem_File_Reader in( data, size );
 	return me->load_m3u( in );
 }
@@ -495,3 +501,39 @@ blargg_err_t M3u_Playlist::load( void const* in, long size )
 	memcpy( data.begin(), in, size );
 	return parse();
 }
+
+blargg_err_t M3u_Playlist::copy( M3u_Playlist const& in )
+{
+	clear();
+	RETURN_ERR( data.resize( in.data.size() ) );
+	RETURN_ERR( entries.resize( in.entries.size() ) );
+	first_error_ = in.first_error_;
+	if ( !data.size() )
+		return 0; // nothing loaded
+	memcpy( data.begin(), in.data.begin(), data.size() );
+
+	// strings point into data or are constants
+	char const* old_data = in.data.begin();
+	size_t const size = data.size();
+	#define REBASE( str ) (str = blargg_rebase( str, old_data, data.begin(), size ))
+	for ( size_t i = 0; i < entries.size(); i++ )
+	{
+		entry_t& e = entries [i];
+		e = in.entries [i];
+		REBASE( e.file );
+		REBASE( e.type );
+		REBASE( e.name );
+	}
+	info_ = in.info_;
+	REBASE( info_.title );
+	REBASE( info_.artist );
+	REBASE( info_.date );
+	REBASE( info_.composer );
+	REBASE( info_.sequencer );
+	REBASE( info_.engineer );
+	REBASE( info_.ripping );
+	REBASE( info_.tagging );
+	REBASE( info_.copyright );
+	#undef REBASE
+	return 0;
+}
@@ -14,6 +14,9 @@ public:
 	blargg_err_t load( Data_Reader& in );
 	blargg_err_t load( void const* data, long size );
 
+	// Make this a copy of other
+	blargg_err_t copy( M3u_Playlist const& other );
+
 	// Line number of first parse error, 0 if no error. Any lines with parse
 	// errors are ignored.
 	int first_error() const { return first_error_; }
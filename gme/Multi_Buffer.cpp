@@ -2,6 +2,8 @@
 
 #include "Multi_Buffer.h"
 
+#include "Gme_Stats.h"
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -28,6 +30,11 @@ Multi_Buffer::Multi_Buffer( int spf ) : samples_per_frame_( spf )
 
 blargg_err_t Multi_Buffer::set_channel_count( int ) { return 0; }
 
+blargg_err_t Multi_Buffer::copy_state( Multi_Buffer const& )
+{
+	return "Buffer doesn't support cloning";
+}
+
 // Silent_Buffer
 
 Silent_Buffer::Silent_Buffer() : Multi_Buffer( 1 ) // 0 channels would probably confuse
@@ -49,6 +56,12 @@ Mono_Buffer::Mono_Buffer() : Multi_Buffer( 1 )
 
 Mono_Buffer::~Mono_Buffer() { }
 
+blargg_err_t Mono_Buffer::copy_state( Multi_Buffer const& other )
+{
+	buf.copy_state( STATIC_CAST(Mono_Buffer const&,other).buf );
+	return 0;
+}
+
 blargg_err_t Mono_Buffer::set_sample_rate( long rate, int msec )
 {
 	RETURN_ERR( buf.set_sample_rate( rate, msec ) );
@@ -93,6 +106,16 @@ void Stereo_Buffer::clear()
 		bufs [i].clear();
 }
 
+blargg_err_t Stereo_Buffer::copy_state( Multi_Buffer const& other )
+{
+	Stereo_Buffer const& in = STATIC_CAST(Stereo_Buffer const&,other);
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].copy_state( in.bufs [i] );
+	stereo_added = in.stereo_added;
+	was_stereo   = in.was_stereo;
+	return 0;
+}
+
 void Stereo_Buffer::end_frame( blip_time_t clock_count )
 {
 	stereo_added = 0;
@@ -105,6 +128,7 @@ void Stereo_Buffer::end_frame( blip_time_t clock_count )
 
 long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
 {
+	GME_STAT_TIME( synth_time );
 	require( !(count & 1) ); // count must be even
 	count = (unsigned) count / 2;
 
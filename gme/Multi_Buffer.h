@@ -45,7 +45,11 @@ public:
 
 	// Count of changes to channel configuration. Incremented whenever
 	// a change is made to any of the Blip_Buffers for any channel.
-	unsigned channels_changed_count() { return channels_changed_count_; }
+	unsigned channels_changed_count() const { return channels_changed_count_; }
+
+	// Copy contents of other buffer, which must be of the same type and set up
+	// the same way. Returns error if not supported by buffer type.
+	virtual blargg_err_t copy_state( Multi_Buffer const& );
 
 	// See Blip_Buffer.h
 	virtual long read_samples( blip_sample_t*, long ) = 0;
@@ -55,6 +59,7 @@ public:
 	BLARGG_DISABLE_NOTHROW
 protected:
 	void channels_changed() { channels_changed_count_++; }
+	void set_samples_per_frame( int n ) { samples_per_frame_ = n; }
 private:
 	// noncopyable
 	Multi_Buffer( const Multi_Buffer& );
@@ -63,7 +68,7 @@ private:
 	unsigned channels_changed_count_;
 	long sample_rate_;
 	int length_;
-	int const samples_per_frame_;
+	int samples_per_frame_;
 };
 
 // Uses a single buffer and outputs mono samples.
@@ -85,6 +90,7 @@ public:
 	long read_samples( blip_sample_t* p, long s ) { return buf.read_samples( p, s ); }
 	channel_t channel( int, int ) { return chan; }
 	void end_frame( blip_time_t t ) { buf.end_frame( t ); }
+	blargg_err_t copy_state( Multi_Buffer const& );
 };
 
 // Uses three buffers (one for center) and outputs stereo sample pairs.
@@ -108,6 +114,7 @@ public:
 
 	long samples_avail() const { return bufs [0].samples_avail() * 2; }
 	long read_samples( blip_sample_t*, long );
+	blargg_err_t copy_state( Multi_Buffer const& );
 
 private:
 	enum { buf_count = 3 };
@@ -134,6 +141,7 @@ public:
 	void end_frame( blip_time_t ) { }
 	long samples_avail() const { return 0; }
 	long read_samples( blip_sample_t*, long ) { return 0; }
+	blargg_err_t copy_state( Multi_Buffer const& ) { return 0; }
 };
 
 
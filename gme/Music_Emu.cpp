@@ -3,7 +3,11 @@
 #include "Music_Emu.h"
 
 #include "Multi_Buffer.h"
+#include "Gme_Stats.h"
+#include "Gme_Rt_Check.h"
+#include "Gme_Lookahead.h"
 #include <string.h>
+#include <math.h>
 #include <algorithm>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -19,10 +23,22 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 
 #include "blargg_source.h"
 
+#ifdef GME_ENABLE_STATS
+	thread_local gme_stats_state_t gme_stats_state;
+#endif
+
+#ifdef GME_RT_CHECK
+	thread_local gme_rt_report_t* gme_rt_current;
+#endif
+
 static int const silence_max = 6; // seconds
 static int const silence_threshold = 0x10;
-static long const fade_block_size = 512;
+static int const fade_block_bits = 9;
+static int const fade_block_size = 1 << fade_block_bits; // samples between points on fade curve
+static int const fade_gain_bits = 14;
+static int const fade_unit = 1 << fade_gain_bits; // gain of 1.0
 static int const fade_shift = 8; // fade ends with gain at 1.0 / (1 << fade_shift)
+static int64_t const no_fade = INT64_MAX / 2 + 1; // fade_start when not fading
 
 using std::min;
 using std::max;
@@ -38,11 +54,19 @@ void Music_Emu::clear_track_vars()
 	emu_time         = 0;
 	emu_track_ended_ = true;
 	track_ended_     = true;
-	fade_start       = INT_MAX / 2 + 1;
+	fade_start       = no_fade;
 	fade_step        = 1;
 	silence_time     = 0;
 	silence_count    = 0;
 	buf_remain       = 0;
+	silence_pending  = false;
+	lookahead_silence_time = -1;
+	event_count      = 0;
+	fade_reported    = false;
+	silence_reported = -1;
+	loop_start       = 0;
+	loop_length      = 0;
+	skipped_scaled   = 0;
 	warning(); // clear warning
 }
 
@@ -56,11 +80,19 @@ void Music_Emu::unload()
 Music_Emu::Music_Emu()
 {
 	effects_buffer = 0;
+	heap_ = 0;
+	lookahead_ = 0;
+	event_func = 0;
+	event_data = 0;
 	multi_channel_ = false;
 	sample_rate_ = 0;
+	native_rate_ = 0;
 	mute_mask_   = 0;
 	tempo_       = 1.0;
 	gain_        = 1.0;
+	max_latency_ = 0;
+	memset( &stats_, 0, sizeof stats_ );
+	memset( &rt_report_, 0, sizeof rt_report_ );
 
 	// defaults
 	max_initial_silence = 2;
@@ -83,21 +115,90 @@ Music_Emu::~Music_Emu() { delete effects_buffer; }
 
 blargg_err_t Music_Emu::set_sample_rate( long rate )
 {
-	require( !sample_rate() ); // sample rate can't be changed once set
+	require( rate > 0 );
+	long const old_rate = sample_rate();
+	if ( rate == old_rate )
+		return 0;
+
+	// derived class sees old rate in sample_rate(), or 0 the first time
 	RETURN_ERR( set_sample_rate_( rate ) );
-	RETURN_ERR( buf.resize( buf_size ) );
+	if ( !old_rate )
+	{
+		RETURN_ERR( buf.resize( buf_size ) );
+		default_equalizer_ = equalizer_;
+	}
 	sample_rate_ = rate;
+
+	if ( old_rate && track_count() )
+	{
+		rescale_track_vars( old_rate );
+		set_tempo( tempo_ ); // derived classes' tempo and muting may depend on rate
+		remute_voices();
+	}
 	return 0;
 }
 
+// Converts track position and fade, which are in samples, from old_rate to
+// current rate
+void Music_Emu::rescale_track_vars( long old_rate )
+{
+	int const channels = out_channels();
+	long const new_rate = sample_rate();
+	#define RESCALE( n ) ((n) / channels * new_rate / old_rate * channels)
+
+	// samples in silence buffer were generated at old rate, so skip them
+	out_time     += buf_remain;
+	buf_remain    = 0;
+	silence_pending = false;
+	out_time      = RESCALE( out_time );
+	silence_count = RESCALE( silence_count );
+	silence_time  = RESCALE( silence_time );
+	if ( silence_reported >= 0 )
+		silence_reported = RESCALE( silence_reported );
+	emu_time      = out_time + silence_count;
+	if ( silence_time > emu_time )
+		silence_time = emu_time;
+	out_time_scaled = out_time_scaled * new_rate / old_rate;
+	skipped_scaled  = skipped_scaled * new_rate / old_rate;
+
+	if ( fade_start != no_fade )
+	{
+		fade_start = RESCALE( fade_start );
+		fade_step = int (max( (int64_t) fade_step * new_rate / old_rate, (int64_t) 1 ));
+	}
+	#undef RESCALE
+}
+
+void Music_Emu::reset_for_reload()
+{
+	require( sample_rate() ); // can only reset emulator whose rate has been set
+	unload();
+	tempo_          = 1.0;
+	mute_mask_      = 0;
+	ignore_silence_ = false;
+	emu_autoload_playback_limit_ = true;
+	set_equalizer( default_equalizer_ );
+	set_max_latency( 0 );
+	disable_echo( false );
+	reset_settings_();
+}
+
 void Music_Emu::pre_load()
 {
 	require( sample_rate() ); // set_sample_rate() must be called before loading a file
 	Gme_File::pre_load();
 }
 
+// Calls that can be made on an audio thread only need to be safe there once a track
+// has started
+gme_rt_report_t* Music_Emu::rt_scope_report()
+{
+	return current_track_ >= 0 ? &rt_report_ : 0;
+}
+
 void Music_Emu::set_equalizer( equalizer_t const& eq )
 {
+	GME_RT_SCOPE( rt_scope_report() );
 	equalizer_ = eq;
 	set_equalizer_( eq );
 }
@@ -134,6 +235,7 @@ void Music_Emu::mute_voice( int index, bool mute )
 void Music_Emu::mute_voices( int mask )
 {
 	require( sample_rate() ); // sample rate must be set first
+	GME_RT_SCOPE( rt_scope_report() );
 	mute_mask_ = mask;
 	mute_voices_( mask );
 }
@@ -146,6 +248,7 @@ void Music_Emu::disable_echo( bool disable )
 void Music_Emu::set_tempo( double t )
 {
 	require( sample_rate() ); // sample rate must be set first
+	GME_RT_SCOPE( rt_scope_report() );
 	double const min = 0.02;
 	double const max = 4.00;
 	if ( t < min ) t = min;
@@ -154,19 +257,86 @@ void Music_Emu::set_tempo( double t )
 	set_tempo_( t );
 }
 
+void Music_Emu::set_max_latency( int msec )
+{
+	require( msec >= 0 );
+	max_latency_ = msec;
+	set_max_latency_( msec );
+}
+
 void Music_Emu::post_load_()
 {
 	set_tempo( tempo_ );
 	remute_voices();
 }
 
+blargg_err_t Music_Emu::clone_from( Music_Emu const& in )
+{
+	require( type() == in.type() && !sample_rate() ); // must be new emulator of same type
+	if ( !in.sample_rate() )
+		return "Use full emulator for cloning";
+	gain_ = in.gain_;
+	if ( in.multi_channel_ )
+		RETURN_ERR( set_multi_channel( true ) );
+	RETURN_ERR( set_sample_rate( in.sample_rate() ) );
+
+	equalizer_   = in.equalizer_;
+	default_equalizer_ = in.default_equalizer_;
+	tempo_       = in.tempo_;
+	mute_mask_   = in.mute_mask_;
+	max_latency_ = in.max_latency_;
+	ignore_silence_ = in.ignore_silence_;
+	emu_autoload_playback_limit_ = in.emu_autoload_playback_limit_;
+
+	if ( in.track_count() )
+		RETURN_ERR( load_clone( in ) ); // applies tempo and muting
+	set_equalizer( equalizer_ );
+	set_max_latency( max_latency_ );
+	if ( !track_count() )
+		return 0;
+	return clone_state_( in );
+}
+
+blargg_err_t Music_Emu::clone_state_( Music_Emu const& in )
+{
+	max_initial_silence = in.max_initial_silence;
+	silence_lookahead   = in.silence_lookahead;
+
+	current_track_   = in.current_track_;
+	out_time         = in.out_time;
+	out_time_scaled  = in.out_time_scaled;
+	emu_time         = in.emu_time;
+	emu_track_ended_ = in.emu_track_ended_;
+	track_ended_     = in.track_ended_;
+	fade_start       = in.fade_start;
+	fade_step        = in.fade_step;
+	silence_time     = in.silence_time;
+	silence_count    = in.silence_count;
+	buf_remain       = in.buf_remain;
+	silence_pending  = in.silence_pending;
+	fade_reported    = in.fade_reported;
+	silence_reported = in.silence_reported;
+	loop_start       = in.loop_start;
+	loop_length      = in.loop_length;
+	skipped_scaled   = in.skipped_scaled;
+	if ( buf.size() )
+		memcpy( buf.begin(), in.buf.begin(), buf.size() * sizeof buf [0] );
+	return 0;
+}
+
 blargg_err_t Music_Emu::start_track( int track )
 {
+	GME_STATS_SCOPE( &stats_ );
 	clear_track_vars();
 
 	int remapped = track;
 	RETURN_ERR( remap_track_( &remapped ) );
 	current_track_ = track;
+	{
+		track_info_t info;
+		if ( !Gme_File::track_info( &info, track ) && info.loop_length > 0 && info.intro_length >= 0 )
+			set_loop_time( info.intro_length / 1000.0, info.loop_length / 1000.0 );
+	}
 	RETURN_ERR( start_track_( remapped ) );
 
 	emu_track_ended_ = false;
@@ -182,6 +352,7 @@ blargg_err_t Music_Emu::start_track( int track )
 				break;
 		}
 
+		skipped_scaled  = int64_t ((emu_time - buf_remain) * tempo_ / out_channels());
 		emu_time        = buf_remain;
 		out_time        = 0;
 		out_time_scaled = 0;
@@ -212,74 +383,79 @@ void Music_Emu::set_autoload_playback_limit( bool do_autoload_limit )
 
 // Tell/Seek
 
-int32_t Music_Emu::msec_to_samples( int32_t msec ) const
+int64_t Music_Emu::msec_to_samples( int64_t msec ) const
 {
-	int32_t sec = msec / 1000;
+	int64_t sec = msec / 1000;
 	msec -= sec * 1000;
 	return (sec * sample_rate() + msec * sample_rate() / 1000) * out_channels();
 }
 
-long Music_Emu::tell_samples() const
+int64_t Music_Emu::tell_samples() const
 {
 	return out_time;
 }
 
-long Music_Emu::tell() const
+int64_t Music_Emu::tell() const
 {
 	int32_t rate = sample_rate() * out_channels();
-	int32_t sec = out_time / rate;
+	int64_t sec = out_time / rate;
 	return sec * 1000 + (out_time - sec * rate) * 1000 / rate;
 }
 
-long Music_Emu::tell_scaled() const
+int64_t Music_Emu::tell_scaled() const
 {
-	return out_time_scaled / (sample_rate() / 1000.0);
+	return int64_t (out_time_scaled / (sample_rate() / 1000.0));
 }
 
-blargg_err_t Music_Emu::seek_samples( long time )
+blargg_err_t Music_Emu::seek_samples( int64_t time )
 {
 	if ( time < out_time )
 		RETURN_ERR( start_track( current_track_ ) );
 	return skip( time - out_time );
 }
 
-blargg_err_t Music_Emu::seek( long msec )
+blargg_err_t Music_Emu::seek( int64_t msec )
 {
 	return seek_samples( msec_to_samples( msec ) );
 }
 
-blargg_err_t Music_Emu::seek_scaled( long msec )
+blargg_err_t Music_Emu::seek_scaled( int64_t msec )
 {
 	require( tempo_ > 0 );
-	int32_t frames = (msec / 1000.0) * sample_rate();
+	int64_t frames = int64_t ((msec / 1000.0) * sample_rate());
 	if ( frames < out_time_scaled )
 		RETURN_ERR( start_track( current_track_ ) );
-	int samples_to_skip = (frames - out_time_scaled) * out_channels() / tempo_;
-	samples_to_skip += samples_to_skip % out_channels();
+	int64_t samples_to_skip = int64_t ((frames - out_time_scaled) * out_channels() / tempo_);
+	samples_to_skip += (out_channels() - samples_to_skip % out_channels()) % out_channels();
 	return skip( samples_to_skip );
 }
 
-blargg_err_t Music_Emu::skip( long count )
+blargg_err_t Music_Emu::skip( int64_t count )
 {
 	require( current_track() >= 0 ); // start_track() must have been called already
+	GME_STATS_SCOPE( &stats_ );
 	out_time += count;
-	out_time_scaled += count * tempo_ / out_channels();
+	out_time_scaled += int64_t (count * tempo_ / out_channels());
 
 	// remove from silence and buf first
 	{
-		long n = min( count, silence_count );
+		long n = (long) min( count, (int64_t) silence_count );
 		silence_count -= n;
 		count -= n;
 
-		n = min( count, buf_remain );
+		n = (long) min( count, (int64_t) buf_remain );
 		buf_remain -= n;
 		count -= n;
 	}
 
-	if ( count && !emu_track_ended_ )
+	// skip_() takes long, so very long skips are done in pieces
+	int64_t const max_skip = 0x10000000;
+	while ( count && !emu_track_ended_ )
 	{
-		emu_time += count;
-		end_track_if_error( skip_( count ) );
+		long n = (long) min( count, max_skip );
+		count -= n;
+		emu_time += n;
+		end_track_if_error( skip_( n ) );
 	}
 
 	if ( !(silence_count | buf_remain) ) // caught up to emulator, so update track ended
@@ -290,8 +466,11 @@ blargg_err_t Music_Emu::skip( long count )
 
 blargg_err_t Music_Emu::skip_( long count )
 {
-	// for long skip, mute sound
-	const long threshold = 30000;
+	// latency doesn't matter when skipping, so use whole buffer
+	long const chunk = buf_size - buf_size % out_channels();
+
+	// for long skip, mute sound (threshold is 15000 frames regardless of channel count)
+	const long threshold = 15000L * out_channels();
 	if ( count > threshold )
 	{
 		int saved_mute = mute_mask_;
@@ -299,8 +478,8 @@ blargg_err_t Music_Emu::skip_( long count )
 
 		while ( count > threshold / 2 && !emu_track_ended_ )
 		{
-			RETURN_ERR( play_( buf_size, buf.begin() ) );
-			count -= buf_size;
+			RETURN_ERR( play_( chunk, buf.begin() ) );
+			count -= chunk;
 		}
 
 		mute_voices( saved_mute );
@@ -308,7 +487,7 @@ blargg_err_t Music_Emu::skip_( long count )
 
 	while ( count && !emu_track_ended_ )
 	{
-		long n = buf_size;
+		long n = chunk;
 		if ( n > count )
 			n = count;
 		count -= n;
@@ -317,13 +496,75 @@ blargg_err_t Music_Emu::skip_( long count )
 	return 0;
 }
 
+// Events
+
+void Music_Emu::add_event( gme_event_type_t type, int64_t time, int loop, const char* warning )
+{
+	if ( !event_func || event_count >= max_events )
+		return;
+	gme_event_t& e = events [event_count++];
+	e.type    = type;
+	e.offset  = 0;
+	e.time    = time - time % out_channels(); // silence can begin part way into frame
+	e.loop    = loop;
+	e.warning = warning;
+}
+
+// Adds event for each loop point in next count samples. Loop points are in track time,
+// so they're found in frames scaled with tempo, counting initial silence skipped.
+void Music_Emu::add_loop_events( long count )
+{
+	double const rate = sample_rate();
+	if ( !event_func || loop_length * rate < 1.0 )
+		return;
+	// same rounding as render() uses to advance out_time_scaled, so blocks don't overlap
+	int64_t const begin = out_time_scaled + skipped_scaled;
+	int64_t const end   = begin + int64_t (count * tempo_ / out_channels());
+	double k = max( ceil( ((double) begin / rate - loop_start) / loop_length ), 1.0 );
+	for ( ; event_count < max_events; k++ )
+	{
+		double const frame = (loop_start + k * loop_length) * rate;
+		if ( frame >= end )
+			break;
+		if ( frame >= begin )
+			add_event( gme_event_loop, out_time +
+					int64_t ((frame - begin) / tempo_) * out_channels(), int (k) );
+	}
+}
+
+// Passes events added since last call to event function in order, with offsets into
+// count frames of frame_size samples played starting at start
+void Music_Emu::send_events( int64_t start, long count, int frame_size )
+{
+	gme_event_func_t const func = event_func; // func might clear it
+	int const n = event_count;
+	event_count = 0;
+	if ( !func )
+		return;
+
+	// stable, so events at same time stay in order they were added
+	for ( int i = 1; i < n; i++ )
+		for ( int j = i; j && events [j].time < events [j - 1].time; j-- )
+			std::swap( events [j], events [j - 1] );
+
+	for ( int i = 0; i < n; i++ )
+	{
+		gme_event_t& e = events [i];
+		int64_t const offset = (e.time - start) / frame_size;
+		e.offset = int (min( max( offset, (int64_t) 0 ), (int64_t) count ));
+		func( event_data, &e );
+	}
+}
+
 // Fading
 
 void Music_Emu::set_fade( long start_msec, long length_msec )
 {
+	GME_RT_SCOPE( rt_scope_report() );
 	fade_step = sample_rate() * length_msec / (fade_block_size * fade_shift * 1000 / out_channels());
 	if(fade_step < 1)	fade_step = 1;
 	fade_start = msec_to_samples( start_msec );
+	fade_reported = false;
 }
 
 // unit / pow( 2.0, (double) x / step )
@@ -334,23 +575,76 @@ static int int_log( int32_t x, int step, int unit )
 	return ((unit - fraction) + (fraction >> 1)) >> shift;
 }
 
+// Gain for pos samples into fade is (base + slope * i) >> fade_block_bits, where i is
+// number of strides since pos. Returns number of strides that holds for, which is until
+// next point on fade curve, so gain changes smoothly rather than in steps. Ends track
+// once gain is low enough.
+long Music_Emu::fade_segment( int64_t pos, int stride, int* base, int* slope )
+{
+	// gain would be 0 long before fade position overflows int_log()
+	int64_t const block = pos >> fade_block_bits;
+	int const gain      = block     < (int64_t) fade_step * 16 ? int_log( int32_t (block),     fade_step, fade_unit ) : 0;
+	int const next_gain = block + 1 < (int64_t) fade_step * 16 ? int_log( int32_t (block + 1), fade_step, fade_unit ) : 0;
+	if ( gain < (fade_unit >> fade_shift) )
+	{
+		if ( !track_ended_ )
+			add_event( gme_event_track_end, fade_start + pos );
+		track_ended_ = emu_track_ended_ = true;
+	}
+
+	int const offset = int (pos & (fade_block_size - 1));
+	*base  = gain * (fade_block_size - offset) + next_gain * offset;
+	*slope = (next_gain - gain) * stride;
+	return (fade_block_size - offset + stride - 1) / stride;
+}
+
+// Kept simple so compiler can vectorize them
+static void fade_samples( Music_Emu::sample_t* io, int count, int base, int slope )
+{
+	for ( int i = 0; i < count; i++ )
+	{
+		// 16-bit gain lets multiply stay 16-bit
+		short const gain = short (base >> fade_block_bits);
+		io [i] = Music_Emu::sample_t (io [i] * gain >> fade_gain_bits);
+		base += slope;
+	}
+}
+
+static void fade_samples( float* io, int count, int base, int slope )
+{
+	float const scale = 1.0f / (fade_block_size * fade_unit);
+	for ( int i = 0; i < count; i++ )
+		io [i] *= float (base + slope * i) * scale;
+}
+
 void Music_Emu::handle_fade( long out_count, sample_t* out )
 {
-	for ( int i = 0; i < out_count; i += fade_block_size )
+	GME_STAT_TIME( fade_time );
+	// fade can begin part way into out
+	for ( long i = (long) max( fade_start - out_time, (int64_t) 0 ); i < out_count; )
 	{
-		int const shift = 14;
-		int const unit = 1 << shift;
-		int gain = int_log( (out_time + i - fade_start) / fade_block_size,
-				fade_step, unit );
-		if ( gain < (unit >> fade_shift) )
-			track_ended_ = emu_track_ended_ = true;
-
-		sample_t* io = &out [i];
-		for ( int count = min( fade_block_size, out_count - i ); count; --count )
-		{
-			*io = sample_t ((*io * gain) >> shift);
-			++io;
-		}
+		int base, slope;
+		long n = min( fade_segment( out_time + i - fade_start, 1, &base, &slope ), out_count - i );
+		fade_samples( &out [i], (int) n, base, slope );
+		i += n;
+	}
+}
+
+// Fades count frames of planes starting at offset, which were played starting at time.
+// Gain is in float so quiet end of fade keeps its resolution.
+void Music_Emu::handle_fade( int64_t time, long count, float* const* planes, long offset )
+{
+	GME_STATS_SCOPE( &stats_ ); // called after render() returns
+	GME_STAT_TIME( fade_time );
+	int const channels = out_channels();
+	int64_t const first = max( fade_start - time, (int64_t) 0 );
+	for ( long i = long ((first + channels - 1) / channels); i < count; )
+	{
+		int base, slope;
+		long n = min( fade_segment( time + i * channels - fade_start, channels, &base, &slope ), count - i );
+		for ( int c = 0; c < channels; c++ )
+			fade_samples( &planes [c] [offset + i], (int) n, base, slope );
+		i += n;
 	}
 }
 
@@ -367,36 +661,145 @@ void Music_Emu::emu_play( long count, sample_t* out )
 }
 
 // number of consecutive silent samples at end
-static long count_silence( Music_Emu::sample_t* begin, long size )
+static long count_silence( Music_Emu::sample_t const* begin, long size )
 {
-	Music_Emu::sample_t first = *begin;
-	*begin = silence_threshold; // sentinel
-	Music_Emu::sample_t* p = begin + size;
-	while ( (unsigned) (*--p + silence_threshold / 2) <= (unsigned) silence_threshold ) { }
-	*begin = first;
-	return size - (p - begin);
+	// skip silent blocks, checking all of each so compiler can vectorize it
+	int const block = 32;
+	long n = size;
+	for ( ; n >= block; n -= block )
+	{
+		Music_Emu::sample_t const* p = &begin [n - block];
+		unsigned loud = 0;
+		for ( int i = 0; i < block; i++ )
+			loud |= (unsigned) (p [i] + silence_threshold / 2) > (unsigned) silence_threshold;
+		if ( loud )
+			break;
+	}
+
+	while ( n && (unsigned) (begin [n - 1] + silence_threshold / 2) <= (unsigned) silence_threshold )
+		n--;
+	return size - n;
 }
 
-// fill internal buffer and check it for silence
+long Music_Emu::buf_fill_size() const
+{
+	long size = buf_size;
+	if ( max_latency_ && msec_to_samples( max_latency_ ) < size )
+		size = (long) max( msec_to_samples( max_latency_ ), (int64_t) out_channels() );
+	return size - size % out_channels();
+}
+
+// fill end of internal buffer and check it for silence
 void Music_Emu::fill_buf()
 {
 	assert( !buf_remain );
+	long const size = buf_fill_size();
 	if ( !emu_track_ended_ )
 	{
-		emu_play( buf_size, buf.begin() );
-		long silence = count_silence( buf.begin(), buf_size );
-		if ( silence < buf_size )
+		GME_STAT_ADD( lookahead_samples, size );
+		emu_play( size, buf.end() - size );
+		long silence = count_silence( buf.end() - size, size );
+		if ( silence < size )
 		{
 			silence_time = emu_time - silence;
-			buf_remain   = buf_size;
+			buf_remain   = size;
 			return;
 		}
 	}
-	silence_count += buf_size;
+	silence_count += size;
+}
+
+// Same as fill_buf(), except samples are generated straight into out if they fit,
+// rather than into buf then copied. Returns number of samples of out to keep.
+long Music_Emu::check_silence( long out_count, sample_t* out )
+{
+	silence_pending = false;
+	long const size = buf_fill_size();
+	if ( out_count < size || emu_track_ended_ )
+	{
+		fill_buf();
+		return 0;
+	}
+
+	emu_play( size, out );
+	long silence = count_silence( out, size );
+	if ( silence < size )
+	{
+		silence_time = emu_time - silence;
+		return size;
+	}
+	silence_count += size; // out is overwritten with silence
+	return 0;
+}
+
+// Speed to run emulator at when looking ahead in play()
+int Music_Emu::lookahead_speed() const
+{
+	if ( max_latency_ || (lookahead_ && lookahead_->helper()) )
+		return 1;
+	return silence_lookahead;
+}
+
+// Called during a run of silence when looking ahead is done in the background. Starts
+// helper from current state if it hasn't been for this run of silence. Otherwise true
+// once helper has found silence lasts long enough to end track and playback reaches
+// where play() would have ended it.
+bool Music_Emu::background_silence_ended( long out_count )
+{
+	if ( !lookahead_->idle() )
+		return false;
+
+	Music_Emu* helper = lookahead_->helper();
+	if ( lookahead_silence_time != silence_time )
+	{
+		if ( buf_remain )
+			return false; // already found sound
+
+		lookahead_silence_time = silence_time;
+		if ( helper->tempo_ != tempo_ )
+			helper->set_tempo( tempo_ );
+		if ( helper->mute_mask_ != mute_mask_ )
+			helper->mute_voices( mute_mask_ );
+		if ( helper->clone_state_( *this ) )
+		{
+			helper->track_ended_ = false;
+			return false;
+		}
+		lookahead_->start();
+		return false;
+	}
+
+	return helper->track_ended_ && (out_time + out_count - silence_time) * silence_lookahead >
+			silence_max * out_channels() * sample_rate();
+}
+
+// Runs on helper thread, on copy of emulator in a run of silence. Sets track_ended_ if
+// silence lasts long enough to end track.
+void Music_Emu::scan_silence( std::atomic<bool> const& cancel )
+{
+	long const end = silence_max * out_channels() * sample_rate();
+	while ( !(buf_remain | static_cast<long>(emu_track_ended_)) && emu_time - silence_time <= end && !cancel )
+		fill_buf();
+	track_ended_ = !buf_remain && emu_time - silence_time > end;
 }
 
 blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 {
+	int64_t const start = out_time;
+	RETURN_ERR( render( out_count, out, true ) );
+	send_events( start, out_count, 1 );
+	return 0;
+}
+
+// Same as play(), except fade is left for caller to apply if fade is false
+blargg_err_t Music_Emu::render( long out_count, sample_t* out, bool fade )
+{
+	GME_STATS_SCOPE( &stats_ );
+	GME_RT_SCOPE( rt_scope_report() );
+#ifdef GME_RT_CHECK
+	int64_t const prev_emu_time = emu_time;
+#endif
+	const char* const prev_warning = current_warning();
 	if ( track_ended_ )
 	{
 		memset( out, 0, out_count * sizeof *out );
@@ -411,11 +814,26 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 		// prints nifty graph of how far ahead we are when searching for silence
 		//debug_printf( "%*s \n", int ((emu_time - out_time) * 7 / sample_rate()), "*" );
 
+		if ( event_func )
+		{
+			add_loop_events( out_count );
+			if ( !fade_reported && fade_start < out_time + out_count )
+			{
+				fade_reported = true;
+				add_event( gme_event_fade_start, max( fade_start, out_time ) );
+			}
+		}
+
 		long pos = 0;
+		if ( silence_pending )
+			pos = check_silence( out_count, out );
+
 		if ( silence_count )
 		{
-			// during a run of silence, run emulator at >=2x speed so it gets ahead
-			long ahead_time = silence_lookahead * (out_time + out_count - silence_time) + silence_time;
+			// during a run of silence, run emulator at >=2x speed so it gets ahead,
+			// unless helper thread is doing that
+			int const lookahead = lookahead_speed();
+			int64_t ahead_time = lookahead * (out_time + out_count - silence_time) + silence_time;
 			while ( emu_time < ahead_time && !(buf_remain | static_cast<long>(emu_track_ended_)) )
 				fill_buf();
 
@@ -424,11 +842,13 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 			memset( out, 0, pos * sizeof *out );
 			silence_count -= pos;
 
-			if ( emu_time - silence_time > silence_max * out_channels() * sample_rate() )
+			if ( emu_time - silence_time > silence_max * out_channels() * sample_rate() ||
+					(lookahead_ && lookahead_->helper() && background_silence_ended( out_count )) )
 			{
 				track_ended_  = emu_track_ended_ = true;
 				silence_count = 0;
 				buf_remain    = 0;
+				add_event( gme_event_track_end, out_time + pos );
 			}
 		}
 
@@ -436,7 +856,7 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 		{
 			// empty silence buf
 			long n = min( buf_remain, out_count - pos );
-			memcpy( &out [pos], buf.begin() + (buf_size - buf_remain), n * sizeof *out );
+			memcpy( &out [pos], buf.end() - buf_remain, n * sizeof *out );
 			buf_remain -= n;
 			pos += n;
 		}
@@ -445,8 +865,14 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 		long remain = out_count - pos;
 		if ( remain )
 		{
+			// emulator that ended while looking ahead ended where that output runs out
+			bool const ended_before = emu_track_ended_;
 			emu_play( remain, out + pos );
-			track_ended_ |= emu_track_ended_;
+			if ( emu_track_ended_ && !track_ended_ )
+			{
+				track_ended_ = true;
+				add_event( gme_event_track_end, out_time + (ended_before ? pos : out_count) );
+			}
 
 			if ( !ignore_silence_ || out_time > fade_start )
 			{
@@ -455,18 +881,57 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 				if ( silence < remain )
 					silence_time = emu_time - silence;
 
-				if ( emu_time - silence_time >= buf_size )
-					fill_buf(); // cause silence detection on next play()
+				// rather than generating ahead now, check at start of next play()
+				silence_pending = emu_time - silence_time >= buf_size;
+				if ( silence_pending && silence_time != silence_reported )
+				{
+					silence_reported = silence_time;
+					add_event( gme_event_silence_start, silence_time );
+				}
 			}
 		}
 
-		if ( fade_start >= 0 && out_time > fade_start )
+		if ( fade && fade_start >= 0 && out_time + out_count > fade_start )
 		{
 			handle_fade( out_count, out );
 		}
 	}
+#ifdef GME_RT_CHECK
+	// Looking ahead for silence runs emulator a few times faster than output, but
+	// when silence begins it catches up in one go unless max latency is set
+	if ( emu_time - prev_emu_time > lookahead_speed() * out_count + buf_size * 2 )
+		GME_RT_UNSAFE( overruns, "play emulated far ahead of output" );
+#endif
+	if ( current_warning() != prev_warning && current_warning() )
+		add_event( gme_event_warning, out_time + out_count, 0, current_warning() );
 	out_time += out_count;
-	out_time_scaled += out_count * tempo_ / out_channels();
+	out_time_scaled += int64_t (out_count * tempo_ / out_channels());
+	return 0;
+}
+
+blargg_err_t Music_Emu::play_planar( long count, float* const* planes )
+{
+	int const channels = out_channels();
+	long const chunk_size = buf_size / channels;
+	sample_t chunk [buf_size];
+	int64_t const start = out_time;
+	for ( long pos = 0; pos < count; )
+	{
+		long n = min( count - pos, chunk_size );
+		int64_t const time = out_time;
+		RETURN_ERR( render( n * channels, chunk, false ) );
+		for ( int c = 0; c < channels; c++ )
+		{
+			sample_t const* in = &chunk [c];
+			float* out = &planes [c] [pos];
+			for ( long i = n; i--; in += channels )
+				*out++ = *in * (1.0f / 0x8000);
+		}
+		if ( fade_start >= 0 && time + n * channels > fade_start )
+			handle_fade( time, n, planes, pos );
+		pos += n;
+	}
+	send_events( start, count, channels );
 	return 0;
 }
 
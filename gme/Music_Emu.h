@@ -6,15 +6,19 @@
 
 #include "Gme_File.h"
 class Multi_Buffer;
+class Gme_Heap;
+class Gme_Lookahead;
 
 struct Music_Emu : public Gme_File {
 public:
 // Basic functionality (see Gme_File.h for file loading/track info functions)
 
-	// Set output sample rate. Must be called only once before loading file.
+	// Set output sample rate. Must be called before loading file. Can be called again
+	// later to change rate, even in the middle of a track, which keeps playing from
+	// about the same position. If this fails, the emulator can only be deleted.
 	blargg_err_t set_sample_rate( long sample_rate );
 
-	// specifies if all 8 voices get rendered to their own stereo channel
+	// specifies if each voice gets rendered to its own stereo channel
 	// default implementation of Music_Emu always returns not supported error (i.e. no multichannel support by default)
 	// derived emus must override this if they support multichannel rendering
 	virtual blargg_err_t set_multi_channel( bool is_enabled );
@@ -27,11 +31,26 @@ public:
 	typedef short sample_t;
 	blargg_err_t play( long count, sample_t* buf );
 
+	// Generate 'count' sample frames as floats from -1.0 to 1.0, writing each of the
+	// out_channels() channels to its own buffer in planes.
+	blargg_err_t play_planar( long count, float* const* planes );
+
+	// Unload file and restore settings to what they were when sample rate was first
+	// set: tempo, muting, equalizer, echo, accuracy, silence handling, track length
+	// limit and latency. Sample rate, multi-channel mode and buffers are kept, so
+	// loading another file only allocates what that file needs.
+	void reset_for_reload();
+
 // Informational
 
 	// Sample rate sound is generated at
 	long sample_rate() const;
 
+	// Rate the emulator generates sound at before resampling to sample_rate(), or 0
+	// if it synthesizes directly at sample_rate(). If set_sample_rate() was given
+	// this rate, output is not resampled at all.
+	long native_rate() const;
+
 	// Index of current track or -1 if one hasn't been started
 	int current_track() const;
 
@@ -43,28 +62,49 @@ public:
 
 	bool multi_channel() const;
 
+	// Number of interleaved channels in each output frame: 2 for stereo, or in
+	// multi-channel mode a stereo pair for each voice, and at least 8 pairs
+	int out_channels() const;
+
+	// Performance counters since emulator was created. Only updated if built with
+	// GME_ENABLE_STATS. See gme.h for definition of struct gme_stats_t.
+	gme_stats_t const& stats() const            { return stats_; }
+
+	// Unsafe things done by real-time calls since emulator was created. Only updated if
+	// built with GME_RT_CHECK. See gme.h for definition of struct gme_rt_report_t.
+	gme_rt_report_t const& rt_report() const    { return rt_report_; }
+
+	// Heap memory for emulator comes from, or NULL if global allocator. See Gme_Alloc.h.
+	Gme_Heap* heap() const                      { return heap_; }
+	void set_heap( Gme_Heap* h )                { heap_ = h; }
+
+	// Helper thread that looks ahead for end of silence instead of play(), or NULL if
+	// none. See gme_set_background_lookahead().
+	Gme_Lookahead* background_lookahead() const { return lookahead_; }
+	void set_background_lookahead( Gme_Lookahead* l ) { lookahead_ = l; }
+
 // Track status/control
 
 	// Number of milliseconds (1000 msec = 1 second) played since beginning of track
-	long tell() const;
+	int64_t tell() const;
 
 	// Number of samples generated since beginning of track
-	long tell_samples() const;
+	int64_t tell_samples() const;
 
 	// Number of milliseconds played since beginning of track (scaled with tempo).
-	long tell_scaled() const;
+	int64_t tell_scaled() const;
 
 	// Seek to new time in track. Seeking backwards or far forward can take a while.
-	blargg_err_t seek( long msec );
+	blargg_err_t seek( int64_t msec );
 
 	// Equivalent to restarting track then skipping n samples
-	blargg_err_t seek_samples( long n );
+	blargg_err_t seek_samples( int64_t n );
 
 	// Seek to new time in track (scaled with tempo).
-	blargg_err_t seek_scaled( long msec );
+	blargg_err_t seek_scaled( int64_t msec );
 
 	// Skip n samples
-	blargg_err_t skip( long n );
+	blargg_err_t skip( int64_t n );
 
 	// True if a track has reached its end
 	bool track_ended() const;
@@ -73,6 +113,10 @@ public:
 	// true. Fade time can be changed while track is playing.
 	void set_fade( long start_msec, long length_msec = 8000 );
 
+	// Function to call at end of play() and play_planar() with each event that happened
+	// during it, or NULL for none. See gme_set_event_func().
+	void set_event_func( gme_event_func_t f, void* data ) { event_func = f; event_data = data; }
+
 	// Controls whether or not to automatically load and obey track length
 	// metadata for supported emulators.
 	//
@@ -93,6 +137,13 @@ public:
 	// Track length as returned by track_info() assumes a tempo of 1.0.
 	void set_tempo( double );
 
+	// Limit how far sound is generated ahead of what play() returns to about msec
+	// milliseconds, so that changes to muting, tempo, etc. are heard sooner. Smaller
+	// values cost more CPU. Silence detection then looks ahead no faster than
+	// playback. 0 restores default of generating each format's usual frame length.
+	void set_max_latency( int msec );
+	int max_latency() const;
+
 	// Mute/unmute voice i, where voice 0 is first voice
 	void mute_voice( int index, bool mute = true );
 
@@ -138,6 +189,16 @@ public:
 	// Equalizer settings for TV speaker
 	static equalizer_t const tv_eq;
 
+// Cloning
+
+	// Make this emulator, newly created for the same file type as other, an
+	// independent copy of other in its current state, sharing its file data and
+	// using its settings. If other uses a custom buffer, one of the same type and
+	// configuration must first be given to set_buffer(). Cloning an emulator that
+	// was loaded with load_mem() shares that memory, which must then remain valid
+	// until both are deleted.
+	blargg_err_t clone_from( Music_Emu const& other );
+
 public:
 	Music_Emu();
 	~Music_Emu();
@@ -145,22 +206,33 @@ protected:
 	void set_max_initial_silence( int n )       { max_initial_silence = n; }
 	void set_silence_lookahead( int n )         { silence_lookahead = n; }
 	void set_voice_count( int n )               { voice_count_ = n; }
+	void set_native_rate( long r )              { native_rate_ = r; }
 	void set_voice_names( const char* const* names );
 	void set_track_ended()                      { emu_track_ended_ = true; }
+	// Loop point for events, as seconds of intro and of loop. Set from track info before
+	// start_track_(), which can replace it with a more exact one.
+	void set_loop_time( double intro, double loop ) { loop_start = intro; loop_length = loop; }
 	double gain() const                         { return gain_; }
 	double tempo() const                        { return tempo_; }
 	void remute_voices();
 	blargg_err_t set_multi_channel_( bool is_enabled );
 
+	// Called again if rate is changed later, with sample_rate() still the old rate
 	virtual blargg_err_t set_sample_rate_( long sample_rate ) = 0;
 	virtual void set_equalizer_( equalizer_t const& ) { }
 	virtual void enable_accuracy_( bool /* enable */ ) { }
 	virtual void mute_voices_( int mask );
 	virtual void disable_echo_( bool /* disable */);
 	virtual void set_tempo_( double );
+	virtual void set_max_latency_( int /* msec */ ) { }
+	virtual void reset_settings_() { } // restore any settings of derived class
 	virtual blargg_err_t start_track_( int ); // tempo is set before this
 	virtual blargg_err_t play_( long count, sample_t* out ) = 0;
 	virtual blargg_err_t skip_( long count );
+
+	// Copy emulation state of other, which has loaded the same file. Derived classes
+	// copy their own state then call their base's.
+	virtual blargg_err_t clone_state_( Music_Emu const& other );
 protected:
 	virtual void unload();
 	virtual void pre_load();
@@ -168,50 +240,86 @@ protected:
 private:
 	// general
 	equalizer_t equalizer_;
+	equalizer_t default_equalizer_;
 	int max_initial_silence;
 	const char** voice_names_;
 	int voice_count_;
 	int mute_mask_;
 	double tempo_;
 	double gain_;
+	int max_latency_;
 	bool multi_channel_;
 
-	// returns the number of output channels, i.e. usually 2 for stereo, unlesss multi_channel_ == true
-	int out_channels() const { return this->multi_channel() ? 2*8 : 2; }
-
 	long sample_rate_;
-	int32_t msec_to_samples( int32_t msec ) const;
+	long native_rate_;
+	int64_t msec_to_samples( int64_t msec ) const;
 
 	// track-specific
+	// Times are 64-bit so a track can play indefinitely without them wrapping around
 	int current_track_;
-	int32_t out_time;        // number of samples played since start of track
-	int32_t out_time_scaled; // number of samples played since start of track (scaled with tempo)
-	int32_t emu_time;        // number of samples emulator has generated since start of track
+	int64_t out_time;        // number of samples played since start of track
+	int64_t out_time_scaled; // number of samples played since start of track (scaled with tempo)
+	int64_t emu_time;        // number of samples emulator has generated since start of track
 	bool emu_track_ended_;   // emulator has reached end of track
 	bool emu_autoload_playback_limit_; // whether to load and obey track length by default
 	volatile bool track_ended_;
 	void clear_track_vars();
+	void rescale_track_vars( long old_rate );
 	void end_track_if_error( blargg_err_t );
 
 	// fading
-	int32_t fade_start;
+	int64_t fade_start;
 	int fade_step;
+	long fade_segment( int64_t pos, int stride, int* base, int* slope );
 	void handle_fade( long count, sample_t* out );
+	void handle_fade( int64_t time, long count, float* const* planes, long offset );
 
 	// silence detection
 	int silence_lookahead; // speed to run emulator when looking ahead for silence
 	bool ignore_silence_;
-	long silence_time;     // number of samples where most recent silence began
+	int64_t silence_time;  // number of samples where most recent silence began
 	long silence_count;    // number of samples of silence to play before using buf
 	long buf_remain;       // number of samples left in silence buffer
+	bool silence_pending;  // next buf_fill_size() samples decide whether silence began
 	enum { buf_size = 2048 };
 	blargg_vector<sample_t> buf;
+	long buf_fill_size() const; // buf_size or max latency, rounded down to whole frames
 	void fill_buf();
+	long check_silence( long out_count, sample_t* out );
+	blargg_err_t render( long count, sample_t* out, bool fade );
+	int lookahead_speed() const;
+
+	// events
+	gme_event_func_t event_func;
+	void* event_data;
+	enum { max_events = 32 };
+	gme_event_t events [max_events];
+	int event_count;
+	bool fade_reported;
+	int64_t silence_reported; // silence_time of last silence event, or -1
+	double loop_start;        // seconds
+	double loop_length;       // seconds, or 0 if track doesn't loop
+	int64_t skipped_scaled;   // initial silence skipped by start_track(), scaled with tempo
+	void add_event( gme_event_type_t, int64_t time, int loop = 0, const char* warning = 0 );
+	void add_loop_events( long count );
+	void send_events( int64_t start, long count, int frame_size );
+
+	// background lookahead
+	Gme_Lookahead* lookahead_;
+	int64_t lookahead_silence_time; // silence_time helper was last started from, or -1
+	bool background_silence_ended( long out_count );
+	void scan_silence( std::atomic<bool> const& cancel );
+	friend class Gme_Lookahead;
 	void emu_play( long count, sample_t* out );
 
 	Multi_Buffer* effects_buffer;
-	friend Music_Emu* gme_internal_new_emu_( gme_type_t, int, bool );
+	gme_stats_t stats_;
+	gme_rt_report_t rt_report_;
+	gme_rt_report_t* rt_scope_report(); // report for real-time calls, or NULL if none
+	Gme_Heap* heap_;
+	friend Music_Emu* gme_internal_new_emu_( gme_type_t, int, bool, size_t );
 	friend void gme_set_stereo_depth( Music_Emu*, double );
+	friend gme_err_t gme_clone( Music_Emu const*, Music_Emu** );
 };
 
 // base class for info-only derivations
@@ -234,8 +342,14 @@ inline blargg_err_t Music_Emu::track_info( track_info_t* out ) const
 }
 
 inline long Music_Emu::sample_rate() const          { return sample_rate_; }
+inline long Music_Emu::native_rate() const          { return native_rate_; }
 inline const char** Music_Emu::voice_names() const  { return voice_names_; }
 inline int Music_Emu::voice_count() const           { return voice_count_; }
+inline int Music_Emu::out_channels() const
+{
+	return multi_channel_ ? 2 * (voice_count_ > 8 ? voice_count_ : 8) : 2;
+}
+inline int Music_Emu::max_latency() const           { return max_latency_; }
 inline int Music_Emu::current_track() const         { return current_track_; }
 inline bool Music_Emu::track_ended() const          { return track_ended_; }
 inline const Music_Emu::equalizer_t& Music_Emu::equalizer() const { return equalizer_; }
@@ -1,6 +1,7 @@
 // Nes_Snd_Emu 0.1.8. http://www.slack.net/~ant/
 
 #include "Nes_Apu.h"
+#include "Gme_Stats.h"
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -115,6 +116,63 @@ void Nes_Apu::reset( bool pal_mode, int initial_dmc_dac )
 		dmc.last_amp = initial_dmc_dac; // prevent output transition
 }
 
+static void copy_osc( Nes_Osc& out, Nes_Osc const& in )
+{
+	Blip_Buffer* output = out.output;
+	out = in;
+	out.output = output;
+}
+
+static void copy_envelope( Nes_Envelope& out, Nes_Envelope const& in )
+{
+	copy_osc( out, in );
+	out.envelope  = in.envelope;
+	out.env_delay = in.env_delay;
+}
+
+void Nes_Apu::copy_state( Nes_Apu const& in )
+{
+	copy_envelope( square1, in.square1 );
+	square1.phase       = in.square1.phase;
+	square1.sweep_delay = in.square1.sweep_delay;
+	copy_envelope( square2, in.square2 );
+	square2.phase       = in.square2.phase;
+	square2.sweep_delay = in.square2.sweep_delay;
+
+	copy_osc( triangle, in.triangle );
+	triangle.phase          = in.triangle.phase;
+	triangle.linear_counter = in.triangle.linear_counter;
+
+	copy_envelope( noise, in.noise );
+	noise.noise = in.noise.noise;
+
+	copy_osc( dmc, in.dmc );
+	dmc.address     = in.dmc.address;
+	dmc.period      = in.dmc.period;
+	dmc.buf         = in.dmc.buf;
+	dmc.bits_remain = in.dmc.bits_remain;
+	dmc.bits        = in.dmc.bits;
+	dmc.buf_full    = in.dmc.buf_full;
+	dmc.silence     = in.dmc.silence;
+	dmc.dac         = in.dmc.dac;
+	dmc.next_irq    = in.dmc.next_irq;
+	dmc.irq_enabled = in.dmc.irq_enabled;
+	dmc.irq_flag    = in.dmc.irq_flag;
+	dmc.pal_mode    = in.dmc.pal_mode;
+
+	tempo_        = in.tempo_;
+	last_time     = in.last_time;
+	last_dmc_time = in.last_dmc_time;
+	earliest_irq_ = in.earliest_irq_;
+	next_irq      = in.next_irq;
+	frame_period  = in.frame_period;
+	frame_delay   = in.frame_delay;
+	frame         = in.frame;
+	osc_enables   = in.osc_enables;
+	frame_mode    = in.frame_mode;
+	irq_flag      = in.irq_flag;
+}
+
 void Nes_Apu::irq_changed()
 {
 	nes_time_t new_irq = dmc.next_irq;
@@ -147,6 +205,7 @@ void Nes_Apu::run_until( nes_time_t end_time )
 
 void Nes_Apu::run_until_( nes_time_t end_time )
 {
+	GME_STAT_TIME( apu_time );
 	require( end_time >= last_time );
 
 	if ( end_time == last_time )
@@ -282,6 +341,7 @@ static const unsigned char length_table [0x20] = {
 
 void Nes_Apu::write_register( nes_time_t time, nes_addr_t addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	require( addr > 0x20 ); // addr must be actual address (i.e. 0x40xx)
 	require( (unsigned) data <= 0xFF );
 
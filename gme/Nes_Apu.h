@@ -57,6 +57,9 @@ public:
 	void save_state( apu_state_t* out ) const;
 	void load_state( apu_state_t const& );
 
+	// Copy emulation state of other APU, keeping own outputs, volume and DMC reader
+	void copy_state( Nes_Apu const& );
+
 	// Set overall volume (default is 1.0)
 	void volume( double );
 
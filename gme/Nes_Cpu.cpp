@@ -3,6 +3,7 @@
 #include "Nes_Cpu.h"
 
 #include "blargg_endian.h"
+#include "Gme_Stats.h"
 #include <limits.h>
 
 #define BLARGG_CPU_X86 1
@@ -88,6 +89,23 @@ void Nes_Cpu::reset( void const* unmapped_page )
 	blargg_verify_byte_order();
 }
 
+void Nes_Cpu::copy_state( Nes_Cpu const& in, void const* in_base, void* base, size_t size )
+{
+	check( state == &state_ && in.state == &in.state_ );
+	memcpy( low_mem, in.low_mem, sizeof low_mem );
+	r = in.r;
+	state_.base = in.state_.base;
+	state_.time = in.state_.time;
+	for ( int i = 0; i < page_count + 1; i++ )
+	{
+		int offset = PAGE_OFFSET( i * page_size );
+		set_code_page( i, blargg_rebase( in.state_.code_map [i] + offset, in_base, base, size ) );
+	}
+	irq_time_    = in.irq_time_;
+	end_time_    = in.end_time_;
+	error_count_ = in.error_count_;
+}
+
 void Nes_Cpu::map_code( nes_addr_t start, unsigned size, void const* data, bool mirror )
 {
 	// address range must begin and end on page boundaries
@@ -183,6 +201,8 @@ loop:
 		pc++;
 	#endif
 
+	GME_STAT_ADD( instructions, 1 );
+
 	static uint8_t const clock_table [256] =
 	{// 0 1 2 3 4 5 6 7 8 9 A B C D E F
 		0,6,2,8,3,3,5,5,3,2,2,2,4,4,6,6,// 0
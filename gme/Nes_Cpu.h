@@ -61,6 +61,11 @@ public:
 	// CPU invokes bad opcode handler if it encounters this
 	enum { bad_opcode = 0xF2 };
 
+	// Copy registers, memory and timing of other CPU. Code mapped to memory within
+	// size bytes at other_base is mapped to the same offset from base instead, so
+	// a copy of an emulator maps its own memory.
+	void copy_state( Nes_Cpu const& other, void const* other_base, void* base, size_t size );
+
 public:
 	Nes_Cpu() { state = &state_; }
 	enum { page_bits = 11 };
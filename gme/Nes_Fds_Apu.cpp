@@ -49,6 +49,26 @@ void Nes_Fds_Apu::reset()
 	}
 }
 
+void Nes_Fds_Apu::copy_state( Nes_Fds_Apu const& in )
+{
+	memcpy( regs_, in.regs_, sizeof regs_ );
+	memcpy( mod_wave, in.mod_wave, sizeof mod_wave );
+	lfo_tempo     = in.lfo_tempo;
+	env_delay     = in.env_delay;
+	env_speed     = in.env_speed;
+	env_gain      = in.env_gain;
+	sweep_delay   = in.sweep_delay;
+	sweep_speed   = in.sweep_speed;
+	sweep_gain    = in.sweep_gain;
+	wave_pos      = in.wave_pos;
+	last_amp      = in.last_amp;
+	wave_fract    = in.wave_fract;
+	mod_fract     = in.mod_fract;
+	mod_pos       = in.mod_pos;
+	mod_write_pos = in.mod_write_pos;
+	last_time     = in.last_time;
+}
+
 void Nes_Fds_Apu::write_( unsigned addr, int data )
 {
 	unsigned reg = addr - io_addr;
@@ -112,6 +132,7 @@ void Nes_Fds_Apu::set_tempo( double t )
 
 void Nes_Fds_Apu::run_until( blip_time_t final_end_time )
 {
+	GME_STAT_TIME( apu_time );
 	int const wave_freq = (regs (0x4083) & 0x0F) * 0x100 + regs (0x4082);
 	Blip_Buffer* const output_ = this->output_;
 	if ( wave_freq && output_ && !((regs (0x4089) | regs (0x4083)) & 0x80) )
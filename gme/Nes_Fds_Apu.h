@@ -7,6 +7,7 @@
 
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
+#include "Gme_Stats.h"
 
 class Nes_Fds_Apu {
 public:
@@ -24,6 +25,9 @@ public:
 	int read( blip_time_t time, unsigned addr );
 	void end_frame( blip_time_t );
 
+	// Copy emulation state of other, keeping own output and volume
+	void copy_state( Nes_Fds_Apu const& );
+
 public:
 	Nes_Fds_Apu();
 	void write_( unsigned addr, int data );
@@ -93,6 +97,7 @@ inline void Nes_Fds_Apu::end_frame( blip_time_t end_time )
 
 inline void Nes_Fds_Apu::write( blip_time_t time, unsigned addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	run_until( time );
 	write_( addr, data );
 }
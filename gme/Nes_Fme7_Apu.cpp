@@ -40,6 +40,7 @@ unsigned char const Nes_Fme7_Apu::amp_table [16] =
 
 void Nes_Fme7_Apu::run_until( blip_time_t end_time )
 {
+	GME_STAT_TIME( apu_time );
 	require( end_time >= last_time );
 
 	for ( int index = 0; index < osc_count; index++ )
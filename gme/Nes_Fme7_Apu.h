@@ -6,6 +6,7 @@
 
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
+#include "Gme_Stats.h"
 
 struct fme7_apu_state_t
 {
@@ -28,6 +29,7 @@ public:
 	void end_frame( blip_time_t );
 	void save_state( fme7_apu_state_t* ) const;
 	void load_state( fme7_apu_state_t const& );
+	void copy_state( Nes_Fme7_Apu const& ); // keeps own outputs and volume
 
 	// Mask and addresses of registers
 	static const unsigned int addr_mask = 0xE000;
@@ -95,6 +97,7 @@ inline void Nes_Fme7_Apu::write_latch( int data ) { latch = data; }
 
 inline void Nes_Fme7_Apu::write_data( blip_time_t time, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	if ( (unsigned) latch >= reg_count )
 	{
 		#ifdef debug_printf
@@ -128,4 +131,13 @@ inline void Nes_Fme7_Apu::load_state( fme7_apu_state_t const& in )
 	*state = in;
 }
 
+inline void Nes_Fme7_Apu::copy_state( Nes_Fme7_Apu const& in )
+{
+	fme7_apu_state_t* state = this;
+	*state = in;
+	last_time = in.last_time;
+	for ( int i = 0; i < osc_count; i++ )
+		oscs [i].last_amp = in.oscs [i].last_amp;
+}
+
 #endif
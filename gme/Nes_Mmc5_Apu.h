@@ -19,6 +19,12 @@ public:
 
 	enum { exram_size = 1024 };
 	unsigned char exram [exram_size];
+
+	void copy_state( Nes_Mmc5_Apu const& in )
+	{
+		Nes_Apu::copy_state( in );
+		memcpy( exram, in.exram, sizeof exram );
+	}
 };
 
 inline void Nes_Mmc5_Apu::osc_output( int i, Blip_Buffer* b )
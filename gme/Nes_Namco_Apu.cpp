@@ -22,6 +22,20 @@ Nes_Namco_Apu::Nes_Namco_Apu()
 	reset();
 }
 
+void Nes_Namco_Apu::copy_state( Nes_Namco_Apu const& in )
+{
+	last_time = in.last_time;
+	addr_reg  = in.addr_reg;
+	memcpy( reg, in.reg, sizeof reg );
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Namco_Osc& osc = oscs [i];
+		osc.delay    = in.oscs [i].delay;
+		osc.last_amp = in.oscs [i].last_amp;
+		osc.wave_pos = in.oscs [i].wave_pos;
+	}
+}
+
 void Nes_Namco_Apu::reset()
 {
 	last_time = 0;
@@ -75,6 +89,7 @@ void Nes_Namco_Apu::end_frame( blip_time_t time )
 
 void Nes_Namco_Apu::run_until( blip_time_t nes_end_time )
 {
+	GME_STAT_TIME( apu_time );
 	int active_oscs = (reg [0x7F] >> 4 & 7) + 1;
 	for ( int i = osc_count - active_oscs; i < osc_count; i++ )
 	{
@@ -6,6 +6,7 @@
 
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
+#include "Gme_Stats.h"
 
 struct namco_state_t;
 
@@ -33,6 +34,9 @@ public:
 	void save_state( namco_state_t* out ) const;
 	void load_state( namco_state_t const& );
 
+	// Copy emulation state of other, keeping own outputs and volume
+	void copy_state( Nes_Namco_Apu const& );
+
 public:
 	Nes_Namco_Apu();
 	BLARGG_DISABLE_NOTHROW
@@ -95,6 +99,7 @@ inline void Nes_Namco_Apu::osc_output( int i, Blip_Buffer* buf )
 
 inline void Nes_Namco_Apu::write_data( blip_time_t time, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	run_until( time );
 	access() = data;
 }
@@ -1,6 +1,7 @@
 // Nes_Snd_Emu 0.1.8. http://www.slack.net/~ant/
 
 #include "Nes_Vrc6_Apu.h"
+#include "Gme_Stats.h"
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -37,6 +38,17 @@ void Nes_Vrc6_Apu::reset()
 	}
 }
 
+void Nes_Vrc6_Apu::copy_state( Nes_Vrc6_Apu const& in )
+{
+	last_time = in.last_time;
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Blip_Buffer* output = oscs [i].output;
+		oscs [i] = in.oscs [i];
+		oscs [i].output = output;
+	}
+}
+
 void Nes_Vrc6_Apu::output( Blip_Buffer* buf )
 {
 	for ( int i = 0; i < osc_count; i++ )
@@ -45,6 +57,7 @@ void Nes_Vrc6_Apu::output( Blip_Buffer* buf )
 
 void Nes_Vrc6_Apu::run_until( blip_time_t time )
 {
+	GME_STAT_TIME( apu_time );
 	require( time >= last_time );
 	run_square( oscs [0], time );
 	run_square( oscs [1], time );
@@ -54,6 +67,7 @@ void Nes_Vrc6_Apu::run_until( blip_time_t time )
 
 void Nes_Vrc6_Apu::write_osc( blip_time_t time, int osc_index, int reg, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	require( (unsigned) osc_index < osc_count );
 	require( (unsigned) reg < reg_count );
 
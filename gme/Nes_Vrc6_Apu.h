@@ -21,6 +21,7 @@ public:
 	void end_frame( blip_time_t );
 	void save_state( vrc6_apu_state_t* ) const;
 	void load_state( vrc6_apu_state_t const& );
+	void copy_state( Nes_Vrc6_Apu const& ); // keeps own outputs and volume
 
 	// Oscillator 0 write-only registers are at $9000-$9002
 	// Oscillator 1 write-only registers are at $A000-$A002
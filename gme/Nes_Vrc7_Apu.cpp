@@ -1,4 +1,5 @@
 #include "Nes_Vrc7_Apu.h"
+#include "Gme_Stats.h"
 
 extern "C" {
 #include "ext/emu2413.h"
@@ -91,6 +92,7 @@ void Nes_Vrc7_Apu::write_reg( int data )
 
 void Nes_Vrc7_Apu::write_data( blip_time_t time, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	int type = (addr >> 4) - 1;
 	int chan = addr & 15;
 	if ( (unsigned) type < 3 && chan < osc_count )
@@ -163,8 +165,30 @@ void Nes_Vrc7_Apu::load_snapshot( vrc7_snapshot_t const& in )
 	}
 }
 
+void Nes_Vrc7_Apu::copy_state( Nes_Vrc7_Apu const& in )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		memcpy( oscs [i].regs, in.oscs [i].regs, sizeof oscs [i].regs );
+		oscs [i].last_amp = in.oscs [i].last_amp;
+	}
+	kon       = in.kon;
+	memcpy( inst, in.inst, sizeof inst );
+	addr      = in.addr;
+	next_time = in.next_time;
+	mono.last_amp = in.mono.last_amp;
+
+	// slots point to patches within chip; wave tables are shared
+	OPLL* out = (OPLL*) opll;
+	OPLL const* from = (OPLL const*) in.opll;
+	memcpy( out, from, sizeof *out );
+	for ( int i = 0; i < 18; i++ )
+		out->slot [i].patch = blargg_rebase( out->slot [i].patch, from, out, sizeof *out );
+}
+
 void Nes_Vrc7_Apu::run_until( blip_time_t end_time )
 {
+	GME_STAT_TIME( apu_time );
 	require( end_time > next_time );
 
 	blip_time_t time = next_time;
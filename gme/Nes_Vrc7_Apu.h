@@ -25,6 +25,10 @@ public:
 	void save_snapshot( vrc7_snapshot_t* ) const;
 	void load_snapshot( vrc7_snapshot_t const& );
 
+	// Copy emulation state of other, including its FM chip, keeping own outputs
+	// and volume
+	void copy_state( Nes_Vrc7_Apu const& );
+
 	void write_reg( int reg );
 	void write_data( blip_time_t, int data );
 
@@ -148,10 +148,27 @@ struct Nsf_File : Gme_Info_
 	}
 };
 
+static blargg_err_t probe_nsf( Gme_Probe& out, byte const* in, long size )
+{
+	if ( size < Nsf_Emu::header_size )
+		return gme_wrong_file_type;
+
+	Nsf_Emu::header_t const& h = *(Nsf_Emu::header_t const*) in;
+	RETURN_ERR( check_nsf_header( &h ) );
+	out.info.track_count = h.track_count;
+	GME_PROBE_FIELD( h, out, game );
+	GME_PROBE_FIELD( h, out, author );
+	GME_PROBE_FIELD( h, out, copyright );
+	if ( h.chip_flags )
+		out.set_field( &out.info.system, "Famicom" );
+	out.report_all();
+	return 0;
+}
+
 static Music_Emu* new_nsf_emu () { return BLARGG_NEW Nsf_Emu ; }
 static Music_Emu* new_nsf_file() { return BLARGG_NEW Nsf_File; }
 
-static gme_type_t_ const gme_nsf_type_ = { "Nintendo NES", 0, &new_nsf_emu, &new_nsf_file, "NSF", 1 };
+static gme_type_t_ const gme_nsf_type_ = { "Nintendo NES", 0, &new_nsf_emu, &new_nsf_file, "NSF", 1, &probe_nsf };
 extern gme_type_t const gme_nsf_type = &gme_nsf_type_;
 
 
@@ -332,7 +349,20 @@ blargg_err_t Nsf_Emu::load_( Data_Reader& in )
 {
 	blaarg_static_assert( offsetof (header_t,unused [4]) == header_size, "NSF Header layout incorrect!" );
 	RETURN_ERR( rom.load( in, header_size, &header_, 0 ) );
+	return init_file();
+}
 
+blargg_err_t Nsf_Emu::load_clone_( Gme_File const& other )
+{
+	Nsf_Emu const& in = STATIC_CAST(Nsf_Emu const&,other);
+	rom.share( in.rom );
+	header_ = in.header_;
+	return init_file();
+}
+
+// Sets up emulator for file data in rom and header_
+blargg_err_t Nsf_Emu::init_file()
+{
 	set_track_count( header_.track_count );
 	RETURN_ERR( check_nsf_header( &header_ ) );
 
@@ -614,6 +644,31 @@ blargg_err_t Nsf_Emu::start_track_( int track )
 	return 0;
 }
 
+blargg_err_t Nsf_Emu::clone_state_( Music_Emu const& other )
+{
+	Nsf_Emu const& in = STATIC_CAST(Nsf_Emu const&,other);
+	cpu::copy_state( in, &in, this, sizeof *this );
+	memcpy( sram, in.sram, sizeof sram );
+	memcpy( mmc5_mul, in.mmc5_mul, sizeof mmc5_mul );
+	saved_state = in.saved_state;
+	next_play   = in.next_play;
+	play_extra  = in.play_extra;
+	play_ready  = in.play_ready;
+
+	apu.copy_state( in.apu );
+	#if !NSF_EMU_APU_ONLY
+	{
+		if ( namco ) namco->copy_state( *in.namco );
+		if ( vrc6  ) vrc6 ->copy_state( *in.vrc6 );
+		if ( fme7  ) fme7 ->copy_state( *in.fme7 );
+		if ( fds   ) fds  ->copy_state( *in.fds );
+		if ( mmc5  ) mmc5 ->copy_state( *in.mmc5 );
+		if ( vrc7  ) vrc7 ->copy_state( *in.vrc7 );
+	}
+	#endif
+	return Classic_Emu::clone_state_( in );
+}
+
 blargg_err_t Nsf_Emu::run_clocks( blip_time_t& duration, int )
 {
 	set_time( 0 );
@@ -55,6 +55,8 @@ public:
 protected:
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t load_( Data_Reader& );
+	blargg_err_t load_clone_( Gme_File const& );
+	blargg_err_t clone_state_( Music_Emu const& );
 	blargg_err_t start_track_( int );
 	blargg_err_t run_clocks( blip_time_t&, int );
 	void set_tempo_( double );
@@ -101,6 +103,7 @@ private:
 	blargg_vector<const char*> apu_names;
 	static int pcm_read( void*, nes_addr_t );
 	blargg_err_t init_sound();
+	blargg_err_t init_file();
 
 	header_t header_;
 
@@ -51,6 +51,32 @@ int Nsfe_Info::remap_track( int track ) const
 	return track;
 }
 
+template<class T>
+static blargg_err_t copy_vector( blargg_vector<T>& out, blargg_vector<T> const& in )
+{
+	RETURN_ERR( out.resize( in.size() ) );
+	if ( out.size() )
+		memcpy( out.begin(), in.begin(), out.size() * sizeof (T) );
+	return 0;
+}
+
+blargg_err_t Nsfe_Info::copy( Nsfe_Info const& in )
+{
+	info = in.info;
+	actual_track_count_ = in.actual_track_count_;
+	playlist_disabled   = in.playlist_disabled;
+	RETURN_ERR( copy_vector( track_name_data, in.track_name_data ) );
+	RETURN_ERR( copy_vector( track_names, in.track_names ) );
+	RETURN_ERR( copy_vector( playlist, in.playlist ) );
+	RETURN_ERR( copy_vector( track_times, in.track_times ) );
+
+	// names point into track_name_data
+	for ( size_t i = 0; i < track_names.size(); i++ )
+		track_names [i] = blargg_rebase( track_names [i], in.track_name_data.begin(),
+				track_name_data.begin(), track_name_data.size() );
+	return 0;
+}
+
 // Read multiple strings and separate into individual strings
 static blargg_err_t read_strs( Data_Reader& in, long size, blargg_vector<char>& chars,
 		blargg_vector<const char*>& strs )
@@ -128,6 +154,10 @@ blargg_err_t Nsfe_Info::load( Data_Reader& in, Nsf_Emu* nsf_emu )
 	};
 	Nsf_Emu::header_t& header = info;
 	header = base_header;
+	info.game [0]      = 0; // auth block is optional
+	info.author [0]    = 0;
+	info.copyright [0] = 0;
+	info.dumper [0]    = 0;
 
 	// parse tags
 	int phase = 0;
@@ -301,10 +331,125 @@ struct Nsfe_File : Gme_Info_
 	}
 };
 
+// Set field to index'th string in block of strings, as separated by read_strs()
+static void probe_str( Gme_Probe& out, gme_str_t* field, byte const* in, long size, int index )
+{
+	byte const* end = in + size;
+	for ( ; index && in < end; index-- )
+	{
+		while ( in < end && *in )
+			in++;
+		if ( in < end )
+			in++;
+	}
+	if ( in < end )
+		out.set_field( field, (char const*) in, (int) (end - in) );
+}
+
+static blargg_err_t probe_nsfe( Gme_Probe& out, byte const* in, long size )
+{
+	if ( size < 4 || memcmp( in, "NSFE", 4 ) )
+		return gme_wrong_file_type;
+
+	// find blocks with info
+	byte const* end = in + size;
+	byte const* auth     = 0;
+	byte const* times    = 0;
+	byte const* names    = 0;
+	byte const* playlist = 0;
+	long auth_size = 0, times_size = 0, names_size = 0, playlist_size = 0;
+	int track_count = 1;
+	in += 4;
+	for ( int phase = 0; phase != 3; )
+	{
+		if ( end - in < 8 )
+			return Data_Reader::eof_error;
+		int32_t block_size = get_le32( in );
+		int32_t tag        = get_le32( in + 4 );
+		in += 8;
+		if ( block_size < 0 )
+			return "Corrupt file";
+		if ( block_size > end - in )
+			return Data_Reader::eof_error;
+
+		switch ( tag )
+		{
+			case BLARGG_4CHAR('O','F','N','I'):
+				if ( block_size < 8 )
+					return "Corrupt file";
+				phase = 1;
+				if ( block_size > (int) offsetof (nsfe_info_t,track_count) )
+					track_count = in [offsetof (nsfe_info_t,track_count)];
+				break;
+
+			case BLARGG_4CHAR('K','N','A','B'):
+				if ( block_size > (int) sizeof Nsf_Emu::header_t::banks )
+					return "Corrupt file";
+				break;
+
+			case BLARGG_4CHAR('h','t','u','a'):
+				auth = in;
+				auth_size = block_size;
+				break;
+
+			case BLARGG_4CHAR('e','m','i','t'):
+				times = in;
+				times_size = block_size / 4;
+				break;
+
+			case BLARGG_4CHAR('l','b','l','t'):
+				names = in;
+				names_size = block_size;
+				break;
+
+			case BLARGG_4CHAR('t','s','l','p'):
+				playlist = in;
+				playlist_size = block_size;
+				break;
+
+			case BLARGG_4CHAR('A','T','A','D'):
+				phase = 2;
+				break;
+
+			case BLARGG_4CHAR('D','N','E','N'):
+				phase = 3;
+				break;
+		}
+		in += block_size;
+	}
+
+	gme_probe_t& info = out.info;
+	info.track_count = playlist_size ? (int) playlist_size : track_count;
+	if ( auth )
+	{
+		probe_str( out, &info.game,      auth, auth_size, 0 );
+		probe_str( out, &info.author,    auth, auth_size, 1 );
+		probe_str( out, &info.copyright, auth, auth_size, 2 );
+		probe_str( out, &info.dumper,    auth, auth_size, 3 );
+	}
+	for ( int i = 0; i < info.track_count; i++ )
+	{
+		int remapped = (i < playlist_size) ? playlist [i] : i;
+		info.song = gme_str_t();
+		info.length = -1;
+		if ( remapped < times_size )
+		{
+			long length = (int32_t) get_le32( times + remapped * 4 );
+			if ( length > 0 )
+				info.length = length;
+		}
+		if ( names )
+			probe_str( out, &info.song, names, names_size, remapped );
+		if ( out.report( i ) )
+			break;
+	}
+	return 0;
+}
+
 static Music_Emu* new_nsfe_emu () { return BLARGG_NEW Nsfe_Emu ; }
 static Music_Emu* new_nsfe_file() { return BLARGG_NEW Nsfe_File; }
 
-static gme_type_t_ const gme_nsfe_type_ = { "Nintendo NES", 0, &new_nsfe_emu, &new_nsfe_file, "NSFE", 1 };
+static gme_type_t_ const gme_nsfe_type_ = { "Nintendo NES", 0, &new_nsfe_emu, &new_nsfe_file, "NSFE", 1, &probe_nsfe };
 extern gme_type_t const gme_nsfe_type = &gme_nsfe_type_;
 
 
@@ -321,6 +466,13 @@ blargg_err_t Nsfe_Emu::load_( Data_Reader& in )
 	return err;
 }
 
+blargg_err_t Nsfe_Emu::load_clone_( Gme_File const& other )
+{
+	Nsfe_Emu const& in = STATIC_CAST(Nsfe_Emu const&,other);
+	RETURN_ERR( info.copy( in.info ) );
+	return Nsf_Emu::load_clone_( in );
+}
+
 void Nsfe_Emu::disable_playlist( bool b )
 {
 	info.disable_playlist( b );
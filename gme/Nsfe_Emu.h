@@ -12,6 +12,9 @@ class Nsfe_Info {
 public:
 	blargg_err_t load( Data_Reader&, Nsf_Emu* );
 
+	// Make this a copy of other
+	blargg_err_t copy( Nsfe_Info const& other );
+
 	struct info_t : Nsf_Emu::header_t
 	{
 		char game      [256];
@@ -56,6 +59,7 @@ public:
 	~Nsfe_Emu();
 protected:
 	blargg_err_t load_( Data_Reader& );
+	blargg_err_t load_clone_( Gme_File const& );
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t start_track_( int );
 	void unload();
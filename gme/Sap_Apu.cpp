@@ -1,6 +1,7 @@
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
 
 #include "Sap_Apu.h"
+#include "Gme_Stats.h"
 
 #include <string.h>
 
@@ -90,6 +91,19 @@ void Sap_Apu::reset( Sap_Apu_Impl* new_impl )
 		memset( &oscs [i], 0, offsetof (osc_t,output) );
 }
 
+void Sap_Apu::copy_state( Sap_Apu const& in, Sap_Apu_Impl* new_impl )
+{
+	impl      = new_impl;
+	last_time = in.last_time;
+	poly5_pos = in.poly5_pos;
+	poly4_pos = in.poly4_pos;
+	polym_pos = in.polym_pos;
+	control   = in.control;
+
+	for ( int i = 0; i < osc_count; i++ )
+		memcpy( &oscs [i], &in.oscs [i], offsetof (osc_t,output) );
+}
+
 inline void Sap_Apu::calc_periods()
 {
 	 // 15/64 kHz clock
@@ -123,6 +137,7 @@ inline void Sap_Apu::calc_periods()
 
 void Sap_Apu::run_until( blip_time_t end_time )
 {
+	GME_STAT_TIME( apu_time );
 	calc_periods();
 	Sap_Apu_Impl* const impl = this->impl; // cache
 
@@ -298,6 +313,7 @@ void Sap_Apu::run_until( blip_time_t end_time )
 
 void Sap_Apu::write_data( blip_time_t time, unsigned addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	run_until( time );
 	int i = (addr ^ 0xD200) >> 1;
 	if ( i < osc_count )
@@ -22,6 +22,9 @@ public:
 
 	void end_frame( blip_time_t );
 
+	// Copy emulation state of other APU, keeping own outputs and using new_impl
+	void copy_state( Sap_Apu const&, Sap_Apu_Impl* new_impl );
+
 public:
 	Sap_Apu();
 private:
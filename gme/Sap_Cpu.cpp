@@ -4,6 +4,7 @@
 
 #include <limits.h>
 #include "blargg_endian.h"
+#include "Gme_Stats.h"
 
 //#include "nes_cpu_log.h"
 
@@ -40,6 +41,16 @@ enum {
     st_c = 0x01
 };
 
+void Sap_Cpu::copy_state( Sap_Cpu const& in, void const* in_base, void* base, size_t size )
+{
+	check( state == &state_ && in.state == &in.state_ );
+	mem = blargg_rebase( in.mem, in_base, base, size );
+	r = in.r;
+	state_ = in.state_;
+	irq_time_ = in.irq_time_;
+	end_time_ = in.end_time_;
+}
+
 void Sap_Cpu::reset( void* new_mem )
 {
 	check( state == &state_ );
@@ -135,6 +146,8 @@ loop:
 	pc++;
 	uint8_t const* instr = mem + pc;
 
+	GME_STAT_ADD( instructions, 1 );
+
 	static uint8_t const clock_table [256] =
 	{// 0 1 2 3 4 5 6 7 8 9 A B C D E F
 		0,6,2,8,3,3,5,5,3,2,2,2,4,4,6,6,// 0
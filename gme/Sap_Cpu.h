@@ -15,6 +15,11 @@ public:
 	// Clear all registers and keep pointer to 64K memory passed in
 	void reset( void* mem_64k );
 
+	// Copy registers and state of other CPU. If its memory is within size bytes at
+	// other_base, memory at the same offset from base is used instead, so a copy of
+	// an emulator uses its own memory.
+	void copy_state( Sap_Cpu const& other, void const* other_base, void* base, size_t size );
+
 	// Run until specified time is reached. Returns true if suspicious/unsupported
 	// instruction was encountered at any point during run.
 	bool run( sap_time_t end_time );
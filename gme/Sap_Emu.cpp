@@ -236,10 +236,22 @@ struct Sap_File : Gme_Info_
 	}
 };
 
+static blargg_err_t probe_sap( Gme_Probe& out, byte const* in, long size )
+{
+	Sap_Emu::info_t info; // strings are unquoted into this
+	RETURN_ERR( parse_info( in, size, &info ) );
+	out.info.track_count = info.track_count;
+	out.set_field( &out.info.game,      info.name );
+	out.set_field( &out.info.author,    info.author );
+	out.set_field( &out.info.copyright, info.copyright );
+	out.report_all();
+	return 0;
+}
+
 static Music_Emu* new_sap_emu () { return BLARGG_NEW Sap_Emu ; }
 static Music_Emu* new_sap_file() { return BLARGG_NEW Sap_File; }
 
-static gme_type_t_ const gme_sap_type_ = { "Atari XL", 0, &new_sap_emu, &new_sap_file, "SAP", 1 };
+static gme_type_t_ const gme_sap_type_ = { "Atari XL", 0, &new_sap_emu, &new_sap_file, "SAP", 1, &probe_sap };
 extern gme_type_t const gme_sap_type = &gme_sap_type_;
 
 // Setup
@@ -256,7 +268,21 @@ blargg_err_t Sap_Emu::load_mem_( byte const* in, long size )
 	info.music_addr = -1;
 	info.fastplay   = 312;
 	RETURN_ERR( parse_info( in, size, &info ) );
+	return init_file();
+}
 
+blargg_err_t Sap_Emu::load_clone_( Gme_File const& other )
+{
+	// file data is shared, so pointers into it remain valid
+	Sap_Emu const& in = STATIC_CAST(Sap_Emu const&,other);
+	info     = in.info;
+	file_end = in.file_end;
+	return init_file();
+}
+
+// Sets up emulator for file data described by info
+blargg_err_t Sap_Emu::init_file()
+{
 	set_warning( info.warning );
 	set_track_count( info.track_count );
 	set_voice_count( Sap_Apu::osc_count << static_cast<int>(info.stereo) );
@@ -328,6 +354,20 @@ inline void Sap_Emu::call_init( int track )
 	}
 }
 
+blargg_err_t Sap_Emu::clone_state_( Music_Emu const& other )
+{
+	Sap_Emu const& in = STATIC_CAST(Sap_Emu const&,other);
+	cpu::copy_state( in, &in, this, sizeof *this );
+	scanline_period = in.scanline_period;
+	next_play       = in.next_play;
+	time_mask       = in.time_mask;
+	apu.copy_state( in.apu, &apu_impl );
+	apu2.copy_state( in.apu2, &apu_impl );
+	mem = in.mem;
+	apu_impl.synth.copy_config( in.apu_impl.synth );
+	return Classic_Emu::clone_state_( in );
+}
+
 blargg_err_t Sap_Emu::start_track_( int track )
 {
 	RETURN_ERR( Classic_Emu::start_track_( track ) );
@@ -32,6 +32,8 @@ public:
 protected:
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t load_mem_( byte const*, long );
+	blargg_err_t load_clone_( Gme_File const& );
+	blargg_err_t clone_state_( Music_Emu const& );
 	blargg_err_t start_track_( int );
 	blargg_err_t run_clocks( blip_time_t&, int );
 	void set_tempo_( double );
@@ -43,6 +45,7 @@ public: private: friend class Sap_Cpu;
 	void cpu_write_( sap_addr_t, int );
 private:
 	info_t info;
+	blargg_err_t init_file();
 
 	byte const* file_end;
 	sap_time_t scanline_period;
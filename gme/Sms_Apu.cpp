@@ -1,6 +1,7 @@
 // Sms_Snd_Emu 0.1.4. http://www.slack.net/~ant/
 
 #include "Sms_Apu.h"
+#include "Gme_Stats.h"
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -233,6 +234,7 @@ void Sms_Apu::reset( unsigned feedback, int noise_width )
 
 void Sms_Apu::run_until( blip_time_t end_time )
 {
+	GME_STAT_TIME( apu_time );
 	require( end_time >= last_time ); // end_time must not be before previous time
 
 	if ( end_time > last_time )
@@ -264,8 +266,39 @@ void Sms_Apu::end_frame( blip_time_t end_time )
 	last_time -= end_time;
 }
 
+static void copy_osc( Sms_Osc& out, Sms_Osc const& in )
+{
+	out.output_select = in.output_select;
+	out.output        = out.outputs [out.output_select];
+	out.delay         = in.delay;
+	out.last_amp      = in.last_amp;
+	out.volume        = in.volume;
+}
+
+void Sms_Apu::copy_state( Sms_Apu const& in )
+{
+	for ( int i = 0; i < 3; i++ )
+	{
+		copy_osc( squares [i], in.squares [i] );
+		squares [i].period = in.squares [i].period;
+		squares [i].phase  = in.squares [i].phase;
+	}
+	copy_osc( noise, in.noise );
+	noise.period   = blargg_rebase( in.noise.period, &in, this, sizeof *this );
+	noise.shifter  = in.noise.shifter;
+	noise.feedback = in.noise.feedback;
+
+	last_time       = in.last_time;
+	latch           = in.latch;
+	noise_feedback  = in.noise_feedback;
+	looped_feedback = in.looped_feedback;
+	square_synth.copy_config( in.square_synth );
+	noise.synth.copy_config( in.noise.synth );
+}
+
 void Sms_Apu::write_ggstereo( blip_time_t time, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	require( (unsigned) data <= 0xFF );
 
 	run_until( time );
@@ -296,6 +329,7 @@ static unsigned char const volumes [16] = {
 
 void Sms_Apu::write_data( blip_time_t time, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	require( (unsigned) data <= 0xFF );
 
 	run_until( time );
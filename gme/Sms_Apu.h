@@ -42,9 +42,13 @@ public:
 	// start a new frame at time 0.
 	void end_frame( blip_time_t );
 
+	// Copy emulation state and volume of other chip, keeping own outputs
+	void copy_state( Sms_Apu const& );
+
 public:
 	Sms_Apu();
 	~Sms_Apu();
+	BLARGG_DISABLE_NOTHROW
 private:
 	// noncopyable
 	Sms_Apu( const Sms_Apu& );
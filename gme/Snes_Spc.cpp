@@ -257,11 +257,25 @@ void Snes_Spc::clear_echo()
 		if ( end > 0x10000 )
 			end = 0x10000;
 		memset( &RAM [addr], 0xFF, end - addr );
+		dsp.ram_written( addr, end - addr );
 	}
 #endif
 }
 
 
+void Snes_Spc::copy_state( Snes_Spc const& in )
+{
+	dsp.copy_state( in.dsp, &in, this, sizeof *this );
+
+	#if SPC_LESS_ACCURATE
+		memcpy( reg_times, in.reg_times, sizeof reg_times );
+	#endif
+
+	m = in.m;
+	m.extra_pos = blargg_rebase( in.m.extra_pos, &in, this, sizeof *this );
+}
+
+
 //// Sample output
 
 void Snes_Spc::reset_buf()
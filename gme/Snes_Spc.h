@@ -39,6 +39,9 @@ public:
 	// you must call set_output() after this.
 	void soft_reset();
 
+	// Copies all state of other SPC, which must have been initialized the same way
+	void copy_state( Snes_Spc const& other );
+
 	// 1024000 SPC clocks per second, sample pair every 32 clocks
 	typedef int time_t;
 	enum { clock_rate = 1024000 };
@@ -54,8 +57,9 @@ public:
 
 // Sound control
 
-	// Mutes voices corresponding to non-zero bits in mask (issues repeated KOFF events).
-	// Reduces emulation accuracy.
+	// Mutes voices corresponding to non-zero bits in mask (overrides VxVOL with 0).
+	// Muted voices keep running, but skip interpolation and mixing. Their OUTX
+	// reads back as 0 unless they are a pitch modulation source.
 	enum { voice_count = 8 };
 	void mute_voices( int mask );
 
@@ -65,6 +69,18 @@ public:
 
 	void disable_echo( bool disable = true );
 
+	// If true, has DSP use its fast mode, which drops a few rarely audible quirks
+	void enable_fast_dsp( bool enable = true );
+
+	// Sets destination for separate output of each voice, in addition to normal
+	// output (see Spc_Dsp::set_voice_output()). Voice output isn't delayed by
+	// the extra_size / 2 values of silence that normal output starts with after
+	// loading, reset() or skip(), so the caller must account for that.
+	void set_voice_output( sample_t* out, int out_size );
+
+	// Number of values written to voice output since it was last set
+	int voice_sample_count() const;
+
 	// Sets tempo, where tempo_unit = normal, tempo_unit / 2 = half speed, etc.
 	static const unsigned int tempo_unit = 0x100;
 	void set_tempo( int );
@@ -280,6 +296,12 @@ inline void Snes_Spc::disable_surround( bool disable ) { dsp.disable_surround( d
 
 inline void Snes_Spc::disable_echo( bool disable ) { dsp.disable_echo( disable ); }
 
+inline void Snes_Spc::enable_fast_dsp( bool enable ) { dsp.enable_fast_mode( enable ); }
+
+inline void Snes_Spc::set_voice_output( sample_t* out, int size ) { dsp.set_voice_output( out, size ); }
+
+inline int Snes_Spc::voice_sample_count() const { return dsp.voice_sample_count(); }
+
 #if !SPC_NO_COPY_STATE_FUNCS
 inline bool Snes_Spc::check_kon() { return dsp.check_kon(); }
 #endif
@@ -4,6 +4,7 @@
 
 #include "Snes_Spc.h"
 
+#include "Gme_Stats.h"
 #include <string.h>
 
 /* Copyright (C) 2004-2007 Shay Green. This module is free software; you
@@ -86,6 +87,7 @@ void Snes_Spc::enable_rom( int enable )
 		if ( enable )
 			memcpy( m.hi_ram, &RAM [rom_addr], sizeof m.hi_ram );
 		memcpy( &RAM [rom_addr], (enable ? m.rom : m.hi_ram), rom_size );
+		dsp.ram_written( rom_addr, rom_size );
 		// TODO: ROM can still get overwritten when DSP writes to echo buffer
 	}
 }
@@ -153,6 +155,7 @@ int Snes_Spc::dsp_read( rel_time_t time )
 
 inline void Snes_Spc::dsp_write( int data, rel_time_t time )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	RUN_DSP( time, reg_times [REGS [r_dspaddr]] )
 	#if SPC_LESS_ACCURATE
 		else if ( m.dsp_time == skipping_time )
@@ -413,6 +416,7 @@ void Snes_Spc::cpu_write( int data, uint16_t addr, rel_time_t time )
 
 	// RAM
 	RAM [addr] = (uint8_t) data;
+	dsp.ram_written( addr );
 	if ( addr >= 0xF0 ) // 64%
 	{
 		const uint16_t reg = addr - 0xF0;
@@ -528,6 +532,9 @@ static int const cpu_lag_max = 12 - 1; // DIV YA,X takes 12 clocks
 
 void Snes_Spc::end_frame( time_t end_time )
 {
+	GME_STAT_TIME( cpu_time );
+	GME_STAT_ADD( cpu_clocks, end_time );
+
 	// Catch CPU up to as close to end as possible. If final instruction
 	// would exceed end, does NOT execute it and leaves m.spc_time < end.
 	if ( end_time > m.spc_time )
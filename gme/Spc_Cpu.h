@@ -85,6 +85,7 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 #define PUSH( data )\
 {\
 	ram [0x100 + sp] = (uint8_t) (data);\
+	dsp.ram_written( 0x100 + sp );\
 	--sp;\
 }
 
@@ -174,6 +175,8 @@ loop:
 	if ( (rel_time += m.cycle_table [opcode]) > 0 )
 		goto out_of_time;
 
+	GME_STAT_ADD( instructions, 1 );
+
 	#ifdef SPC_CPU_OPCODE_HOOK
 		SPC_CPU_OPCODE_HOOK( GET_PC(), opcode );
 	#endif
@@ -253,6 +256,7 @@ loop:
 		{
 			int i = dp + temp;
 			ram [i] = (uint8_t) data;
+			dsp.ram_written( i );
 			i -= 0xF0;
 			if ( (unsigned) i < 0x10 ) // 76%
 			{
@@ -275,6 +279,7 @@ loop:
 		{
 			int i = dp + data;
 			ram [i] = (uint8_t) a;
+			dsp.ram_written( i );
 			i -= 0xF0;
 			if ( (unsigned) i < 0x10 ) // 39%
 			{
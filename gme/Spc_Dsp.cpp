@@ -1,6 +1,7 @@
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
 
 #include "Spc_Dsp.h"
+#include "Gme_Stats.h"
 
 #include "blargg_endian.h"
 #include <string.h>
@@ -86,6 +87,16 @@ void Spc_Dsp::set_output( sample_t* out, int size )
 	m.out_end   = out + size;
 }
 
+void Spc_Dsp::set_voice_output( sample_t* out, int size )
+{
+	require( size % (voice_count * 2) == 0 );
+	if ( !out )
+		size = 0;
+	m.voice_out_begin = out;
+	m.voice_out       = out;
+	m.voice_out_end   = out + size;
+}
+
 // Volume registers and efb are signed! Easy to forget int8_t cast.
 // Prefixes are to avoid accidental use of locals with same names.
 
@@ -180,379 +191,695 @@ inline void Spc_Dsp::run_counter( int i )
 #define READ_COUNTER( rate )\
 	(*m.counter_select [rate] & counter_mask [rate])
 
+// Same, but reads from a copy of the counters
+#define READ_COUNTER_AT( counters, rate )\
+	(counters [m.counter_select [rate] - m.counters] & counter_mask [rate])
 
-//// Emulation
 
-void Spc_Dsp::run( int clock_count )
+//// BRR cache
+
+static inline int brr_cache_index( int addr, int const key [2] )
 {
-	int new_phase = m.phase + clock_count;
-	int count = new_phase >> 5;
-	m.phase = new_phase & 31;
-	if ( !count )
-		return;
+	unsigned h = addr ^ (unsigned) key [0] * 0x9E3779B1 ^ (unsigned) key [1] * 0x85EBCA6B;
+	return (h ^ h >> 16) & (Spc_Dsp::brr_cache_size - 1);
+}
 
-	uint8_t* const ram = m.ram;
-#ifdef SPC_ISOLATED_ECHO_BUFFER
-	uint8_t* const echo_ram = m.echo_ram;
-#endif
-	uint8_t const* const dir = &ram [REG(dir) * 0x100];
-	int const slow_gaussian = (REG(pmon) >> 1) | REG(non);
-	int const noise_rate = REG(flg) & 0x1F;
+// Blocks overlapping granule must be marked, so writes to it are noticed
+void Spc_Dsp::mark_brr_block( int addr )
+{
+	m.brr_map [addr >> brr_granule_bits] = 1;
+	m.brr_map [((addr + 8) & 0xFFFF) >> brr_granule_bits] = 1;
+}
 
-	// Global volume
-	int mvoll = (int8_t) REG(mvoll);
-	int mvolr = (int8_t) REG(mvolr);
-	int evoll = (int8_t) REG(evoll);
-	int evolr = (int8_t) REG(evolr);
+void Spc_Dsp::start_brr_block( voice_t* const v, int addr, int brr_header )
+{
+	v->brr_key [0] = 0;
+	v->brr_key [1] = 0;
+	if ( brr_header & 0x0C ) // filter 0 doesn't depend on previous samples
+	{
+		v->brr_key [0] = v->buf_pos [brr_buf_size - 1];
+		v->brr_key [1] = v->buf_pos [brr_buf_size - 2];
+	}
 
-	if ( !m.echo_enable)
+	brr_block_t const& b = m.brr_cache [brr_cache_index( addr, v->brr_key )];
+	v->brr_cache_state = brr_filling;
+	if ( b.addr == addr && b.key [0] == v->brr_key [0] && b.key [1] == v->brr_key [1] )
 	{
-		mvoll = 127;
-		mvolr = 127;
-		evoll = 0;
-		evolr = 0;
+		memcpy( v->brr_block, b.samples, sizeof v->brr_block );
+		v->brr_cache_state = brr_cached;
 	}
+	mark_brr_block( addr );
+}
 
-	if ( mvoll * mvolr < m.surround_threshold )
-		mvoll = -mvoll; // eliminate surround
+void Spc_Dsp::add_brr_block( voice_t const* v, int addr )
+{
+	brr_block_t& b = m.brr_cache [brr_cache_index( addr, v->brr_key )];
+	b.addr    = addr;
+	b.key [0] = v->brr_key [0];
+	b.key [1] = v->brr_key [1];
+	memcpy( b.samples, v->brr_block, sizeof b.samples );
+}
 
-	do
+void Spc_Dsp::invalidate_brr( int granule )
+{
+	m.brr_map [granule] = 0;
+
+	int const begin = granule << brr_granule_bits;
+	int const brr_block_size = 9;
+	#define OVERLAPS( addr ) \
+		(((begin - (addr)) & 0xFFFF) < brr_block_size ||\
+		(((addr) - begin) & 0xFFFF) < (1 << brr_granule_bits))
+
+	for ( int i = 0; i < brr_cache_size; i++ )
 	{
-		// KON/KOFF reading
-		if ( (m.every_other_sample ^= 1) != 0 )
-		{
-			m.new_kon &= ~m.kon;
-			m.kon    = m.new_kon;
-			m.t_koff = REG(koff);
-		}
+		brr_block_t& b = m.brr_cache [i];
+		if ( b.addr >= 0 && OVERLAPS( b.addr ) )
+			b.addr = -1;
+	}
 
-		run_counter( 1 );
-		run_counter( 2 );
-		run_counter( 3 );
+	// Voices finish current block by decoding from RAM, like the hardware
+	for ( int i = 0; i < voice_count; i++ )
+	{
+		voice_t& v = m.voices [i];
+		if ( v.brr_cache_state != brr_uncached && OVERLAPS( v.brr_addr ) )
+			v.brr_cache_state = brr_uncached;
+	}
+	#undef OVERLAPS
+}
 
-		// Noise
-		if ( !READ_COUNTER( noise_rate ) )
-		{
-			int feedback = (m.noise << 13) ^ (m.noise << 14);
-			m.noise = (feedback & 0x4000) ^ (m.noise >> 1);
-		}
+void Spc_Dsp::ram_written( int addr, int size )
+{
+	if ( size > 0 )
+	{
+		int const last = (addr + size - 1) >> brr_granule_bits;
+		for ( int i = addr >> brr_granule_bits; i <= last; i++ )
+			if ( m.brr_map [i & (0xFFFF >> brr_granule_bits)] )
+				invalidate_brr( i & (0xFFFF >> brr_granule_bits) );
+	}
+}
 
-		// Voices
-		int pmon_input = 0;
-		int main_out_l = 0;
-		int main_out_r = 0;
-		int echo_out_l = 0;
-		int echo_out_r = 0;
-		voice_t* v = m.voices;
-		uint8_t* v_regs = m.regs;
-		int vbit = 1;
-		do
-		{
-			#define SAMPLE_PTR(i) GET_LE16A( &dir [VREG(v_regs,srcn) * 4 + i * 2] )
+void Spc_Dsp::clear_brr_cache()
+{
+	for ( int i = 0; i < brr_cache_size; i++ )
+		m.brr_cache [i].addr = -1;
+	memset( m.brr_map, 0, sizeof m.brr_map );
 
-			int brr_header = ram [v->brr_addr];
-			int kon_delay = v->kon_delay;
+	for ( int i = 0; i < voice_count; i++ )
+		m.voices [i].brr_cache_state = brr_uncached;
+}
 
-			// Pitch
-			int pitch = GET_LE16A( &VREG(v_regs,pitchl) ) & 0x3FFF;
-			if ( REG(pmon) & vbit )
-				pitch += ((pmon_input >> 5) * pitch) >> 10;
 
-			// KON phases
-			if ( --kon_delay >= 0 )
-			{
-				v->kon_delay = kon_delay;
+//// Emulation
 
-				// Get ready to start BRR decoding on next sample
-				if ( kon_delay == 4 )
-				{
-					v->brr_addr   = SAMPLE_PTR( 0 );
-					v->brr_offset = 1;
-					v->buf_pos    = v->buf;
-					brr_header    = 0; // header is ignored on this sample
-				}
+#define SAMPLE_PTR(i) GET_LE16A( &dir [VREG(v_regs,srcn) * 4 + i * 2] )
 
-				// Envelope is never run during KON
-				v->env        = 0;
-				v->hidden_env = 0;
+inline void Spc_Dsp::run_globals( int noise_rate )
+{
+	// KON/KOFF reading
+	if ( (m.every_other_sample ^= 1) != 0 )
+	{
+		m.new_kon &= ~m.kon;
+		m.kon    = m.new_kon;
+		m.t_koff = REG(koff);
+	}
 
-				// Disable BRR decoding until last three samples
-				v->interp_pos = (kon_delay & 3 ? 0x4000 : 0);
+	run_counter( 1 );
+	run_counter( 2 );
+	run_counter( 3 );
 
-				// Pitch is never added during KON
-				pitch = 0;
-			}
+	// Noise
+	if ( !READ_COUNTER( noise_rate ) )
+	{
+		int feedback = (m.noise << 13) ^ (m.noise << 14);
+		m.noise = (feedback & 0x4000) ^ (m.noise >> 1);
+	}
+}
 
-			int env = v->env;
+inline int Spc_Dsp::run_kon_phase( voice_t* const v, uint8_t const* const dir,
+		uint8_t const* const v_regs, int brr_header )
+{
+	int kon_delay = --v->kon_delay;
 
-			// Gaussian interpolation
-			{
-				int output = 0;
-				VREG(v_regs,envx) = (uint8_t) (env >> 4);
-				if ( env )
-				{
-					// Make pointers into gaussian based on fractional position between samples
-					int offset = (unsigned) v->interp_pos >> 3 & 0x1FE;
-					short const* fwd = interleved_gauss       + offset;
-					short const* rev = interleved_gauss + 510 - offset; // mirror left half of gaussian
+	// Get ready to start BRR decoding on next sample
+	if ( kon_delay == 4 )
+	{
+		v->brr_addr   = SAMPLE_PTR( 0 );
+		v->brr_offset = 1;
+		v->buf_pos    = v->buf;
+		brr_header    = 0; // header is ignored on this sample
+	}
 
-					int const* in = &v->buf_pos [(unsigned) v->interp_pos >> 12];
+	// Envelope is never run during KON
+	v->env        = 0;
+	v->hidden_env = 0;
 
-					if ( !(slow_gaussian & vbit) ) // 99%
-					{
-						// Faster approximation when exact sample value isn't necessary for pitch mod
-						output = (fwd [0] * in [0] +
-						          fwd [1] * in [1] +
-						          rev [1] * in [2] +
-						          rev [0] * in [3]) >> 11;
-						output = (output * env) >> 11;
-					}
-					else
-					{
-						output = (int16_t) (m.noise * 2);
-						if ( !(REG(non) & vbit) )
-						{
-							output  = (fwd [0] * in [0]) >> 11;
-							output += (fwd [1] * in [1]) >> 11;
-							output += (rev [1] * in [2]) >> 11;
-							output = (int16_t) output;
-							output += (rev [0] * in [3]) >> 11;
-
-							CLAMP16( output );
-							output &= ~1;
-						}
-						output = (output * env) >> 11 & ~1;
-					}
+	// Disable BRR decoding until last three samples
+	v->interp_pos = (kon_delay & 3 ? 0x4000 : 0);
 
-					// Output
-					int l = output * v->volume [0];
-					int r = output * v->volume [1];
+	return brr_header;
+}
 
-					main_out_l += l;
-					main_out_r += r;
+// Returns voice output for current sample, before volume is applied
+inline int Spc_Dsp::interpolate( voice_t const* const v, int const env, int const slow,
+		int const noise_voice, int const noise ) const
+{
+	// Make pointers into gaussian based on fractional position between samples
+	int offset = (unsigned) v->interp_pos >> 3 & 0x1FE;
+	short const* fwd = interleved_gauss       + offset;
+	short const* rev = interleved_gauss + 510 - offset; // mirror left half of gaussian
 
-					if ( REG(eon) & vbit )
-					{
-						echo_out_l += l;
-						echo_out_r += r;
-					}
-				}
+	int const* in = &v->buf_pos [(unsigned) v->interp_pos >> 12];
 
-				pmon_input = output;
-				VREG(v_regs,outx) = (uint8_t) (output >> 8);
-			}
+	int output;
+	if ( !slow ) // 99%
+	{
+		// Faster approximation when exact sample value isn't necessary for pitch mod
+		output = (fwd [0] * in [0] +
+		          fwd [1] * in [1] +
+		          rev [1] * in [2] +
+		          rev [0] * in [3]) >> 11;
+		output = (output * env) >> 11;
+	}
+	else
+	{
+		output = (int16_t) (noise * 2);
+		if ( !noise_voice )
+		{
+			output  = (fwd [0] * in [0]) >> 11;
+			output += (fwd [1] * in [1]) >> 11;
+			output += (rev [1] * in [2]) >> 11;
+			output = (int16_t) output;
+			output += (rev [0] * in [3]) >> 11;
+
+			CLAMP16( output );
+			output &= ~1;
+		}
+		output = (output * env) >> 11 & ~1;
+	}
+	return output;
+}
+
+// Counters are the values of m.counters for the current sample, and kon and
+// koff are the KON/KOFF events to act on this sample
+inline bool Spc_Dsp::run_envelope( voice_t* const v, uint8_t const* const v_regs, int const vbit,
+		int const brr_header, int env, unsigned const* counters, int kon, int koff )
+{
+	// Soft reset or end of sample
+	if ( REG(flg) & 0x80 || (brr_header & 3) == 1 )
+	{
+		v->env_mode = env_release;
+		env         = 0;
+	}
 
-			// Soft reset or end of sample
-			if ( REG(flg) & 0x80 || (brr_header & 3) == 1 )
+	// KOFF
+	if ( koff & vbit )
+		v->env_mode = env_release;
+
+	// KON
+	if ( kon & vbit )
+	{
+		v->kon_delay = 5;
+		v->env_mode  = env_attack;
+		REG(endx) &= ~vbit;
+	}
+
+	// Envelope
+	if ( !v->kon_delay )
+	{
+		if ( v->env_mode == env_release ) // 97%
+		{
+			env -= 0x8;
+			v->env = env;
+			if ( env <= 0 )
 			{
-				v->env_mode = env_release;
-				env         = 0;
+				v->env = 0;
+				return false; // no BRR decoding for you!
 			}
-
-			if ( m.every_other_sample )
+		}
+		else // 3%
+		{
+			int rate;
+			int const adsr0 = VREG(v_regs,adsr0);
+			int env_data = VREG(v_regs,adsr1);
+			if ( adsr0 >= 0x80 ) // 97% ADSR
 			{
-				// KOFF
-				if ( m.t_koff & vbit )
-					v->env_mode = env_release;
+				if ( v->env_mode > env_decay ) // 89%
+				{
+					env--;
+					env -= env >> 8;
+					rate = env_data & 0x1F;
 
-				// KON
-				if ( m.kon & vbit )
+					// optimized handling
+					v->hidden_env = env;
+					if ( !READ_COUNTER_AT( counters, rate ) )
+						v->env = env;
+					return true;
+				}
+				else if ( v->env_mode == env_decay )
 				{
-					v->kon_delay = 5;
-					v->env_mode  = env_attack;
-					REG(endx) &= ~vbit;
+					env--;
+					env -= env >> 8;
+					rate = (adsr0 >> 3 & 0x0E) + 0x10;
+				}
+				else // env_attack
+				{
+					rate = (adsr0 & 0x0F) * 2 + 1;
+					env += rate < 31 ? 0x20 : 0x400;
 				}
 			}
-
-			// Envelope
-			if ( !v->kon_delay )
+			else // GAIN
 			{
-				if ( v->env_mode == env_release ) // 97%
+				int mode;
+				env_data = VREG(v_regs,gain);
+				mode = env_data >> 5;
+				if ( mode < 4 ) // direct
 				{
-					env -= 0x8;
-					v->env = env;
-					if ( env <= 0 )
-					{
-						v->env = 0;
-						goto skip_brr; // no BRR decoding for you!
-					}
+					env = env_data * 0x10;
+					rate = 31;
 				}
-				else // 3%
+				else
 				{
-					int rate;
-					int const adsr0 = VREG(v_regs,adsr0);
-					int env_data = VREG(v_regs,adsr1);
-					if ( adsr0 >= 0x80 ) // 97% ADSR
+					rate = env_data & 0x1F;
+					if ( mode == 4 ) // 4: linear decrease
 					{
-						if ( v->env_mode > env_decay ) // 89%
-						{
-							env--;
-							env -= env >> 8;
-							rate = env_data & 0x1F;
-
-							// optimized handling
-							v->hidden_env = env;
-							if ( READ_COUNTER( rate ) )
-								goto exit_env;
-							v->env = env;
-							goto exit_env;
-						}
-						else if ( v->env_mode == env_decay )
-						{
-							env--;
-							env -= env >> 8;
-							rate = (adsr0 >> 3 & 0x0E) + 0x10;
-						}
-						else // env_attack
-						{
-							rate = (adsr0 & 0x0F) * 2 + 1;
-							env += rate < 31 ? 0x20 : 0x400;
-						}
+						env -= 0x20;
 					}
-					else // GAIN
+					else if ( mode < 6 ) // 5: exponential decrease
 					{
-						int mode;
-						env_data = VREG(v_regs,gain);
-						mode = env_data >> 5;
-						if ( mode < 4 ) // direct
-						{
-							env = env_data * 0x10;
-							rate = 31;
-						}
-						else
-						{
-							rate = env_data & 0x1F;
-							if ( mode == 4 ) // 4: linear decrease
-							{
-								env -= 0x20;
-							}
-							else if ( mode < 6 ) // 5: exponential decrease
-							{
-								env--;
-								env -= env >> 8;
-							}
-							else // 6,7: linear increase
-							{
-								env += 0x20;
-								if ( mode > 6 && (unsigned) v->hidden_env >= 0x600 )
-									env += 0x8 - 0x20; // 7: two-slope linear increase
-							}
-						}
+						env--;
+						env -= env >> 8;
 					}
+					else // 6,7: linear increase
+					{
+						env += 0x20;
+						if ( mode > 6 && (unsigned) v->hidden_env >= 0x600 )
+							env += 0x8 - 0x20; // 7: two-slope linear increase
+					}
+				}
+			}
 
-					// Sustain level
-					if ( (env >> 8) == (env_data >> 5) && v->env_mode == env_decay )
-						v->env_mode = env_sustain;
+			// Sustain level
+			if ( (env >> 8) == (env_data >> 5) && v->env_mode == env_decay )
+				v->env_mode = env_sustain;
 
-					v->hidden_env = env;
+			v->hidden_env = env;
 
-					// unsigned cast because linear decrease going negative also triggers this
-					if ( (unsigned) env > 0x7FF )
-					{
-						env = (env < 0 ? 0 : 0x7FF);
-						if ( v->env_mode == env_attack )
-							v->env_mode = env_decay;
-					}
+			// unsigned cast because linear decrease going negative also triggers this
+			if ( (unsigned) env > 0x7FF )
+			{
+				env = (env < 0 ? 0 : 0x7FF);
+				if ( v->env_mode == env_attack )
+					v->env_mode = env_decay;
+			}
 
-					if ( !READ_COUNTER( rate ) )
-						v->env = env; // nothing else is controlled by the counter
-				}
+			if ( !READ_COUNTER_AT( counters, rate ) )
+				v->env = env; // nothing else is controlled by the counter
+		}
+	}
+	return true;
+}
+
+// Decodes four samples from nybbles (in 0xABCD order) to pos, using previous
+// samples before pos for the filter
+static inline void decode_brr( int* pos, int nybbles, int brr_header )
+{
+	int const brr_buf_size = Spc_Dsp::brr_buf_size;
+
+	// 0: >>1  1: <<0  2: <<1 ... 12: <<11  13-15: >>4 <<11
+	static unsigned char const shifts [16 * 2] = {
+		13,12,12,12,12,12,12,12,12,12,12, 12, 12, 16, 16, 16,
+		 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 11, 11, 11
+	};
+	int const scale = brr_header >> 4;
+	int const right_shift = shifts [scale];
+	int const left_shift  = shifts [scale + 16];
+
+	// Decode four samples
+	for ( int* end = pos + 4; pos < end; pos++, nybbles <<= 4 )
+	{
+		// Extract upper nybble and scale appropriately. Every cast is
+		// necessary to maintain correctness and avoid undef behavior
+		int s = int16_t(uint16_t((int16_t) nybbles >> right_shift) << left_shift);
+
+		// Apply IIR filter (8 is the most commonly used)
+		int const filter = brr_header & 0x0C;
+		int const p1 = pos [brr_buf_size - 1];
+		int const p2 = pos [brr_buf_size - 2] >> 1;
+		if ( filter >= 8 )
+		{
+			s += p1;
+			s -= p2;
+			if ( filter == 8 ) // s += p1 * 0.953125 - p2 * 0.46875
+			{
+				s += p2 >> 4;
+				s += (p1 * -3) >> 6;
+			}
+			else // s += p1 * 0.8984375 - p2 * 0.40625
+			{
+				s += (p1 * -13) >> 7;
+				s += (p2 * 3) >> 4;
 			}
-		exit_env:
+		}
+		else if ( filter ) // s += p1 * 0.46875
+		{
+			s += p1 >> 1;
+			s += (-p1) >> 5;
+		}
+
+		// Adjust and write sample
+		CLAMP16( s );
+		s = (int16_t) (s * 2);
+		pos [brr_buf_size] = pos [0] = s; // second copy simplifies wrap-around
+	}
+}
+
+inline void Spc_Dsp::run_brr( voice_t* const v, uint8_t const* const dir,
+		uint8_t const* const v_regs, int const vbit, int const pitch, int const brr_header )
+{
+	// Apply pitch
+	int old_pos = v->interp_pos;
+	int interp_pos = (old_pos & 0x3FFF) + pitch;
+	if ( interp_pos > 0x7FFF )
+		interp_pos = 0x7FFF;
+	v->interp_pos = interp_pos;
+
+	// BRR decode if necessary
+	if ( old_pos < 0x4000 )
+		return;
+
+	uint8_t const* const ram = m.ram;
+	int const block_addr = v->brr_addr;
+	int const step = v->brr_offset >> 1; // which four samples of block
+
+	int const nybbles_addr = v->brr_addr + v->brr_offset;
+
+	// Advance read position
+	int const brr_block_size = 9;
+	int brr_offset = v->brr_offset;
+	if ( (brr_offset += 2) >= brr_block_size )
+	{
+		// Next BRR block
+		int brr_addr = (v->brr_addr + brr_block_size) & 0xFFFF;
+		assert( brr_offset == brr_block_size );
+		if ( brr_header & 1 )
+		{
+			brr_addr = SAMPLE_PTR( 1 );
+			if ( !v->kon_delay )
+				REG(endx) |= vbit;
+		}
+		v->brr_addr = brr_addr;
+		brr_offset  = 1;
+	}
+	v->brr_offset = brr_offset;
+
+	// Write to next four samples in circular buffer
+	int* pos = v->buf_pos;
+
+	if ( !step )
+		start_brr_block( v, block_addr, brr_header );
+
+	if ( v->brr_cache_state == brr_cached )
+	{
+		short const* in = &v->brr_block [step * 4];
+		for ( int i = 0; i < 4; i++ )
+			pos [brr_buf_size + i] = pos [i] = in [i];
+	}
+	else
+	{
+		// Arrange the four input nybbles in 0xABCD order for easy decoding
+		int nybbles = ram [nybbles_addr & 0xFFFF] * 0x100 +
+				ram [(nybbles_addr + 1) & 0xFFFF];
 
+		decode_brr( pos, nybbles, brr_header );
+
+		if ( v->brr_cache_state == brr_filling )
+		{
+			short* out = &v->brr_block [step * 4];
+			for ( int i = 0; i < 4; i++ )
+				out [i] = (short) pos [i];
+
+			if ( step == 3 )
+				add_brr_block( v, block_addr );
+		}
+	}
+	pos += 4;
+
+	if ( pos >= &v->buf [brr_buf_size] )
+		pos = v->buf;
+	v->buf_pos = pos;
+}
+
+void Spc_Dsp::init_mix( mix_t& mix ) const
+{
+	// Global volume
+	mix.mvoll = (int8_t) REG(mvoll);
+	mix.mvolr = (int8_t) REG(mvolr);
+	mix.evoll = (int8_t) REG(evoll);
+	mix.evolr = (int8_t) REG(evolr);
+
+	if ( !m.echo_enable)
+	{
+		mix.mvoll = 127;
+		mix.mvolr = 127;
+		mix.evoll = 0;
+		mix.evolr = 0;
+	}
+
+	if ( mix.mvoll * mix.mvolr < m.surround_threshold )
+		mix.mvoll = -mix.mvoll; // eliminate surround
+
+	mix.flg = REG(flg);
+	mix.efb = (int8_t) REG(efb);
+	for ( int i = 0; i < echo_hist_size; i++ )
+		mix.fir [i] = (int8_t) REG(fir + i * 0x10);
+
+	// FIR result only matters if it's heard or fed back into echo buffer
+	mix.fir_needed = mix.evoll | mix.evolr | (mix.flg & 0x20 ? 0 : mix.efb);
+}
+
+inline void Spc_Dsp::run_echo( mix_t const& mix, int main_out_l, int main_out_r,
+		int echo_out_l, int echo_out_r )
+{
+	// Echo position
+	int echo_offset = m.echo_offset;
+#ifdef SPC_ISOLATED_ECHO_BUFFER
+	// And here, we win no awards for accuracy, but gain playback of dodgy Super Mario World mod SPCs
+	uint8_t* const echo_ptr = &m.echo_ram [(REG(esa) * 0x100 + echo_offset) & 0xFFFF];
+#else
+	uint8_t* const echo_ptr = &m.ram [(REG(esa) * 0x100 + echo_offset) & 0xFFFF];
+#endif
+	if ( !echo_offset )
+		m.echo_length = (REG(edl) & 0x0F) * 0x800;
+	echo_offset += 4;
+	if ( echo_offset >= m.echo_length )
+		echo_offset = 0;
+	m.echo_offset = echo_offset;
+
+	// FIR
+	int echo_in_l = GET_LE16SA( echo_ptr + 0 );
+	int echo_in_r = GET_LE16SA( echo_ptr + 2 );
+
+	int (*echo_hist_pos) [2] = m.echo_hist_pos;
+	if ( ++echo_hist_pos >= &m.echo_hist [echo_hist_size] )
+		echo_hist_pos = m.echo_hist;
+	m.echo_hist_pos = echo_hist_pos;
+
+	echo_hist_pos [0] [0] = echo_hist_pos [8] [0] = echo_in_l;
+	echo_hist_pos [0] [1] = echo_hist_pos [8] [1] = echo_in_r;
+
+	if ( mix.fir_needed )
+	{
+		echo_in_l *= mix.fir [7];
+		echo_in_r *= mix.fir [7];
+		for ( int i = 0; i < echo_hist_size - 1; i++ )
+		{
+			echo_in_l += echo_hist_pos [i + 1] [0] * mix.fir [i];
+			echo_in_r += echo_hist_pos [i + 1] [1] * mix.fir [i];
+		}
+	}
+	else
+	{
+		echo_in_l = 0;
+		echo_in_r = 0;
+	}
+
+	// Echo out
+	if ( !(mix.flg & 0x20) )
+	{
+		int l = (echo_out_l >> 7) + ((echo_in_l * mix.efb) >> 14);
+		int r = (echo_out_r >> 7) + ((echo_in_r * mix.efb) >> 14);
+
+		// just to help pass more validation tests
+		#if SPC_MORE_ACCURACY
+			l &= ~1;
+			r &= ~1;
+		#endif
+
+		CLAMP16( l );
+		CLAMP16( r );
+
+		SET_LE16A( echo_ptr + 0, l );
+		SET_LE16A( echo_ptr + 2, r );
+	#ifndef SPC_ISOLATED_ECHO_BUFFER
+		ram_written( echo_ptr - m.ram );
+	#endif
+	}
+
+	// Sound out
+	int l = (main_out_l * mix.mvoll + echo_in_l * mix.evoll) >> 14;
+	int r = (main_out_r * mix.mvolr + echo_in_r * mix.evolr) >> 14;
+
+	CLAMP16( l );
+	CLAMP16( r );
+
+	if ( (mix.flg & 0x40) )
+	{
+		l = 0;
+		r = 0;
+	}
+
+	sample_t* out = m.out;
+	WRITE_SAMPLES( l, r, out );
+	m.out = out;
+}
+
+// Writes one voice's part of main output, before it's summed with other voices
+inline void Spc_Dsp::write_voice_out( mix_t const& mix, sample_t* out, int l, int r )
+{
+	l = (l * mix.mvoll) >> 14;
+	r = (r * mix.mvolr) >> 14;
+
+	CLAMP16( l );
+	CLAMP16( r );
+
+	if ( mix.flg & 0x40 )
+	{
+		l = 0;
+		r = 0;
+	}
+
+	out [0] = (sample_t) l;
+	out [1] = (sample_t) r;
+}
+
+void Spc_Dsp::run( int clock_count )
+{
+	GME_STAT_TIME( apu_time );
+	int new_phase = m.phase + clock_count;
+	int count = new_phase >> 5;
+	m.phase = new_phase & 31;
+	if ( !count )
+		return;
+
+	if ( m.fast_mode )
+	{
+		run_fast( count );
+		return;
+	}
+
+	uint8_t* const ram = m.ram;
+	uint8_t const* const dir = &ram [REG(dir) * 0x100];
+	int const slow_gaussian = (REG(pmon) >> 1) | REG(non);
+	int const noise_rate = REG(flg) & 0x1F;
+
+	// Muted voices are only interpolated when needed for pitch modulation
+	int const audible = ~m.mute_mask | (REG(pmon) >> 1);
+
+	mix_t mix;
+	init_mix( mix );
+
+	do
+	{
+		run_globals( noise_rate );
+
+		int kon  = 0;
+		int koff = 0;
+		if ( m.every_other_sample )
+		{
+			kon  = m.kon;
+			koff = m.t_koff;
+		}
+
+		// Separate voice output
+		sample_t* voice_out = 0;
+		if ( m.voice_out < m.voice_out_end )
+		{
+			voice_out = m.voice_out;
+			memset( voice_out, 0, voice_count * 2 * sizeof *voice_out );
+			m.voice_out = voice_out + voice_count * 2;
+		}
+
+		// Voices
+		int pmon_input = 0;
+		int main_out_l = 0;
+		int main_out_r = 0;
+		int echo_out_l = 0;
+		int echo_out_r = 0;
+		voice_t* v = m.voices;
+		uint8_t* v_regs = m.regs;
+		int vbit = 1;
+		do
+		{
+			// Released voice that has reached silence does nothing until KON
+			if ( !(v->env | v->kon_delay) && v->env_mode == env_release && !(kon & vbit) )
 			{
-				// Apply pitch
-				int old_pos = v->interp_pos;
-				int interp_pos = (old_pos & 0x3FFF) + pitch;
-				if ( interp_pos > 0x7FFF )
-					interp_pos = 0x7FFF;
-				v->interp_pos = interp_pos;
-
-				// BRR decode if necessary
-				if ( old_pos >= 0x4000 )
-				{
-					// Arrange the four input nybbles in 0xABCD order for easy decoding
-					int nybbles = ram [(v->brr_addr + v->brr_offset) & 0xFFFF] * 0x100 +
-							ram [(v->brr_addr + v->brr_offset + 1) & 0xFFFF];
-
-					// Advance read position
-					int const brr_block_size = 9;
-					int brr_offset = v->brr_offset;
-					if ( (brr_offset += 2) >= brr_block_size )
-					{
-						// Next BRR block
-						int brr_addr = (v->brr_addr + brr_block_size) & 0xFFFF;
-						assert( brr_offset == brr_block_size );
-						if ( brr_header & 1 )
-						{
-							brr_addr = SAMPLE_PTR( 1 );
-							if ( !v->kon_delay )
-								REG(endx) |= vbit;
-						}
-						v->brr_addr = brr_addr;
-						brr_offset  = 1;
-					}
-					v->brr_offset = brr_offset;
+				VREG(v_regs,envx) = 0;
+				VREG(v_regs,outx) = 0;
+				pmon_input = 0;
+			}
+			else
+			{
+				int brr_header = ram [v->brr_addr];
 
-					// Decode
+				// Pitch
+				int pitch = GET_LE16A( &VREG(v_regs,pitchl) ) & 0x3FFF;
+				if ( REG(pmon) & vbit )
+					pitch += ((pmon_input >> 5) * pitch) >> 10;
 
-					// 0: >>1  1: <<0  2: <<1 ... 12: <<11  13-15: >>4 <<11
-					static unsigned char const shifts [16 * 2] = {
-						13,12,12,12,12,12,12,12,12,12,12, 12, 12, 16, 16, 16,
-						 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 11, 11, 11
-					};
-					int const scale = brr_header >> 4;
-					int const right_shift = shifts [scale];
-					int const left_shift  = shifts [scale + 16];
+				// KON phases
+				if ( v->kon_delay )
+				{
+					brr_header = run_kon_phase( v, dir, v_regs, brr_header );
 
-					// Write to next four samples in circular buffer
-					int* pos = v->buf_pos;
-					int* end;
+					// Pitch is never added during KON
+					pitch = 0;
+				}
 
-					// Decode four samples
-					for ( end = pos + 4; pos < end; pos++, nybbles <<= 4 )
+				int env = v->env;
+
+				// Gaussian interpolation
+				{
+					int output = 0;
+					VREG(v_regs,envx) = (uint8_t) (env >> 4);
+					if ( env && (audible & vbit) )
 					{
-						// Extract upper nybble and scale appropriately. Every cast is
-						// necessary to maintain correctness and avoid undef behavior
-						int s = int16_t(uint16_t((int16_t) nybbles >> right_shift) << left_shift);
-
-						// Apply IIR filter (8 is the most commonly used)
-						int const filter = brr_header & 0x0C;
-						int const p1 = pos [brr_buf_size - 1];
-						int const p2 = pos [brr_buf_size - 2] >> 1;
-						if ( filter >= 8 )
-						{
-							s += p1;
-							s -= p2;
-							if ( filter == 8 ) // s += p1 * 0.953125 - p2 * 0.46875
-							{
-								s += p2 >> 4;
-								s += (p1 * -3) >> 6;
-							}
-							else // s += p1 * 0.8984375 - p2 * 0.40625
-							{
-								s += (p1 * -13) >> 7;
-								s += (p2 * 3) >> 4;
-							}
-						}
-						else if ( filter ) // s += p1 * 0.46875
+						output = interpolate( v, env, slow_gaussian & vbit, REG(non) & vbit, m.noise );
+
+						// Output
+						int l = output * v->volume [0];
+						int r = output * v->volume [1];
+
+						main_out_l += l;
+						main_out_r += r;
+
+						if ( REG(eon) & vbit )
 						{
-							s += p1 >> 1;
-							s += (-p1) >> 5;
+							echo_out_l += l;
+							echo_out_r += r;
 						}
 
-						// Adjust and write sample
-						CLAMP16( s );
-						s = (int16_t) (s * 2);
-						pos [brr_buf_size] = pos [0] = s; // second copy simplifies wrap-around
+						if ( voice_out )
+							write_voice_out( mix, &voice_out [(v - m.voices) * 2], l, r );
 					}
 
-					if ( pos >= &v->buf [brr_buf_size] )
-						pos = v->buf;
-					v->buf_pos = pos;
+					pmon_input = output;
+					VREG(v_regs,outx) = (uint8_t) (output >> 8);
 				}
+
+				if ( run_envelope( v, v_regs, vbit, brr_header, env, m.counters, kon, koff ) )
+					run_brr( v, dir, v_regs, vbit, pitch, brr_header );
 			}
-skip_brr:
+
 			// Next voice
 			vbit <<= 1;
 			v_regs += 0x10;
@@ -560,91 +887,196 @@ skip_brr:
 		}
 		while ( vbit < 0x100 );
 
-		// Echo position
-		int echo_offset = m.echo_offset;
-#ifdef SPC_ISOLATED_ECHO_BUFFER
-		// And here, we win no awards for accuracy, but gain playback of dodgy Super Mario World mod SPCs
-		uint8_t* const echo_ptr = &echo_ram [(REG(esa) * 0x100 + echo_offset) & 0xFFFF];
-#else
-		uint8_t* const echo_ptr = &ram [(REG(esa) * 0x100 + echo_offset) & 0xFFFF];
-#endif
-		if ( !echo_offset )
-			m.echo_length = (REG(edl) & 0x0F) * 0x800;
-		echo_offset += 4;
-		if ( echo_offset >= m.echo_length )
-			echo_offset = 0;
-		m.echo_offset = echo_offset;
-
-		// FIR
-		int echo_in_l = GET_LE16SA( echo_ptr + 0 );
-		int echo_in_r = GET_LE16SA( echo_ptr + 2 );
-
-		int (*echo_hist_pos) [2] = m.echo_hist_pos;
-		if ( ++echo_hist_pos >= &m.echo_hist [echo_hist_size] )
-			echo_hist_pos = m.echo_hist;
-		m.echo_hist_pos = echo_hist_pos;
-
-		echo_hist_pos [0] [0] = echo_hist_pos [8] [0] = echo_in_l;
-		echo_hist_pos [0] [1] = echo_hist_pos [8] [1] = echo_in_r;
-
-		#define CALC_FIR_( i, in )  ((in) * (int8_t) REG(fir + i * 0x10))
-		echo_in_l = CALC_FIR_( 7, echo_in_l );
-		echo_in_r = CALC_FIR_( 7, echo_in_r );
-
-		#define CALC_FIR( i, ch )   CALC_FIR_( i, echo_hist_pos [i + 1] [ch] )
-		#define DO_FIR( i )\
-			echo_in_l += CALC_FIR( i, 0 );\
-			echo_in_r += CALC_FIR( i, 1 );
-		DO_FIR( 0 );
-		DO_FIR( 1 );
-		DO_FIR( 2 );
-		#if defined (__MWERKS__) && __MWERKS__ < 0x3200
-			__eieio(); // keeps compiler from stupidly "caching" things in memory
-		#endif
-		DO_FIR( 3 );
-		DO_FIR( 4 );
-		DO_FIR( 5 );
-		DO_FIR( 6 );
+		run_echo( mix, main_out_l, main_out_r, echo_out_l, echo_out_r );
+	}
+	while ( --count );
+}
 
-		// Echo out
-		if ( !(REG(flg) & 0x20) )
-		{
-			int l = (echo_out_l >> 7) + ((echo_in_l * (int8_t) REG(efb)) >> 14);
-			int r = (echo_out_r >> 7) + ((echo_in_r * (int8_t) REG(efb)) >> 14);
+// Fast mode runs each voice for a block of samples before moving on to the
+// next voice, rather than all voices for each sample. This keeps a voice's
+// state in registers and lets voices that are released and silent be
+// skipped for the whole block. Counters, noise and KON/KOFF are run for the
+// block first, and voices are run in order so pitch modulation still sees
+// the previous voice's output for the same sample. Each voice's output for
+// the block is then mixed in with a separate pass. Output matches run()
+// except for these rarely heard quirks:
+//
+// - The echo buffer is written after the block's voices have run, so BRR
+//   data or sample directory entries overwritten by the echo buffer are
+//   read up to fast_block_size samples (2 msec) late.
+//
+// - ENVX and OUTX are only updated at the end of run_fast(). The SMP can't
+//   read them before then, so this only matters to code that inspects the
+//   registers directly.
+enum { fast_block_size = 64 };
+
+void Spc_Dsp::run_fast( int count )
+{
+	GME_STAT_TIME( apu_time );
+	uint8_t const* const ram = m.ram;
+	uint8_t const* const dir = &ram [REG(dir) * 0x100];
+	int const slow_gaussian = (REG(pmon) >> 1) | REG(non);
+	int const noise_rate = REG(flg) & 0x1F;
+	int const audible = ~m.mute_mask | (REG(pmon) >> 1);
 
-			// just to help pass more validation tests
-			#if SPC_MORE_ACCURACY
-				l &= ~1;
-				r &= ~1;
-			#endif
+	mix_t mix;
+	init_mix( mix );
 
-			CLAMP16( l );
-			CLAMP16( r );
+	int last_env [voice_count];
+	int last_out [voice_count];
 
-			SET_LE16A( echo_ptr + 0, l );
-			SET_LE16A( echo_ptr + 2, r );
+	do
+	{
+		int const n = (count < fast_block_size ? count : (int) fast_block_size);
+		count -= n;
+
+		// Global state for each sample of block
+		unsigned counters [fast_block_size] [4];
+		int noise [fast_block_size];
+		int kon   [fast_block_size];
+		int koff  [fast_block_size];
+		int block_kon = 0;
+		for ( int s = 0; s < n; s++ )
+		{
+			run_globals( noise_rate );
+			memcpy( counters [s], m.counters, sizeof m.counters );
+			noise [s] = m.noise;
+			kon   [s] = 0;
+			koff  [s] = 0;
+			if ( m.every_other_sample )
+			{
+				kon  [s] = m.kon;
+				koff [s] = m.t_koff;
+				block_kon |= m.kon;
+			}
 		}
 
-		// Sound out
-		int l = (main_out_l * mvoll + echo_in_l * evoll) >> 14;
-		int r = (main_out_r * mvolr + echo_in_r * evolr) >> 14;
+		// Separate voice output, for as many samples as fit
+		sample_t* const block_voice_out = m.voice_out;
+		int voice_out_count = 0;
+		if ( block_voice_out < m.voice_out_end )
+		{
+			voice_out_count = (m.voice_out_end - block_voice_out) / (voice_count * 2);
+			if ( voice_out_count > n )
+				voice_out_count = n;
+			memset( block_voice_out, 0, voice_out_count * voice_count * 2 * sizeof *block_voice_out );
+			m.voice_out = block_voice_out + voice_out_count * voice_count * 2;
+		}
 
-		CLAMP16( l );
-		CLAMP16( r );
+		int main_out_l [fast_block_size];
+		int main_out_r [fast_block_size];
+		int echo_out_l [fast_block_size];
+		int echo_out_r [fast_block_size];
+		memset( main_out_l, 0, n * sizeof main_out_l [0] );
+		memset( main_out_r, 0, n * sizeof main_out_r [0] );
+		memset( echo_out_l, 0, n * sizeof echo_out_l [0] );
+		memset( echo_out_r, 0, n * sizeof echo_out_r [0] );
+
+		// Output of previous voice is kept for pitch modulation
+		int voice_out [2] [fast_block_size];
+		int* prev_out = voice_out [0];
+		int* out      = voice_out [1];
+		bool prev_silent = true;
 
-		if ( (REG(flg) & 0x40) )
+		voice_t* v = m.voices;
+		uint8_t* v_regs = m.regs;
+		for ( int i = 0; i < voice_count; i++, v++, v_regs += 0x10 )
 		{
-			l = 0;
-			r = 0;
+			int const vbit = 1 << i;
+
+			// Released voice that has reached silence does nothing until KON
+			if ( !(v->env | v->kon_delay) && v->env_mode == env_release && !(block_kon & vbit) )
+			{
+				last_env [i] = 0;
+				last_out [i] = 0;
+				prev_silent = true;
+				continue;
+			}
+
+			int const pitch    = GET_LE16A( &VREG(v_regs,pitchl) ) & 0x3FFF;
+			bool const pmon    = (REG(pmon) & vbit) && !prev_silent;
+			bool const heard   = (audible & vbit) != 0;
+			int const slow     = slow_gaussian & vbit;
+			int const non      = REG(non) & vbit;
+			int const echo_on  = REG(eon) & vbit;
+			int const volume_l = v->volume [0];
+			int const volume_r = v->volume [1];
+
+			int env    = 0;
+			int output = 0;
+			for ( int s = 0; s < n; s++ )
+			{
+				int brr_header = ram [v->brr_addr];
+
+				int voice_pitch = pitch;
+				if ( pmon )
+					voice_pitch += ((prev_out [s] >> 5) * pitch) >> 10;
+
+				// KON phases
+				if ( v->kon_delay )
+				{
+					brr_header = run_kon_phase( v, dir, v_regs, brr_header );
+					voice_pitch = 0;
+				}
+
+				env    = v->env;
+				output = 0;
+				if ( env && heard )
+					output = interpolate( v, env, slow, non, noise [s] );
+				out [s] = output;
+
+				if ( run_envelope( v, v_regs, vbit, brr_header, env, counters [s], kon [s], koff [s] ) )
+					run_brr( v, dir, v_regs, vbit, voice_pitch, brr_header );
+			}
+
+			last_env [i] = env;
+			last_out [i] = output;
+
+			// Mix voice into block once it's all been run. Silent samples add
+			// nothing, so these are kept simple for compiler to vectorize.
+			if ( heard )
+			{
+				for ( int s = 0; s < n; s++ )
+				{
+					main_out_l [s] += out [s] * volume_l;
+					main_out_r [s] += out [s] * volume_r;
+				}
+
+				if ( echo_on )
+				{
+					for ( int s = 0; s < n; s++ )
+					{
+						echo_out_l [s] += out [s] * volume_l;
+						echo_out_r [s] += out [s] * volume_r;
+					}
+				}
+
+				for ( int s = 0; s < voice_out_count; s++ )
+					write_voice_out( mix, &block_voice_out [(s * voice_count + i) * 2],
+							out [s] * volume_l, out [s] * volume_r );
+			}
+
+			int* temp = prev_out;
+			prev_out = out;
+			out = temp;
+			prev_silent = false;
 		}
 
-		sample_t* out = m.out;
-		WRITE_SAMPLES( l, r, out );
-		m.out = out;
+		for ( int s = 0; s < n; s++ )
+			run_echo( mix, main_out_l [s], main_out_r [s], echo_out_l [s], echo_out_r [s] );
+	}
+	while ( count );
+
+	for ( int i = 0; i < voice_count; i++ )
+	{
+		uint8_t* const v_regs = &m.regs [i * 0x10];
+		VREG(v_regs,envx) = (uint8_t) (last_env [i] >> 4);
+		VREG(v_regs,outx) = (uint8_t) (last_out [i] >> 8);
 	}
-	while ( --count );
 }
 
+#undef SAMPLE_PTR
+
 
 //// Setup
 
@@ -663,6 +1095,25 @@ Spc_Dsp::Spc_Dsp()
 	memset(&m, 0, sizeof(state_t));
 }
 
+void Spc_Dsp::copy_state( Spc_Dsp const& in, void const* in_base, void* base, size_t size )
+{
+	m = in.m;
+	#define REBASE( p ) (m.p = blargg_rebase( in.m.p, in_base, base, size ))
+	REBASE( echo_hist_pos );
+	for ( int i = 0; i < voice_count; i++ )
+		REBASE( voices [i].buf_pos );
+	for ( int i = 0; i < 32; i++ )
+		REBASE( counter_select [i] );
+	REBASE( ram );
+	REBASE( out );
+	REBASE( out_end );
+	REBASE( out_begin );
+	REBASE( voice_out );
+	REBASE( voice_out_end );
+	REBASE( voice_out_begin );
+	#undef REBASE
+}
+
 void Spc_Dsp::init( void* ram_64k )
 {
 	m.ram = (uint8_t*) ram_64k;
@@ -670,6 +1121,7 @@ void Spc_Dsp::init( void* ram_64k )
 	disable_surround( false );
 	disable_echo( false );
 	set_output( 0, 0 );
+	set_voice_output( 0, 0 );
 	reset();
 
 	// be sure this sign-extends
@@ -722,6 +1174,7 @@ void Spc_Dsp::load( uint8_t const regs [register_count] )
 	}
 	m.new_kon = REG(kon);
 
+	clear_brr_cache();
 	mute_voices( m.mute_mask );
 	soft_reset_common();
 }
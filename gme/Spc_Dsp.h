@@ -24,6 +24,15 @@ public:
 	// output buffer could hold.
 	int sample_count() const;
 
+	// Sets destination for separate output of each voice, or disables it if out
+	// is NULL. Each sample holds voice_count stereo pairs, with main volume
+	// applied but no echo. Samples that don't fit in out_size are discarded.
+	void set_voice_output( sample_t* out, int out_size );
+
+	// Number of values written to voice output since it was last set, always
+	// a multiple of voice_count * 2
+	int voice_sample_count() const;
+
 // Emulation
 
 	// Resets DSP to power-on state
@@ -44,7 +53,9 @@ public:
 // Sound control
 
 	// Mutes voices corresponding to non-zero bits in mask (overrides VxVOL with 0).
-	// Reduces emulation accuracy.
+	// Muted voices skip interpolation and mixing unless the next voice uses them
+	// for pitch modulation, so their OUTX reads back as 0. Envelope and BRR
+	// decoding still run, so unmuting resumes exactly where the voice would be.
 	enum { voice_count = 8 };
 	void mute_voices( int mask );
 
@@ -53,12 +64,29 @@ public:
 
 	void disable_echo( bool disable = true );
 
+	// If true, runs each voice for a block of samples at a time, which is
+	// faster but drops a few rarely heard timing quirks (listed above
+	// run_fast() in Spc_Dsp.cpp).
+	void enable_fast_mode( bool enable = true );
+
+// RAM
+
+	// Tells DSP that RAM at addr was modified by something other than the DSP,
+	// so it can discard any BRR samples it decoded from there. Must be called
+	// for every such write, or output will use stale samples.
+	void ram_written( int addr );
+	void ram_written( int addr, int size );
+
 // State
 
 	// Resets DSP and uses supplied values to initialize registers
 	enum { register_count = 128 };
 	void load( uint8_t const regs [register_count] );
 
+	// Copies all state of other DSP. Pointers into the size bytes at other_base,
+	// such as its RAM, are moved to the same offset from base.
+	void copy_state( Spc_Dsp const& other, void const* other_base, void* base, size_t size );
+
 // DSP register addresses
 
 	// Global registers
@@ -107,6 +135,21 @@ public:
 		int hidden_env;         // used by GAIN mode 7, very obscure quirk
 		int volume [2];         // copy of volume from DSP registers, with surround disabled
 		int enabled;            // -1 if enabled, 0 if muted
+		int brr_cache_state;    // where samples of current BRR block come from
+		int brr_key [2];        // previous two samples when current block started
+		short brr_block [16];   // decoded samples of current BRR block
+	};
+
+	// Decoded BRR blocks are cached, keyed by address and the two previous
+	// samples that the block's filter depends on
+	enum { brr_cache_size = 256 };
+	enum { brr_granule_bits = 4 }; // granularity of RAM write tracking
+	enum brr_cache_state_t { brr_uncached, brr_cached, brr_filling };
+	struct brr_block_t
+	{
+		int addr;               // -1 if unused
+		int key [2];
+		short samples [16];
 	};
 private:
 	struct state_t
@@ -142,15 +185,48 @@ private:
 		int mute_mask;
 		int surround_threshold;
 		int echo_enable;
+		int fast_mode;
 		sample_t* out;
 		sample_t* out_end;
 		sample_t* out_begin;
 		sample_t extra [extra_size];
+		sample_t* voice_out;
+		sample_t* voice_out_end;
+		sample_t* voice_out_begin;
+
+		brr_block_t brr_cache [brr_cache_size];
+		uint8_t brr_map [0x10000 >> brr_granule_bits]; // non-zero where RAM has cached samples
 	};
 	state_t m;
 
+	// Global registers that can only change between calls to run()
+	struct mix_t
+	{
+		int mvoll, mvolr;
+		int evoll, evolr;
+		int efb;
+		int flg;
+		int fir [echo_hist_size];
+		int fir_needed;
+	};
+
 	void init_counter();
 	void run_counter( int );
+	void run_globals( int noise_rate );
+	int  run_kon_phase( voice_t*, uint8_t const* dir, uint8_t const* v_regs, int brr_header );
+	int  interpolate( voice_t const*, int env, int slow, int noise_voice, int noise ) const;
+	bool run_envelope( voice_t*, uint8_t const* v_regs, int vbit, int brr_header, int env,
+			unsigned const* counters, int kon, int koff );
+	void run_brr( voice_t*, uint8_t const* dir, uint8_t const* v_regs, int vbit, int pitch, int brr_header );
+	void init_mix( mix_t& ) const;
+	void run_echo( mix_t const&, int main_out_l, int main_out_r, int echo_out_l, int echo_out_r );
+	static void write_voice_out( mix_t const&, sample_t* out, int l, int r );
+	void run_fast( int count );
+	void mark_brr_block( int addr );
+	void start_brr_block( voice_t*, int addr, int brr_header );
+	void add_brr_block( voice_t const*, int addr );
+	void invalidate_brr( int granule );
+	void clear_brr_cache();
 	void soft_reset_common();
 	void write_outline( int addr, int data );
 	void update_voice_vol( int addr );
@@ -160,6 +236,8 @@ private:
 
 inline int Spc_Dsp::sample_count() const { return m.out - m.out_begin; }
 
+inline int Spc_Dsp::voice_sample_count() const { return m.voice_out - m.voice_out_begin; }
+
 inline int Spc_Dsp::read( int addr ) const
 {
 	assert( (unsigned) addr < register_count );
@@ -214,6 +292,19 @@ inline void Spc_Dsp::disable_echo( bool disable )
 	m.echo_enable = !disable;
 }
 
+inline void Spc_Dsp::ram_written( int addr )
+{
+	assert( (unsigned) addr < 0x10000 );
+	int const granule = addr >> brr_granule_bits;
+	if ( m.brr_map [granule] )
+		invalidate_brr( granule );
+}
+
+inline void Spc_Dsp::enable_fast_mode( bool enable )
+{
+	m.fast_mode = enable;
+}
+
 #define SPC_NO_COPY_STATE_FUNCS 1
 
 #define SPC_LESS_ACCURATE 1
@@ -35,6 +35,8 @@ Spc_Emu::Spc_Emu()
 	set_voice_names( names );
 
 	set_gain( 1.4 );
+	set_native_rate( native_sample_rate );
+	voice_buf_count = 0;
 }
 
 Spc_Emu::~Spc_Emu() { }
@@ -48,8 +50,22 @@ byte const* Spc_Emu::trailer() const { return &file_data [min( file_size, spc_si
 
 long Spc_Emu::trailer_size() const { return max( 0L, file_size - spc_size ); }
 
-static void get_spc_xid6( byte const* begin, long size, track_info_t* out )
+// Fields found in xid6 info, pointing into it
+struct spc_xid6_t
+{
+	gme_str_t song;
+	gme_str_t game;
+	gme_str_t author;
+	gme_str_t dumper;
+	gme_str_t comment;
+	gme_str_t copyright;
+	int year;
+};
+
+static void parse_spc_xid6( byte const* begin, long size, spc_xid6_t* out )
 {
+	memset( out, 0, sizeof *out );
+
 	// header
 	byte const* end = begin + size;
 	if ( size < 8 || memcmp( begin, "xid6", 4 ) )
@@ -65,11 +81,6 @@ static void get_spc_xid6( byte const* begin, long size, track_info_t* out )
 		end = in + info_size;
 	}
 
-	int year = 0;
-	char copyright [256 + 5];
-	int copyright_len = 0;
-	int const year_len = 5;
-
 	while ( end - in >= 4 )
 	{
 		// header
@@ -85,15 +96,15 @@ static void get_spc_xid6( byte const* begin, long size, track_info_t* out )
 		}
 
 		// handle specific block types
-		char* field = 0;
+		gme_str_t* field = 0;
 		switch ( id )
 		{
-			case 0x01: field = out->song;    break;
-			case 0x02: field = out->game;    break;
-			case 0x03: field = out->author;  break;
-			case 0x04: field = out->dumper;  break;
-			case 0x07: field = out->comment; break;
-			case 0x14: year = data;          break;
+			case 0x01: field = &out->song;    break;
+			case 0x02: field = &out->game;    break;
+			case 0x03: field = &out->author;  break;
+			case 0x04: field = &out->dumper;  break;
+			case 0x07: field = &out->comment; break;
+			case 0x14: out->year = data;      break;
 
 			//case 0x30: // intro length
 			// Many SPCs have intro length set wrong for looped tracks, making it useless
@@ -114,8 +125,8 @@ static void get_spc_xid6( byte const* begin, long size, track_info_t* out )
 			*/
 
 			case 0x13:
-				copyright_len = min( len, (int) sizeof copyright - year_len );
-				memcpy( &copyright [year_len], in, copyright_len );
+				out->copyright.str = (char const*) in;
+				out->copyright.len = min( len, 256 );
 				break;
 
 			default:
@@ -127,7 +138,11 @@ static void get_spc_xid6( byte const* begin, long size, track_info_t* out )
 		if ( field )
 		{
 			check( type == 1 );
-			Gme_File::copy_field_( field, (char const*) in, len );
+			if ( len && *in ) // empty field doesn't replace earlier one
+			{
+				field->str = (char const*) in;
+				field->len = len;
+			}
 		}
 
 		// skip to next block
@@ -147,25 +162,50 @@ static void get_spc_xid6( byte const* begin, long size, track_info_t* out )
 		}
 	}
 
-	char* p = &copyright [year_len];
-	if ( year )
+	check( in == end );
+}
+
+int const spc_year_len = 5;
+
+// Writes year, if any, followed by copyright to out, which must have room for
+// copyright.len + spc_year_len characters. Returns length written.
+static int get_spc_copyright( spc_xid6_t const& xid6, char* out )
+{
+	char* p = out;
+	if ( xid6.year )
 	{
-		*--p = ' ';
+		int year = xid6.year;
 		for ( int n = 4; n--; )
 		{
-			*--p = char (year % 10 + '0');
+			p [n] = char (year % 10 + '0');
 			year /= 10;
 		}
-		copyright_len += year_len;
+		p [4] = ' ';
+		p += spc_year_len;
 	}
-	if ( copyright_len )
-		Gme_File::copy_field_( out->copyright, p, copyright_len );
+	if ( xid6.copyright.len )
+		memcpy( p, xid6.copyright.str, xid6.copyright.len );
+	return (p - out) + xid6.copyright.len;
+}
 
-	check( in == end );
+static void get_spc_xid6( byte const* begin, long size, track_info_t* out )
+{
+	spc_xid6_t xid6;
+	parse_spc_xid6( begin, size, &xid6 );
+	Gme_File::copy_field_( out->song,    xid6.song.str,    xid6.song.len );
+	Gme_File::copy_field_( out->game,    xid6.game.str,    xid6.game.len );
+	Gme_File::copy_field_( out->author,  xid6.author.str,  xid6.author.len );
+	Gme_File::copy_field_( out->dumper,  xid6.dumper.str,  xid6.dumper.len );
+	Gme_File::copy_field_( out->comment, xid6.comment.str, xid6.comment.len );
+
+	char copyright [256 + spc_year_len];
+	int copyright_len = get_spc_copyright( xid6, copyright );
+	if ( copyright_len )
+		Gme_File::copy_field_( out->copyright, copyright, copyright_len );
 }
 
-static void get_spc_info( Spc_Emu::header_t const& h, byte const* xid6, long xid6_size,
-		track_info_t* out )
+// Length in msec, or -1 if unknown
+static long get_spc_length( Spc_Emu::header_t const& h )
 {
 	// decode length (can be in text or binary format, sometimes ambiguous ugh)
 	long len_secs = 0;
@@ -186,9 +226,24 @@ static void get_spc_info( Spc_Emu::header_t const& h, byte const* xid6, long xid
 	if ( !len_secs || len_secs > 0x1FFF )
 		len_secs = get_le16( h.len_secs );
 	if ( len_secs < 0x1FFF )
-		out->length = len_secs * 1000;
+		return len_secs * 1000;
+	return -1;
+}
 
-	int offset = (h.author [0] < ' ' || unsigned (h.author [0] - '0') <= 9);
+// Offset of author in its field, which is sometimes shifted by a byte
+static int spc_author_offset( Spc_Emu::header_t const& h )
+{
+	return (h.author [0] < ' ' || unsigned (h.author [0] - '0') <= 9);
+}
+
+static void get_spc_info( Spc_Emu::header_t const& h, byte const* xid6, long xid6_size,
+		track_info_t* out )
+{
+	long length = get_spc_length( h );
+	if ( length >= 0 )
+		out->length = length;
+
+	int offset = spc_author_offset( h );
 	Gme_File::copy_field_( out->author, &h.author [offset], sizeof h.author - offset );
 
 	GME_COPY_FIELD( h, out, song );
@@ -244,10 +299,46 @@ struct Spc_File : Gme_Info_
 	}
 };
 
+static blargg_err_t probe_spc( Gme_Probe& out, byte const* in, long size )
+{
+	if ( size < Snes_Spc::spc_min_file_size )
+		return gme_wrong_file_type;
+
+	Spc_Emu::header_t const& h = *(Spc_Emu::header_t const*) in;
+	RETURN_ERR( check_spc_header( h.tag ) );
+
+	out.info.length = get_spc_length( h );
+
+	int offset = spc_author_offset( h );
+	out.set_field( &out.info.author, &h.author [offset], sizeof h.author - offset );
+
+	GME_PROBE_FIELD( h, out, song );
+	GME_PROBE_FIELD( h, out, game );
+	GME_PROBE_FIELD( h, out, dumper );
+	GME_PROBE_FIELD( h, out, comment );
+
+	if ( size > spc_size )
+	{
+		spc_xid6_t xid6;
+		parse_spc_xid6( in + spc_size, size - spc_size, &xid6 );
+		out.set_field( &out.info.song,    xid6.song.str,    xid6.song.len );
+		out.set_field( &out.info.game,    xid6.game.str,    xid6.game.len );
+		out.set_field( &out.info.author,  xid6.author.str,  xid6.author.len );
+		out.set_field( &out.info.dumper,  xid6.dumper.str,  xid6.dumper.len );
+		out.set_field( &out.info.comment, xid6.comment.str, xid6.comment.len );
+
+		char* copyright = out.field_buf( xid6.copyright.len + spc_year_len );
+		if ( copyright )
+			out.set_field( &out.info.copyright, copyright, get_spc_copyright( xid6, copyright ) );
+	}
+	out.report_all();
+	return 0;
+}
+
 static Music_Emu* new_spc_emu () { return BLARGG_NEW Spc_Emu ; }
 static Music_Emu* new_spc_file() { return BLARGG_NEW Spc_File; }
 
-static gme_type_t_ const gme_spc_type_ = { "Super Nintendo", 1, &new_spc_emu, &new_spc_file, "SPC", 0 };
+static gme_type_t_ const gme_spc_type_ = { "Super Nintendo", 1, &new_spc_emu, &new_spc_file, "SPC", 0, &probe_spc };
 extern gme_type_t const gme_spc_type = &gme_spc_type_;
 
 
@@ -255,20 +346,62 @@ extern gme_type_t const gme_spc_type = &gme_spc_type_;
 
 blargg_err_t Spc_Emu::set_sample_rate_( long sample_rate )
 {
-	RETURN_ERR( apu.init() );
-	enable_accuracy( false );
+	if ( !this->sample_rate() )
+	{
+		RETURN_ERR( apu.init() );
+
+		// Full DSP emulation by default, without the extra output filtering that
+		// enable_accuracy( true ) adds. enable_accuracy( false ) selects fast DSP.
+		filter.enable( false );
+		for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+			voice_filters [i].enable( false );
+	}
+
+	// SPC runs at its native rate regardless, so a rate change only retunes resampler
 	if ( sample_rate != native_sample_rate )
 	{
 		RETURN_ERR( resampler.buffer_size( native_sample_rate / 20 * 2 ) );
 		resampler.time_ratio( (double) native_sample_rate / sample_rate, 0.9965 );
 	}
+
+	if ( multi_channel() )
+	{
+		// Room for the few samples the DSP can run past the end of a block
+		RETURN_ERR( voice_buf.resize( (voice_block_size + Snes_Spc::extra_size) *
+				Snes_Spc::voice_count * 2 ) );
+		for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+		{
+			if ( sample_rate != native_sample_rate )
+			{
+				RETURN_ERR( voice_resamplers [i].buffer_size( voice_block_size * 2 ) );
+				voice_resamplers [i].time_ratio( (double) native_sample_rate / sample_rate, 0.9965 );
+			}
+		}
+	}
 	return 0;
 }
 
+blargg_err_t Spc_Emu::set_multi_channel( bool is_enabled )
+{
+	return Music_Emu::set_multi_channel_( is_enabled );
+}
+
 void Spc_Emu::enable_accuracy_( bool b )
 {
 	Music_Emu::enable_accuracy_( b );
 	filter.enable( b );
+	for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+		voice_filters [i].enable( b );
+	apu.enable_fast_dsp( !b );
+}
+
+void Spc_Emu::reset_settings_()
+{
+	// neither enable_accuracy( true ) nor ( false ), as in set_sample_rate_()
+	filter.enable( false );
+	for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+		voice_filters [i].enable( false );
+	apu.enable_fast_dsp( false );
 }
 
 void Spc_Emu::mute_voices_( int m )
@@ -293,6 +426,36 @@ blargg_err_t Spc_Emu::load_mem_( byte const* in, long size )
 	return check_spc_header( in );
 }
 
+blargg_err_t Spc_Emu::load_clone_( Gme_File const& other )
+{
+	// file data is shared, so it remains valid
+	Spc_Emu const& in = STATIC_CAST(Spc_Emu const&,other);
+	return load_mem_( in.file_data, in.file_size );
+}
+
+blargg_err_t Spc_Emu::clone_state_( Music_Emu const& other )
+{
+	Spc_Emu const& in = STATIC_CAST(Spc_Emu const&,other);
+	// resamplers aren't used, and might not be set up, at native rate
+	bool const resampled = sample_rate() != native_sample_rate;
+	if ( resampled )
+		resampler.copy_state( in.resampler );
+	filter = in.filter;
+	apu.copy_state( in.apu );
+	if ( multi_channel() )
+	{
+		voice_buf_count = in.voice_buf_count;
+		memcpy( voice_buf.begin(), in.voice_buf.begin(), voice_buf_count * sizeof voice_buf [0] );
+		for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+		{
+			if ( resampled )
+				voice_resamplers [i].copy_state( in.voice_resamplers [i] );
+			voice_filters [i] = in.voice_filters [i];
+		}
+	}
+	return Music_Emu::clone_state_( in );
+}
+
 // Emulation
 
 void Spc_Emu::set_tempo_( double t )
@@ -308,6 +471,16 @@ blargg_err_t Spc_Emu::start_track_( int track )
 	RETURN_ERR( apu.load_spc( file_data, file_size ) );
 	filter.set_gain( (int) (gain() * SPC_Filter::gain_unit) );
 	apu.clear_echo();
+	if ( multi_channel() )
+	{
+		for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+		{
+			voice_resamplers [i].clear();
+			voice_filters [i].clear();
+			voice_filters [i].set_gain( (int) (gain() * SPC_Filter::gain_unit) );
+		}
+		reset_voice_buf();
+	}
 	track_info_t spc_info;
 	RETURN_ERR( track_info_( &spc_info, track ) );
 
@@ -326,10 +499,24 @@ blargg_err_t Spc_Emu::play_and_filter( long count, sample_t out [] )
 
 blargg_err_t Spc_Emu::skip_( long count )
 {
+	int const voice_frame_size = Snes_Spc::voice_count * 2;
+	if ( multi_channel() )
+		count = count / voice_frame_size * 2;
+
 	if ( sample_rate() != native_sample_rate )
 	{
 		count = long (count * resampler.ratio()) & ~1;
-		count -= resampler.skip_input( count );
+		if ( multi_channel() )
+		{
+			int skipped = 0;
+			for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+				skipped = voice_resamplers [i].skip_input( count );
+			count -= skipped;
+		}
+		else
+		{
+			count -= resampler.skip_input( count );
+		}
 	}
 
 	// TODO: shouldn't skip be adjusted for the 64 samples read afterwards?
@@ -338,16 +525,30 @@ blargg_err_t Spc_Emu::skip_( long count )
 	{
 		RETURN_ERR( apu.skip( count ) );
 		filter.clear();
+		if ( multi_channel() )
+		{
+			for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+				voice_filters [i].clear();
+			reset_voice_buf();
+		}
 	}
 
 	// eliminate pop due to resampler
 	const int resampler_latency = 64;
+	if ( multi_channel() )
+	{
+		sample_t buf [resampler_latency / 2 * voice_frame_size];
+		return play_voices( resampler_latency / 2 * voice_frame_size, buf );
+	}
 	sample_t buf [resampler_latency];
 	return play_( resampler_latency, buf );
 }
 
 blargg_err_t Spc_Emu::play_( long count, sample_t* out )
 {
+	if ( multi_channel() )
+		return play_voices( count, out );
+
 	if ( sample_rate() == native_sample_rate )
 		return play_and_filter( count, out );
 
@@ -358,6 +559,8 @@ blargg_err_t Spc_Emu::play_( long count, sample_t* out )
 		if ( remain > 0 )
 		{
 			long n = resampler.max_write();
+			if ( max_latency() )
+				n = min( n, (long) max_latency() * native_sample_rate / 1000 * 2 );
 			RETURN_ERR( play_and_filter( n, resampler.buffer() ) );
 			resampler.write( n );
 		}
@@ -365,3 +568,110 @@ blargg_err_t Spc_Emu::play_( long count, sample_t* out )
 	check( remain == 0 );
 	return 0;
 }
+
+// Multi-channel
+
+// Voice output from the DSP is queued in voice_buf and used in step with normal
+// output, which is still generated since it drives Snes_Spc's timing.
+
+void Spc_Emu::reset_voice_buf()
+{
+	// Match the silence that normal output starts with
+	voice_buf_count = Snes_Spc::extra_size / 4 * Snes_Spc::voice_count * 2;
+	memset( voice_buf.begin(), 0, voice_buf_count * sizeof voice_buf [0] );
+}
+
+blargg_err_t Spc_Emu::run_voices( int count )
+{
+	int const frame_size = Snes_Spc::voice_count * 2;
+	assert( count <= voice_block_size );
+
+	sample_t mix [voice_block_size * 2];
+	int const free_count = (int) voice_buf.size() - voice_buf_count;
+	apu.set_voice_output( &voice_buf [voice_buf_count], free_count / frame_size * frame_size );
+	blargg_err_t err = apu.play( count * 2, mix );
+	voice_buf_count += apu.voice_sample_count();
+	apu.set_voice_output( 0, 0 );
+
+	check( voice_buf_count >= count * frame_size );
+	return err;
+}
+
+// Copies count samples of one voice from voice_buf to out as stereo, and filters them
+void Spc_Emu::read_voice( int index, int count, sample_t out [] )
+{
+	int const frame_size = Snes_Spc::voice_count * 2;
+	sample_t const* in = &voice_buf [index * 2];
+	for ( int i = 0; i < count; i++ )
+	{
+		out [i * 2 + 0] = in [0];
+		out [i * 2 + 1] = in [1];
+		in += frame_size;
+	}
+	voice_filters [index].run( out, count * 2 );
+}
+
+void Spc_Emu::remove_voice_samples( int count )
+{
+	int const size = count * Snes_Spc::voice_count * 2;
+	voice_buf_count -= size;
+	memmove( voice_buf.begin(), &voice_buf [size], voice_buf_count * sizeof voice_buf [0] );
+}
+
+blargg_err_t Spc_Emu::play_voices( long count, sample_t out [] )
+{
+	int const frame_size = Snes_Spc::voice_count * 2;
+	long remain = count / frame_size;
+	while ( remain > 0 )
+	{
+		int n = (int) min( remain, (long) voice_block_size );
+		sample_t buf [voice_block_size * 2];
+		if ( sample_rate() == native_sample_rate )
+		{
+			RETURN_ERR( run_voices( n ) );
+			for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+			{
+				read_voice( i, n, buf );
+				for ( int j = 0; j < n; j++ )
+				{
+					out [j * frame_size + i * 2 + 0] = buf [j * 2 + 0];
+					out [j * frame_size + i * 2 + 1] = buf [j * 2 + 1];
+				}
+			}
+			remove_voice_samples( n );
+		}
+		else
+		{
+			// All resamplers get the same input, so they always have the same
+			// number of samples available
+			int read = 0;
+			for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+			{
+				read = voice_resamplers [i].read( buf, n * 2 ) / 2;
+				for ( int j = 0; j < read; j++ )
+				{
+					out [j * frame_size + i * 2 + 0] = buf [j * 2 + 0];
+					out [j * frame_size + i * 2 + 1] = buf [j * 2 + 1];
+				}
+			}
+			n = read;
+
+			if ( n < remain )
+			{
+				int in_count = min( voice_resamplers [0].max_write() / 2, (int) voice_block_size );
+				if ( max_latency() )
+					in_count = min( in_count, max_latency() * native_sample_rate / 1000 );
+				RETURN_ERR( run_voices( in_count ) );
+				for ( int i = 0; i < Snes_Spc::voice_count; i++ )
+				{
+					read_voice( i, in_count, voice_resamplers [i].buffer() );
+					voice_resamplers [i].write( in_count * 2 );
+				}
+				remove_voice_samples( in_count );
+			}
+		}
+		out += n * frame_size;
+		remain -= n;
+	}
+	return 0;
+}
@@ -44,6 +44,11 @@ public:
 	// Prevents channels and global volumes from being phase-negated
 	void disable_surround( bool disable = true );
 
+	// Multi-channel output gives each of the 8 voices its own stereo channel.
+	// These are dry: main volume and filtering are applied, but echo isn't
+	// included in any of them.
+	blargg_err_t set_multi_channel( bool is_enabled ) override;
+
 	static gme_type_t static_type() { return gme_spc_type; }
 
 public:
@@ -59,6 +64,8 @@ public:
 	~Spc_Emu();
 protected:
 	blargg_err_t load_mem_( byte const*, long );
+	blargg_err_t load_clone_( Gme_File const& );
+	blargg_err_t clone_state_( Music_Emu const& );
 	blargg_err_t track_info_( track_info_t*, int track ) const;
 	blargg_err_t set_sample_rate_( long );
 	blargg_err_t start_track_( int );
@@ -68,6 +75,7 @@ protected:
 	void disable_echo_( bool disable );
 	void set_tempo_( double );
 	void enable_accuracy_( bool );
+	void reset_settings_();
 private:
 	byte const* file_data;
 	long        file_size;
@@ -76,6 +84,18 @@ private:
 	Snes_Spc apu;
 
 	blargg_err_t play_and_filter( long count, sample_t out [] );
+
+	// multi-channel
+	enum { voice_block_size = 512 }; // most samples generated at once
+	blargg_vector<sample_t> voice_buf; // voice output from DSP not yet used
+	int voice_buf_count;
+	Fir_Resampler<24> voice_resamplers [Snes_Spc::voice_count];
+	SPC_Filter voice_filters [Snes_Spc::voice_count];
+	void reset_voice_buf();
+	blargg_err_t run_voices( int count );
+	void read_voice( int index, int count, sample_t out [] );
+	void remove_voice_samples( int count );
+	blargg_err_t play_voices( long count, sample_t out [] );
 };
 
 inline void Spc_Emu::disable_surround( bool b ) { apu.disable_surround( b ); }
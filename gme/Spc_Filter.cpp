@@ -2,6 +2,7 @@
 
 #include "Spc_Filter.h"
 
+#include "Gme_Stats.h"
 #include <string.h>
 
 /* Copyright (C) 2007 Shay Green. This module is free software; you
@@ -29,6 +30,7 @@ SPC_Filter::SPC_Filter()
 
 void SPC_Filter::run( short* io, int count )
 {
+	GME_STAT_TIME( resample_time );
 	require( (count & 1) == 0 ); // must be even
 
 	int const gain = this->gain;
@@ -33,6 +33,8 @@ Vgm_Emu::Vgm_Emu()
 	psg_dual = false;
 	psg_t6w28 = false;
 	psg_rate   = 0;
+	uses_fm    = false;
+	fm_rate_stale = false;
 	set_type( gme_vgm_type );
 
 	static int const types [8] = {
@@ -60,6 +62,12 @@ static byte const* skip_gd3_str( byte const* in, byte const* end )
 	return in;
 }
 
+static void convert_gd3_str( byte const* in, int len, char* out )
+{
+	for ( int i = 0; i < len; i++ )
+		out [i] = (in [i * 2 + 1] ? '?' : in [i * 2]); // TODO: convert to utf-8
+}
+
 static byte const* get_gd3_str( byte const* in, byte const* end, char* field )
 {
 	byte const* mid = skip_gd3_str( in, end );
@@ -68,8 +76,7 @@ static byte const* get_gd3_str( byte const* in, byte const* end, char* field )
 	{
 		len = min( len, (int) Gme_File::max_field_ );
 		field [len] = 0;
-		for ( int i = 0; i < len; i++ )
-			field [i] = (in [i * 2 + 1] ? '?' : in [i * 2]); // TODO: convert to utf-8
+		convert_gd3_str( in, len, field );
 	}
 	return mid;
 }
@@ -90,6 +97,42 @@ static void parse_gd3( byte const* in, byte const* end, track_info_t* out )
 	in = get_gd3_str ( in, end, out->comment );
 }
 
+static byte const* probe_gd3_str( byte const* in, byte const* end, Gme_Probe& out,
+		gme_str_t* field )
+{
+	byte const* mid = skip_gd3_str( in, end );
+	int len = (mid - in) / 2 - 1;
+	if ( len > 0 )
+	{
+		len = min( len, (int) Gme_File::max_field_ );
+		char* str = out.field_buf( len );
+		if ( str )
+		{
+			convert_gd3_str( in, len, str );
+			field->str = str;
+			field->len = len;
+		}
+	}
+	return mid;
+}
+
+static byte const* probe_gd3_pair( byte const* in, byte const* end, Gme_Probe& out,
+		gme_str_t* field )
+{
+	return skip_gd3_str( probe_gd3_str( in, end, out, field ), end );
+}
+
+static void probe_gd3( byte const* in, byte const* end, Gme_Probe& out )
+{
+	in = probe_gd3_pair( in, end, out, &out.info.song );
+	in = probe_gd3_pair( in, end, out, &out.info.game );
+	in = probe_gd3_pair( in, end, out, &out.info.system );
+	in = probe_gd3_pair( in, end, out, &out.info.author );
+	in = probe_gd3_str ( in, end, out, &out.info.copyright );
+	in = probe_gd3_pair( in, end, out, &out.info.dumper );
+	in = probe_gd3_str ( in, end, out, &out.info.comment );
+}
+
 static int const gd3_header_size = 12;
 
 static long check_gd3_header( byte const* h, long remain )
@@ -124,7 +167,9 @@ byte const* Vgm_Emu::gd3_data( int* size ) const
 	return gd3;
 }
 
-static void get_vgm_length( Vgm_Emu::header_t const& h, track_info_t* out )
+// Info is track_info_t or gme_probe_t
+template<class Info>
+static void get_vgm_length( Vgm_Emu::header_t const& h, Info* out )
 {
 	long length = get_le32( h.track_duration ) * 10 / 441;
 	if ( length > 0 )
@@ -205,13 +250,35 @@ struct Vgm_File : Gme_Info_
 	}
 };
 
+static blargg_err_t probe_vgm( Gme_Probe& out, byte const* in, long size )
+{
+	if ( size <= Vgm_Emu::header_size )
+		return gme_wrong_file_type;
+
+	Vgm_Emu::header_t const& h = *(Vgm_Emu::header_t const*) in;
+	RETURN_ERR( check_vgm_header( h ) );
+	get_vgm_length( h, &out.info );
+
+	long gd3_offset = get_le32( h.gd3_offset ) - 0x2C;
+	long remain = size - Vgm_Emu::header_size - gd3_offset;
+	if ( gd3_offset > 0 && remain >= gd3_header_size )
+	{
+		byte const* gd3 = in + Vgm_Emu::header_size + gd3_offset;
+		long gd3_size = check_gd3_header( gd3, remain );
+		if ( gd3_size )
+			probe_gd3( gd3 + gd3_header_size, gd3 + gd3_header_size + gd3_size, out );
+	}
+	out.report_all();
+	return 0;
+}
+
 static Music_Emu* new_vgm_emu () { return BLARGG_NEW Vgm_Emu ; }
 static Music_Emu* new_vgm_file() { return BLARGG_NEW Vgm_File; }
 
-static gme_type_t_ const gme_vgm_type_ = { "Sega SMS/Genesis", 1, &new_vgm_emu, &new_vgm_file, "VGM", 1 };
+static gme_type_t_ const gme_vgm_type_ = { "Sega SMS/Genesis", 1, &new_vgm_emu, &new_vgm_file, "VGM", 1, &probe_vgm };
 extern gme_type_t const gme_vgm_type = &gme_vgm_type_;
 
-static gme_type_t_ const gme_vgz_type_ = { "Sega SMS/Genesis", 1, &new_vgm_emu, &new_vgm_file, "VGZ", 1 };
+static gme_type_t_ const gme_vgz_type_ = { "Sega SMS/Genesis", 1, &new_vgm_emu, &new_vgm_file, "VGZ", 1, 0 };
 extern gme_type_t const gme_vgz_type = &gme_vgz_type_;
 
 
@@ -236,28 +303,46 @@ void Vgm_Emu::set_tempo_( double t )
 blargg_err_t Vgm_Emu::set_sample_rate_( long sample_rate )
 {
 	RETURN_ERR( blip_buf.set_sample_rate( sample_rate, 1000 / 30 ) );
-	return Classic_Emu::set_sample_rate_( sample_rate );
-}
+	if ( multi_channel() )
+		RETURN_ERR( pcm_buf.set_sample_rate( sample_rate, 1000 / 30 ) );
+	RETURN_ERR( Classic_Emu::set_sample_rate_( sample_rate ) );
 
-blargg_err_t Vgm_Emu::set_multi_channel ( bool is_enabled )
-{
-	// we acutally should check here whether this is classic emu or not
-	// however set_multi_channel() is called before setup_fm() resulting in uninited is_classic_emu()
-	// hard code it to unsupported
-#if 0
-	if ( is_classic_emu() )
+	if ( uses_fm && track_count() )
 	{
-		RETURN_ERR( Music_Emu::set_multi_channel_( is_enabled ) );
-		return 0;
+		// rate changed after loading
+		if ( current_track() < 0 )
+			return setup_fm();
+
+		// Setting FM chip's rate would reset it, so leave it running at its
+		// current rate and just resample that to the new rate. start_track()
+		// sets it up properly.
+		Dual_Resampler::setup( fm_rate / sample_rate, rolloff, fm_gain * gain() );
+		RETURN_ERR( Dual_Resampler::reset( blip_buf.length() * sample_rate / 1000 ) );
+		set_max_latency_( max_latency() );
+		fm_rate_stale = true;
 	}
-	else
-#endif
+	return 0;
+}
+
+void Vgm_Emu::set_max_latency_( int msec )
+{
+	// FM is generated a frame at a time, which is normally the whole buffer
+	if ( uses_fm && blip_buf.sample_rate() )
 	{
-		(void) is_enabled;
-		return "multichannel rendering not supported for YM2*** FM sound chip emulators";
+		int length = blip_buf.length();
+		if ( msec && msec < length )
+			length = msec;
+		Dual_Resampler::resize( length * blip_buf.sample_rate() / 1000 );
 	}
 }
 
+blargg_err_t Vgm_Emu::set_multi_channel ( bool is_enabled )
+{
+	// PSG-only files use Classic_Emu's buffer, while YM2612 files give each FM
+	// channel, PCM and PSG their own output (see setup_fm())
+	return Music_Emu::set_multi_channel_( is_enabled );
+}
+
 void Vgm_Emu::update_eq( blip_eq_t const& eq )
 {
 	psg[0].treble_eq( eq );
@@ -345,6 +430,7 @@ blargg_err_t Vgm_Emu::load_mem_( byte const* new_data, long new_size )
 	psg_t6w28 = ( psg_rate & 0x80000000 ) != 0;
 	psg_rate &= 0x0FFFFFFF;
 	blip_buf.clock_rate( psg_rate );
+	pcm_buf.clock_rate( psg_rate );
 
 	data     = new_data;
 	data_end = new_data + new_size;
@@ -378,6 +464,8 @@ blargg_err_t Vgm_Emu::setup_fm()
 		update_fm_rates( &ym2413_rate, &ym2612_rate );
 
 	uses_fm = false;
+	fm_rate_stale = false;
+	set_native_rate( 0 );
 
 	fm_rate = blip_buf.sample_rate() * oversample_factor;
 
@@ -385,8 +473,14 @@ blargg_err_t Vgm_Emu::setup_fm()
 	{
 		ym2612_rate &= ~0xC0000000;
 		uses_fm = true;
-		if ( disable_oversampling_ )
+		set_native_rate( long (ym2612_rate / 144.0 + 0.5) );
+		if ( blip_buf.sample_rate() == native_rate() )
+			fm_rate = blip_buf.sample_rate(); // resampler just copies
+		else if ( disable_oversampling_ )
 			fm_rate = ym2612_rate / 144.0;
+		Dual_Resampler::enable_multi_channel( multi_channel() ? Ym2612_Emu::channel_count : 0, 2 );
+		ym2612[0].separate_channels( multi_channel() );
+		ym2612[1].separate_channels( multi_channel() );
 		Dual_Resampler::setup( fm_rate / blip_buf.sample_rate(), rolloff, fm_gain * gain() );
 		RETURN_ERR( ym2612[0].set_rate( fm_rate, ym2612_rate ) );
 		ym2612[0].enable( true );
@@ -400,9 +494,15 @@ blargg_err_t Vgm_Emu::setup_fm()
 
 	if ( !uses_fm && ym2413_rate )
 	{
+		if ( multi_channel() )
+			return "multichannel rendering not supported for YM2413 FM sound chip emulator";
 		ym2413_rate &= ~0xC0000000;
 		uses_fm = true;
-		if ( disable_oversampling_ )
+		Dual_Resampler::enable_multi_channel( 0, 0 );
+		set_native_rate( long (ym2413_rate / 72.0 + 0.5) );
+		if ( blip_buf.sample_rate() == native_rate() )
+			fm_rate = blip_buf.sample_rate(); // resampler just copies
+		else if ( disable_oversampling_ )
 			fm_rate = ym2413_rate / 72.0;
 		Dual_Resampler::setup( fm_rate / blip_buf.sample_rate(), rolloff, fm_gain * gain() );
 		int result = ym2413[0].set_rate( fm_rate, ym2413_rate );
@@ -424,6 +524,7 @@ blargg_err_t Vgm_Emu::setup_fm()
 	if ( uses_fm )
 	{
 		RETURN_ERR( Dual_Resampler::reset( blip_buf.length() * blip_buf.sample_rate() / 1000 ) );
+		set_max_latency_( max_latency() );
 		psg[0].volume( 0.135 * fm_gain * gain() );
 		if ( psg_dual )
 			psg[1].volume( 0.135 * fm_gain * gain() );
@@ -441,11 +542,72 @@ blargg_err_t Vgm_Emu::setup_fm()
 	return 0;
 }
 
+blargg_err_t Vgm_Emu::load_clone_( Gme_File const& other )
+{
+	// file data is shared, so it remains valid
+	Vgm_Emu const& in = STATIC_CAST(Vgm_Emu const&,other);
+	disable_oversampling_ = in.disable_oversampling_;
+	return load_mem_( in.data, in.data_end - in.data );
+}
+
+blargg_err_t Vgm_Emu::clone_state_( Music_Emu const& other )
+{
+	Vgm_Emu const& in = STATIC_CAST(Vgm_Emu const&,other);
+	if ( in.fm_rate_stale )
+	{
+		// other's FM chips are still running at rate from before sample rate
+		// changed; copying the chips copies their rate
+		fm_rate = in.fm_rate;
+		fm_rate_stale = true;
+		Dual_Resampler::setup( fm_rate / sample_rate(), rolloff, fm_gain * gain() );
+		RETURN_ERR( Dual_Resampler::reset( blip_buf.length() * sample_rate() / 1000 ) );
+		set_max_latency_( max_latency() );
+	}
+
+	vgm_rate         = in.vgm_rate;
+	fm_time_offset   = in.fm_time_offset;
+	fm_time_factor   = in.fm_time_factor;
+	blip_time_factor = in.blip_time_factor;
+	vgm_time         = in.vgm_time;
+	pos              = in.pos;
+	pcm_data         = in.pcm_data;
+	pcm_pos          = in.pcm_pos;
+	dac_amp          = in.dac_amp;
+	dac_disabled     = in.dac_disabled;
+
+	psg[0].copy_state( in.psg[0] );
+	if ( psg_dual )
+		psg[1].copy_state( in.psg[1] );
+	if ( uses_fm )
+	{
+		for ( int i = 0; i < 2; i++ )
+			if ( ym2612[i].enabled() )
+				ym2612[i].copy_state( in.ym2612[i] );
+		dac_synth.copy_config( in.dac_synth );
+		blip_buf.copy_state( in.blip_buf );
+		if ( multi_channel() )
+			pcm_buf.copy_state( in.pcm_buf );
+		Dual_Resampler::copy_state( in );
+	}
+	return Classic_Emu::clone_state_( in );
+}
+
 // Emulation
 
 blargg_err_t Vgm_Emu::start_track_( int track )
 {
-	RETURN_ERR( Classic_Emu::start_track_( track ) );
+	bool const rate_changed = fm_rate_stale;
+	RETURN_ERR( Classic_Emu::start_track_( track ) ); // reloads file, which calls setup_fm()
+	if ( rate_changed )
+	{
+		set_tempo_( tempo() );
+		remute_voices();
+	}
+	// exact loop point rather than track info's msec
+	long const loop = get_le32( header().loop_duration );
+	if ( loop > 0 && get_le32( header().loop_offset ) && get_le32( header().track_duration ) > 0 )
+		set_loop_time( (get_le32( header().track_duration ) - loop) / 44100.0, loop / 44100.0 );
+
 	psg[0].reset( get_le16( header().noise_feedback ), header().noise_width );
 	if ( psg_dual )
 		psg[1].reset( get_le16( header().noise_feedback ), header().noise_width );
@@ -480,6 +642,7 @@ blargg_err_t Vgm_Emu::start_track_( int track )
 
 		fm_time_offset = 0;
 		blip_buf.clear();
+		pcm_buf.clear();
 		Dual_Resampler::clear();
 	}
 	return 0;
@@ -499,6 +662,14 @@ blargg_err_t Vgm_Emu::play_( long count, sample_t* out )
 	if ( !uses_fm )
 		return Classic_Emu::play_( count, out );
 
-	Dual_Resampler::dual_play( count, out, blip_buf );
+	if ( multi_channel() )
+	{
+		Blip_Buffer* bufs [2] = { &pcm_buf, &blip_buf };
+		Dual_Resampler::dual_play_multi( count, out, bufs );
+	}
+	else
+	{
+		Dual_Resampler::dual_play( count, out, blip_buf );
+	}
 	return 0;
 }
@@ -64,11 +64,14 @@ public:
 protected:
 	blargg_err_t track_info_( track_info_t*, int track ) const override;
 	blargg_err_t load_mem_( byte const*, long ) override;
+	blargg_err_t load_clone_( Gme_File const& ) override;
+	blargg_err_t clone_state_( Music_Emu const& ) override;
 	blargg_err_t set_sample_rate_( long sample_rate ) override;
 	blargg_err_t start_track_( int ) override;
 	blargg_err_t play_( long count, sample_t* ) override;
 	blargg_err_t run_clocks( blip_time_t&, int ) override;
 	void set_tempo_( double ) override;
+	void set_max_latency_( int ) override;
 	void mute_voices_( int mask ) override;
 	void set_voice( int, Blip_Buffer*, Blip_Buffer*, Blip_Buffer* ) override;
 	void update_eq( blip_eq_t const& ) override;
@@ -80,6 +83,7 @@ private:
 	long vgm_rate;
 	bool disable_oversampling_;
 	bool uses_fm;
+	bool fm_rate_stale; // sample rate changed during track, so FM needs setup_fm()
 	blargg_err_t setup_fm();
 };
 
@@ -5,6 +5,7 @@
 #include <math.h>
 #include <string.h>
 #include "blargg_endian.h"
+#include "Gme_Stats.h"
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -108,8 +109,11 @@ inline int Ym_Emu<Emu>::run_until( int time )
 			return false;
 		last_time = time;
 		short* p = out;
-		out += count * Emu::out_chan_count;
-		Emu::run( count, p );
+		out += count * out_step;
+		if ( out_step == Emu::out_chan_count )
+			Emu::run( count, p );
+		else
+			Emu::run_channels( count, p );
 	}
 	return true;
 }
@@ -131,7 +135,7 @@ void Vgm_Emu_Impl::write_pcm( vgm_time_t vgm_time, int amp )
 	int delta = amp - old;
 	dac_amp = amp;
 	if ( old >= 0 )
-		dac_synth.offset_inline( blip_time, delta, &blip_buf );
+		dac_synth.offset_inline( blip_time, delta, multi_channel() ? &pcm_buf : &blip_buf );
 	else
 		dac_amp |= dac_disabled;
 }
@@ -321,7 +325,8 @@ int Vgm_Emu_Impl::play_frame( blip_time_t blip_time, int sample_count, sample_t*
 		ym2612[0].begin_frame( buf );
 		if ( ym2612[1].enabled() )
 			ym2612[1].begin_frame( buf );
-		memset( buf, 0, pairs * stereo * sizeof *buf );
+		int channels = multi_channel() ? Ym2612_Emu::channel_count : 1;
+		memset( buf, 0, pairs * channels * stereo * sizeof *buf );
 	}
 	else if ( ym2413[0].enabled() )
 	{
@@ -331,7 +336,10 @@ int Vgm_Emu_Impl::play_frame( blip_time_t blip_time, int sample_count, sample_t*
 		memset( buf, 0, pairs * stereo * sizeof *buf );
 	}
 
-	run_commands( vgm_time );
+	{
+		GME_STAT_TIME( cpu_time );
+		run_commands( vgm_time );
+	}
 
 	if ( ym2612[0].enabled() )
 		ym2612[0].run_until( pairs );
@@ -19,11 +19,14 @@ class Ym_Emu : public Emu {
 protected:
 	int last_time;
 	short* out;
+	int out_step; // output values per sample
 	enum { disabled_time = -1 };
 public:
-	Ym_Emu()                        : last_time( disabled_time ), out( NULL ) { }
+	Ym_Emu()                        : last_time( disabled_time ), out( NULL ), out_step( Emu::out_chan_count ) { }
 	void enable( bool b )           { last_time = b ? 0 : disabled_time; }
 	bool enabled() const            { return last_time != disabled_time; }
+	// If true, output holds each channel separately (see Emu::run_channels())
+	void separate_channels( bool b ) { out_step = b ? Emu::channel_count * 2 : Emu::out_chan_count; }
 	void begin_frame( short* p );
 	int run_until( int time );
 };
@@ -66,6 +69,7 @@ protected:
 	Ym_Emu<Ym2413_Emu> ym2413[2];
 
 	Blip_Buffer blip_buf;
+	Blip_Buffer pcm_buf; // PCM in multi-channel FM mode, when blip_buf only has PSG
 	Sms_Apu psg[2];
 	bool psg_dual;
 	bool psg_t6w28;
@@ -28,6 +28,10 @@ public:
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+
+	// Run and add pair_count samples into out, which holds channel_count stereo
+	// pairs per sample so that each channel is kept separate
+	void run_channels( int pair_count, sample_t* out );
 };
 
 #endif
@@ -5,6 +5,8 @@
 #ifdef VGM_YM2612_GENS
 
 #include "Ym2612_GENS.h"
+#include "Gme_Stats.h"
+#include "blargg_common.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -276,7 +278,7 @@ struct Ym2612_GENS_Impl
 	void write0( int addr, int data );
 	void write1( int addr, int data );
 	void run_timer( int );
-	void run( int pair_count, Ym2612_GENS_Emu::sample_t* );
+	void run( int pair_count, Ym2612_GENS_Emu::sample_t*, bool separate );
 };
 
 void Ym2612_GENS_Impl::KEY_ON( channel_t& ch, int nsl)
@@ -830,7 +832,7 @@ const char* Ym2612_GENS_Emu::set_rate( double sample_rate, double clock_rate )
 {
 	if ( !impl )
 	{
-		impl = (Ym2612_GENS_Impl*) malloc( sizeof *impl );
+		impl = (Ym2612_GENS_Impl*) blargg_malloc( sizeof *impl );
 		if ( !impl )
 			return "Out of memory";
 		impl->mute_mask = 0;
@@ -844,7 +846,7 @@ const char* Ym2612_GENS_Emu::set_rate( double sample_rate, double clock_rate )
 
 Ym2612_GENS_Emu::~Ym2612_GENS_Emu()
 {
-	free( impl );
+	blargg_free( impl );
 }
 
 inline void Ym2612_GENS_Impl::write0( int opn_addr, int data )
@@ -953,14 +955,39 @@ void Ym2612_GENS_Impl::reset()
 
 void Ym2612_GENS_Emu::write0( int addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	impl->write0( addr, data );
 }
 
 void Ym2612_GENS_Emu::write1( int addr, int data )
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	impl->write1( addr, data );
 }
 
+void Ym2612_GENS_Emu::copy_state( Ym2612_GENS_Emu const& in )
+{
+	if ( !impl || !in.impl )
+		return;
+
+	memcpy( impl, in.impl, sizeof *impl );
+	for ( int c = 0; c < channel_count; c++ )
+	{
+		for ( int s = 0; s < 4; s++ )
+		{
+			slot_t& sl = impl->YM2612.CHANNEL [c].SLOT [s];
+			#define REBASE( p ) (sl.p = blargg_rebase( sl.p, in.impl, impl, sizeof *impl ))
+			REBASE( DT );
+			REBASE( AR );
+			REBASE( DR );
+			REBASE( SR );
+			REBASE( RR );
+			REBASE( OUTp );
+			#undef REBASE
+		}
+	}
+}
+
 void Ym2612_GENS_Emu::mute_voices( int mask ) { impl->mute_mask = mask; }
 
 static void update_envelope_( slot_t* sl )
@@ -1033,16 +1060,17 @@ static inline void update_envelope( slot_t& sl )
 		update_envelope_( &sl );
 }
 
+// Adds channel's output into stereo pairs step values apart in buf
 template<int algo>
 struct ym2612_update_chan {
-	static void func( tables_t&, channel_t&, Ym2612_GENS_Emu::sample_t*, int );
+	static void func( tables_t&, channel_t&, Ym2612_GENS_Emu::sample_t*, int, int );
 };
 
-typedef void (*ym2612_update_chan_t)( tables_t&, channel_t&, Ym2612_GENS_Emu::sample_t*, int );
+typedef void (*ym2612_update_chan_t)( tables_t&, channel_t&, Ym2612_GENS_Emu::sample_t*, int, int );
 
 template<int algo>
 void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
-		Ym2612_GENS_Emu::sample_t* buf, int length )
+		Ym2612_GENS_Emu::sample_t* buf, int length, int step )
 {
 	int not_end = ch.SLOT [S3].Ecnt - ENV_END;
 
@@ -1180,7 +1208,7 @@ void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
 		ch.S0_OUT [0] = CH_S0_OUT_0;
 		buf [0] = t0;
 		buf [1] = t1;
-		buf += 2;
+		buf += step;
 	}
 	while ( --length );
 
@@ -1249,7 +1277,7 @@ void Ym2612_GENS_Impl::run_timer( int length )
 	while ( remain > 0 );
 }
 
-void Ym2612_GENS_Impl::run( int pair_count, Ym2612_GENS_Emu::sample_t* out )
+void Ym2612_GENS_Impl::run( int pair_count, Ym2612_GENS_Emu::sample_t* out, bool separate )
 {
 	if ( pair_count <= 0 )
 		return;
@@ -1309,15 +1337,28 @@ void Ym2612_GENS_Impl::run( int pair_count, Ym2612_GENS_Emu::sample_t* out )
 		}
 	}
 
+	// each channel is generated on its own, so it can just as well go to its own pair
+	int const step = separate ? channel_count * 2 : 2;
 	for ( int i = 0; i < channel_count; i++ )
 	{
 		if ( !(mute_mask & (1 << i)) && (i != 5 || !YM2612.DAC) )
-			UPDATE_CHAN [YM2612.CHANNEL [i].ALGO]( g, YM2612.CHANNEL [i], out, pair_count );
+			UPDATE_CHAN [YM2612.CHANNEL [i].ALGO]( g, YM2612.CHANNEL [i],
+					separate ? out + i * 2 : out, pair_count, step );
 	}
 
 	g.LFOcnt += g.LFOinc * pair_count;
 }
 
-void Ym2612_GENS_Emu::run( int pair_count, sample_t* out ) { impl->run( pair_count, out ); }
+void Ym2612_GENS_Emu::run( int pair_count, sample_t* out )
+{
+	GME_STAT_TIME( apu_time );
+	impl->run( pair_count, out, false );
+}
+
+void Ym2612_GENS_Emu::run_channels( int pair_count, sample_t* out )
+{
+	GME_STAT_TIME( apu_time );
+	impl->run( pair_count, out, true );
+}
 
 #endif /* VGM_YM2612_GENS */
@@ -5,6 +5,8 @@
 #ifdef VGM_YM2612_MAME
 
 #include "Ym2612_MAME.h"
+#include "Gme_Stats.h"
+#include "blargg_common.h"
 
 /*
 **
@@ -326,6 +328,14 @@ static void ym2612_reset_chip(void *chip);
 static void ym2612_generate(void *chip, FMSAMPLE *buffer, int frames, int mix);
 #define ym2612_update_one(chip, buffer, length) ym2612_generate(chip, buffer, length, 0)
 
+/**
+ * @brief Generate output of specified length with each channel kept separate
+ * @param chip Chip instance
+ * @param buffer Output sound buffer, which output is mixed with
+ * @param frames Output buffer size in frames (one frame - six stereo pairs, one for each channel)
+ */
+static void ym2612_generate_channels(void *chip, FMSAMPLE *buffer, int frames);
+
 /**
  * @brief Single-Sample generation prepare
  * @param chip Chip instance
@@ -335,8 +345,9 @@ static void ym2612_pre_generate(void *chip);
  * @brief Generate single stereo PCM frame. Will be used native sample rate of 53267 Hz
  * @param chip Chip instance
  * @param buffer One stereo PCM frame
+ * @param channels Stereo PCM frame of each channel, or NULL if not needed
  */
-static void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[2]);
+static void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[2], FMSAMPLE channels[6][2]);
 
 /* void ym2612_post_generate(void *chip, int length); */
 
@@ -845,6 +856,8 @@ typedef struct
 	INT32		framecnt;			/* resampling frames count*/
 	FMSAMPLE	cur_sample[2];		/* previous sample */
 	FMSAMPLE	prev_sample[2];		/* previous sample */
+	FMSAMPLE	cur_channels[6][2];	/* cur_sample of each channel, for ym2612_generate_channels() */
+	FMSAMPLE	prev_channels[6][2];
 #endif
 	UINT8		address;			/* address register     */
 	UINT8		status;				/* status flag          */
@@ -2520,7 +2533,7 @@ static void ym2612_generate(void *chip, FMSAMPLE *buffer, int frames, int mix)
 			/* Copy-Pasta from Nuked */
 			F2612->OPN.ST.prev_sample[0] = F2612->OPN.ST.cur_sample[0];
 			F2612->OPN.ST.prev_sample[1] = F2612->OPN.ST.cur_sample[1];
-			ym2612_generate_one_native(chip, F2612->OPN.ST.cur_sample);
+			ym2612_generate_one_native(chip, F2612->OPN.ST.cur_sample, NULL);
 			F2612->OPN.ST.framecnt -= F2612->OPN.ST.rateratio;
 			/* Copy-Pasta from Nuked */
 		}
@@ -2540,13 +2553,13 @@ static void ym2612_generate(void *chip, FMSAMPLE *buffer, int frames, int mix)
 #else
 		if (mix)
 		{
-			ym2612_generate_one_native(chip, bufTmp);
+			ym2612_generate_one_native(chip, bufTmp, NULL);
 			bufOut[0] += bufTmp[0];
 			bufOut[1] += bufTmp[1];
 		}
 		else
 		{
-			ym2612_generate_one_native(chip, bufOut);
+			ym2612_generate_one_native(chip, bufOut, NULL);
 		}
 		bufOut += 2;
 #endif
@@ -2554,6 +2567,57 @@ static void ym2612_generate(void *chip, FMSAMPLE *buffer, int frames, int mix)
 	/* ym2612_post_generate(chip, frames); */
 }
 
+static void ym2612_generate_channels(void *chip, FMSAMPLE *buffer, int frames)
+{
+	YM2612 *F2612 = (YM2612 *)chip;
+	FM_CH  *cch = F2612->CH;
+	int i, c;
+#if RSM_ENABLE
+	FM_ST  *ST = &F2612->OPN.ST;
+#else
+	FMSAMPLE bufTmp[2];
+	FMSAMPLE channels[6][2];
+#endif
+
+	ym2612_pre_generate(chip);
+
+	if (!frames)
+	{
+		update_ssg_eg_channel(&cch[0].SLOT[SLOT1]);
+		update_ssg_eg_channel(&cch[1].SLOT[SLOT1]);
+		update_ssg_eg_channel(&cch[2].SLOT[SLOT1]);
+		update_ssg_eg_channel(&cch[3].SLOT[SLOT1]);
+		update_ssg_eg_channel(&cch[4].SLOT[SLOT1]);
+		update_ssg_eg_channel(&cch[5].SLOT[SLOT1]);
+	}
+
+	/* same as ym2612_generate(), with each channel resampled on its own */
+	for(i=0 ; i < frames ; i++)
+	{
+#if RSM_ENABLE
+		while(ST->framecnt >= ST->rateratio)
+		{
+			ST->prev_sample[0] = ST->cur_sample[0];
+			ST->prev_sample[1] = ST->cur_sample[1];
+			memcpy(ST->prev_channels, ST->cur_channels, sizeof ST->cur_channels);
+			ym2612_generate_one_native(chip, ST->cur_sample, ST->cur_channels);
+			ST->framecnt -= ST->rateratio;
+		}
+		for (c = 0; c < 12; c++)
+		{
+			buffer[c] += (FMSAMPLE)((ST->prev_channels[c >> 1][c & 1] * (ST->rateratio - ST->framecnt)
+								  + ST->cur_channels[c >> 1][c & 1] * ST->framecnt) / ST->rateratio);
+		}
+		ST->framecnt += 1 << RSM_FRAC;
+#else
+		ym2612_generate_one_native(chip, bufTmp, channels);
+		for (c = 0; c < 12; c++)
+			buffer[c] += channels[c >> 1][c & 1];
+#endif
+		buffer += 12;
+	}
+}
+
 void ym2612_pre_generate(void *chip)
 {
 	YM2612 *F2612 = (YM2612 *)chip;
@@ -2580,7 +2644,7 @@ void ym2612_pre_generate(void *chip)
 	refresh_fc_eg_chan( OPN, &cch[5] );
 }
 
-void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[2])
+void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[2], FMSAMPLE channels[6][2])
 {
 	YM2612 *F2612 = (YM2612 *)chip;
 	FM_OPN *OPN   = &F2612->OPN;
@@ -2713,6 +2777,24 @@ void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[2])
 	buffer[0] = (FMSAMPLE)(F2612->WaveL / 2);
 	buffer[1] = (FMSAMPLE)(F2612->WaveR / 2);
 
+	/* each channel as it would be mixed above if it were the only one. PseudoSt is
+	   never set, so WaveOutMode is always 0x03 and each sample is used as is. */
+	if (channels)
+	{
+		int c;
+		for (c = 0; c < 6; c++)
+		{
+			/* pan masks are unsigned, so go back to int before halving as lt/rt do */
+			channels[c][0] = (FMSAMPLE)((int)(out_fm[c] & OPN->pan[c * 2 + 0]) / 2);
+			channels[c][1] = (FMSAMPLE)((int)(out_fm[c] & OPN->pan[c * 2 + 1]) / 2);
+		}
+		if (F2612->dac_test)
+		{
+			channels[4][0] = (FMSAMPLE)((dacout + dacout) / 2);
+			channels[4][1] = 0;
+		}
+	}
+
 	/* CSM mode: if CSM Key ON has occured, CSM Key OFF need to be sent       */
 	/* only if Timer A does not overflow again (i.e CSM Key ON not set again) */
 	OPN->SL3.key_csm <<= 1;
@@ -2807,7 +2889,7 @@ static void * ym2612_init(void *param, int clock, int rate,
 
 	/* allocate extend state space */
 	/* F2612 = auto_alloc_clear(device->machine, YM2612); */
-	F2612 = (YM2612 *)malloc(sizeof(YM2612));
+	F2612 = (YM2612 *)blargg_malloc(sizeof(YM2612));
 	if (F2612 == NULL)
 		return NULL;
 	memset(F2612, 0x00, sizeof(YM2612));
@@ -2857,7 +2939,7 @@ static void ym2612_shutdown(void *chip)
 
 	FMCloseTable();
 	/* auto_free(F2612->OPN.ST.device->machine, F2612); */
-	free(F2612);
+	blargg_free(F2612);
 }
 
 /* reset one of chip */
@@ -2878,6 +2960,8 @@ static void ym2612_reset_chip(void *chip)
 	F2612->OPN.ST.framecnt = 1 << RSM_FRAC;
 	memset(&(F2612->OPN.ST.cur_sample), 0x00, sizeof(FMSAMPLE) * 2);
 	memset(&(F2612->OPN.ST.prev_sample), 0x00, sizeof(FMSAMPLE) * 2);
+	memset(&(F2612->OPN.ST.cur_channels), 0x00, sizeof(FMSAMPLE) * 12);
+	memset(&(F2612->OPN.ST.prev_channels), 0x00, sizeof(FMSAMPLE) * 12);
 #endif
 
 	OPN->eg_timer = 0;
@@ -3061,6 +3145,30 @@ static void ym2612_setoptions(UINT8 Flags)
 }
 #endif
 
+/* copy state of one chip to another, moving pointers within it */
+static void ym2612_copy_state(void *chip, const void *in_chip)
+{
+	YM2612 *F2612 = (YM2612 *)chip;
+	const YM2612 *in = (const YM2612 *)in_chip;
+	int c, s;
+
+	memcpy(F2612, in, sizeof(YM2612));
+	#define REBASE(p) ((p) = blargg_rebase((p), in, F2612, sizeof(YM2612)))
+	REBASE(F2612->OPN.P_CH);
+	for (c = 0; c < 6; c++)
+	{
+		FM_CH *CH = &F2612->CH[c];
+		REBASE(CH->connect1);
+		REBASE(CH->connect2);
+		REBASE(CH->connect3);
+		REBASE(CH->connect4);
+		REBASE(CH->mem_connect);
+		for (s = 0; s < 4; s++)
+			REBASE(CH->SLOT[s].DT);
+	}
+	#undef REBASE
+}
+
 } // Ym2612_MameImpl
 
 
@@ -3085,6 +3193,11 @@ void Ym2612_MAME_Emu::reset()
 	if ( impl ) Ym2612_MameImpl::ym2612_reset_chip( impl );
 }
 
+void Ym2612_MAME_Emu::copy_state( Ym2612_MAME_Emu const& in )
+{
+	if ( impl && in.impl ) Ym2612_MameImpl::ym2612_copy_state( impl, in.impl );
+}
+
 void Ym2612_MAME_Emu::mute_voices(int mask)
 {
 	if ( impl ) Ym2612_MameImpl::ym2612_set_mutemask( impl, mask );
@@ -3092,6 +3205,7 @@ void Ym2612_MAME_Emu::mute_voices(int mask)
 
 void Ym2612_MAME_Emu::write0(int addr, int data)
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	if ( !impl ) return;
 	Ym2612_MameImpl::ym2612_write( impl, 0, static_cast<uint8_t>(addr) );
 	Ym2612_MameImpl::ym2612_write( impl, 1, static_cast<uint8_t>(data) );
@@ -3099,6 +3213,7 @@ void Ym2612_MAME_Emu::write0(int addr, int data)
 
 void Ym2612_MAME_Emu::write1(int addr, int data)
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	if ( !impl ) return;
 	Ym2612_MameImpl::ym2612_write( impl, 0 + 2, static_cast<uint8_t>(addr) );
 	Ym2612_MameImpl::ym2612_write( impl, 1 + 2, static_cast<uint8_t>(data) );
@@ -3107,7 +3222,14 @@ void Ym2612_MAME_Emu::write1(int addr, int data)
 void Ym2612_MAME_Emu::run(int pair_count, Ym2612_MAME_Emu::sample_t *out)
 {
 	(void) &Ym2612_MameImpl::TimerBOver; // squelch clang warning, which appears to be from a config choice
+	GME_STAT_TIME( apu_time );
 	if ( impl ) Ym2612_MameImpl::ym2612_generate( impl, out, pair_count, 1);
 }
 
+void Ym2612_MAME_Emu::run_channels( int pair_count, sample_t* out )
+{
+	GME_STAT_TIME( apu_time );
+	if ( impl ) Ym2612_MameImpl::ym2612_generate_channels( impl, out, pair_count );
+}
+
 #endif /* VGM_YM2612_MAME */
@@ -19,6 +19,9 @@ public:
 	// Reset to power-up state
 	void reset();
 
+	// Copy state of other chip, including the rate it was set to
+	void copy_state( Ym2612_MAME_Emu const& );
+
 	// Mute voice n if bit n (1 << n) of mask is set
 	enum { channel_count = 6 };
 	void mute_voices( int mask );
@@ -33,6 +36,10 @@ public:
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+
+	// Run and add pair_count samples into out, which holds channel_count stereo
+	// pairs per sample so that each channel is kept separate
+	void run_channels( int pair_count, sample_t* out );
 };
 
 #endif
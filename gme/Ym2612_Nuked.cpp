@@ -5,6 +5,8 @@
 #ifdef VGM_YM2612_NUKED
 
 #include "Ym2612_Nuked.h"
+#include "Gme_Stats.h"
+#include "blargg_common.h"
 
 /*
  * Copyright (C) 2017 Alexey Khokholov (Nuke.YKT)
@@ -218,6 +220,8 @@ typedef struct
     Bit32s samplecnt;
     Bit32s oldsamples[2];
     Bit32s samples[2];
+    Bit32s ch_oldsamples[6][2];
+    Bit32s ch_samples[6][2];
 
     Bit64u writebuf_samplecnt;
     Bit32u writebuf_cur;
@@ -242,6 +246,9 @@ void OPN2_Generate(ym3438_t *chip, Bit16s *buf);
 void OPN2_GenerateResampled(ym3438_t *chip, Bit16s *buf);
 void OPN2_GenerateStream(ym3438_t *chip, Bit16s *output, Bit32u numsamples);
 void OPN2_GenerateStreamMix(ym3438_t *chip, Bit16s *output, Bit32u numsamples);
+void OPN2_GenerateChannels(ym3438_t *chip, Bit16s buf[6][2]);
+void OPN2_GenerateResampledChannels(ym3438_t *chip, Bit16s *buf);
+void OPN2_GenerateStreamChannelsMix(ym3438_t *chip, Bit16s *output, Bit32u numsamples);
 void OPN2_SetOptions(Bit8u flags);
 void OPN2_SetMute(ym3438_t *chip, Bit32u mute);
 
@@ -1681,6 +1688,23 @@ void OPN2_WriteBuffered(ym3438_t *chip, Bit32u port, Bit8u data)
     chip->writebuf_last = (chip->writebuf_last + 1) % OPN_WRITEBUF_SIZE;
 }
 
+/* Performs buffered writes that are due, then advances write buffer time */
+static void OPN2_RunWriteBuffer(ym3438_t *chip)
+{
+    while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
+    {
+        if (!(chip->writebuf[chip->writebuf_cur].port & 0x04))
+        {
+            break;
+        }
+        chip->writebuf[chip->writebuf_cur].port &= 0x03;
+        OPN2_Write(chip, chip->writebuf[chip->writebuf_cur].port,
+                   chip->writebuf[chip->writebuf_cur].data);
+        chip->writebuf_cur = (chip->writebuf_cur + 1) % OPN_WRITEBUF_SIZE;
+    }
+    chip->writebuf_samplecnt++;
+}
+
 void OPN2_Generate(ym3438_t *chip, Bit16s *buf)
 {
     Bit32u i;
@@ -1723,18 +1747,32 @@ void OPN2_Generate(ym3438_t *chip, Bit16s *buf)
             buf[1] += buffer[1];
         }
 
-        while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
+        OPN2_RunWriteBuffer(chip);
+    }
+}
+
+/* Same as OPN2_Generate, but keeps the output of each channel separate */
+void OPN2_GenerateChannels(ym3438_t *chip, Bit16s buf[6][2])
+{
+    static const Bit8u slot_channel[6] = { 1, 5, 3, 0, 4, 2 };
+    Bit32u i, ch;
+    Bit16s buffer[2];
+    Bit32u mute;
+
+    memset(buf, 0, sizeof(Bit16s) * 6 * 2);
+
+    for (i = 0; i < 24; i++)
+    {
+        ch = slot_channel[chip->cycles >> 2];
+        mute = chip->mute[ch == 5 ? 5 + chip->dacen : ch];
+        OPN2_Clock(chip, buffer);
+        if (!mute)
         {
-            if (!(chip->writebuf[chip->writebuf_cur].port & 0x04))
-            {
-                break;
-            }
-            chip->writebuf[chip->writebuf_cur].port &= 0x03;
-            OPN2_Write(chip, chip->writebuf[chip->writebuf_cur].port,
-                       chip->writebuf[chip->writebuf_cur].data);
-            chip->writebuf_cur = (chip->writebuf_cur + 1) % OPN_WRITEBUF_SIZE;
+            buf[ch][0] += buffer[0];
+            buf[ch][1] += buffer[1];
         }
-        chip->writebuf_samplecnt++;
+
+        OPN2_RunWriteBuffer(chip);
     }
 }
 
@@ -1758,6 +1796,33 @@ void OPN2_GenerateResampled(ym3438_t *chip, Bit16s *buf)
     chip->samplecnt += 1 << RSM_FRAC;
 }
 
+void OPN2_GenerateResampledChannels(ym3438_t *chip, Bit16s *buf)
+{
+    Bit16s buffer[6][2];
+    Bit32u ch, i;
+
+    while (chip->samplecnt >= chip->rateratio)
+    {
+        memcpy(chip->ch_oldsamples, chip->ch_samples, sizeof(chip->ch_samples));
+        OPN2_GenerateChannels(chip, buffer);
+        for (ch = 0; ch < 6; ch++)
+        {
+            chip->ch_samples[ch][0] = buffer[ch][0] * 11;
+            chip->ch_samples[ch][1] = buffer[ch][1] * 11;
+        }
+        chip->samplecnt -= chip->rateratio;
+    }
+    for (ch = 0; ch < 6; ch++)
+    {
+        for (i = 0; i < 2; i++)
+        {
+            buf[ch * 2 + i] = (Bit16s)(((chip->ch_oldsamples[ch][i] * (chip->rateratio - chip->samplecnt)
+                             + chip->ch_samples[ch][i] * chip->samplecnt) / chip->rateratio)>>1);
+        }
+    }
+    chip->samplecnt += 1 << RSM_FRAC;
+}
+
 void OPN2_GenerateStream(ym3438_t *chip, Bit16s *output, Bit32u numsamples)
 {
     Bit32u i;
@@ -1784,6 +1849,20 @@ void OPN2_GenerateStreamMix(ym3438_t *chip, Bit16s *output, Bit32u numsamples)
     }
 }
 
+void OPN2_GenerateStreamChannelsMix(ym3438_t *chip, Bit16s *output, Bit32u numsamples)
+{
+    Bit32u i, j;
+    Bit16s buffer[6 * 2];
+
+    for (i = 0; i < numsamples; i++)
+    {
+        OPN2_GenerateResampledChannels(chip, buffer);
+        for (j = 0; j < 6 * 2; j++)
+        {
+            *output++ += buffer[j];
+        }
+    }
+}
 
 void OPN2_SetOptions(Bit8u flags)
 {
@@ -1818,13 +1897,13 @@ void OPN2_SetMute(ym3438_t *chip, Bit32u mute)
 Ym2612_Nuked_Emu::Ym2612_Nuked_Emu()
 {
 	Ym2612_NukedImpl::OPN2_SetChipType( Ym2612_NukedImpl::ym3438_type_asic );
-	impl = new Ym2612_NukedImpl::ym3438_t;
+	impl = (Ym2612_Nuked_Impl*) blargg_malloc( sizeof (Ym2612_NukedImpl::ym3438_t) );
 }
 
 Ym2612_Nuked_Emu::~Ym2612_Nuked_Emu()
 {
 	Ym2612_NukedImpl::ym3438_t *chip_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t*>(impl);
-	if ( chip_r ) delete chip_r;
+	blargg_free( chip_r );
 }
 
 const char *Ym2612_Nuked_Emu::set_rate(double sample_rate, double clock_rate)
@@ -1844,6 +1923,15 @@ void Ym2612_Nuked_Emu::reset()
 	if ( chip_r ) Ym2612_NukedImpl::OPN2_Reset( chip_r, static_cast<Bit32u>(prev_sample_rate), static_cast<Bit32u>(prev_clock_rate) );
 }
 
+void Ym2612_Nuked_Emu::copy_state( Ym2612_Nuked_Emu const& in )
+{
+	Ym2612_NukedImpl::ym3438_t *chip_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t*>(impl);
+	Ym2612_NukedImpl::ym3438_t const *in_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t const*>(in.impl);
+	if ( chip_r && in_r ) *chip_r = *in_r;
+	prev_sample_rate = in.prev_sample_rate;
+	prev_clock_rate = in.prev_clock_rate;
+}
+
 void Ym2612_Nuked_Emu::mute_voices(int mask)
 {
 	Ym2612_NukedImpl::ym3438_t *chip_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t*>(impl);
@@ -1852,6 +1940,7 @@ void Ym2612_Nuked_Emu::mute_voices(int mask)
 
 void Ym2612_Nuked_Emu::write0(int addr, int data)
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	Ym2612_NukedImpl::ym3438_t *chip_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t*>(impl);
 	if ( !chip_r ) return;
 	Ym2612_NukedImpl::OPN2_WriteBuffered( chip_r, 0, static_cast<Bit8u>(addr) );
@@ -1860,6 +1949,7 @@ void Ym2612_Nuked_Emu::write0(int addr, int data)
 
 void Ym2612_Nuked_Emu::write1(int addr, int data)
 {
+	GME_STAT_ADD( apu_writes, 1 );
 	Ym2612_NukedImpl::ym3438_t *chip_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t*>(impl);
 	if ( !chip_r ) return;
 	Ym2612_NukedImpl::OPN2_WriteBuffered( chip_r, 0 + 2, static_cast<Bit8u>(addr) );
@@ -1870,7 +1960,16 @@ void Ym2612_Nuked_Emu::run(int pair_count, Ym2612_Nuked_Emu::sample_t *out)
 {
 	Ym2612_NukedImpl::ym3438_t *chip_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t*>(impl);
 	if ( !chip_r ) return;
+	GME_STAT_TIME( apu_time );
 	Ym2612_NukedImpl::OPN2_GenerateStreamMix(chip_r, out, pair_count);
 }
 
+void Ym2612_Nuked_Emu::run_channels(int pair_count, Ym2612_Nuked_Emu::sample_t *out)
+{
+	Ym2612_NukedImpl::ym3438_t *chip_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t*>(impl);
+	if ( !chip_r ) return;
+	GME_STAT_TIME( apu_time );
+	Ym2612_NukedImpl::OPN2_GenerateStreamChannelsMix(chip_r, out, pair_count);
+}
+
 #endif /* VGM_YM2612_NUKED */
@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
+#include <atomic>
 
 // BLARGG_RESTRICT: equivalent to restrict, where supported
 #if (defined(__GNUC__) && (__GNUC__ >= 3)) || \
@@ -42,6 +44,13 @@ inline T uMinus(T in)
 	return ~(in - 1);
 }
 
+// Allocate and free memory as malloc() etc. do, but through allocator set with
+// gme_set_allocator(), from current emulator's heap if any (see Gme_Alloc.h). Only
+// blocks from these may be passed to blargg_realloc() and blargg_free().
+void* blargg_malloc( size_t );
+void* blargg_realloc( void*, size_t );
+void blargg_free( void* );
+
 // blargg_vector - very lightweight vector of POD types (no constructor/destructor)
 template<class T>
 class blargg_vector {
@@ -49,20 +58,22 @@ class blargg_vector {
 	size_t size_;
 public:
 	blargg_vector() : begin_( 0 ), size_( 0 ) { }
-	~blargg_vector() { free( begin_ ); }
+	~blargg_vector() { blargg_free( begin_ ); }
 	size_t size() const { return size_; }
 	T* begin() const { return begin_; }
 	T* end() const { return begin_ + size_; }
 	blargg_err_t resize( size_t n )
 	{
-		void* p = realloc( begin_, n * sizeof (T) );
+		if ( n == size_ )
+			return 0;
+		void* p = blargg_realloc( begin_, n * sizeof (T) );
 		if ( !p && n )
 			return "Out of memory";
 		begin_ = (T*) p;
 		size_ = n;
 		return 0;
 	}
-	void clear() { free( begin_ ); begin_ = nullptr; size_ = 0; }
+	void clear() { blargg_free( begin_ ); begin_ = nullptr; size_ = 0; }
 	T& operator [] ( size_t n ) const
 	{
 		assert( n <= size_ ); // <= to allow past-the-end value
@@ -74,10 +85,10 @@ public:
 #include <new>
 #ifndef BLARGG_DISABLE_NOTHROW
 	#define BLARGG_DISABLE_NOTHROW \
-		void* operator new ( size_t s ) noexcept { return malloc( s ); }\
-		void* operator new ( size_t s, const std::nothrow_t& ) noexcept { return malloc( s ); }\
-		void operator delete ( void* p ) noexcept { free( p ); }\
-		void operator delete ( void* p, const std::nothrow_t&) noexcept { free( p ); }
+		void* operator new ( size_t s ) noexcept { return blargg_malloc( s ); }\
+		void* operator new ( size_t s, const std::nothrow_t& ) noexcept { return blargg_malloc( s ); }\
+		void operator delete ( void* p ) noexcept { blargg_free( p ); }\
+		void operator delete ( void* p, const std::nothrow_t&) noexcept { blargg_free( p ); }
 #endif
 
 // Use to force disable exceptions for a specific allocation no matter what class
@@ -93,4 +104,80 @@ public:
 // int8_t etc.
 #include <stdint.h>
 
+// blargg_shared_vector - blargg_vector whose contents can be shared by several
+// vectors, for data that doesn't change once loaded. Contents are freed along with
+// the last vector using them. resize() and clear() only affect this vector, but
+// writing through begin() while shared affects all of them.
+template<class T>
+class blargg_shared_vector {
+	T* begin_;
+	size_t size_;
+
+	// reference count is kept just before contents, in a header that keeps them
+	// aligned as malloc() would
+	enum { header_size = 16 };
+	typedef std::atomic<long> refs_t;
+	static_assert( sizeof (refs_t) <= header_size, "Reference count doesn't fit" );
+	refs_t& refs() const { return *(refs_t*) ((char*) begin_ - header_size); }
+	void release()
+	{
+		if ( begin_ && refs().fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+			blargg_free( (char*) begin_ - header_size );
+	}
+public:
+	blargg_shared_vector() : begin_( 0 ), size_( 0 ) { }
+	~blargg_shared_vector() { release(); }
+	size_t size() const { return size_; }
+	T* begin() const { return begin_; }
+	T* end() const { return begin_ + size_; }
+	blargg_err_t resize( size_t n )
+	{
+		if ( n == size_ )
+			return 0;
+		T* p = 0;
+		if ( n )
+		{
+			char* block = (char*) blargg_malloc( header_size + n * sizeof (T) );
+			if ( !block )
+				return "Out of memory";
+			new (block) refs_t( 1 );
+			p = (T*) (block + header_size);
+			if ( size_ )
+				memcpy( p, begin_, (n < size_ ? n : size_) * sizeof (T) );
+		}
+		release();
+		begin_ = p;
+		size_ = n;
+		return 0;
+	}
+	void clear() { release(); begin_ = nullptr; size_ = 0; }
+	// Use same contents as other
+	void share( blargg_shared_vector const& other )
+	{
+		if ( other.begin_ )
+			other.refs().fetch_add( 1, std::memory_order_relaxed );
+		release();
+		begin_ = other.begin_;
+		size_ = other.size_;
+	}
+	T& operator [] ( size_t n ) const
+	{
+		assert( n <= size_ ); // <= to allow past-the-end value
+		return begin_ [n];
+	}
+private:
+	// noncopyable
+	blargg_shared_vector( const blargg_shared_vector& );
+	blargg_shared_vector& operator = ( const blargg_shared_vector& );
+};
+
+// Pointer p moved to the same offset from new_base if it points within the size
+// bytes at old_base, otherwise p unchanged. For copying state that points into itself.
+template<class T>
+inline T* blargg_rebase( T* p, void const* old_base, void* new_base, size_t size )
+{
+	uintptr_t offset = (uintptr_t) p - (uintptr_t) old_base;
+	return offset < size ? (T*) ((char*) new_base + offset) : p;
+}
+
 #endif
@@ -58,6 +58,10 @@
 #include "emu2413.h"
 #include "panning.h" // Maxim
 
+/* game-music-emu: allocate through library's allocator */
+void *gme_ext_calloc (size_t, size_t);
+void gme_ext_free (void *);
+
 /*#ifdef EMU2413_COMPACTION
 #define OPLL_TONE_NUM 1
 static unsigned char default_inst[OPLL_TONE_NUM][(16 + 3) * 16] = {
@@ -1000,7 +1004,7 @@ OPLL_new (e_uint32 clk, e_uint32 rate)
 
   maketables (clk, rate);
 
-  opll = (OPLL *) calloc (1, sizeof (OPLL));
+  opll = (OPLL *) gme_ext_calloc (1, sizeof (OPLL));
   if (opll == NULL)
     return NULL;
 
@@ -1023,7 +1027,7 @@ OPLL_new (e_uint32 clk, e_uint32 rate)
 void
 OPLL_delete (OPLL * opll)
 {
-  free (opll);
+  gme_ext_free (opll);
 }
 
 
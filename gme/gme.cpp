@@ -1,6 +1,10 @@
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
 
 #include "Music_Emu.h"
+#include "Gme_Alloc.h"
+#include "Gme_Rt_Check.h"
+#include "Gme_Lookahead.h"
+#include "Gme_Playlist.h"
 
 #ifdef GEN_TYPES_H
 #include "gen_types.h" /* same as gme_types.h but generated by build system */
@@ -27,6 +31,68 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 
 #include "blargg_source.h"
 
+// Memory allocated in rest of scope comes from emulator's heap
+#define HEAP_SCOPE( me ) Gme_Heap_Scope heap_scope( (me)->heap() )
+
+static void delete_lookahead( Music_Emu* );
+
+// Deletes emulator and releases its heap
+static void delete_emu( Music_Emu* me )
+{
+	if ( me )
+	{
+		delete_lookahead( me );
+		Gme_Heap* heap = me->heap();
+		delete me;
+		if ( heap )
+			heap->release();
+	}
+}
+
+// Background lookahead
+
+// Helper emulator is a clone, so it's remade whenever a track starts or something
+// changes that clone_state_() can't copy. Without one, play() looks ahead itself.
+static gme_err_t update_lookahead( Music_Emu* me )
+{
+	Gme_Lookahead* lookahead = me->background_lookahead();
+	if ( !lookahead )
+		return 0;
+	Music_Emu* helper = 0;
+	gme_err_t err = 0;
+	if ( me->current_track() >= 0 )
+		err = gme_clone( me, &helper );
+	delete_emu( lookahead->set_helper( helper ) );
+	return err;
+}
+
+static void delete_lookahead( Music_Emu* me )
+{
+	if ( Gme_Lookahead* lookahead = me->background_lookahead() )
+	{
+		delete_emu( lookahead->set_helper( 0 ) );
+		me->set_background_lookahead( 0 );
+		delete lookahead;
+	}
+}
+
+gme_err_t gme_set_background_lookahead( Music_Emu* me, int enable )
+{
+	if ( !enable )
+	{
+		delete_lookahead( me );
+		return 0;
+	}
+	HEAP_SCOPE( me );
+	if ( !me->background_lookahead() )
+	{
+		Gme_Lookahead* lookahead = BLARGG_NEW Gme_Lookahead;
+		CHECK_ALLOC( lookahead );
+		me->set_background_lookahead( lookahead );
+	}
+	return update_lookahead( me );
+}
+
 gme_type_t const* gme_type_list()
 {
 	static gme_type_t const gme_type_list_ [] = {
@@ -157,13 +223,30 @@ gme_err_t gme_open_data( void const* data, long size, Music_Emu** out, int sampl
 	gme_err_t err = gme_load_data( emu, data, size );
 
 	if ( err )
-		delete emu;
+		delete_emu( emu );
 	else
 		*out = emu;
 
 	return err;
 }
 
+gme_err_t gme_probe_info( void const* data, long size, gme_probe_func_t func, void* user_data )
+{
+	require( (data || !size) && func );
+
+	gme_type_t file_type = 0;
+	if ( size >= 4 )
+		file_type = gme_identify_extension( gme_identify_header( data ) );
+	if ( !file_type )
+		return gme_wrong_file_type;
+
+	if ( !file_type->probe_ )
+		return "Can't get info from this file type without opening it";
+
+	Gme_Probe probe( file_type, func, user_data );
+	return file_type->probe_( probe, (uint8_t const*) data, size );
+}
+
 gme_err_t gme_open_file( const char* path, Music_Emu** out, int sample_rate )
 {
 	require( path && out );
@@ -190,11 +273,15 @@ gme_err_t gme_open_file( const char* path, Music_Emu** out, int sample_rate )
 
 	// optimization: avoids seeking/re-reading header
 	Remaining_Reader rem( header, header_size, &in );
-	gme_err_t err = emu->load( rem );
+	gme_err_t err;
+	{
+		HEAP_SCOPE( emu );
+		err = emu->load( rem );
+	}
 	in.close();
 
 	if ( err )
-		delete emu;
+		delete_emu( emu );
 	else
 		*out = emu;
 
@@ -211,17 +298,22 @@ int gme_autoload_playback_limit( Music_Emu const* emu )
 	return emu->autoload_playback_limit();
 }
 
-// Used to implement gme_new_emu and gme_new_emu_multi_channel
-Music_Emu* gme_internal_new_emu_( gme_type_t type, int rate, bool multi_channel )
+// Used to implement gme_new_emu, gme_new_emu_multi_channel and gme_new_emu_arena
+Music_Emu* gme_internal_new_emu_( gme_type_t type, int rate, bool multi_channel, size_t arena_size )
 {
 	if ( type )
 	{
 		if ( rate == gme_info_only )
 			return type->new_info();
 
+		Gme_Heap* heap = Gme_Heap::create( arena_size );
+		if ( !heap )
+			return 0;
+		Gme_Heap_Scope scope( heap );
 		Music_Emu* me = type->new_emu();
 		if ( me )
 		{
+			me->set_heap( heap );
 		#if !GME_DISABLE_STEREO_DEPTH
 			me->set_multi_channel( multi_channel );
 
@@ -248,33 +340,105 @@ Music_Emu* gme_internal_new_emu_( gme_type_t type, int rate, bool multi_channel
 					return me;
 				}
 			}
-			delete me;
+			delete_emu( me );
+		}
+		else
+		{
+			heap->release();
 		}
 	}
 	return 0;
 }
 
+gme_err_t gme_clone( Music_Emu const* in, Music_Emu** out )
+{
+	require( in && out );
+	*out = 0;
+	// clone gets same kind of heap
+	Gme_Heap* heap = Gme_Heap::create( in->heap() ? in->heap()->arena_size() : 0 );
+	CHECK_ALLOC( heap );
+	Gme_Heap_Scope scope( heap );
+	Music_Emu* me = in->type()->new_emu();
+	if ( !me )
+	{
+		heap->release();
+		return "Out of memory";
+	}
+	me->set_heap( heap );
+#if !GME_DISABLE_STEREO_DEPTH
+	if ( in->effects_buffer )
+	{
+		Effects_Buffer const* fx = STATIC_CAST(Effects_Buffer const*,in->effects_buffer);
+		me->effects_buffer = BLARGG_NEW Effects_Buffer( in->multi_channel() ? 8 : 1 );
+		if ( !me->effects_buffer )
+		{
+			delete_emu( me );
+			return "Out of memory";
+		}
+		STATIC_CAST(Effects_Buffer*,me->effects_buffer)->config( fx->config() );
+		me->set_buffer( me->effects_buffer );
+	}
+#endif
+	gme_err_t err = me->clone_from( *in );
+	if ( err )
+		delete_emu( me );
+	else
+		*out = me;
+	return err;
+}
+
 Music_Emu* gme_new_emu( gme_type_t type, int rate )
 {
-    return gme_internal_new_emu_( type, rate, false /* no multichannel */);
+    return gme_internal_new_emu_( type, rate, false /* no multichannel */, 0 );
 }
 
 Music_Emu* gme_new_emu_multi_channel( gme_type_t type, int rate )
 {
     // multi-channel emulator (if possible, not all emu types support multi-channel)
-    return gme_internal_new_emu_( type, rate, true /* multichannel */);
+    return gme_internal_new_emu_( type, rate, true /* multichannel */, 0 );
+}
+
+Music_Emu* gme_new_emu_arena( gme_type_t type, int rate, int multi_channel, size_t arena_size )
+{
+	return gme_internal_new_emu_( type, rate, multi_channel != 0, arena_size );
+}
+
+void gme_set_allocator( gme_allocator_t const* a )
+{
+	if ( a )
+		Gme_Heap::set_allocator( a->alloc, a->free, a->user_data );
+	else
+		Gme_Heap::set_allocator( 0, 0, 0 );
 }
 
-gme_err_t gme_load_file( Music_Emu* me, const char* path ) { return me->load_file( path ); }
+void gme_memory_usage( Music_Emu const* me, gme_memory_t* out )
+{
+	gme_memory_t m = gme_memory_t();
+	if ( Gme_Heap const* heap = me->heap() )
+	{
+		m.current    = heap->used();
+		m.peak       = heap->peak();
+		m.arena_size = heap->arena_size();
+	}
+	*out = m;
+}
+
+gme_err_t gme_load_file( Music_Emu* me, const char* path )
+{
+	HEAP_SCOPE( me );
+	return me->load_file( path );
+}
 
 gme_err_t gme_load_data( Music_Emu* me, void const* data, long size )
 {
+	HEAP_SCOPE( me );
 	Mem_File_Reader in( data, size );
 	return me->load( in );
 }
 
 gme_err_t gme_load_tracks( Music_Emu* me, void const* data, long* sizes, int count )
 {
+	HEAP_SCOPE( me );
 	return me->load_tracks( data, sizes, count );
 }
 
@@ -286,11 +450,149 @@ int gme_fixed_track_count( gme_type_t t )
 
 gme_err_t gme_load_custom( Music_Emu* me, gme_reader_t func, long size, void* data )
 {
+	HEAP_SCOPE( me );
 	Callback_Reader in( func, size, data );
 	return me->load( in );
 }
 
-void gme_delete( Music_Emu* me ) { delete me; }
+void gme_delete( Music_Emu* me ) { delete_emu( me ); }
+
+void gme_reset_for_reload( Music_Emu* me )
+{
+	delete_lookahead( me );
+	HEAP_SCOPE( me );
+	me->reset_for_reload();
+	gme_set_stereo_depth( me, 0.0 );
+}
+
+struct gme_pool_t
+{
+	gme_type_t type;
+	int rate;
+	bool multi_channel;
+	blargg_vector<Music_Emu*> emus; // free emulators
+	size_t count;
+
+	// emulators are only created and reset outside lock, so it's held briefly
+	std::atomic_flag busy = ATOMIC_FLAG_INIT;
+	void lock()
+	{
+		GME_RT_UNSAFE( locks, "pool lock" );
+		while ( busy.test_and_set( std::memory_order_acquire ) ) { }
+	}
+	void unlock() { busy.clear( std::memory_order_release ); }
+
+	// Adds emulator to free ones, or deletes it if out of memory
+	blargg_err_t add( Music_Emu* me )
+	{
+		lock();
+		blargg_err_t err = 0;
+		if ( count >= emus.size() )
+			err = emus.resize( count ? count * 2 : 4 );
+		if ( !err )
+			emus [count++] = me;
+		unlock();
+		if ( err )
+			delete_emu( me );
+		return err;
+	}
+
+	BLARGG_DISABLE_NOTHROW
+};
+
+gme_pool_t* gme_new_pool( gme_type_t type, int rate, int multi_channel )
+{
+	require( type && rate != gme_info_only );
+	gme_pool_t* pool = BLARGG_NEW gme_pool_t;
+	if ( pool )
+	{
+		pool->type          = type;
+		pool->rate          = rate;
+		pool->multi_channel = multi_channel != 0;
+		pool->count         = 0;
+	}
+	return pool;
+}
+
+gme_err_t gme_pool_reserve( gme_pool_t* pool, int count )
+{
+	for ( ;; )
+	{
+		pool->lock();
+		bool const enough = pool->count >= (size_t) count;
+		pool->unlock();
+		if ( enough )
+			return 0;
+		Music_Emu* me = gme_internal_new_emu_( pool->type, pool->rate, pool->multi_channel, 0 );
+		CHECK_ALLOC( me );
+		RETURN_ERR( pool->add( me ) );
+	}
+}
+
+Music_Emu* gme_pool_acquire( gme_pool_t* pool )
+{
+	Music_Emu* me = 0;
+	pool->lock();
+	if ( pool->count )
+		me = pool->emus [--pool->count];
+	pool->unlock();
+	if ( !me )
+		me = gme_internal_new_emu_( pool->type, pool->rate, pool->multi_channel, 0 );
+	return me;
+}
+
+void gme_pool_release( gme_pool_t* pool, Music_Emu* me )
+{
+	if ( !me )
+		return;
+	gme_reset_for_reload( me );
+	if ( gme_set_sample_rate( me, pool->rate ) ) // in case user changed it
+	{
+		delete_emu( me );
+		return;
+	}
+	pool->add( me );
+}
+
+void gme_delete_pool( gme_pool_t* pool )
+{
+	if ( !pool )
+		return;
+	for ( size_t i = 0; i < pool->count; i++ )
+		delete_emu( pool->emus [i] );
+	delete pool;
+}
+
+struct gme_playlist_t : Gme_Playlist
+{
+	explicit gme_playlist_t( int rate ) : Gme_Playlist( rate ) { }
+};
+
+gme_playlist_t* gme_new_playlist( int sample_rate )
+{
+	require( sample_rate > 0 );
+	return BLARGG_NEW gme_playlist_t( sample_rate );
+}
+
+gme_err_t gme_playlist_add_file( gme_playlist_t* pl, const char* path, int track, int length, int fade )
+{
+	return pl->add_file( path, track, length, fade );
+}
+
+gme_err_t gme_playlist_add_data( gme_playlist_t* pl, void const* data, long size, int track,
+		int length, int fade )
+{
+	return pl->add_data( data, size, track, length, fade );
+}
+
+gme_err_t   gme_playlist_load_m3u     ( gme_playlist_t* pl, const char* path ) { return pl->load_m3u( path ); }
+void        gme_playlist_set_crossfade( gme_playlist_t* pl, int msec )         { pl->set_crossfade( msec < 0 ? 0 : msec ); }
+void        gme_playlist_play         ( gme_playlist_t* pl, int n, short* p )  { pl->play( n, p ); }
+void        gme_playlist_wait         ( gme_playlist_t* pl )                   { pl->wait(); }
+int         gme_playlist_current      ( gme_playlist_t const* pl )             { return pl->current(); }
+int         gme_playlist_ended        ( gme_playlist_t const* pl )             { return pl->ended(); }
+const char* gme_playlist_warning      ( gme_playlist_t* pl )                   { return pl->warning(); }
+void        gme_delete_playlist       ( gme_playlist_t* pl )                   { delete pl; }
 
 gme_type_t gme_type( Music_Emu const* me ) { return me->type(); }
 
@@ -381,27 +683,53 @@ void*     gme_user_data      ( Music_Emu const* me )                { return me-
 void      gme_set_user_data  ( Music_Emu* me, void* new_user_data ) { me->set_user_data( new_user_data ); }
 void      gme_set_user_cleanup(Music_Emu* me, gme_user_cleanup_t func ) { me->set_user_cleanup( func ); }
 
-gme_err_t gme_start_track    ( Music_Emu* me, int index )           { return me->start_track( index ); }
-gme_err_t gme_play           ( Music_Emu* me, int n, short* p )     { return me->play( n, p ); }
+gme_err_t gme_start_track( Music_Emu* me, int index )
+{
+	HEAP_SCOPE( me );
+	gme_err_t err = me->start_track( index );
+	gme_err_t lookahead_err = update_lookahead( me );
+	return err ? err : lookahead_err;
+}
+
+gme_err_t gme_play           ( Music_Emu* me, int n, short* p )     { HEAP_SCOPE( me ); return me->play( n, p ); }
+gme_err_t gme_play_planar    ( Music_Emu* me, int n, float* const* p ) { HEAP_SCOPE( me ); return me->play_planar( n, p ); }
 void      gme_set_fade       ( Music_Emu* me, int start_msec )      { me->set_fade( start_msec ); }
 void      gme_set_fade_msecs ( Music_Emu* me, int start_msec, int fade_msec ) { me->set_fade( start_msec, fade_msec ); }
+void      gme_set_event_func ( Music_Emu* me, gme_event_func_t func, void* data ) { me->set_event_func( func, data ); }
 int       gme_track_ended    ( Music_Emu const* me )                { return me->track_ended(); }
-int       gme_tell           ( Music_Emu const* me )                { return me->tell(); }
-int       gme_tell_samples   ( Music_Emu const* me )                { return me->tell_samples(); }
-int       gme_tell_scaled    ( Music_Emu const* me )                { return me->tell_scaled(); }
-gme_err_t gme_seek           ( Music_Emu* me, int msec )            { return me->seek( msec ); }
-gme_err_t gme_seek_samples   ( Music_Emu* me, int n )               { return me->seek_samples( n ); }
-gme_err_t gme_seek_scaled    ( Music_Emu* me, int msec )            { return me->seek_scaled( msec ); }
+int       gme_tell           ( Music_Emu const* me )                { return int (me->tell()); }
+int       gme_tell_samples   ( Music_Emu const* me )                { return int (me->tell_samples()); }
+int       gme_tell_scaled    ( Music_Emu const* me )                { return int (me->tell_scaled()); }
+int64_t   gme_tell64         ( Music_Emu const* me )                { return me->tell(); }
+int64_t   gme_tell_samples64 ( Music_Emu const* me )                { return me->tell_samples(); }
+gme_err_t gme_seek           ( Music_Emu* me, int msec )            { HEAP_SCOPE( me ); return me->seek( msec ); }
+gme_err_t gme_seek_samples   ( Music_Emu* me, int n )               { HEAP_SCOPE( me ); return me->seek_samples( n ); }
+gme_err_t gme_seek_scaled    ( Music_Emu* me, int msec )            { HEAP_SCOPE( me ); return me->seek_scaled( msec ); }
+gme_err_t gme_seek64         ( Music_Emu* me, int64_t msec )        { HEAP_SCOPE( me ); return me->seek( msec ); }
+gme_err_t gme_seek_samples64 ( Music_Emu* me, int64_t n )           { HEAP_SCOPE( me ); return me->seek_samples( n ); }
 int       gme_voice_count    ( Music_Emu const* me )                { return me->voice_count(); }
 void      gme_ignore_silence ( Music_Emu* me, int disable )         { me->ignore_silence( disable != 0 ); }
-void      gme_set_tempo      ( Music_Emu* me, double t )            { me->set_tempo( t ); }
+void      gme_set_tempo      ( Music_Emu* me, double t )            { HEAP_SCOPE( me ); me->set_tempo( t ); }
+void      gme_set_max_latency( Music_Emu* me, int msec )            { HEAP_SCOPE( me ); me->set_max_latency( msec < 0 ? 0 : msec ); update_lookahead( me ); }
 void      gme_mute_voice     ( Music_Emu* me, int index, int mute ) { me->mute_voice( index, mute != 0 ); }
 void      gme_mute_voices    ( Music_Emu* me, int mask )            { me->mute_voices( mask ); }
 void      gme_disable_echo   ( Music_Emu* me, int disable )         { me->disable_echo( disable ); }
-void      gme_enable_accuracy( Music_Emu* me, int enabled )         { me->enable_accuracy( enabled ); }
+void      gme_enable_accuracy( Music_Emu* me, int enabled )         { HEAP_SCOPE( me ); me->enable_accuracy( enabled ); update_lookahead( me ); }
+int       gme_native_sample_rate( Music_Emu const* me )             { return me->native_rate(); }
+
+gme_err_t gme_set_sample_rate( Music_Emu* me, int sample_rate )
+{
+	if ( sample_rate <= 0 )
+		return "Invalid sample rate";
+	HEAP_SCOPE( me );
+	RETURN_ERR( me->set_sample_rate( sample_rate ) );
+	return update_lookahead( me );
+}
+
 void      gme_clear_playlist ( Music_Emu* me )                      { me->clear_playlist(); }
 int       gme_type_multitrack( gme_type_t t )                       { return t->track_count != 1; }
 int       gme_multi_channel  ( Music_Emu const* me )                { return me->multi_channel(); }
+int       gme_channel_count  ( Music_Emu const* me )                { return me->out_channels(); }
 
 void      gme_set_equalizer  ( Music_Emu* me, gme_equalizer_t const* eq )
 {
@@ -419,6 +747,24 @@ void gme_equalizer( Music_Emu const* me, gme_equalizer_t* out )
 	*out = e;
 }
 
+gme_err_t gme_get_stats( Music_Emu const* me, gme_stats_t* out )
+{
+	*out = me->stats();
+	#ifndef GME_ENABLE_STATS
+		return "Library built without GME_ENABLE_STATS";
+	#endif
+	return 0;
+}
+
+gme_err_t gme_rt_report( Music_Emu const* me, gme_rt_report_t* out )
+{
+	*out = me->rt_report();
+	#ifndef GME_RT_CHECK
+		return "Library built without GME_RT_CHECK";
+	#endif
+	return 0;
+}
+
 const char* gme_voice_name( Music_Emu const* me, int i )
 {
 	assert( (unsigned) i < (unsigned) me->voice_count() );
@@ -4,6 +4,9 @@
 #ifndef GME_H
 #define GME_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 	extern "C" {
 #endif
@@ -47,6 +50,12 @@ BLARGG_EXPORT gme_err_t gme_start_track( Music_Emu*, int index );
 /* Generate 'count' 16-bit signed samples info 'out'. Output is in stereo. */
 BLARGG_EXPORT gme_err_t gme_play( Music_Emu*, int count, short out [] );
 
+/* Generate 'count' sample frames as floats from -1.0 to 1.0, writing each output
+ * channel to its own buffer in 'planes', which holds gme_channel_count() buffers
+ * of at least 'count' floats each.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_play_planar( Music_Emu*, int count, float* const* planes );
+
 /* Finish using emulator and free memory */
 BLARGG_EXPORT void gme_delete( Music_Emu* );
 
@@ -85,10 +94,12 @@ BLARGG_EXPORT int gme_autoload_playback_limit( Music_Emu const* );
 /* True if a track has reached its end */
 BLARGG_EXPORT int gme_track_ended( Music_Emu const* );
 
-/* Number of milliseconds (1000 = one second) played since beginning of track */
+/* Number of milliseconds (1000 = one second) played since beginning of track. Wraps
+around after about 24 days; see gme_tell64(). */
 BLARGG_EXPORT int gme_tell( Music_Emu const* );
 
-/* Number of samples generated since beginning of track */
+/* Number of samples generated since beginning of track. Wraps around after about 6
+hours at 48 kHz stereo; see gme_tell_samples64(). */
 BLARGG_EXPORT int gme_tell_samples( Music_Emu const* );
 
 /* Number of milliseconds played since beginning of track (scaled with tempo).
@@ -105,6 +116,14 @@ BLARGG_EXPORT gme_err_t gme_seek_samples( Music_Emu*, int n );
  * @since 0.6.5 */
 BLARGG_EXPORT gme_err_t gme_seek_scaled( Music_Emu*, int msec );
 
+/* Same as gme_tell(), gme_tell_samples(), gme_seek() and gme_seek_samples(), but with
+64-bit times that don't wrap around, for tracks played indefinitely.
+ * @since 0.6.5 */
+BLARGG_EXPORT int64_t gme_tell64( Music_Emu const* );
+BLARGG_EXPORT int64_t gme_tell_samples64( Music_Emu const* );
+BLARGG_EXPORT gme_err_t gme_seek64( Music_Emu*, int64_t msec );
+BLARGG_EXPORT gme_err_t gme_seek_samples64( Music_Emu*, int64_t n );
+
 
 /******** Informational ********/
 
@@ -170,6 +189,27 @@ BLARGG_EXPORT void gme_set_stereo_depth( Music_Emu*, double depth );
 if ignore is true */
 BLARGG_EXPORT void gme_ignore_silence( Music_Emu*, int ignore );
 
+/* Limit how far the emulator generates sound ahead of what gme_play() returns to
+about msec milliseconds, for interactive use where changes to muting, tempo,
+equalizer etc. should be heard quickly. Smaller values cost more CPU, since sound
+is generated in smaller pieces. Silence detection then looks ahead no faster than
+playback, rather than running seconds ahead during silence. GYM is still generated
+a whole 1/60 second frame at a time, since that's how its commands are timed. 0
+restores the default, where most formats generate up to 50 ms at a time.
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_set_max_latency( Music_Emu*, int msec );
+
+/* When silence begins, end-of-track detection normally runs the emulator a few times
+faster than playback inside gme_play(), making that call take much longer than
+usual. If enable is true, that's done on a helper thread with a copy of the
+emulator instead, and gme_play() never generates more than it returns. The track
+still ends at about the same point. Creates the thread, and a copy of the emulator
+whenever a track starts, so call from where allocation and blocking are OK, not
+from the audio thread. Disabled by gme_reset_for_reload() and not copied by
+gme_clone().
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_set_background_lookahead( Music_Emu*, int enable );
+
 /* Adjust song tempo, where 1.0 = normal, 0.5 = half speed, 2.0 = double speed.
 Track length as returned by track_info() assumes a tempo of 1.0. */
 BLARGG_EXPORT void gme_set_tempo( Music_Emu*, double tempo );
@@ -207,9 +247,93 @@ BLARGG_EXPORT void gme_equalizer( Music_Emu const*, gme_equalizer_t* out );
 /* Change frequency equalizer parameters */
 BLARGG_EXPORT void gme_set_equalizer( Music_Emu*, gme_equalizer_t const* eq );
 
-/* Enables/disables most accurate sound emulation options */
+/* Enables/disables most accurate sound emulation options. For SPC, enabling adds
+filtering to match the SNES's analog output, and disabling selects a faster DSP
+mode that runs voices in blocks, dropping a few rarely heard timing quirks. By
+default SPC uses full DSP emulation without the output filter. */
 BLARGG_EXPORT void gme_enable_accuracy( Music_Emu*, int enabled );
 
+/* Sample rate the emulator generates sound at before resampling to the rate passed
+to gme_open_data() etc., or 0 if it synthesizes directly at the output rate. This is
+32000 for SPC and the FM chip rate for GYM and VGM with FM. Opening a file with this
+rate as its sample rate skips resampling entirely, so a host that resamples anyway
+only does it once. For VGM the rate depends on the file, so it's only valid after
+loading.
+ * @since 0.6.5 */
+BLARGG_EXPORT int gme_native_sample_rate( Music_Emu const* );
+
+/* Change output sample rate of an emulator, even one that has a file loaded and is
+in the middle of a track. Playback continues from about the same position, after a
+click as a few milliseconds of buffered output are dropped. Buffers are reused where
+possible rather than reallocated. For GYM and VGM with FM the FM chip keeps running
+at its old rate until the next gme_start_track(), so output matches a newly opened
+emulator only from then on. If this returns an error the emulator can only be
+deleted.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_set_sample_rate( Music_Emu*, int sample_rate );
+
+/* Performance counters accumulated by an emulator since it was created. Counts are
+totals; times are wall-clock seconds spent in each stage, not counting time spent in
+stages nested inside it (e.g. APU time isn't included in CPU time). Only collected
+if the library was built with GME_ENABLE_STATS, which adds a little overhead. */
+typedef struct gme_stats_t
+{
+	long long cpu_clocks;        /* sound hardware clocks emulated */
+	long long instructions;      /* CPU instructions executed */
+	long long apu_writes;        /* writes to sound chip registers */
+	long long blip_deltas;       /* amplitude changes added to Blip_Buffers */
+	long long samples_resampled; /* samples passed through FIR resampler */
+	long long lookahead_samples; /* samples generated ahead for silence detection */
+
+	long long l6,l7,l8,l9,l10,l11,l12,l13,l14,l15; /* reserved */
+
+	double cpu_time;             /* CPU and command stream emulation */
+	double apu_time;             /* sound chip emulation */
+	double synth_time;           /* band-limited synthesis and mixing */
+	double resample_time;        /* resampling and output filtering */
+	double effects_time;         /* stereo echo and effects */
+	double fade_time;            /* fading out at end of track */
+
+	double d6,d7,d8,d9,d10,d11,d12,d13,d14,d15; /* reserved */
+} gme_stats_t;
+
+/* Get performance counters for emulator. If the library was built without
+GME_ENABLE_STATS, sets *out to all zeroes and returns an error.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_get_stats( Music_Emu const*, gme_stats_t* out );
+
+/* Things done by calls that may be made on a real-time audio thread once a track is
+started, which would make them unsafe there. Those calls are gme_play(),
+gme_play_planar(), gme_set_fade(), gme_set_fade_msecs(), gme_mute_voice(),
+gme_mute_voices(), gme_set_tempo() and gme_set_equalizer(). Only checked if the library
+was built with GME_RT_CHECK, a debugging aid which adds a little overhead. */
+typedef struct gme_rt_report_t
+{
+	long allocs;        /* memory allocations and frees */
+	long locks;         /* locks taken */
+	long file_io;       /* file operations */
+	long overruns;      /* plays that emulated far more than they output, which happens
+	                       when silence detection catches up unless gme_set_max_latency()
+	                       or gme_set_background_lookahead() was used */
+	const char* last;   /* what the most recent was, or NULL if none */
+
+	long l5,l6,l7,l8,l9,l10,l11,l12,l13,l14,l15; /* reserved */
+} gme_rt_report_t;
+
+/* Get report of unsafe things done in real-time calls to emulator since it was created.
+If the library was built without GME_RT_CHECK, sets *out to all zeroes and returns an
+error.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_rt_report( Music_Emu const*, gme_rt_report_t* out );
+
+/* Create an independent copy of an emulator in its current state, with the same file,
+track position and settings, and set *out to it. Both then generate identical output
+when played the same way. The file data is shared rather than copied, so this is much
+faster than opening the file again. Can't be used on an emulator opened with
+gme_info_only.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_clone( Music_Emu const*, Music_Emu** out );
+
 
 /******** Game music types ********/
 
@@ -243,11 +367,20 @@ BLARGG_EXPORT const char* gme_type_system( gme_type_t );
 /* True if this music file type supports multiple tracks */
 BLARGG_EXPORT int gme_type_multitrack( gme_type_t );
 
-/* whether the pcm output retrieved by gme_play() will have all 8 voices rendered to their
- * individual stereo channel or (if false) these voices get mixed into one single stereo channel
+/* whether the pcm output retrieved by gme_play() will have each voice rendered to its
+ * individual stereo channel or (if false) these voices get mixed into one single stereo channel.
+ * See gme_channel_count() for the resulting number of channels.
+ * Besides the "classic" emulators, SPC (dry, without echo), GYM and YM2612 VGM files support
+ * this, the latter two as 6 FM channels followed by PCM and PSG.
  * @since 0.6.3 */
 BLARGG_EXPORT int gme_multi_channel( Music_Emu const* );
 
+/* Number of interleaved channels in each sample frame generated by gme_play(): 2 unless
+ * in multi-channel mode, where each voice gets a stereo pair. That is at least 16 channels,
+ * more if the loaded file has over 8 voices, so check again after loading a file.
+ * @since 0.6.5 */
+BLARGG_EXPORT int gme_channel_count( Music_Emu const* );
+
 /******** Advanced file loading ********/
 
 /* Error returned if file type is not supported */
@@ -313,6 +446,245 @@ BLARGG_EXPORT gme_err_t gme_load_custom( Music_Emu*, gme_reader_t, long file_siz
 /* Load m3u playlist file from memory (must be done after loading music) */
 BLARGG_EXPORT gme_err_t gme_load_m3u_data( Music_Emu*, void const* data, long size );
 
+/* Unload file and restore the settings emulator had when created: tempo, voice muting,
+equalizer, stereo depth, echo, accuracy, silence handling, track length limit and
+latency. Sample rate, multi-channel mode, user data and buffers are kept, so loading
+another file of the same type with gme_load_data() etc. then only allocates what that
+file needs. Can't be used on an emulator opened with gme_info_only.
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_reset_for_reload( Music_Emu* );
+
+/* Pool of emulators of one type and sample rate, for reusing them across files rather
+than creating and deleting one each time. Can be used from several threads at once.
+ * @since 0.6.5 */
+typedef struct gme_pool_t gme_pool_t;
+
+/* Create empty pool of emulators of given type and sample rate, which use
+multi-channel output if multi_channel is non-zero (see gme_new_emu_multi_channel()).
+Returns NULL if out of memory.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_pool_t* gme_new_pool( gme_type_t, int sample_rate, int multi_channel );
+
+/* Create emulators until pool holds at least count of them, so later calls to
+gme_pool_acquire() don't have to.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_pool_reserve( gme_pool_t*, int count );
+
+/* Take an emulator with no file loaded from pool, or create one if pool is empty.
+Returns NULL if out of memory.
+ * @since 0.6.5 */
+BLARGG_EXPORT Music_Emu* gme_pool_acquire( gme_pool_t* );
+
+/* Reset emulator from gme_pool_acquire() with gme_reset_for_reload(), and to the pool's
+sample rate if that was changed, then put it back in pool for reuse.
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_pool_release( gme_pool_t*, Music_Emu* );
+
+/* Delete pool and emulators in it. Emulators acquired and not released must still be
+deleted with gme_delete().
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_delete_pool( gme_pool_t* );
+
+/* Functions the library allocates and frees memory with. alloc must return memory
+aligned as malloc()'s is, or NULL if out of memory. Both get user_data.
+ * @since 0.6.5 */
+typedef struct gme_allocator_t
+{
+	void* (*alloc)( void* user_data, size_t size );
+	void  (*free)( void* user_data, void* p );
+	void* user_data;
+} gme_allocator_t;
+
+/* Allocate all memory with copy of allocator from now on, or with malloc() and free()
+again if NULL. Must only be called when nothing allocated by the library exists
+(emulators, pools, track info). Allocator is called from whichever threads use the
+library, so it must be thread-safe if several do.
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_set_allocator( gme_allocator_t const* );
+
+/* Same as gme_new_emu(), or gme_new_emu_multi_channel() if multi_channel is non-zero,
+except that all memory for the emulator comes from an arena of arena_size bytes that
+is allocated now and freed by gme_delete(). Loading files, starting tracks, playing
+etc. then never allocate memory otherwise, and fail with "Out of memory" if the arena
+runs out. gme_memory_usage() shows how much a file needs. A clone of the emulator
+gets an arena of the same size. Returns NULL if out of memory.
+ * @since 0.6.5 */
+BLARGG_EXPORT Music_Emu* gme_new_emu_arena( gme_type_t, int sample_rate, int multi_channel,
+		size_t arena_size );
+
+/* Memory allocated for an emulator, in bytes, including file data and allocator
+overhead. Only memory allocated by gme_ functions is counted, so a Music_Emu created
+directly in C++ and emulators opened with gme_info_only report 0.
+ * @since 0.6.5 */
+typedef struct gme_memory_t
+{
+	size_t current;     /* allocated now */
+	size_t peak;        /* most allocated at once since emulator was created */
+	size_t arena_size;  /* size of arena, or 0 if not created with gme_new_emu_arena() */
+} gme_memory_t;
+
+/* Get memory usage of emulator
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_memory_usage( Music_Emu const*, gme_memory_t* out );
+
+/* String that isn't nul-terminated, with len of 0 if not available
+ * @since 0.6.5 */
+typedef struct gme_str_t
+{
+	const char* str;
+	int len;
+} gme_str_t;
+
+/* Track information passed to gme_probe_func_t. Fields have the same meanings as in
+gme_info_t.
+ * @since 0.6.5 */
+typedef struct gme_probe_t
+{
+	gme_type_t type;
+	int track;              /* 0 to track_count - 1 */
+	int track_count;
+
+	/* times in milliseconds; -1 if unknown */
+	int length;
+	int intro_length;
+	int loop_length;
+	int fade_length;
+
+	gme_str_t system;
+	gme_str_t game;
+	gme_str_t song;
+	gme_str_t author;
+	gme_str_t copyright;
+	gme_str_t comment;
+	gme_str_t dumper;
+} gme_probe_t;
+
+/* Called by gme_probe_info() for each track in order. Return non-zero to stop.
+ * @since 0.6.5 */
+typedef int (*gme_probe_func_t)( void* user_data, gme_probe_t const* );
+
+/* Get information about each track of music file data by parsing its header directly,
+without creating an emulator, copying data, or allocating memory, so scanning a large
+library is much faster than opening each file with gme_info_only. Gives the same
+information as gme_track_info(), except that no m3u playlist is applied and strings
+aren't truncated to fit fixed-size fields. Strings point into data, or into temporary
+storage where text had to be converted (VGM's UTF-16 and SAP's quoted strings, for
+example), so they're only valid during the call to func. Compressed VGZ data isn't
+supported. Returns error if data is wrong type or corrupt, and func isn't called.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_probe_info( void const* data, long size, gme_probe_func_t func,
+		void* user_data );
+
+
+/******** Events ********/
+
+/* Kinds of event passed to gme_event_func_t
+ * @since 0.6.5 */
+typedef enum gme_event_type_t
+{
+	gme_event_track_end = 1, /* track ended, by fade, silence or emulator reaching its end */
+	gme_event_fade_start,    /* fade began */
+	gme_event_loop,          /* track reached end of its loop and went back to loop start */
+	gme_event_silence_start, /* silence began that will end track if it lasts */
+	gme_event_warning        /* emulator set a warning */
+} gme_event_type_t;
+
+/* Something that happened during a call to gme_play() or gme_play_planar()
+ * @since 0.6.5 */
+typedef struct gme_event_t
+{
+	gme_event_type_t type;
+	int offset;          /* sample in gme_play()'s buffer (frame for gme_play_planar())
+	                        where event happened, from 0 to count */
+	int64_t time;        /* gme_tell_samples64() at that point */
+	int loop;            /* gme_event_loop: number of times loop has been reached */
+	const char* warning; /* gme_event_warning: same as gme_warning(), which still returns it */
+} gme_event_t;
+
+/* Called with each event, in order of time
+ * @since 0.6.5 */
+typedef void (*gme_event_func_t)( void* user_data, gme_event_t const* );
+
+/* Have func called with events at exact sample offsets, so large blocks can be played
+rather than checking gme_track_ended() etc. after small ones. Calls are made on the
+thread that called gme_play() or gme_play_planar(), just before it returns, and func
+must not play. Loop points come from the track's intro and loop lengths, in
+gme_track_info() or an m3u playlist; VGM uses the exact ones in its header. Where
+silence or a warning was found after sound was generated, or an emulator ended on its
+own, the event is at the end of the block that found it, or where the silence began
+for silence. Silence isn't reported while gme_ignore_silence() is on, and nothing is
+reported while seeking. At most 32 events are reported for each call and any more are
+dropped. Pass NULL to stop. Not copied by gme_clone().
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_set_event_func( Music_Emu*, gme_event_func_t func, void* user_data );
+
+
+/******** Playlists ********/
+
+/* List of tracks played one after another with no gap between them. A helper thread
+opens each file and starts its track, which can take a while when it begins with
+silence, while the track before it plays, so gme_playlist_play() only has to generate
+sound. Tracks can be added while it plays, from another thread.
+ * @since 0.6.5 */
+typedef struct gme_playlist_t gme_playlist_t;
+
+/* Create empty playlist with stereo output at sample_rate, and start its thread.
+Returns NULL if out of memory.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_playlist_t* gme_new_playlist( int sample_rate );
+
+/* Add track of file or file data to end of playlist. length_msec of -1 uses length
+from track information, or intro plus two loops, or 2.5 minutes, and 0 plays until
+track ends by itself. fade_msec of -1 uses track information's or 8 seconds. Data is
+copied. File isn't opened until shortly before it plays, and if that fails it's
+skipped and gme_playlist_warning() gives the error.
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_playlist_add_file( gme_playlist_t*, const char path [], int track,
+		int length_msec, int fade_msec );
+BLARGG_EXPORT gme_err_t gme_playlist_add_data( gme_playlist_t*, void const* data, long size,
+		int track, int length_msec, int fade_msec );
+
+/* Add each entry of m3u playlist file, whose file names are relative to its directory.
+Entries' times are used as with gme_load_m3u().
+ * @since 0.6.5 */
+BLARGG_EXPORT gme_err_t gme_playlist_load_m3u( gme_playlist_t*, const char path [] );
+
+/* Start each track while the one before it still has msec of its fade to go, fading
+the new one in over that time. 0 (the default) starts each track at the exact sample
+where the one before it ends. Tracks that end by themselves rather than with a fade
+aren't crossfaded.
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_playlist_set_crossfade( gme_playlist_t*, int msec );
+
+/* Generate count 16-bit stereo samples into out. Output is silent while there's no
+track ready to play. Doesn't block or allocate, so it can be called from an audio
+thread.
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_playlist_play( gme_playlist_t*, int count, short out [] );
+
+/* Wait until the track after the one playing is ready, or all tracks have been tried.
+For rendering faster than real time, call before each gme_playlist_play() so it never
+outputs silence waiting for one. Not for an audio thread.
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_playlist_wait( gme_playlist_t* );
+
+/* Index of track playing as of last gme_playlist_play(), in order added, or -1 if none
+ * @since 0.6.5 */
+BLARGG_EXPORT int gme_playlist_current( gme_playlist_t const* );
+
+/* True if all tracks added so far have been played
+ * @since 0.6.5 */
+BLARGG_EXPORT int gme_playlist_ended( gme_playlist_t const* );
+
+/* Most recent error opening a track, which was skipped, or NULL if none. Clears it
+after returning it.
+ * @since 0.6.5 */
+BLARGG_EXPORT const char* gme_playlist_warning( gme_playlist_t* );
+
+/* Stop thread and delete playlist
+ * @since 0.6.5 */
+BLARGG_EXPORT void gme_delete_playlist( gme_playlist_t* );
+
 
 /******** User data ********/
 
@@ -5,6 +5,8 @@
 #include <string.h>
 #include <ctype.h>
 #include "SDL_rwops.h"
+#include "SDL_thread.h"
+#include "SDL_timer.h"
 #include "Archive_Reader.h"
 
 /* Copyright (C) 2005-2010 by Shay Green. Permission is hereby granted, free of
@@ -35,6 +37,12 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 // scope
 static const int fill_rate = 80;
 
+// Number of samples render thread generates at a time
+static const int render_block_size = 1024;
+
+// Number of commands that can wait for render thread before post() blocks
+static const int max_commands = 64;
+
 // Simple sound driver using SDL
 typedef void (*sound_callback_t)( void* data, short* out, int count );
 static const char* sound_init( long sample_rate, int buf_size, sound_callback_t, void* data );
@@ -64,13 +72,25 @@ static const arc_type_t arcs[] = {
 
 Music_Player::Music_Player()
 {
-	emu_        = 0;
-	scope_buf   = 0;
-	paused      = false;
-	track_info_ = NULL;
+	emu_          = 0;
+	scope_buf     = 0;
+	track_info_   = NULL;
+	render_thread = NULL;
+	lookahead     = 0;
+	track_serial  = 0;
+	render_serial = 0;
+	stop_rendering   = false;
+	discard_pos      = 0;
+	paused           = false;
+	rendering        = false;
+	render_time      = 0;
+	ended_serial     = 0;
+	render_error     = NULL;
+	underrun_count   = 0;
+	underrun_samples = 0;
 }
 
-gme_err_t Music_Player::init( long rate )
+gme_err_t Music_Player::init( long rate, int lookahead_msec )
 {
 	sample_rate = rate;
 
@@ -79,21 +99,55 @@ gme_err_t Music_Player::init( long rate )
 	while ( buf_size < min_size )
 		buf_size *= 2;
 
+	// device takes buf_size stereo frames per callback, so stay at least two ahead
+	lookahead = sample_rate * 2 * lookahead_msec / 1000;
+	if ( lookahead < (size_t) buf_size * 4 )
+		lookahead = (size_t) buf_size * 4;
+	RETURN_ERR( samples.resize( lookahead + render_block_size ) );
+	RETURN_ERR( commands.resize( max_commands ) );
+
 	return sound_init( sample_rate, buf_size, fill_buffer, this );
 }
 
 void Music_Player::stop()
 {
 	sound_stop();
+	stop_render_thread();
+	free_info();
 	gme_delete( emu_ );
 	emu_ = NULL;
 }
 
+gme_err_t Music_Player::read_info()
+{
+	int const count = gme_track_count( emu_ );
+	RETURN_ERR( track_infos.resize( count ) );
+	for ( int i = 0; i < count; i++ )
+		track_infos [i] = NULL;
+	for ( int i = 0; i < count; i++ )
+		RETURN_ERR( gme_track_info( emu_, &track_infos [i], i ) );
+
+	// names are owned by emulator, so they last until it's deleted
+	int const voices = gme_voice_count( emu_ );
+	RETURN_ERR( voice_names.resize( voices ) );
+	for ( int i = 0; i < voices; i++ )
+		voice_names [i] = gme_voice_name( emu_, i );
+	return 0;
+}
+
+void Music_Player::free_info()
+{
+	for ( size_t i = 0; i < track_infos.size(); i++ )
+		gme_free_info( track_infos [i] );
+	track_infos.clear();
+	voice_names.clear();
+	track_info_ = NULL;
+}
+
 Music_Player::~Music_Player()
 {
 	stop();
 	sound_cleanup();
-	gme_free_info( track_info_ );
 }
 
 // check if file is an archive
@@ -199,25 +253,17 @@ gme_err_t Music_Player::load_file(const char* path , bool by_mem)
 	if ( gme_load_m3u( emu_, m3u_path ) ) { } // ignore error
 
 	//gme_ignore_silence(emu_, 1);
-	return 0;
-}
-
-int Music_Player::track_count() const
-{
-	return emu_ ? gme_track_count( emu_ ) : false;
+	RETURN_ERR( read_info() );
+	return start_rendering();
 }
 
 gme_err_t Music_Player::start_track( int track )
 {
 	if ( emu_ )
 	{
-		// Sound must not be running when operating on emulator
-		sound_stop();
-		RETURN_ERR( gme_start_track( emu_, track ) );
-
-		gme_free_info( track_info_ );
-		track_info_ = nullptr;
-		RETURN_ERR( gme_track_info( emu_, &track_info_, track ) );
+		if ( track < 0 || track >= track_count() )
+			return "Invalid track";
+		track_info_ = track_infos [track];
 
 		// Calculate track length
 		if ( track_info_->play_length > 0 )
@@ -233,7 +279,7 @@ gme_err_t Music_Player::start_track( int track )
 			//track_info_->length = (long) (2.5 * 60 * 1000);
 		//gme_set_fade_msecs( emu_, track_info_->length, 1 );
 
-		paused = false;
+		post( cmd_start_track, track, ++track_serial );
 		sound_start();
 	}
 	return 0;
@@ -241,102 +287,54 @@ gme_err_t Music_Player::start_track( int track )
 
 void Music_Player::pause( int b )
 {
-	paused = b;
-	if ( b )
-	{
-		sound_stop();
-	}
-	else
-	{
-		sound_start();
-	}
-}
-
-void Music_Player::suspend()
-{
-	if ( !paused )
-		sound_stop();
-}
-
-void Music_Player::resume()
-{
-	if ( !paused )
-		sound_start();
+	post( cmd_pause, b );
 }
 
 bool Music_Player::track_ended() const
 {
-	return emu_ ? gme_track_ended( emu_ ) : false;
+	// not over until device has played everything rendered
+	return emu_ ? ended_serial == track_serial && !samples.count() : false;
 }
 
-void Music_Player::set_stereo_depth( double tempo )
+void Music_Player::set_stereo_depth( double depth )
 {
-	suspend();
-	gme_set_stereo_depth( emu_, tempo );
-	resume();
+	post( cmd_stereo_depth, 0, 0, depth );
 }
 
 void Music_Player::enable_accuracy( bool b )
 {
-	suspend();
-	gme_enable_accuracy( emu_, b );
-	resume();
+	post( cmd_accuracy, b );
 }
 
 void Music_Player::set_tempo( double tempo )
 {
-	suspend();
-	gme_set_tempo( emu_, tempo );
-	resume();
+	post( cmd_tempo, 0, 0, tempo );
 }
 
 void Music_Player::set_echo_disable( bool d )
 {
-	suspend();
-	gme_disable_echo( emu_, d );
-	resume();
+	post( cmd_echo, d );
 }
 
 void Music_Player::mute_voices( int mask )
 {
-	suspend();
-	gme_mute_voices( emu_, mask );
-	gme_ignore_silence( emu_, mask != 0 );
-	resume();
-}
-
-int Music_Player::get_voice_count()
-{
-	return gme_voice_count(emu_);
-}
-
-const char* Music_Player::get_voice_name(int i)
-{
-	return gme_voice_name(emu_, i);
+	post( cmd_mute, mask );
 }
 
 void Music_Player::seek_forward()
 {
-	suspend();
-	int pos = gme_tell( emu_ );
-	if ( pos > 0 )
-		gme_seek( emu_, pos + 1000 );
-	resume();
+	post( cmd_seek, 1000 );
 }
 
 void Music_Player::seek_backward()
 {
-	suspend();
-	int pos = gme_tell( emu_ );
-	if ( pos > 0 )
-		gme_seek( emu_, pos - 1000 );
-	resume();
+	post( cmd_seek, -1000 );
 }
 
 void Music_Player::set_fadeout( int fadems )
 {
 	if(track_info_)
-		gme_set_fade_msecs(emu_, playtime - fadems, fadems);
+		post( cmd_fade, playtime - fadems, fadems );
 		//gme_set_fade_msecs(emu_, playtime, fadems);
 }
 
@@ -346,7 +344,19 @@ void Music_Player::fill_buffer( void* data, sample_t* out, int count )
 	self->maxval=0;
 	if ( self->emu_ )
 	{
-		if ( gme_play( self->emu_, count, out ) ) { } // ignore error
+		// drop samples made obsolete by a seek or track change
+		self->samples.skip_to( self->discard_pos );
+
+		int n = self->paused ? 0 : (int) self->samples.read( out, count );
+		if ( n < count )
+		{
+			memset( out + n, 0, (count - n) * sizeof *out );
+			if ( self->rendering && !self->paused )
+			{
+				self->underrun_count++;
+				self->underrun_samples += count - n;
+			}
+		}
 
 		if ( self->scope_buf )
 			memcpy( self->scope_buf, out, self->scope_buf_size * sizeof *self->scope_buf );
@@ -361,13 +371,175 @@ void Music_Player::fill_buffer( void* data, sample_t* out, int count )
 
 int Music_Player::get_time()
 {
-	int pos = gme_tell( emu_ );
-	return pos;
+	// device is behind render thread by whatever is still in the ring
+	long pending = (long) samples.count() * 1000 / (sample_rate * 2);
+	int pos = render_time - (int) pending;
+	return pos > 0 ? pos : 0;
 }
 
 const char* Music_Player::get_error()
 {
-	return gme_warning( emu_ );
+	return render_error.exchange( NULL );
+}
+
+Music_Player::underrun_t Music_Player::underruns() const
+{
+	underrun_t u = { underrun_count, underrun_samples };
+	return u;
+}
+
+void Music_Player::reset_underruns()
+{
+	underrun_count   = 0;
+	underrun_samples = 0;
+}
+
+// Render thread
+
+void Music_Player::post( command_type_t type, int i, int i2, double d )
+{
+	if ( !render_thread )
+		return;
+
+	command_t cmd = { type, i, i2, d };
+	while ( !commands.write( &cmd, 1 ) )
+		SDL_Delay( 1 ); // render thread is busy; only the caller waits
+}
+
+void Music_Player::run_command( command_t const& cmd )
+{
+	switch ( cmd.type )
+	{
+	case cmd_start_track: {
+		rendering     = false;
+		render_serial = cmd.i2;
+		gme_err_t err = gme_start_track( emu_, cmd.i );
+		if ( err )
+		{
+			render_error = err;
+			ended_serial = render_serial;
+		}
+		render_time = 0;
+		paused      = false;
+		discard_pos = samples.write_position();
+		break;
+	}
+
+	case cmd_seek: {
+		// relative to what's being heard, not what's been rendered
+		int pos = get_time() + cmd.i;
+		rendering = false;
+		gme_err_t err = gme_seek( emu_, pos > 0 ? pos : 0 );
+		if ( err )
+			render_error = err;
+		render_time  = gme_tell( emu_ );
+		ended_serial = gme_track_ended( emu_ ) ? render_serial : -1;
+		discard_pos  = samples.write_position();
+		break;
+	}
+
+	case cmd_pause:
+		paused = cmd.i != 0;
+		if ( paused )
+			rendering = false;
+		break;
+
+	case cmd_tempo:
+		gme_set_tempo( emu_, cmd.d );
+		break;
+
+	case cmd_accuracy:
+		gme_enable_accuracy( emu_, cmd.i );
+		break;
+
+	case cmd_stereo_depth:
+		gme_set_stereo_depth( emu_, cmd.d );
+		break;
+
+	case cmd_echo:
+		gme_disable_echo( emu_, cmd.i );
+		break;
+
+	case cmd_mute:
+		gme_mute_voices( emu_, cmd.i );
+		gme_ignore_silence( emu_, cmd.i != 0 );
+		break;
+
+	case cmd_fade:
+		gme_set_fade_msecs( emu_, cmd.i, cmd.i2 );
+		break;
+	}
+	report_warning();
+}
+
+// Passes emulator's warning on to get_error(), unless an error is still waiting there
+void Music_Player::report_warning()
+{
+	if ( const char* w = gme_warning( emu_ ) )
+	{
+		gme_err_t none = NULL;
+		render_error.compare_exchange_strong( none, w );
+	}
+}
+
+int Music_Player::render_loop( void* data )
+{
+	Music_Player* self = (Music_Player*) data;
+	sample_t block [render_block_size];
+	while ( !self->stop_rendering )
+	{
+		command_t cmd;
+		while ( self->commands.read( &cmd, 1 ) )
+			self->run_command( cmd );
+
+		if ( self->paused || self->ended_serial == self->render_serial ||
+				self->samples.count() + render_block_size > self->lookahead )
+		{
+			SDL_Delay( 2 );
+			continue;
+		}
+
+		if ( gme_play( self->emu_, render_block_size, block ) ) { } // ignore error
+		self->report_warning();
+		self->render_time = gme_tell( self->emu_ );
+		self->samples.write( block, render_block_size );
+		self->rendering = true;
+
+		if ( gme_track_ended( self->emu_ ) )
+		{
+			self->rendering    = false;
+			self->ended_serial = self->render_serial;
+		}
+	}
+	return 0;
+}
+
+gme_err_t Music_Player::start_rendering()
+{
+	stop_rendering = false;
+	render_thread = SDL_CreateThread( render_loop, "gme render", this );
+	if ( !render_thread )
+		return "Couldn't create render thread";
+	return 0;
+}
+
+void Music_Player::stop_render_thread()
+{
+	if ( render_thread )
+	{
+		stop_rendering = true;
+		SDL_WaitThread( render_thread, NULL );
+		render_thread = NULL;
+	}
+
+	// sound is stopped too, so nothing else is using these
+	samples.clear();
+	commands.clear();
+	discard_pos  = 0;
+	paused       = false;
+	rendering    = false;
+	render_time  = 0;
+	ended_serial = track_serial;
 }
 
 // Sound output driver using SDL
@@ -7,12 +7,124 @@
 #include <stddef.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <atomic>
 #include "gme/gme.h"
 
+struct SDL_Thread;
+
+// gme_vector - very lightweight vector of POD types (no constructor/destructor)
+template<class T>
+class gme_vector {
+	T* begin_;
+	size_t size_;
+public:
+	gme_vector() : begin_( 0 ), size_( 0 ) { }
+	~gme_vector() { free( begin_ ); }
+	size_t size() const { return size_; }
+	T* begin() const { return begin_; }
+	T* end() const { return begin_ + size_; }
+	gme_err_t resize( size_t n )
+	{
+		void* p = realloc( begin_, n * sizeof (T) );
+		if ( !p && n )
+			return "Out of memory";
+		begin_ = (T*) p;
+		size_ = n;
+		return 0;
+	}
+	void clear() { free( begin_ ); begin_ = nullptr; size_ = 0; }
+	T& operator [] ( size_t n ) const
+	{
+		assert( n <= size_ ); // <= to allow past-the-end value
+		return begin_ [n];
+	}
+};
+
+// gme_ring - lock-free ring buffer of POD types for one writer thread and one
+// reader thread. Positions only ever increase, so a position handed from the
+// writer to the reader stays valid for skip_to().
+template<class T>
+class gme_ring {
+	gme_vector<T> buf;
+	size_t mask;
+	std::atomic<size_t> write_pos; // only changed by writer
+	std::atomic<size_t> read_pos;  // only changed by reader
+public:
+	gme_ring() : mask( 0 ), write_pos( 0 ), read_pos( 0 ) { }
+
+	// Make room for at least n items and empty ring. Neither thread may be using it.
+	gme_err_t resize( size_t n )
+	{
+		size_t size = 1;
+		while ( size < n )
+			size *= 2;
+		gme_err_t err = buf.resize( size );
+		if ( err )
+			return err;
+		mask = size - 1;
+		clear();
+		return 0;
+	}
+
+	// Empty ring. Neither thread may be using it.
+	void clear() { write_pos = 0; read_pos = 0; }
+
+	size_t capacity() const { return buf.size(); }
+
+	// Number of items waiting to be read
+	size_t count() const { return write_pos.load( std::memory_order_acquire ) -
+			read_pos.load( std::memory_order_acquire ); }
+
+	// Writer: add up to n items and return number added
+	size_t write( T const* in, size_t n )
+	{
+		size_t w = write_pos.load( std::memory_order_relaxed );
+		size_t free_count = capacity() - (w - read_pos.load( std::memory_order_acquire ));
+		if ( n > free_count )
+			n = free_count;
+		size_t first = capacity() - (w & mask);
+		if ( first > n )
+			first = n;
+		memcpy( &buf [w & mask], in, first * sizeof *in );
+		memcpy( buf.begin(), in + first, (n - first) * sizeof *in );
+		write_pos.store( w + n, std::memory_order_release );
+		return n;
+	}
+
+	// Writer: position just past last item added
+	size_t write_position() const { return write_pos.load( std::memory_order_relaxed ); }
+
+	// Reader: remove up to n items and return number removed
+	size_t read( T* out, size_t n )
+	{
+		size_t r = read_pos.load( std::memory_order_relaxed );
+		size_t avail = write_pos.load( std::memory_order_acquire ) - r;
+		if ( n > avail )
+			n = avail;
+		size_t first = capacity() - (r & mask);
+		if ( first > n )
+			first = n;
+		memcpy( out, &buf [r & mask], first * sizeof *out );
+		memcpy( out + first, buf.begin(), (n - first) * sizeof *out );
+		read_pos.store( r + n, std::memory_order_release );
+		return n;
+	}
+
+	// Reader: discard items before pos, a value from write_position()
+	void skip_to( size_t pos )
+	{
+		size_t r = read_pos.load( std::memory_order_relaxed );
+		if ( (ptrdiff_t) (pos - r) > 0 )
+			read_pos.store( pos, std::memory_order_release );
+	}
+};
+
 class Music_Player {
 public:
-	// Initialize player and set sample rate
-	gme_err_t init( long sample_rate = 44100 );
+	// Initialize player and set sample rate. Emulation runs on its own thread,
+	// which stays up to lookahead_msec ahead of the sound device.
+	gme_err_t init( long sample_rate = 44100, int lookahead_msec = 200 );
 
 	// Load game music file. NULL on success, otherwise error string.
 	gme_err_t load_file( const char* path, bool by_mem );
@@ -26,7 +138,7 @@ public:
 // Optional functions
 
 	// Number of tracks in current file, or 0 if no file loaded.
-	int track_count() const;
+	int track_count() const { return (int) track_infos.size(); }
 
 	// Info for current track
 	gme_info_t const& track_info() const { return *track_info_; }
@@ -37,7 +149,8 @@ public:
 	// True if track ended
 	bool track_ended() const;
 
-	// Pointer to emulator
+	// Pointer to emulator. Only safe to use while no file is loaded, since the
+	// render thread uses it the rest of the time.
 	Music_Emu* emu() const { return emu_; }
 
 	// Set stereo depth, where 0.0 = none and 1.0 = maximum
@@ -70,14 +183,24 @@ public:
 
 	int get_time();
 
+	// Error or warning from render thread since last call, or NULL if none
 	const char *get_error();
 
-	int get_voice_count();
+	int get_voice_count() const { return (int) voice_names.size(); }
 
-	const char* get_voice_name(int i);
+	const char* get_voice_name(int i) const { return voice_names [i]; }
 
 	int get_maxval()	{ return maxval; }
 
+	// Times the sound device asked for samples that hadn't been rendered yet,
+	// and total number of samples it got silence for instead
+	struct underrun_t {
+		long count;
+		long samples;
+	};
+	underrun_t underruns() const;
+	void reset_underruns();
+
 	int playtime;
 
 public:
@@ -88,46 +211,59 @@ private:
 	sample_t* scope_buf;
 	long sample_rate;
 	int scope_buf_size;
-	bool paused;
-	gme_info_t* track_info_;
 
-	void suspend();
-	void resume();
+	// read from emu_ by load_file() before render thread starts, so UI thread
+	// never has to touch emu_ while it's playing
+	gme_vector<gme_info_t*> track_infos;
+	gme_vector<const char*> voice_names;
+	gme_info_t* track_info_;            // entry of track_infos for current track
+	gme_err_t read_info();
+	void free_info();
+
 	static void fill_buffer( void*, sample_t*, int );
 
 	int maxval;
+
+	// Everything the render thread does to emu_ after load_file() arrives as a
+	// command, so neither it nor the sound callback ever waits on a lock.
+	enum command_type_t {
+		cmd_start_track, cmd_seek, cmd_pause, cmd_tempo, cmd_accuracy,
+		cmd_stereo_depth, cmd_echo, cmd_mute, cmd_fade
+	};
+	struct command_t {
+		command_type_t type;
+		int    i;
+		int    i2;
+		double d;
+	};
+	gme_ring<command_t> commands;
+	void post( command_type_t, int i = 0, int i2 = 0, double d = 0 );
+	void run_command( command_t const& );
+
+	// render thread
+	SDL_Thread* render_thread;
+	std::atomic<bool> stop_rendering;
+	gme_ring<sample_t> samples;
+	size_t lookahead;                   // samples to keep rendered ahead of device
+	std::atomic<size_t> discard_pos;    // device skips samples before this ring position
+	std::atomic<bool> paused;
+	std::atomic<bool> rendering;        // track is playing, so empty ring is an underrun
+	std::atomic<int> render_time;       // gme_tell() after last rendered block
+	std::atomic<int> ended_serial;      // serial of track emulator ended
+	int track_serial;                   // serial of most recently started track
+	std::atomic<gme_err_t> render_error; // for get_error()
+	void report_warning();
+	int render_serial;                  // render thread's copy of track_serial
+	static int render_loop( void* );
+	gme_err_t start_rendering();
+	void stop_render_thread();
+
+	std::atomic<long> underrun_count;
+	std::atomic<long> underrun_samples;
 };
 
 // Use to force disable exceptions for a specific allocation no matter what class
 #include <new>
 #define GME_NEW new (std::nothrow)
 
-// gme_vector - very lightweight vector of POD types (no constructor/destructor)
-template<class T>
-class gme_vector {
-	T* begin_;
-	size_t size_;
-public:
-	gme_vector() : begin_( 0 ), size_( 0 ) { }
-	~gme_vector() { free( begin_ ); }
-	size_t size() const { return size_; }
-	T* begin() const { return begin_; }
-	T* end() const { return begin_ + size_; }
-	gme_err_t resize( size_t n )
-	{
-		void* p = realloc( begin_, n * sizeof (T) );
-		if ( !p && n )
-			return "Out of memory";
-		begin_ = (T*) p;
-		size_ = n;
-		return 0;
-	}
-	void clear() { free( begin_ ); begin_ = nullptr; size_ = 0; }
-	T& operator [] ( size_t n ) const
-	{
-		assert( n <= size_ ); // <= to allow past-the-end value
-		return begin_ [n];
-	}
-};
-
 #endif
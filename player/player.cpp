@@ -111,6 +111,8 @@ static void printInfo()
 	printw("introlen: %d\n",player->track_info().intro_length);
 	printw("fadelen:  %d\n",player->track_info().fade_length);
 	printw("playlen:  %d\n",player->track_info().play_length);
+	Music_Player::underrun_t underruns = player->underruns();
+	printw("underruns: %ld (%ld samples)\n", underruns.count, underruns.samples);
 	printw("\n");
 
 /*
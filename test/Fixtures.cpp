@@ -0,0 +1,901 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Fixtures.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Each fixture is a tiny hand-assembled driver for the format's CPU: init sets
+// up every sound channel the fixture uses and play (or an interrupt) changes
+// pitches every frame, so that register writes, CPU emulation and synthesis
+// all show up in profiles. VGM and GYM stream the same short FM/PSG/DAC
+// pattern instead.
+
+typedef std::vector<unsigned char> bytes_t;
+
+static void add( bytes_t& out, std::initializer_list<int> in )
+{
+	for ( int b : in )
+		out.push_back( (unsigned char) b );
+}
+
+static void add_str( bytes_t& out, const char* s )
+{
+	out.insert( out.end(), s, s + strlen( s ) );
+}
+
+static void append( bytes_t& out, bytes_t const& in )
+{
+	size_t pos = out.size();
+	out.resize( pos + in.size() );
+	if ( in.size() )
+		memcpy( &out [pos], &in [0], in.size() );
+}
+
+static void set_le16( bytes_t& out, size_t pos, unsigned n )
+{
+	out [pos    ] = (unsigned char) n;
+	out [pos + 1] = (unsigned char) (n >> 8);
+}
+
+static void set_le32( bytes_t& out, size_t pos, unsigned long n )
+{
+	set_le16( out, pos, n & 0xFFFF );
+	set_le16( out, pos + 2, (n >> 16) & 0xFFFF );
+}
+
+static void set_be16( bytes_t& out, size_t pos, unsigned n )
+{
+	out [pos    ] = (unsigned char) (n >> 8);
+	out [pos + 1] = (unsigned char) n;
+}
+
+// Pads code out to given address, assuming it starts at base
+static void org( bytes_t& code, unsigned base, unsigned addr )
+{
+	assert( code.size() <= addr - base );
+	code.resize( addr - base, 0 );
+}
+
+// 6502 (NSF, SAP) and HuC6280 (HES)
+
+// LDA #data / STA addr
+static void sta( bytes_t& code, int data, unsigned addr )
+{
+	add( code, { 0xA9, data, 0x8D, int (addr & 0xFF), int (addr >> 8) } );
+}
+
+// init at base, play at base + 0x100
+static bytes_t nes_code( unsigned base, int chips )
+{
+	bytes_t code;
+	sta( code, 0x0F, 0x4015 ); // square 1 and 2, triangle, noise
+	sta( code, 0xBF, 0x4000 );
+	sta( code, 0xFD, 0x4002 );
+	sta( code, 0x00, 0x4003 );
+	sta( code, 0x7F, 0x4004 );
+	sta( code, 0x80, 0x4006 );
+	sta( code, 0x01, 0x4007 );
+	sta( code, 0xFF, 0x4008 );
+	sta( code, 0x40, 0x400A );
+	sta( code, 0x02, 0x400B );
+	sta( code, 0x3F, 0x400C );
+	sta( code, 0x04, 0x400E );
+	sta( code, 0x08, 0x400F );
+
+	if ( chips & 0x01 ) // VRC6 square and saw
+	{
+		sta( code, 0x3F, 0x9000 );
+		sta( code, 0x80, 0x9001 );
+		sta( code, 0x81, 0x9002 );
+		sta( code, 0x20, 0xB000 );
+		sta( code, 0x40, 0xB001 );
+		sta( code, 0x80, 0xB002 );
+	}
+
+	if ( chips & 0x02 ) // VRC7 channel 1
+	{
+		sta( code, 0x30, 0x9010 );
+		sta( code, 0x30, 0x9030 ); // instrument 3, full volume
+		sta( code, 0x10, 0x9010 );
+		sta( code, 0xAC, 0x9030 );
+		sta( code, 0x20, 0x9010 );
+		sta( code, 0x19, 0x9030 ); // key on, octave 4
+	}
+
+	if ( chips & 0x10 ) // Namco channel 8 playing 32-sample wave at $00
+	{
+		sta( code, 0x80, 0xF800 ); // auto-increment from $00
+		for ( int i = 0; i < 16; i++ )
+			sta( code, (i * 2 + 1) << 4 | (i * 2), 0x4800 );
+		sta( code, 0xF8, 0xF800 );
+		static int const regs [8] = { 0x00, 0x00, 0x40, 0x00, 0xE0, 0x00, 0x00, 0x0F };
+		for ( int i = 0; i < 8; i++ )
+			sta( code, regs [i], 0x4800 );
+	}
+
+	if ( chips & 0x20 ) // FME7 tones A and B
+	{
+		static int const regs [] = { 7, 0x3C, 8, 0x0C, 9, 0x0A, 0, 0x80, 1, 0x01, 2, 0xC0, 3, 0x00 };
+		for ( unsigned i = 0; i < sizeof regs / sizeof *regs; i += 2 )
+		{
+			sta( code, regs [i], 0xC000 );
+			sta( code, regs [i + 1], 0xE000 );
+		}
+	}
+	add( code, { 0x60 } ); // RTS
+
+	org( code, base, base + 0x100 );
+	add( code, {
+		0xE6, 0x00,       // INC $00
+		0xA5, 0x00,       // LDA $00
+		0x8D, 0x02, 0x40, // STA $4002
+		0x49, 0xFF,       // EOR #$FF
+		0x8D, 0x06, 0x40, // STA $4006
+		0x4A,             // LSR A
+		0x8D, 0x0A, 0x40  // STA $400A
+	} );
+	if ( chips & 0x01 )
+		add( code, { 0x8D, 0x01, 0x90, 0x8D, 0x01, 0xB0 } );
+	if ( chips & 0x02 )
+		add( code, { 0xA2, 0x10, 0x8E, 0x10, 0x90, 0x8D, 0x30, 0x90 } ); // LDX #$10 STX $9010 STA $9030
+	if ( chips & 0x10 )
+		add( code, { 0xA2, 0xFA, 0x8E, 0x00, 0xF8, 0x8D, 0x00, 0x48 } ); // LDX #$FA STX $F800 STA $4800
+	if ( chips & 0x20 )
+		add( code, { 0xA2, 0x00, 0x8E, 0x00, 0xC0, 0x8D, 0x00, 0xE0 } );
+	add( code, {
+		0xA5, 0x00,       // LDA $00
+		0x29, 0x1F,       // AND #$1F
+		0xD0, 0x05,       // BNE +5
+		0xA9, 0x08,       // LDA #$08
+		0x8D, 0x0F, 0x40, // STA $400F (restart noise)
+		0x60              // RTS
+	} );
+	return code;
+}
+
+static bytes_t make_nsf()
+{
+	int const chips = 0x01 | 0x10; // VRC6, Namco
+	bytes_t f( 0x80, 0 );
+	memcpy( &f [0], "NESM\x1A", 5 );
+	f [5] = 1;      // version
+	f [6] = 1;      // tracks
+	f [7] = 1;      // first track
+	set_le16( f, 0x08, 0x8000 ); // load
+	set_le16( f, 0x0A, 0x8000 ); // init
+	set_le16( f, 0x0C, 0x8100 ); // play
+	strcpy( (char*) &f [0x0E], "Fixture" );
+	set_le16( f, 0x6E, 16666 );  // NTSC rate
+	set_le16( f, 0x78, 20000 );  // PAL rate
+	f [0x7B] = chips;
+	bytes_t code = nes_code( 0x8000, chips );
+	append( f, code );
+	return f;
+}
+
+static void add_chunk( bytes_t& f, const char* tag, bytes_t const& data )
+{
+	size_t pos = f.size();
+	f.resize( pos + 8 );
+	set_le32( f, pos, data.size() );
+	memcpy( &f [pos + 4], tag, 4 );
+	append( f, data );
+}
+
+static bytes_t make_nsfe()
+{
+	int const chips = 0x02 | 0x20; // VRC7, FME7
+	bytes_t f;
+	add_str( f, "NSFE" );
+
+	bytes_t info( 10, 0 );
+	set_le16( info, 0, 0x8000 ); // load
+	set_le16( info, 2, 0x8000 ); // init
+	set_le16( info, 4, 0x8100 ); // play
+	info [6] = 0;                // NTSC
+	info [7] = chips;
+	info [8] = 1;                // tracks
+	info [9] = 0;                // first track
+	add_chunk( f, "INFO", info );
+
+	add_chunk( f, "DATA", nes_code( 0x8000, chips ) );
+	add_chunk( f, "NEND", bytes_t() );
+	return f;
+}
+
+static bytes_t make_sap()
+{
+	bytes_t code;
+	sta( code, 0x03, 0xD20F ); // SKCTL
+	sta( code, 0x00, 0xD208 ); // AUDCTL
+	sta( code, 0x40, 0xD200 );
+	sta( code, 0xAA, 0xD201 ); // pure tone
+	sta( code, 0x60, 0xD202 );
+	sta( code, 0xA8, 0xD203 );
+	sta( code, 0x20, 0xD204 );
+	sta( code, 0x86, 0xD205 ); // polynomial noise
+	sta( code, 0x50, 0xD210 ); // second POKEY
+	sta( code, 0xAA, 0xD211 );
+	sta( code, 0x03, 0xD21F );
+	add( code, { 0x60 } );
+
+	org( code, 0x2000, 0x2100 );
+	add( code, {
+		0xE6, 0x80,       // INC $80
+		0xA5, 0x80,       // LDA $80
+		0x8D, 0x00, 0xD2, // STA $D200
+		0x8D, 0x10, 0xD2, // STA $D210
+		0x49, 0xFF,       // EOR #$FF
+		0x8D, 0x02, 0xD2, // STA $D202
+		0x60
+	} );
+
+	bytes_t f;
+	add_str( f, "SAP\r\nAUTHOR \"gme\"\r\nNAME \"Fixture\"\r\nSTEREO\r\n"
+			"TYPE B\r\nINIT 2000\r\nPLAYER 2100\r\n" );
+	size_t pos = f.size();
+	f.resize( pos + 6 );
+	set_le16( f, pos    , 0xFFFF );
+	set_le16( f, pos + 2, 0x2000 );
+	set_le16( f, pos + 4, 0x2000 + code.size() - 1 );
+	append( f, code );
+	return f;
+}
+
+static bytes_t make_hes()
+{
+	// One 8K bank mapped at $E000, with I/O at $0000 and RAM at $2000.
+	// Timer interrupt changes pitch about 55 times a second.
+	bytes_t code;
+	sta( code, 0xFF, 0x0801 ); // main volume
+	for ( int ch = 0; ch < 3; ch++ )
+	{
+		sta( code, ch, 0x0800 );
+		sta( code, 0x00, 0x0804 );
+		add( code, {
+			0xA2, 0x00,       // LDX #0
+			0x8A,             // TXA
+			0x8D, 0x06, 0x08, // STA $0806 (wave data)
+			0xE8,             // INX
+			0xE0, 0x20,       // CPX #32
+			0xD0, 0xF7        // BNE
+		} );
+		sta( code, 0x80 + ch * 0x40, 0x0802 );
+		sta( code, 0x01, 0x0803 );
+		sta( code, ch == 1 ? 0xF8 : 0x8F, 0x0805 ); // balance
+		sta( code, 0x9F, 0x0804 ); // enable, full volume
+	}
+	sta( code, 0x7F, 0x0C00 ); // timer period
+	sta( code, 0x01, 0x0C01 ); // timer on
+	sta( code, 0x03, 0x1402 ); // enable timer interrupt only
+	add( code, { 0x58, 0x60 } ); // CLI RTS
+
+	org( code, 0xE000, 0xE100 );
+	add( code, {
+		0x48,             // PHA
+		0x8D, 0x03, 0x14, // STA $1403 (acknowledge timer)
+		0xE6, 0x00,       // INC $00
+		0xA9, 0x00,       // LDA #0
+		0x8D, 0x00, 0x08, // STA $0800
+		0xA5, 0x00,       // LDA $00
+		0x8D, 0x02, 0x08, // STA $0802
+		0xA9, 0x02,       // LDA #2
+		0x8D, 0x00, 0x08, // STA $0800
+		0xA5, 0x00,       // LDA $00
+		0x49, 0xFF,       // EOR #$FF
+		0x8D, 0x02, 0x08, // STA $0802
+		0x68,             // PLA
+		0x40              // RTI
+	} );
+
+	org( code, 0xE000, 0xFFF6 );
+	for ( int i = 0; i < 5; i++ )
+		add( code, { 0x00, 0xE1 } ); // all vectors to $E100
+
+	bytes_t f( 0x20, 0 );
+	memcpy( &f [0], "HESM", 4 );
+	set_le16( f, 0x06, 0xE000 ); // init
+	static unsigned char const banks [8] = { 0xFF, 0xF8, 0, 0, 0, 0, 0, 0 };
+	memcpy( &f [0x08], banks, 8 );
+	memcpy( &f [0x10], "DATA", 4 );
+	set_le32( f, 0x14, code.size() );
+	set_le32( f, 0x18, 0 );
+	append( f, code );
+	return f;
+}
+
+// LR35902 (GBS)
+
+static bytes_t make_gbs()
+{
+	bytes_t code;
+	// LD A,data / LDH (reg),A
+	#define GB_REG( reg, data ) add( code, { 0x3E, data, 0xE0, reg } )
+	GB_REG( 0x26, 0x80 ); // sound on
+	GB_REG( 0x24, 0x77 );
+	GB_REG( 0x25, 0xFF );
+	GB_REG( 0x11, 0x80 ); // square 1
+	GB_REG( 0x12, 0xF0 );
+	GB_REG( 0x13, 0x00 );
+	GB_REG( 0x14, 0x87 );
+	GB_REG( 0x16, 0x40 ); // square 2
+	GB_REG( 0x17, 0xF0 );
+	GB_REG( 0x18, 0x80 );
+	GB_REG( 0x19, 0x86 );
+	GB_REG( 0x1A, 0x00 ); // wave
+	for ( int i = 0; i < 16; i++ )
+		GB_REG( 0x30 + i, (i * 2) << 4 | (i * 2 + 1) );
+	GB_REG( 0x1A, 0x80 );
+	GB_REG( 0x1C, 0x20 );
+	GB_REG( 0x1D, 0x00 );
+	GB_REG( 0x1E, 0x86 );
+	GB_REG( 0x21, 0xF1 ); // noise
+	GB_REG( 0x22, 0x45 );
+	GB_REG( 0x23, 0x80 );
+	#undef GB_REG
+	add( code, { 0xC9 } ); // RET
+
+	org( code, 0x400, 0x500 );
+	add( code, {
+		0xFA, 0x00, 0xC0, // LD A,($C000)
+		0x3C,             // INC A
+		0xEA, 0x00, 0xC0, // LD ($C000),A
+		0xE0, 0x13,       // LDH ($13),A
+		0x2F,             // CPL
+		0xE0, 0x18,       // LDH ($18),A
+		0xE0, 0x1D,       // LDH ($1D),A
+		0xE6, 0x1F,       // AND $1F
+		0x20, 0x04,       // JR NZ,+4
+		0x3E, 0x80,       // LD A,$80
+		0xE0, 0x23,       // LDH ($23),A (restart noise)
+		0xC9              // RET
+	} );
+
+	bytes_t f( 0x70, 0 );
+	memcpy( &f [0], "GBS", 3 );
+	f [3] = 1; // version
+	f [4] = 1; // tracks
+	f [5] = 1; // first track
+	set_le16( f, 0x06, 0x400 ); // load
+	set_le16( f, 0x08, 0x400 ); // init
+	set_le16( f, 0x0A, 0x500 ); // play
+	set_le16( f, 0x0C, 0xFFFE ); // stack
+	strcpy( (char*) &f [0x10], "Fixture" );
+	append( f, code );
+	return f;
+}
+
+// Z80 (KSS, AY)
+
+// AY register writes through subroutine taking register in A and data in E
+static void z80_ay_init( bytes_t& code, unsigned write_reg )
+{
+	static int const regs [] = {
+		7, 0x38, 8, 0x0F, 9, 0x0C, 10, 0x0A,
+		0, 0x80, 1, 0x01, 2, 0x40, 3, 0x02, 4, 0x00, 5, 0x01
+	};
+	for ( unsigned i = 0; i < sizeof regs / sizeof *regs; i += 2 )
+		add( code, { 0x3E, regs [i], 0x1E, regs [i + 1], // LD A,reg LD E,data
+				0xCD, int (write_reg & 0xFF), int (write_reg >> 8) } ); // CALL write_reg
+}
+
+// Increments counter and writes it to AY register 0
+static void z80_ay_play( bytes_t& code, unsigned counter, unsigned write_reg )
+{
+	add( code, {
+		0x21, int (counter & 0xFF), int (counter >> 8), // LD HL,counter
+		0x34,                                           // INC (HL)
+		0x5E,                                           // LD E,(HL)
+		0x3E, 0x00,                                     // LD A,0
+		0xCD, int (write_reg & 0xFF), int (write_reg >> 8)
+	} );
+}
+
+static bytes_t make_kss()
+{
+	// Code loaded at $4000, with AY on ports $A0/$A1 and SCC at $9800
+	bytes_t code;
+	z80_ay_init( code, 0x4100 );
+	add( code, {
+		0x21, 0x00, 0x98, // LD HL,$9800
+		0x06, 0x40,       // LD B,64 (waves for channels 1 and 2)
+		0xAF,             // XOR A
+		0x77,             // LD (HL),A
+		0xC6, 0x08,       // ADD A,8
+		0x23,             // INC HL
+		0x10, 0xFA        // DJNZ
+	} );
+	static int const scc_regs [] = { 0x80, 0x00, 0x81, 0x01, 0x82, 0x80, 0x83, 0x00,
+			0x8A, 0x0F, 0x8B, 0x0C, 0x8F, 0x03 };
+	for ( unsigned i = 0; i < sizeof scc_regs / sizeof *scc_regs; i += 2 )
+		add( code, { 0x3E, scc_regs [i + 1], 0x32, scc_regs [i], 0x98 } ); // LD A,data LD ($98xx),A
+	add( code, { 0xC9 } );
+
+	org( code, 0x4000, 0x4080 );
+	z80_ay_play( code, 0x5000, 0x4100 );
+	add( code, {
+		0x7B,             // LD A,E
+		0x32, 0x80, 0x98, // LD ($9880),A
+		0xC9
+	} );
+
+	org( code, 0x4000, 0x4100 );
+	add( code, {
+		0xD3, 0xA0, // OUT ($A0),A
+		0x7B,       // LD A,E
+		0xD3, 0xA1, // OUT ($A1),A
+		0xC9
+	} );
+
+	bytes_t f( 0x10, 0 );
+	memcpy( &f [0], "KSCC", 4 );
+	set_le16( f, 0x04, 0x4000 ); // load
+	set_le16( f, 0x06, code.size() );
+	set_le16( f, 0x08, 0x4000 ); // init
+	set_le16( f, 0x0A, 0x4080 ); // play
+	append( f, code );
+	return f;
+}
+
+static bytes_t make_ay()
+{
+	// Spectrum AY at ports $FFFD/$BFFD, code at $8000
+	bytes_t code;
+	z80_ay_init( code, 0x8100 );
+	add( code, { 0xC9 } );
+
+	org( code, 0x8000, 0x8080 );
+	z80_ay_play( code, 0xC000, 0x8100 );
+	add( code, { 0xC9 } );
+
+	org( code, 0x8000, 0x8100 );
+	add( code, {
+		0x01, 0xFD, 0xFF, // LD BC,$FFFD
+		0xED, 0x79,       // OUT (C),A
+		0x06, 0xBF,       // LD B,$BF
+		0xED, 0x59,       // OUT (C),E
+		0xC9
+	} );
+
+	// Offsets in AY files are relative to the field holding them
+	bytes_t f( 0x3C, 0 );
+	memcpy( &f [0], "ZXAYEMUL", 8 );
+	f [0x10] = 0;                     // last track
+	set_be16( f, 0x12, 0x14 - 0x12 ); // track list
+	set_be16( f, 0x14, 0x3C - 0x14 ); // name
+	set_be16( f, 0x16, 0x18 - 0x16 ); // track data
+	for ( int i = 0; i < 4; i++ )
+		f [0x18 + i] = i;             // channel mapping
+	set_be16( f, 0x22, 0x26 - 0x22 ); // registers
+	set_be16( f, 0x24, 0x2C - 0x24 ); // blocks
+	set_be16( f, 0x26, 0xF000 );      // stack
+	set_be16( f, 0x28, 0x8000 );      // init
+	set_be16( f, 0x2A, 0x8080 );      // play
+	set_be16( f, 0x2C, 0x8000 );      // block address
+	set_be16( f, 0x2E, code.size() );
+	set_be16( f, 0x30, 0x44 - 0x30 ); // block data
+	// $32: end of block list, followed by padding
+	add_str( f, "Fixture" );
+	f.resize( 0x44, 0 );
+	append( f, code );
+	return f;
+}
+
+// SPC700 (SPC)
+
+static bytes_t make_spc()
+{
+	bytes_t f( 0x10200, 0 );
+	memcpy( &f [0], "SNES-SPC700 Sound File Data v0.30\x1A\x1A", 35 );
+	f [0x23] = 27; // no ID666 tag
+	f [0x24] = 30;
+	set_le16( f, 0x25, 0x0400 ); // PC
+	f [0x2A] = 0x02; // PSW
+	f [0x2B] = 0xEF; // SP
+	size_t const ram = 0x100;
+
+	// Directory at $200 pointing to two BRR samples
+	set_le16( f, ram + 0x200, 0x300 );
+	set_le16( f, ram + 0x202, 0x300 );
+	set_le16( f, ram + 0x204, 0x500 );
+	set_le16( f, ram + 0x206, 0x500 );
+	for ( int s = 0; s < 2; s++ )
+	{
+		int const blocks = s ? 8 : 16;
+		size_t addr = ram + (s ? 0x500 : 0x300);
+		for ( int b = 0; b < blocks; b++ )
+		{
+			unsigned char* p = &f [addr + b * 9];
+			p [0] = 9 << 4 | (s ? 0 : 1) << 2 | (b == blocks - 1 ? 3 : 0); // end+loop on last
+			for ( int i = 0; i < 16; i++ )
+			{
+				int n = b * 16 + i;
+				int v = s ? (n % 16) - 8 : int (7 * sin( n * 2 * 3.14159265358979 / 64 ));
+				p [1 + i / 2] |= (v & 15) << (i & 1 ? 0 : 4);
+			}
+		}
+	}
+
+	// Key on voices from counter driven by timer 0
+	static unsigned char const code [] = {
+		0x8F, 0x00, 0xFA, // MOV $FA,#$00
+		0x8F, 0x01, 0xF1, // MOV $F1,#$01
+		0xE4, 0xFD,       // MOV A,$FD
+		0xF0, 0xFC,       // BEQ
+		0x8F, 0x4C, 0xF2, // MOV $F2,#$4C (KON)
+		0xE4, 0x00,       // MOV A,$00
+		0xBC,             // INC A
+		0xC4, 0x00,       // MOV $00,A
+		0xC4, 0xF3,       // MOV $F3,A
+		0x8F, 0x02, 0xF2, // MOV $F2,#$02 (voice 0 pitch)
+		0xC4, 0xF3,       // MOV $F3,A
+		0x2F, 0xEB        // BRA
+	};
+	memcpy( &f [ram + 0x400], code, sizeof code );
+
+	size_t const dsp = 0x10100;
+	for ( int v = 0; v < 8; v++ )
+	{
+		unsigned char* p = &f [dsp + v * 0x10];
+		p [0] = 0x40 - v * 4; // volume
+		p [1] = 0x20 + v * 4;
+		int pitch = 0x0800 + v * 0x180;
+		p [2] = pitch & 0xFF;
+		p [3] = pitch >> 8;
+		p [4] = v & 1;        // sample
+		p [5] = 0x8F;         // ADSR
+		p [6] = 0xE0 | (8 + v);
+		p [7] = 0x7F;         // GAIN
+	}
+	static unsigned char const regs [] = {
+		0x0C, 0x60, 0x1C, 0x60, // main volume
+		0x2C, 0x20, 0x3C, 0x20, // echo volume
+		0x4C, 0xFF, 0x5C, 0x00, 0x6C, 0x00,
+		0x0D, 0x40,             // echo feedback
+		0x2D, 0x04,             // pitch modulation
+		0x3D, 0x80,             // noise
+		0x4D, 0xF0,             // echo on
+		0x5D, 0x02,             // directory
+		0x6D, 0x80, 0x7D, 0x02, // echo buffer
+		0x0F, 0x7F              // FIR
+	};
+	for ( unsigned i = 0; i < sizeof regs; i += 2 )
+		f [dsp + regs [i]] = regs [i + 1];
+	return f;
+}
+
+// YM2612 + SN76489 (VGM, GYM)
+
+struct Fm_Stream
+{
+	virtual void write( int port, int addr, int data ) = 0;
+	virtual void write_psg( int data ) = 0;
+
+	// Ends 1/60 second frame, spreading DAC samples evenly over it
+	virtual void end_frame( unsigned char const* dac, int count ) = 0;
+
+	virtual ~Fm_Stream() { }
+};
+
+int const fm_dac_per_frame = 91;
+
+// Writes setup frame then frame_count looping frames
+static void write_fm_song( Fm_Stream& out, int frame_count, bool setup )
+{
+	if ( setup )
+	{
+		out.write( 0, 0x22, 0x00 );
+		out.write( 0, 0x27, 0x00 );
+		for ( int ch = 0; ch < 6; ch++ )
+		{
+			int const port = ch / 3;
+			int const c = ch % 3;
+			out.write( port, 0xB0 + c, 0x34 ); // feedback 6, algorithm 4
+			out.write( port, 0xB4 + c, 0xC0 );
+			static int const op_offsets [4] = { 0, 8, 4, 12 };
+			for ( int op = 0; op < 4; op++ )
+			{
+				int const r = op_offsets [op] + c;
+				out.write( port, 0x30 + r, op + 1 );
+				out.write( port, 0x40 + r, (op & 1) ? 0x08 : 0x20 );
+				out.write( port, 0x50 + r, 0x1F );
+				out.write( port, 0x60 + r, 0x08 );
+				out.write( port, 0x70 + r, 0x04 );
+				out.write( port, 0x80 + r, 0x46 );
+				out.write( port, 0x90 + r, 0x00 );
+			}
+		}
+		out.write( 0, 0x2B, 0x80 ); // DAC replaces channel 6
+		out.write_psg( 0x90 | 2 );
+		out.write_psg( 0xB0 | 4 );
+		out.write_psg( 0xE5 );
+		out.write_psg( 0xF8 );
+		out.end_frame( 0, 0 );
+	}
+
+	static int const fnums [8] = { 644, 723, 811, 965, 1083, 1288, 1446, 1622 };
+	unsigned char dac [fm_dac_per_frame];
+	for ( int frame = 0; frame < frame_count; frame++ )
+	{
+		if ( frame % 4 == 0 )
+		{
+			for ( int ch = 0; ch < 5; ch++ )
+			{
+				int const port = ch / 3;
+				int const c = ch % 3;
+				int const key = port << 2 | c;
+				int const fnum = fnums [(frame / 4 + ch * 2) % 8];
+				out.write( 0, 0x28, key );
+				out.write( port, 0xA4 + c, 4 << 3 | fnum >> 8 );
+				out.write( port, 0xA0 + c, fnum & 0xFF );
+				out.write( 0, 0x28, 0xF0 | key );
+			}
+		}
+
+		int const period = 0x100 + frame * 8;
+		out.write_psg( 0x80 | (period & 0x0F) );
+		out.write_psg( period >> 4 & 0x3F );
+
+		for ( int i = 0; i < fm_dac_per_frame; i++ )
+			dac [i] = (unsigned char) ((i * 5 + frame * 3) & 0xFF);
+		out.end_frame( dac, fm_dac_per_frame );
+	}
+}
+
+struct Vgm_Stream : Fm_Stream
+{
+	bytes_t& out;
+	long samples;
+
+	explicit Vgm_Stream( bytes_t& out ) : out( out ), samples( 0 ) { }
+
+	void write( int port, int addr, int data )
+	{
+		add( out, { 0x52 + port, addr, data } );
+	}
+
+	void write_psg( int data ) { add( out, { 0x50, data } ); }
+
+	void end_frame( unsigned char const* dac, int count )
+	{
+		int const frame_samples = 735;
+		int remain = frame_samples;
+		for ( int i = 0; i < count; i++ )
+		{
+			add( out, { 0x52, 0x2A, dac [i], 0x70 + 7 } ); // wait 8
+			remain -= 8;
+		}
+		add( out, { 0x61, remain & 0xFF, remain >> 8 } );
+		samples += frame_samples;
+	}
+};
+
+static bytes_t make_vgm()
+{
+	int const loop_frames = 32;
+	bytes_t f( 0x40, 0 );
+	memcpy( &f [0], "Vgm ", 4 );
+	set_le32( f, 0x08, 0x150 );
+	set_le32( f, 0x0C, 3579545 ); // SN76489
+	set_le16( f, 0x28, 0x0009 );  // noise feedback
+	f [0x2A] = 16;                // noise width
+	set_le32( f, 0x2C, 7670453 ); // YM2612
+	set_le32( f, 0x34, 0x40 - 0x34 );
+
+	Vgm_Stream s( f );
+	write_fm_song( s, 0, true );
+	size_t const loop_pos = f.size();
+	long const intro = s.samples;
+	write_fm_song( s, loop_frames, false );
+	add( f, { 0x66 } );
+
+	set_le32( f, 0x04, f.size() - 0x04 );
+	set_le32( f, 0x18, s.samples );
+	set_le32( f, 0x1C, loop_pos - 0x1C );
+	set_le32( f, 0x20, s.samples - intro );
+	return f;
+}
+
+struct Gym_Stream : Fm_Stream
+{
+	bytes_t& out;
+
+	explicit Gym_Stream( bytes_t& out ) : out( out ) { }
+
+	void write( int port, int addr, int data ) { add( out, { 1 + port, addr, data } ); }
+
+	void write_psg( int data ) { add( out, { 3, data } ); }
+
+	void end_frame( unsigned char const* dac, int count )
+	{
+		for ( int i = 0; i < count; i++ )
+			add( out, { 1, 0x2A, dac [i] } );
+		add( out, { 0 } );
+	}
+};
+
+static bytes_t make_gym()
+{
+	int const header_size = 428;
+	bytes_t f( header_size, 0 );
+	memcpy( &f [0], "GYMX", 4 );
+	strcpy( (char*) &f [4], "Fixture" );
+	set_le32( f, header_size - 8, 2 ); // loop to second frame, after setup
+
+	Gym_Stream s( f );
+	write_fm_song( s, 32, true );
+	return f;
+}
+
+void make_fixtures( std::vector<Fixture>& out )
+{
+	struct maker_t {
+		const char* name;
+		const char* ext;
+		bytes_t (*make)();
+	};
+	static maker_t const makers [] = {
+		{ "ay",   "AY",   make_ay },
+		{ "gbs",  "GBS",  make_gbs },
+		{ "gym",  "GYM",  make_gym },
+		{ "hes",  "HES",  make_hes },
+		{ "kss",  "KSS",  make_kss },
+		{ "nsf",  "NSF",  make_nsf },
+		{ "nsfe", "NSFE", make_nsfe },
+		{ "sap",  "SAP",  make_sap },
+		{ "spc",  "SPC",  make_spc },
+		{ "vgm",  "VGM",  make_vgm },
+	};
+	for ( maker_t const& m : makers )
+	{
+		Fixture fx;
+		fx.name = m.name;
+		fx.ext  = m.ext;
+		fx.data = m.make();
+		out.push_back( fx );
+	}
+}
+
+// Test runners
+
+const char* make_sources( std::vector<Fixture> const& fixtures, int argc, char** argv,
+		std::vector<Test_Source>& out )
+{
+	for ( Fixture const& f : fixtures )
+	{
+		Test_Source src = { f.name, gme_identify_extension( f.ext ), &f, 0 };
+		out.push_back( src );
+	}
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		Test_Source src = { argv [i], 0, 0, argv [i] };
+		if ( gme_err_t err = gme_identify_file( argv [i], &src.type ) )
+			return err;
+		if ( !src.type )
+			return gme_wrong_file_type;
+		size_t slash = src.name.rfind( '/' );
+		if ( slash != std::string::npos )
+			src.name.erase( 0, slash + 1 );
+		out.push_back( src );
+	}
+	return 0;
+}
+
+const char* read_source( Test_Source const& src, std::vector<unsigned char>& out )
+{
+	if ( src.fixture )
+	{
+		out = src.fixture->data;
+		return 0;
+	}
+
+	FILE* in = fopen( src.path, "rb" );
+	if ( !in )
+		return "Couldn't open file";
+	out.clear();
+	unsigned char buf [4096];
+	for ( size_t n; (n = fread( buf, 1, sizeof buf, in )) > 0; )
+		out.insert( out.end(), buf, buf + n );
+	bool const failed = ferror( in ) != 0;
+	fclose( in );
+	return failed ? "Couldn't read file" : 0;
+}
+
+Fixture const* find_fixture( std::vector<Fixture> const& fixtures, const char* name )
+{
+	for ( Fixture const& f : fixtures )
+		if ( !strcmp( f.name, name ) && gme_identify_extension( f.ext ) )
+			return &f;
+	return 0;
+}
+
+const char* open_fixture( Fixture const& f, Music_Emu** out, bool ignore_silence )
+{
+	Music_Emu* emu = gme_new_emu( gme_identify_extension( f.ext ), fixture_rate );
+	if ( !emu )
+		return "Out of memory";
+	gme_ignore_silence( emu, ignore_silence );
+	gme_set_autoload_playback_limit( emu, 0 );
+	gme_err_t err = gme_load_data( emu, &f.data [0], (long) f.data.size() );
+	if ( !err )
+		err = gme_start_track( emu, 0 );
+	if ( err )
+	{
+		gme_delete( emu );
+		return err;
+	}
+	*out = emu;
+	return 0;
+}
+
+gme_err_t load_source( Music_Emu* emu, Test_Source const& src )
+{
+	return src.fixture ?
+			gme_load_data( emu, &src.fixture->data [0], (long) src.fixture->data.size() ) :
+			gme_load_file( emu, src.path );
+}
+
+gme_err_t play_frames( Music_Emu* emu, long frames, std::vector<short>& out )
+{
+	int const channels = gme_channel_count( emu );
+	out.resize( frames * channels );
+	static int const sizes [] = { 1024, 80, 512, 2, 1500 };
+	long pos = 0;
+	for ( int i = 0; pos < frames; i++ )
+	{
+		long n = sizes [i % 5];
+		if ( n > frames - pos )
+			n = frames - pos;
+		if ( gme_err_t err = gme_play( emu, (int) (n * channels), &out [pos * channels] ) )
+			return err;
+		pos += n;
+	}
+	return 0;
+}
+
+static int failures = 0;
+
+static void print_result( const char* prefix, const char* format, va_list args )
+{
+	fputs( prefix, stdout );
+	vprintf( format, args );
+	putchar( '\n' );
+}
+
+void pass( const char* format, ... )
+{
+	va_list args;
+	va_start( args, format );
+	print_result( "ok    ", format, args );
+	va_end( args );
+}
+
+void fail( const char* format, ... )
+{
+	failures++;
+	va_list args;
+	va_start( args, format );
+	print_result( "FAIL  ", format, args );
+	va_end( args );
+}
+
+void report( const char* name, const char* err )
+{
+	if ( err )
+		fail( "%-12s %s", name, err );
+	else
+		pass( "%-12s", name );
+}
+
+int test_failures() { return failures; }
+
+int finish_tests()
+{
+	printf( "%d failed\n", failures );
+	return failures ? 1 : 0;
+}
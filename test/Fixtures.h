@@ -0,0 +1,81 @@
+// Synthetic music files for benchmarks and regression tests
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include "gme/gme.h"
+
+#include <string>
+#include <vector>
+
+// A small file generated in memory that drives one format's CPU and sound
+// chips with a simple looping pattern. Output depends only on the emulator,
+// so hashes of it can be compared between builds. None of them end or go
+// silent, so rendering a fixed duration always does the same amount of work.
+struct Fixture
+{
+	const char* name;  // "nsf", "vgm", etc.
+	const char* ext;   // extension to pass to gme_identify_extension()
+	std::vector<unsigned char> data;
+};
+
+// Appends one fixture for each format the library knows about. Pass each
+// fixture's type from gme_identify_extension( ext ) to gme_new_emu(); it's 0
+// for formats disabled at build time.
+void make_fixtures( std::vector<Fixture>& out );
+
+// Test runners
+
+// Sample rate and channel count open_fixture() uses
+int const fixture_rate = 44100;
+int const fixture_channels = 2;
+
+// Number of samples in msec of output from open_fixture()
+inline int64_t msec_to_samples( int msec ) { return (int64_t) msec * fixture_rate / 1000 * fixture_channels; }
+
+// Fixture with given name, or NULL if there's none or its format is disabled
+Fixture const* find_fixture( std::vector<Fixture> const&, const char* name );
+
+// Opens fixture and starts its first track. Unless ignore_silence is false, track
+// only ends when a fade does.
+const char* open_fixture( Fixture const&, Music_Emu** out, bool ignore_silence = true );
+
+// Music to test, either a fixture or a file named on command line
+struct Test_Source
+{
+	std::string name;
+	gme_type_t type;        // 0 if format is disabled at build time
+	Fixture const* fixture; // NULL for file
+	const char* path;
+};
+
+// Appends a source for each fixture, then each file named in argv [1] onwards.
+// Returns error if a file's type isn't known.
+const char* make_sources( std::vector<Fixture> const&, int argc, char** argv,
+		std::vector<Test_Source>& out );
+
+// Reads source's whole file
+const char* read_source( Test_Source const&, std::vector<unsigned char>& out );
+
+// Loads source into emulator of its type
+gme_err_t load_source( Music_Emu*, Test_Source const& );
+
+// Plays frames into out, in calls of varying sizes that don't line up with anything
+// emulators do internally. Sizes are the same each time, so outputs can be compared.
+gme_err_t play_frames( Music_Emu*, long frames, std::vector<short>& out );
+
+// Prints "ok" or "FAIL" line. fail() also counts failure.
+void pass( const char* format, ... );
+void fail( const char* format, ... );
+
+// Prints result line for name, which failed if err isn't NULL
+void report( const char* name, const char* err );
+
+// Number of failures so far
+int test_failures();
+
+// Prints number of failures and returns exit status for main()
+int finish_tests();
+
+#endif
@@ -0,0 +1,160 @@
+// Checks gme_set_allocator(), gme_new_emu_arena() and gme_memory_usage()
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_alloc_test [file ...]
+
+For the generated fixtures in test/Fixtures.h and any files named, plays part of
+the first track with all memory coming from a counting allocator, then again with
+an emulator given an arena twice as big as the first one needed. The arena
+emulator must play the same, and nothing may be allocated outside its arena once
+it's created. Everything must be freed when emulators are deleted, and an arena
+too small must fail with an error rather than crash. */
+
+#include "gme/gme.h"
+#include "Fixtures.h"
+
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::vector<short> samples_t;
+
+// Allocator that counts calls and blocks not yet freed
+struct counts_t
+{
+	long calls;
+	long blocks;
+};
+
+static void* counted_alloc( void* user_data, size_t size )
+{
+	counts_t* c = (counts_t*) user_data;
+	c->calls++;
+	void* p = malloc( size );
+	if ( p )
+		c->blocks++;
+	return p;
+}
+
+static void counted_free( void* user_data, void* p )
+{
+	counts_t* c = (counts_t*) user_data;
+	if ( p )
+		c->blocks--;
+	free( p );
+}
+
+static counts_t counts;
+
+// Loads, plays a second, seeks back and plays a little more
+static gme_err_t play( Test_Source const& src, Music_Emu* emu, samples_t& out )
+{
+	if ( gme_err_t err = load_source( emu, src ) )
+		return err;
+	if ( gme_err_t err = gme_start_track( emu, 0 ) )
+		return err;
+	int const block = 2048;
+	out.resize( block * 24 );
+	for ( int i = 0; i < 24; i++ )
+	{
+		if ( i == 20 )
+		{
+			if ( gme_err_t err = gme_seek( emu, 100 ) )
+				return err;
+		}
+		if ( gme_err_t err = gme_play( emu, block, &out [i * block] ) )
+			return err;
+	}
+	return 0;
+}
+
+static const char* check_arena( Test_Source const& src )
+{
+	int const rate = 44100;
+	long const blocks = counts.blocks;
+
+	// normal emulator, to find memory needed
+	Music_Emu* emu = gme_new_emu( src.type, rate );
+	if ( !emu )
+		return "Out of memory";
+	samples_t expected;
+	gme_err_t err = play( src, emu, expected );
+	gme_memory_t mem;
+	gme_memory_usage( emu, &mem );
+	gme_delete( emu );
+	if ( err )
+		return err;
+	if ( !mem.current || mem.peak < mem.current || mem.arena_size )
+		return "wrong memory usage reported";
+	if ( counts.blocks != blocks )
+		return "memory not freed";
+
+	// arena emulator
+	emu = gme_new_emu_arena( src.type, rate, 0, mem.peak * 2 );
+	if ( !emu )
+		return "Out of memory";
+	long const calls = counts.calls;
+	samples_t actual;
+	err = play( src, emu, actual );
+	if ( !err && counts.calls != calls )
+		err = "allocated outside arena";
+	if ( !err && actual != expected )
+		err = "arena emulator played differently";
+
+	// clone has arena of same size
+	Music_Emu* copy = 0;
+	if ( !err )
+		err = gme_clone( emu, &copy );
+	gme_memory_t copy_mem;
+	if ( !err )
+	{
+		gme_memory_usage( copy, &copy_mem );
+		if ( copy_mem.arena_size != mem.peak * 2 / 16 * 16 || !copy_mem.current )
+			err = "clone's arena is wrong";
+	}
+	gme_delete( emu );
+	gme_delete( copy );
+	if ( !err && counts.blocks != blocks )
+		err = "arena not freed";
+	if ( err )
+		return err;
+
+	// arena too small
+	for ( size_t size = 256; size < mem.peak; size *= 4 )
+	{
+		emu = gme_new_emu_arena( src.type, rate, 0, size );
+		if ( !emu )
+			continue;
+		err = play( src, emu, actual );
+		gme_delete( emu );
+		if ( err && strcmp( err, "Out of memory" ) )
+			return err;
+		if ( counts.blocks != blocks )
+			return "memory not freed after running out";
+	}
+	return 0;
+}
+
+int main( int argc, char** argv )
+{
+	gme_allocator_t const allocator = { counted_alloc, counted_free, &counts };
+	gme_set_allocator( &allocator );
+
+	std::vector<Fixture> fixtures;
+	make_fixtures( fixtures );
+	std::vector<Test_Source> sources;
+	if ( const char* err = make_sources( fixtures, argc, argv, sources ) )
+		fail( "%s", err );
+	for ( Test_Source const& src : sources )
+	{
+		if ( src.type )
+			report( src.name.c_str(), check_arena( src ) );
+	}
+
+	if ( counts.blocks )
+		fail( "%ld blocks not freed", counts.blocks );
+	gme_set_allocator( 0 );
+	return finish_tests();
+}
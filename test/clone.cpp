@@ -0,0 +1,195 @@
+// Checks that emulators copied with gme_clone() play the same as the original
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_clone_test [file ...]
+
+For the generated fixtures in test/Fixtures.h and any files named, plays part of
+a track with various settings, clones the emulator, then plays further. The clone
+must generate exactly what the original did, even after the original has been
+deleted. Cloning before the track starts and cloning a clone are checked too. */
+
+#include "gme/gme.h"
+#include "Fixtures.h"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+typedef std::vector<short> samples_t;
+
+struct setup_t
+{
+	const char* name;
+	bool multi;
+	int latency;  // msec, or 0
+	int mute;     // voice mask
+	double tempo;
+	double depth; // stereo depth
+	int fade;     // msec, or -1 for none
+	int new_rate; // sample rate to change to during track, or 0
+};
+
+static setup_t const setups [] = {
+	{ "stereo",  false,  0, 0, 1.0, 0.0,   -1,     0 },
+	{ "effects", false,  0, 2, 1.0, 0.5,   -1,     0 },
+	{ "multi",   true,   0, 0, 1.0, 0.0,   -1,     0 },
+	{ "latency", false, 10, 5, 1.3, 0.0,   -1,     0 },
+	{ "fade",    false,  0, 0, 0.9, 0.0, 1200,     0 },
+	{ "rate",    false,  0, 0, 1.0, 0.0,   -1, 32000 },
+};
+
+static gme_err_t open( Test_Source const& src, setup_t const& s, Music_Emu** out )
+{
+	int const rate = 44100;
+	Music_Emu* emu = s.multi ? gme_new_emu_multi_channel( src.type, rate ) :
+			gme_new_emu( src.type, rate );
+	if ( !emu )
+		return "Out of memory";
+	if ( gme_err_t err = load_source( emu, src ) )
+	{
+		gme_delete( emu );
+		return err;
+	}
+	gme_set_stereo_depth( emu, s.depth );
+	gme_set_tempo( emu, s.tempo );
+	gme_mute_voices( emu, s.mute );
+	if ( s.latency )
+		gme_set_max_latency( emu, s.latency );
+	*out = emu;
+	return 0;
+}
+
+static bool same( Music_Emu* a, Music_Emu* b, samples_t const& sa, samples_t const& sb )
+{
+	return sa == sb && gme_tell_samples( a ) == gme_tell_samples( b ) &&
+			gme_track_ended( a ) == gme_track_ended( b );
+}
+
+// Plays, clones after played frames, then checks that clone continues the same way
+static const char* check_clone( Test_Source const& src, setup_t const& s, long played )
+{
+	Music_Emu* emu;
+	if ( gme_err_t err = open( src, s, &emu ) )
+		return err;
+
+	static char error [256];
+	gme_err_t err = gme_start_track( emu, 0 );
+	if ( !err && s.fade >= 0 )
+		gme_set_fade_msecs( emu, s.fade, 500 );
+
+	samples_t before, expected, actual, again;
+	if ( !err )
+		err = play_frames( emu, played, before );
+	if ( !err && s.new_rate )
+		err = gme_set_sample_rate( emu, s.new_rate );
+
+	Music_Emu* copy = 0;
+	if ( !err )
+		err = gme_clone( emu, &copy );
+
+	// original is deleted before clone plays, so clone mustn't depend on it
+	long const remain = 44100 * 2;
+	if ( !err )
+		err = play_frames( emu, remain, expected );
+	bool const ended = !err && gme_track_ended( emu );
+	int const tell = err ? 0 : gme_tell_samples( emu );
+	gme_delete( emu );
+	if ( err )
+	{
+		gme_delete( copy );
+		return err;
+	}
+
+	Music_Emu* copy2 = 0;
+	err = gme_clone( copy, &copy2 );
+	if ( !err )
+		err = play_frames( copy, remain, actual );
+	if ( !err && (actual != expected || gme_tell_samples( copy ) != tell ||
+			gme_track_ended( copy ) != ended) )
+		err = "clone played differently";
+	if ( !err )
+		err = play_frames( copy2, remain, again );
+	if ( !err && !same( copy, copy2, actual, again ) )
+		err = "clone of clone played differently";
+	gme_delete( copy );
+	gme_delete( copy2 );
+	if ( err )
+	{
+		snprintf( error, sizeof error, "after %ld frames: %s", played, err );
+		return error;
+	}
+	return 0;
+}
+
+// Clones before starting track
+static const char* check_unstarted( Test_Source const& src, setup_t const& s )
+{
+	Music_Emu* emu;
+	if ( gme_err_t err = open( src, s, &emu ) )
+		return err;
+	Music_Emu* copy = 0;
+	gme_err_t err = gme_clone( emu, &copy );
+	int const tracks [2] = { 0, gme_track_count( emu ) - 1 };
+	for ( int i = 0; i < 2 && !err; i++ )
+	{
+		samples_t a, b;
+		err = gme_start_track( emu, tracks [i] );
+		if ( !err )
+			err = gme_start_track( copy, tracks [i] );
+		if ( !err )
+			err = play_frames( emu, 44100, a );
+		if ( !err )
+			err = play_frames( copy, 44100, b );
+		if ( !err && !same( emu, copy, a, b ) )
+			err = "clone of unstarted emulator played differently";
+	}
+	gme_delete( emu );
+	gme_delete( copy );
+	return err;
+}
+
+static void check( Test_Source const& src )
+{
+	if ( !src.type )
+		return;
+	int const prev_failures = test_failures();
+	int checked = 0;
+	for ( setup_t const& s : setups )
+	{
+		gme_err_t err = check_unstarted( src, s );
+		long const played [] = { 0, 3000, 44100 + 17 };
+		for ( int i = 0; i < 3 && !err; i++ )
+			err = check_clone( src, s, played [i] );
+		if ( err && !strcmp( err, "unsupported for this emulator type" ) )
+			continue; // no multi-channel
+		checked++;
+		if ( err )
+			fail( "%-12s %-8s %s", src.name.c_str(), s.name, err );
+	}
+
+	// info-only emulators can't be cloned
+	if ( Music_Emu* info = gme_new_emu( src.type, gme_info_only ) )
+	{
+		Music_Emu* copy = 0;
+		if ( !load_source( info, src ) && (!gme_clone( info, &copy ) || copy) )
+			fail( "%-12s cloned info-only emulator", src.name.c_str() );
+		gme_delete( copy );
+		gme_delete( info );
+	}
+	if ( test_failures() == prev_failures )
+		pass( "%-12s %d setups", src.name.c_str(), checked );
+}
+
+int main( int argc, char** argv )
+{
+	std::vector<Fixture> fixtures;
+	make_fixtures( fixtures );
+	std::vector<Test_Source> sources;
+	if ( const char* err = make_sources( fixtures, argc, argv, sources ) )
+		fail( "%s", err );
+	for ( Test_Source const& src : sources )
+		check( src );
+	return finish_tests();
+}
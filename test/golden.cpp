@@ -0,0 +1,397 @@
+// Renders music files and compares hashes of the output against a manifest
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_golden [-u] [-j threads] [-d data_dir] manifest
+
+Each non-comment line of the manifest names something to render and the
+hash its output should have:
+
+	name  track  seconds  rate  options  hash
+
+name     file relative to data_dir, or fixture:<name> for one of the
+         generated fixtures in test/Fixtures.h
+options  "-" or a comma-separated list of:
+         multi   - use multi-channel output and hash every channel
+         zlib    - skip if library was built without zlib
+         ym=CORE - only check with YM2612 emulator CORE (Nuked, MAME, GENS),
+                   since each core's output differs
+         from=RATE - open at RATE and play part of track first, then change
+                   to rate with gme_set_sample_rate() and restart track;
+                   output should be the same as if opened at rate
+         latency=MSEC - limit latency with gme_set_max_latency()
+         reload  - get emulator from a pool, play it with other settings, then
+                   put it back and get it again; output should be the same as
+                   with a new emulator
+         frames=N - play N frames per gme_play() call rather than 1024
+         fast    - turn accuracy off with gme_enable_accuracy(), which runs SPC
+                   with its fast DSP mode
+hash     64-bit FNV-1a hash of the 16-bit little-endian samples
+
+Entries are rendered in parallel, each with its own emulator. Exits with
+failure if any entry's hash differs or it can't be rendered. With -u, the
+manifest is rewritten with the current hashes instead, which is how it was
+generated in the first place; only do that when output is meant to change. */
+
+#include "gme/gme.h"
+#include "Fixtures.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef GME_GOLDEN_YM2612
+	#define GME_GOLDEN_YM2612 "Nuked"
+#endif
+
+struct entry_t
+{
+	std::string line;    // original line, for rewriting comments as-is
+	bool is_entry;
+	std::string name;
+	int track;
+	int seconds;
+	int rate;
+	std::string options;
+	std::string expected;
+
+	// result
+	bool skipped;
+	std::string actual;
+	std::string error;
+};
+
+static std::vector<Fixture> fixtures;
+static std::string data_dir = ".";
+
+static bool has_option( entry_t const& e, const char* opt )
+{
+	std::string list = "," + e.options + ",";
+	return list.find( std::string( "," ) + opt + "," ) != std::string::npos;
+}
+
+// Reason entry doesn't apply to this build, or NULL
+static const char* skip_reason( entry_t const& e )
+{
+	size_t ym = e.options.find( "ym=" );
+	if ( ym != std::string::npos )
+	{
+		std::string core = e.options.substr( ym + 3, e.options.find( ',', ym ) - (ym + 3) );
+		if ( core != GME_GOLDEN_YM2612 )
+			return "other YM2612 emulator";
+	}
+	#ifndef GME_GOLDEN_ZLIB
+		if ( has_option( e, "zlib" ) )
+			return "built without zlib";
+	#endif
+	return 0;
+}
+
+static gme_err_t load_entry( Music_Emu* emu, Fixture const* fx, std::string const& path )
+{
+	return fx ? gme_load_data( emu, &fx->data [0], (long) fx->data.size() ) :
+			gme_load_file( emu, path.c_str() );
+}
+
+// Plays emulator with every setting changed, then returns it to pool and gets it
+// back, to check that gme_reset_for_reload() restores everything
+static gme_err_t reuse( gme_pool_t* pool, Music_Emu** emu, Fixture const* fx,
+		std::string const& path )
+{
+	gme_err_t err = load_entry( *emu, fx, path );
+	if ( !err )
+	{
+		gme_equalizer_t eq;
+		gme_equalizer( *emu, &eq );
+		eq.treble = -30;
+		eq.bass   = 200;
+		gme_set_equalizer( *emu, &eq );
+		gme_set_tempo( *emu, 1.5 );
+		gme_mute_voices( *emu, 1 );
+		gme_set_stereo_depth( *emu, 0.7 );
+		gme_set_max_latency( *emu, 5 );
+		gme_ignore_silence( *emu, 1 );
+		gme_disable_echo( *emu, 1 );
+		gme_enable_accuracy( *emu, 1 );
+		err = gme_start_track( *emu, gme_track_count( *emu ) - 1 );
+	}
+	std::vector<short> buf( 1024 * gme_channel_count( *emu ) );
+	for ( int n = 0; n < 8 && !err; n++ )
+		err = gme_play( *emu, (int) buf.size(), &buf [0] );
+
+	Music_Emu* const used = *emu;
+	gme_pool_release( pool, used );
+	*emu = gme_pool_acquire( pool );
+	if ( !err && *emu != used )
+		err = "Pool didn't reuse emulator";
+	return err;
+}
+
+static gme_err_t open_entry( entry_t const& e, Music_Emu** out )
+{
+	bool const multi = has_option( e, "multi" );
+	Fixture const* fx = 0;
+	std::string path;
+	gme_type_t type;
+	if ( !e.name.compare( 0, 8, "fixture:" ) )
+	{
+		for ( Fixture const& f : fixtures )
+			if ( e.name.compare( 8, std::string::npos, f.name ) == 0 )
+				fx = &f;
+		if ( !fx )
+			return "Unknown fixture";
+		type = gme_identify_extension( fx->ext );
+	}
+	else
+	{
+		path = data_dir + "/" + e.name;
+		if ( gme_err_t err = gme_identify_file( path.c_str(), &type ) )
+			return err;
+	}
+	if ( !type )
+		return gme_wrong_file_type;
+
+	size_t from = e.options.find( "from=" );
+	int const rate = (from != std::string::npos) ? atoi( e.options.c_str() + from + 5 ) : e.rate;
+	Music_Emu* emu;
+	gme_err_t err = 0;
+	if ( has_option( e, "reload" ) )
+	{
+		gme_pool_t* pool = gme_new_pool( type, rate, multi );
+		if ( !pool )
+			return "Out of memory";
+		emu = gme_pool_acquire( pool );
+		if ( emu )
+			err = reuse( pool, &emu, fx, path );
+		gme_delete_pool( pool );
+	}
+	else
+	{
+		emu = multi ? gme_new_emu_multi_channel( type, rate ) : gme_new_emu( type, rate );
+	}
+	if ( !emu )
+		return "Out of memory";
+	if ( !err )
+		err = load_entry( emu, fx, path );
+	if ( err )
+	{
+		gme_delete( emu );
+		return err;
+	}
+	size_t latency = e.options.find( "latency=" );
+	if ( latency != std::string::npos )
+		gme_set_max_latency( emu, atoi( e.options.c_str() + latency + 8 ) );
+	if ( has_option( e, "fast" ) )
+		gme_enable_accuracy( emu, 0 );
+	*out = emu;
+	return 0;
+}
+
+static gme_err_t render( entry_t& e )
+{
+	Music_Emu* emu = 0;
+	if ( gme_err_t err = open_entry( e, &emu ) )
+		return err;
+
+	unsigned long long hash = 0xCBF29CE484222325ull;
+	gme_err_t err = 0;
+	if ( e.options.find( "from=" ) != std::string::npos )
+	{
+		std::vector<short> buf( 1024 * gme_channel_count( emu ) );
+		err = gme_start_track( emu, e.track );
+		for ( int n = 0; n < 32 && !err; n++ )
+			err = gme_play( emu, (int) buf.size(), &buf [0] );
+		if ( !err )
+			err = gme_set_sample_rate( emu, e.rate );
+	}
+	if ( !err )
+		err = gme_start_track( emu, e.track );
+	if ( !err )
+	{
+		int const channels = gme_channel_count( emu );
+		size_t const frames_opt = e.options.find( "frames=" );
+		int const frames = (frames_opt != std::string::npos) ?
+				atoi( e.options.c_str() + frames_opt + 7 ) : 1024;
+		std::vector<short> buf( frames * channels );
+		long remain = (long) e.seconds * e.rate;
+		while ( remain > 0 && !err )
+		{
+			int const n = remain < frames ? (int) remain : frames;
+			err = gme_play( emu, n * channels, &buf [0] );
+			for ( int i = 0; i < n * channels; i++ )
+			{
+				hash = (hash ^ (buf [i] & 0xFF)) * 0x100000001B3ull;
+				hash = (hash ^ (buf [i] >> 8 & 0xFF)) * 0x100000001B3ull;
+			}
+			remain -= n;
+		}
+	}
+	gme_delete( emu );
+	if ( err )
+		return err;
+
+	char str [17];
+	snprintf( str, sizeof str, "%016llx", hash );
+	e.actual = str;
+	return 0;
+}
+
+static bool parse_manifest( const char* path, std::vector<entry_t>& out )
+{
+	FILE* in = fopen( path, "r" );
+	if ( !in )
+	{
+		perror( path );
+		return false;
+	}
+	char line [512];
+	int line_num = 0;
+	bool ok = true;
+	while ( fgets( line, sizeof line, in ) )
+	{
+		line_num++;
+		entry_t e = entry_t();
+		size_t len = strcspn( line, "\r\n" );
+		line [len] = 0;
+		e.line = line;
+
+		char name [256], options [128], hash [64];
+		if ( line [0] != '#' && sscanf( line, "%255s %d %d %d %127s %63s", name,
+				&e.track, &e.seconds, &e.rate, options, hash ) == 6 )
+		{
+			e.is_entry = true;
+			e.name     = name;
+			e.options  = strcmp( options, "-" ) ? options : "";
+			e.expected = hash;
+		}
+		else if ( line [0] && line [0] != '#' && strspn( line, " \t" ) != len )
+		{
+			fprintf( stderr, "%s:%d: expected name, track, seconds, rate, options, hash\n",
+					path, line_num );
+			ok = false;
+		}
+		out.push_back( e );
+	}
+	fclose( in );
+	return ok;
+}
+
+static bool write_manifest( const char* path, std::vector<entry_t> const& entries )
+{
+	FILE* out = fopen( path, "w" );
+	if ( !out )
+	{
+		perror( path );
+		return false;
+	}
+	for ( entry_t const& e : entries )
+	{
+		if ( !e.is_entry )
+		{
+			fprintf( out, "%s\n", e.line.c_str() );
+			continue;
+		}
+		fprintf( out, "%-24s %2d %3d %6d  %-16s %s\n", e.name.c_str(), e.track, e.seconds,
+				e.rate, e.options.empty() ? "-" : e.options.c_str(),
+				e.actual.empty() ? e.expected.c_str() : e.actual.c_str() );
+	}
+	return fclose( out ) == 0;
+}
+
+static void usage()
+{
+	fprintf( stderr, "Usage: gme_golden [-u] [-j threads] [-d data_dir] manifest\n" );
+	exit( EXIT_FAILURE );
+}
+
+int main( int argc, char** argv )
+{
+	bool update = false;
+	int thread_count = (int) std::thread::hardware_concurrency();
+	int i = 1;
+	for ( ; i < argc && argv [i] [0] == '-'; i++ )
+	{
+		if ( !strcmp( argv [i], "-u" ) )
+			update = true;
+		else if ( !strcmp( argv [i], "-j" ) && i + 1 < argc )
+			thread_count = atoi( argv [++i] );
+		else if ( !strcmp( argv [i], "-d" ) && i + 1 < argc )
+			data_dir = argv [++i];
+		else
+			usage();
+	}
+	if ( i + 1 != argc )
+		usage();
+	const char* manifest = argv [i];
+	if ( thread_count < 1 )
+		thread_count = 1;
+
+	std::vector<entry_t> entries;
+	if ( !parse_manifest( manifest, entries ) )
+		return EXIT_FAILURE;
+	make_fixtures( fixtures );
+
+	std::atomic<size_t> next( 0 );
+	auto worker = [&]() {
+		for ( size_t n; (n = next++) < entries.size(); )
+		{
+			entry_t& e = entries [n];
+			if ( !e.is_entry )
+				continue;
+			if ( skip_reason( e ) )
+			{
+				e.skipped = true;
+				continue;
+			}
+			if ( gme_err_t err = render( e ) )
+				e.error = err;
+		}
+	};
+	std::vector<std::thread> threads;
+	for ( int t = 1; t < thread_count; t++ )
+		threads.push_back( std::thread( worker ) );
+	worker();
+	for ( std::thread& t : threads )
+		t.join();
+
+	int checked = 0, skipped = 0, failed = 0;
+	for ( entry_t const& e : entries )
+	{
+		if ( !e.is_entry )
+			continue;
+		const char* status = "ok";
+		if ( e.skipped )
+		{
+			skipped++;
+			printf( "skip  %-24s %s (%s)\n", e.name.c_str(), e.options.c_str(), skip_reason( e ) );
+			continue;
+		}
+		checked++;
+		if ( !e.error.empty() )
+		{
+			failed++;
+			printf( "FAIL  %-24s %s: %s\n", e.name.c_str(), e.options.c_str(), e.error.c_str() );
+			continue;
+		}
+		if ( e.actual != e.expected )
+		{
+			status = update ? "new " : "FAIL";
+			if ( !update )
+				failed++;
+		}
+		printf( "%-4s  %-24s %s %s", status, e.name.c_str(), e.options.c_str(), e.actual.c_str() );
+		if ( e.actual != e.expected )
+			printf( " (expected %s)", e.expected.c_str() );
+		printf( "\n" );
+	}
+	printf( "%d checked, %d failed, %d skipped (YM2612: %s)\n", checked, failed, skipped,
+			GME_GOLDEN_YM2612 );
+
+	if ( update && !write_manifest( manifest, entries ) )
+		return EXIT_FAILURE;
+	return failed ? EXIT_FAILURE : 0;
+}
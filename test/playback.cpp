@@ -0,0 +1,619 @@
+// Checks track position, fades and other playback behavior on generated fixtures
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_playback_test [group ...]
+
+Runs each named group of checks, or all of them, on the fixtures in test/Fixtures.h
+that the group applies to.
+
+time64: seeks to just before sample 2^31, where 32-bit times used to wrap around,
+then plays past it into a fade. gme_tell64() etc. must keep counting, sound must
+continue, the fade must end the track when it should, and seeking back must still
+work. Only for emulators that skip quickly.
+
+lookahead: plays with background lookahead, muting all voices briefly then unmuting
+them. Since gme_play() no longer runs ahead looking for the end of silence, sound must
+come back right away rather than seconds later. Then mutes them for good, and the
+track must end where it does without background lookahead.
+
+fade: plays a track with and without a fade, in blocks that don't line up with the
+fade. Output must be untouched before the fade start, then the ratio between the two
+must fall steadily without steps, and the track must end at about the fade length.
+gme_play_planar() must give the same fade in float, keeping resolution that 16-bit
+output loses near the end.
+
+events: plays in large blocks that don't line up with anything, collecting events
+from gme_set_event_func(). A fade must report its start at the exact sample and its
+end about where it finishes, then gme_track_ended() must be true. Muting everything
+must report silence where it began, then the end of the track. The VGM fixture's loop
+must be reported each time around at the sample given by its header, also at another
+tempo and with gme_play_planar(). Offsets must match times, and events must be in
+order. */
+
+#include "gme/gme.h"
+#include "Fixtures.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int const rate = fixture_rate;
+static int const channels = fixture_channels;
+
+// time64
+
+static const char* play_past_2g( Music_Emu* emu )
+{
+	// a second before boundary
+	int64_t const boundary = (int64_t) 1 << 31;
+	int64_t const start = boundary - rate * channels;
+	if ( gme_err_t err = gme_seek_samples64( emu, start ) )
+		return err;
+	if ( gme_tell_samples64( emu ) != start )
+		return "wrong position after seek";
+	if ( gme_tell64( emu ) != start * 1000 / (rate * channels) )
+		return "wrong msec position after seek";
+
+	// fade starting 2 seconds later and lasting 1 second
+	int64_t const fade_start = gme_tell64( emu ) + 2000;
+	gme_set_fade_msecs( emu, (int) fade_start, 1000 );
+
+	short buf [4096];
+	bool sound_after = false;
+	while ( !gme_track_ended( emu ) && gme_tell64( emu ) < fade_start + 5000 )
+	{
+		int64_t const pos = gme_tell_samples64( emu );
+		if ( gme_err_t err = gme_play( emu, 4096, buf ) )
+			return err;
+		if ( gme_tell_samples64( emu ) != pos + 4096 )
+			return "position didn't advance";
+		if ( pos >= boundary )
+		{
+			for ( int i = 0; i < 4096; i++ )
+				sound_after |= buf [i] != 0;
+		}
+	}
+	if ( gme_tell_samples64( emu ) <= boundary )
+		return "didn't play past boundary";
+	if ( !sound_after )
+		return "no sound after boundary";
+	if ( !gme_track_ended( emu ) )
+		return "fade didn't end track";
+	int64_t const end = gme_tell64( emu );
+	if ( end <= fade_start + 500 || end >= fade_start + 1500 )
+		return "fade ended at wrong time";
+
+	// seeking back restarts track
+	if ( gme_err_t err = gme_seek64( emu, 1000 ) )
+		return err;
+	if ( gme_tell64( emu ) != 1000 || gme_tell_samples64( emu ) != rate * channels )
+		return "wrong position after seeking back";
+	return 0;
+}
+
+static const char* check_time64( Fixture const& f )
+{
+	Music_Emu* emu;
+	if ( const char* err = open_fixture( f, &emu ) )
+		return err;
+	const char* err = play_past_2g( emu );
+	gme_delete( emu );
+	return err;
+}
+
+// lookahead
+
+// Plays until msec position, or until sound if stop_at_sound. Returns error, or 0 and
+// sets *found if there was sound. Like gme_play(), counts low-level noise as silence.
+static gme_err_t play_until( Music_Emu* emu, int msec, bool stop_at_sound, bool* found )
+{
+	*found = false;
+	short buf [256 * 2];
+	while ( gme_tell( emu ) < msec && !gme_track_ended( emu ) )
+	{
+		if ( gme_err_t err = gme_play( emu, 256 * 2, buf ) )
+			return err;
+		for ( int i = 0; i < 256 * 2; i++ )
+			*found |= abs( buf [i] ) > 8;
+		if ( *found && stop_at_sound )
+			break;
+	}
+	return 0;
+}
+
+// Plays, then mutes and sets *end_msec to where track ended. With background
+// lookahead, first has a gap where sound must come back right after, and waits at
+// expected end for helper thread rather than playing past it.
+static const char* play_to_end( Music_Emu* emu, bool background, int expected, int* end_msec )
+{
+	bool sound;
+	if ( gme_err_t err = play_until( emu, 1000, false, &sound ) )
+		return err;
+	if ( !sound )
+		return "no sound";
+
+	if ( background )
+	{
+		// gap
+		gme_mute_voices( emu, -1 );
+		if ( gme_err_t err = play_until( emu, 1500, false, &sound ) ) // buffered sound and echo
+			return err;
+		if ( gme_err_t err = play_until( emu, 1800, false, &sound ) )
+			return err;
+		if ( sound )
+			return "sound while muted";
+		gme_mute_voices( emu, 0 );
+		if ( gme_err_t err = play_until( emu, 1900, true, &sound ) )
+			return err;
+		if ( !sound )
+			return "sound didn't come back soon after unmuting";
+		if ( gme_track_ended( emu ) )
+			return "track ended during gap";
+	}
+
+	// end
+	if ( gme_err_t err = play_until( emu, 3000, false, &sound ) )
+		return err;
+	gme_mute_voices( emu, -1 );
+
+	short buf [256 * 2];
+	while ( !gme_track_ended( emu ) && gme_tell( emu ) < 20000 )
+	{
+		if ( background && gme_tell( emu ) >= expected )
+			break;
+		if ( gme_err_t err = gme_play( emu, 256 * 2, buf ) )
+			return err;
+	}
+
+	// playing in real time would have given helper thread time to finish by now
+	for ( int i = 0; i < 2000 && !gme_track_ended( emu ); i++ )
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		if ( gme_err_t err = gme_play( emu, 2 * 2, buf ) )
+			return err;
+	}
+	if ( !gme_track_ended( emu ) )
+		return "track didn't end";
+	*end_msec = gme_tell( emu );
+
+	if ( background )
+	{
+		// turning it off goes back to normal
+		if ( gme_err_t err = gme_set_background_lookahead( emu, 0 ) )
+			return err;
+		gme_mute_voices( emu, 0 );
+		if ( gme_err_t err = gme_start_track( emu, 0 ) )
+			return err;
+		if ( gme_err_t err = play_until( emu, 500, false, &sound ) )
+			return err;
+		if ( !sound )
+			return "no sound after turning off";
+	}
+	return 0;
+}
+
+static const char* run_lookahead( Fixture const& f, bool background, int expected, int* end_msec )
+{
+	Music_Emu* emu;
+	if ( const char* err = open_fixture( f, &emu, false ) )
+		return err;
+	const char* err = gme_set_background_lookahead( emu, background );
+	if ( !err )
+		err = play_to_end( emu, background, expected, end_msec );
+	gme_delete( emu );
+	return err;
+}
+
+static const char* check_lookahead( Fixture const& f )
+{
+	int expected;
+	if ( const char* err = run_lookahead( f, false, 0, &expected ) )
+		return err;
+
+	int end;
+	if ( const char* err = run_lookahead( f, true, expected, &end ) )
+		return err;
+
+	// track ends a fixed time after silence begins, so only where gme_play() calls
+	// fall should make it differ
+	if ( end < expected - 50 || end > expected + 50 )
+	{
+		static char str [64];
+		snprintf( str, sizeof str, "track ended at %d msec rather than %d", end, expected );
+		return str;
+	}
+	return 0;
+}
+
+// fade
+
+static int const fade_start = 1010; // msec
+static int const fade_length = 1500;
+static int const fade_frames = 1000; // per gme_play() call, not a fade block multiple
+
+static const char* open_faded( Fixture const& f, bool fade, Music_Emu** out )
+{
+	if ( const char* err = open_fixture( f, out ) )
+		return err;
+	if ( fade )
+		gme_set_fade_msecs( *out, fade_start, fade_length );
+	return 0;
+}
+
+// Plays until faded emulator ends, and sets *end to sample where it did
+static const char* render( Fixture const& f, bool fade, std::vector<short>& out, long* end )
+{
+	Music_Emu* emu;
+	if ( const char* err = open_faded( f, fade, &emu ) )
+		return err;
+	long const max = (long) msec_to_samples( fade_start + fade_length * 2 );
+	out.resize( max );
+	*end = max;
+	for ( long pos = 0; pos < max; pos += fade_frames * channels )
+	{
+		if ( fade && gme_track_ended( emu ) && *end == max )
+			*end = pos;
+		int const n = (int) (max - pos < fade_frames * channels ? max - pos : fade_frames * channels);
+		if ( gme_err_t err = gme_play( emu, n, &out [pos] ) )
+		{
+			gme_delete( emu );
+			return err;
+		}
+	}
+	gme_delete( emu );
+	return 0;
+}
+
+static const char* render_planar( Fixture const& f, long count, std::vector<float>& out )
+{
+	Music_Emu* emu;
+	if ( const char* err = open_faded( f, true, &emu ) )
+		return err;
+	std::vector<float> planes [channels];
+	for ( int c = 0; c < channels; c++ )
+		planes [c].resize( count / channels );
+	for ( long pos = 0; pos < count / channels; pos += fade_frames )
+	{
+		float* p [channels];
+		for ( int c = 0; c < channels; c++ )
+			p [c] = &planes [c] [pos];
+		long const n = count / channels - pos < fade_frames ? count / channels - pos : fade_frames;
+		if ( gme_err_t err = gme_play_planar( emu, (int) n, p ) )
+		{
+			gme_delete( emu );
+			return err;
+		}
+	}
+	gme_delete( emu );
+
+	out.resize( count );
+	for ( long i = 0; i < count; i++ )
+		out [i] = planes [i % channels] [i / channels];
+	return 0;
+}
+
+static const char* check_fade( Fixture const& f )
+{
+	std::vector<short> plain, faded;
+	long end, unused;
+	if ( const char* err = render( f, false, plain, &unused ) )
+		return err;
+	if ( const char* err = render( f, true, faded, &end ) )
+		return err;
+
+	long const start = (long) msec_to_samples( fade_start );
+	if ( memcmp( &plain [0], &faded [0], start * sizeof plain [0] ) )
+		return "output changed before fade start";
+	if ( plain [start] != 0 && faded [start] == plain [start] && faded [start + 2000] == plain [start + 2000] )
+		return "fade didn't start";
+
+	// gain only falls, by no more than it should between nearby samples; old fade
+	// dropped by 2% every 512 samples
+	double prev_gain = 1.0;
+	double prev_tolerance = 0.0;
+	long prev = start;
+	bool quiet = false;
+	for ( long i = start; i < end; i++ )
+	{
+		if ( abs( plain [i] ) < 4000 )
+			continue;
+		double const gain = (double) faded [i] / plain [i];
+		double const tolerance = 1.0 / abs( plain [i] ) + prev_tolerance; // rounding
+		if ( gain > prev_gain + tolerance )
+			return "gain went up during fade";
+		if ( gain < prev_gain - 0.0001 * (i - prev) - tolerance )
+			return "gain stepped down";
+		prev_gain = gain;
+		prev_tolerance = 1.0 / abs( plain [i] );
+		prev = i;
+		quiet |= gain < 0.1;
+	}
+	if ( !quiet )
+		return "didn't get quiet";
+
+	long const expected_end = (long) msec_to_samples( fade_start + fade_length );
+	if ( end < expected_end - msec_to_samples( 100 ) || end > expected_end + msec_to_samples( 100 ) )
+		return "fade ended at wrong time";
+
+	// float output is same fade, with more resolution
+	std::vector<float> planar;
+	if ( const char* err = render_planar( f, end, planar ) )
+		return err;
+	bool finer = false;
+	for ( long i = 0; i < end; i++ )
+	{
+		float const s = planar [i] * 0x8000;
+		if ( fabs( s - faded [i] ) > 3.0f ) // 16-bit gain and result are rounded down
+			return "planar output differs";
+		finer |= faded [i] && i > start && s != floorf( s );
+	}
+	if ( !finer )
+		return "planar fade has no more resolution than 16-bit";
+	return 0;
+}
+
+// events
+
+struct played_t
+{
+	std::vector<gme_event_t> events;
+	int64_t block_start;
+	int block_frames;
+	bool planar;
+	const char* problem; // first problem found in an event
+};
+
+static void record_event( void* data, gme_event_t const* e )
+{
+	played_t& p = *(played_t*) data;
+	int const count = p.block_frames * (p.planar ? 1 : channels);
+
+	// silence can have begun in an earlier call, which offset can't point to
+	int64_t expected = (e->time - p.block_start) / (p.planar ? channels : 1);
+	if ( e->type == gme_event_silence_start && expected < 0 )
+		expected = 0;
+	if ( !p.problem && (e->offset < 0 || e->offset > count || e->offset != expected) )
+		p.problem = "event offset doesn't match its time";
+	if ( !p.problem && !p.events.empty() && e->time < p.events.back().time )
+		p.problem = "events out of order";
+	p.events.push_back( *e );
+}
+
+// Plays block_frames at a time until msec or track ends. Sets *ended_at to time of
+// first call after which gme_track_ended() was true, or -1.
+static const char* play_events( Music_Emu* emu, played_t& p, int msec, int block_frames, bool planar,
+		int64_t* ended_at = 0 )
+{
+	std::vector<short> buf( block_frames * channels );
+	std::vector<float> planes_data( block_frames * channels );
+	float* planes [channels];
+	for ( int c = 0; c < channels; c++ )
+		planes [c] = &planes_data [c * block_frames];
+
+	gme_set_event_func( emu, record_event, &p );
+	p.block_frames = block_frames;
+	p.planar = planar;
+	if ( ended_at )
+		*ended_at = -1;
+	while ( gme_tell( emu ) < msec && !gme_track_ended( emu ) )
+	{
+		p.block_start = gme_tell_samples64( emu );
+		gme_err_t err = planar ? gme_play_planar( emu, block_frames, planes ) :
+				gme_play( emu, block_frames * channels, &buf [0] );
+		if ( err )
+			return err;
+		if ( ended_at && gme_track_ended( emu ) )
+			*ended_at = p.block_start;
+	}
+	gme_set_event_func( emu, 0, 0 );
+	return p.problem;
+}
+
+static int count_events( played_t const& p, gme_event_type_t type )
+{
+	int n = 0;
+	for ( gme_event_t const& e : p.events )
+		n += e.type == type;
+	return n;
+}
+
+static gme_event_t const* find_event( played_t const& p, gme_event_type_t type )
+{
+	for ( gme_event_t const& e : p.events )
+		if ( e.type == type )
+			return &e;
+	return 0;
+}
+
+static const char* check_fade_events( Fixture const& f, bool planar )
+{
+	int const start = 1010;
+	int const length = 500;
+	Music_Emu* emu;
+	if ( const char* err = open_fixture( f, &emu ) )
+		return err;
+	gme_set_fade_msecs( emu, start, length );
+
+	played_t p = played_t();
+	int64_t ended_at;
+	const char* err = play_events( emu, p, 10000, 4001, planar, &ended_at );
+	gme_delete( emu );
+	if ( err )
+		return err;
+
+	gme_event_t const* fade = find_event( p, gme_event_fade_start );
+	gme_event_t const* end = find_event( p, gme_event_track_end );
+	if ( count_events( p, gme_event_fade_start ) != 1 || !fade )
+		return "no fade start event";
+	if ( fade->time != msec_to_samples( start ) )
+		return "fade start at wrong time";
+	if ( count_events( p, gme_event_track_end ) != 1 || !end )
+		return "no track end event";
+	int64_t const expected_end = msec_to_samples( start + length );
+	if ( end->time < expected_end - msec_to_samples( 100 ) || end->time > expected_end + msec_to_samples( 100 ) )
+		return "fade ended at wrong time";
+	if ( ended_at < 0 || end->time < ended_at || end->time > ended_at + 4001 * channels )
+		return "track end wasn't reported in call where track ended";
+	if ( &p.events.back() != end )
+		return "event after track end";
+	return 0;
+}
+
+static const char* check_silence_events( Fixture const& f )
+{
+	Music_Emu* emu;
+	if ( const char* err = open_fixture( f, &emu, false ) )
+		return err;
+
+	played_t p = played_t();
+	const char* err = play_events( emu, p, 1000, 3001, false );
+	int64_t const muted = gme_tell_samples64( emu );
+	gme_mute_voices( emu, -1 );
+	int64_t ended_at = -1;
+	if ( !err )
+		err = play_events( emu, p, 30000, 3001, false, &ended_at );
+	gme_delete( emu );
+	if ( err )
+		return err;
+
+	gme_event_t const* silence = find_event( p, gme_event_silence_start );
+	gme_event_t const* end = find_event( p, gme_event_track_end );
+	if ( !silence )
+		return "no silence start event";
+	if ( silence->time < muted || silence->time > muted + msec_to_samples( 500 ) )
+		return "silence start at wrong time";
+	if ( !end || ended_at < 0 )
+		return "no track end event";
+	if ( end->time < silence->time || end->time < ended_at || end->time > ended_at + 3001 * channels )
+		return "track end at wrong time";
+	if ( count_events( p, gme_event_fade_start ) || count_events( p, gme_event_loop ) )
+		return "unexpected event";
+	return 0;
+}
+
+static long get_le32( unsigned char const* p )
+{
+	return p [0] | p [1] << 8 | p [2] << 16 | (long) p [3] << 24;
+}
+
+static const char* check_loop_events( Fixture const& f, double tempo, bool planar )
+{
+	// VGM header gives loop in 44100 Hz samples, same as rate here
+	long const loop = get_le32( &f.data [0x20] );
+	long const intro = get_le32( &f.data [0x18] ) - loop;
+
+	Music_Emu* emu;
+	if ( const char* err = open_fixture( f, &emu ) )
+		return err;
+	gme_set_tempo( emu, tempo );
+	played_t p = played_t();
+	const char* err = play_events( emu, p, 4000, 7777, planar );
+	gme_delete( emu );
+	if ( err )
+		return err;
+
+	int n = 0;
+	for ( gme_event_t const& e : p.events )
+	{
+		if ( e.type != gme_event_loop )
+			return "unexpected event";
+		n++;
+		if ( e.loop != n )
+			return "loop count wrong";
+		// track position drops fraction of a frame on each call at other tempos
+		int64_t const frame = (int64_t) ((intro + (double) n * loop) / tempo);
+		int64_t const calls = e.time / channels / 7777 + 1;
+		if ( e.time / channels < frame - 1 || e.time / channels > frame + (tempo != 1.0 ? calls : 0) )
+			return "loop at wrong time";
+	}
+	int const expected = (int) ((4.0 * rate * tempo - intro) / loop);
+	if ( n < expected - 1 || n > expected + 1 )
+		return "wrong number of loops";
+	return 0;
+}
+
+static const char* check_events( Fixture const& f )
+{
+	if ( !strcmp( f.name, "vgm" ) )
+	{
+		const char* err = check_loop_events( f, 1.0, false );
+		if ( !err )
+			err = check_loop_events( f, 1.0, true );
+		if ( !err )
+			err = check_loop_events( f, 1.7, false );
+		return err;
+	}
+	const char* err = check_fade_events( f, false );
+	if ( !err )
+		err = check_fade_events( f, true );
+	if ( !err )
+		err = check_silence_events( f );
+	return err;
+}
+
+// Runner
+
+struct group_t
+{
+	const char* name;
+	const char* fixtures; // names separated by spaces, or NULL for all
+	const char* (*check)( Fixture const& );
+};
+
+static group_t const groups [] = {
+	{ "time64",    "hes nsf sap", check_time64 }, // others take too long to skip 2^31 samples
+	{ "lookahead", 0,             check_lookahead },
+	{ "fade",      "nsf spc vgm", check_fade },
+	{ "events",    "nsf spc vgm", check_events },
+};
+
+static bool listed( const char* list, const char* name )
+{
+	size_t const len = strlen( name );
+	for ( const char* p = list; (p = strstr( p, name )) != 0; p += len )
+	{
+		if ( (p == list || p [-1] == ' ') && (p [len] == ' ' || !p [len]) )
+			return true;
+	}
+	return false;
+}
+
+int main( int argc, char** argv )
+{
+	std::vector<Fixture> fixtures;
+	make_fixtures( fixtures );
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		bool known = false;
+		for ( group_t const& g : groups )
+			known |= !strcmp( argv [i], g.name );
+		if ( !known )
+			fail( "%s: no such group", argv [i] );
+	}
+
+	for ( group_t const& g : groups )
+	{
+		bool wanted = argc <= 1;
+		for ( int i = 1; i < argc; i++ )
+			wanted |= !strcmp( argv [i], g.name );
+		if ( !wanted )
+			continue;
+
+		for ( Fixture const& f : fixtures )
+		{
+			if ( (g.fixtures && !listed( g.fixtures, f.name )) || !gme_identify_extension( f.ext ) )
+				continue;
+			std::string const name = std::string( g.name ) + " " + f.name;
+			report( name.c_str(), g.check( f ) );
+		}
+	}
+
+	return finish_tests();
+}
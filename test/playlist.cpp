@@ -0,0 +1,258 @@
+// Checks gme_playlist_t gapless playback
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_playlist_test
+
+Plays playlists of fixtures from test/Fixtures.h and compares them with each track
+played on its own until its end. Without crossfade, output must be the tracks joined
+at their exact ends, skipping one that can't be opened. With crossfade, the next track
+must be mixed in fading up from where the one before it has that much fade left. An m3u
+playlist written next to the test's copies of the fixtures must play the same way. */
+
+#include "gme/gme.h"
+#include "Fixtures.h"
+
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int const rate = fixture_rate;
+static int const channels = fixture_channels;
+static int const block = 3001; // frames per gme_playlist_play()
+
+typedef std::vector<short> samples_t;
+
+struct track_t
+{
+	const char* name; // fixture
+	int length;       // msec
+	int fade;
+};
+
+static void on_event( void* end, gme_event_t const* e )
+{
+	if ( e->type == gme_event_track_end )
+		*(int64_t*) end = e->time;
+}
+
+// Plays track on its own up to where it ends
+static const char* render( Fixture const& f, track_t const& t, samples_t& out )
+{
+	Music_Emu* emu;
+	if ( const char* err = open_fixture( f, &emu, false ) )
+		return err;
+	gme_set_fade_msecs( emu, t.length, t.fade );
+	int64_t end = -1;
+	gme_set_event_func( emu, on_event, &end );
+	out.clear();
+	gme_err_t err = 0;
+	while ( !err && !gme_track_ended( emu ) )
+	{
+		size_t const pos = out.size();
+		out.resize( pos + 1000 * channels );
+		err = gme_play( emu, 1000 * channels, &out [pos] );
+	}
+	gme_delete( emu );
+	if ( err )
+		return err;
+	if ( end < 0 || end > (int64_t) out.size() )
+		return "track didn't end";
+	out.resize( (size_t) end );
+	return 0;
+}
+
+// Plays playlist until it ends, checking that it moves through tracks in order
+static const char* play( gme_playlist_t* pl, int track_count, samples_t& out )
+{
+	int prev = -1;
+	int const max = msec_to_samples( 20000 );
+	out.clear();
+	while ( !gme_playlist_ended( pl ) )
+	{
+		if ( (int) out.size() > max )
+			return "playlist didn't end";
+		gme_playlist_wait( pl );
+		size_t const pos = out.size();
+		out.resize( pos + block * channels );
+		gme_playlist_play( pl, block * channels, &out [pos] );
+		int const current = gme_playlist_current( pl );
+		if ( current >= 0 && current < prev )
+			return "went back to earlier track";
+		if ( current >= track_count )
+			return "track index out of range";
+		if ( current >= 0 )
+			prev = current;
+	}
+	if ( prev != track_count - 1 )
+		return "didn't reach last track";
+	return 0;
+}
+
+static const char* compare( samples_t const& out, samples_t const& expected, int tolerance )
+{
+	for ( size_t i = 0; i < out.size(); i++ )
+	{
+		int const e = i < expected.size() ? expected [i] : 0;
+		if ( abs( out [i] - e ) > tolerance )
+		{
+			static char str [64];
+			snprintf( str, sizeof str, "output differs at sample %ld", (long) i );
+			return str;
+		}
+	}
+	if ( out.size() < expected.size() )
+		return "output too short";
+	return 0;
+}
+
+static const char* check_gapless( std::vector<Fixture> const& fixtures )
+{
+	static track_t const tracks [] = {
+		{ "nsf", 700, 300 },
+		{ "vgm", 500, 0 },
+		{ "spc", 400, 200 },
+	};
+
+	gme_playlist_t* pl = gme_new_playlist( rate );
+	if ( !pl )
+		return "Out of memory";
+	samples_t expected;
+	const char* err = 0;
+	int count = 0;
+	for ( track_t const& t : tracks )
+	{
+		Fixture const* f = find_fixture( fixtures, t.name );
+		if ( !f || err )
+			continue;
+		samples_t s;
+		err = render( *f, t, s );
+		expected.insert( expected.end(), s.begin(), s.end() );
+		if ( !err )
+			err = gme_playlist_add_data( pl, &f->data [0], (long) f->data.size(), 0, t.length, t.fade );
+		count++;
+
+		// one that can't be opened gets skipped
+		static unsigned char const junk [] = "not a music file";
+		if ( !err && count == 1 )
+			err = gme_playlist_add_data( pl, junk, sizeof junk, 0, -1, -1 );
+		count += count == 1;
+	}
+
+	samples_t out;
+	if ( !err )
+		err = play( pl, count, out );
+	if ( !err && !gme_playlist_warning( pl ) )
+		err = "no warning for file that couldn't be opened";
+	gme_delete_playlist( pl );
+	if ( !err )
+		err = compare( out, expected, 0 );
+	return err;
+}
+
+static const char* check_crossfade( std::vector<Fixture> const& fixtures )
+{
+	int const xfade = 250;
+	track_t const a = { "nsf", 700, 500 };
+	track_t const b = { "vgm", 600, 0 };
+	Fixture const* fa = find_fixture( fixtures, a.name );
+	Fixture const* fb = find_fixture( fixtures, b.name );
+	if ( !fa || !fb )
+		return 0;
+
+	samples_t sa, sb;
+	if ( const char* err = render( *fa, a, sa ) )
+		return err;
+	if ( const char* err = render( *fb, b, sb ) )
+		return err;
+
+	// second track starts where first has xfade msec of fade left, fading in over that
+	long const start = (long) msec_to_samples( a.length + a.fade - xfade );
+	long const ramp = (long) msec_to_samples( xfade );
+	if ( (long) sa.size() <= start || (long) sa.size() > start + ramp )
+		return "first track doesn't end during crossfade";
+	samples_t expected( start + sb.size() );
+	for ( size_t i = 0; i < expected.size(); i++ )
+	{
+		int s = i < sa.size() ? sa [i] : 0;
+		if ( (long) i >= start )
+		{
+			long const t = (long) i - start;
+			int in = sb [t];
+			if ( t < ramp )
+				in = short (in * (float (t & ~1) * (1.0f / ramp)));
+			s += in;
+		}
+		expected [i] = short (s < -0x8000 ? -0x8000 : s > 0x7FFF ? 0x7FFF : s);
+	}
+
+	gme_playlist_t* pl = gme_new_playlist( rate );
+	if ( !pl )
+		return "Out of memory";
+	gme_playlist_set_crossfade( pl, xfade );
+	const char* err = gme_playlist_add_data( pl, &fa->data [0], (long) fa->data.size(), 0, a.length, a.fade );
+	if ( !err )
+		err = gme_playlist_add_data( pl, &fb->data [0], (long) fb->data.size(), 0, b.length, b.fade );
+	samples_t out;
+	if ( !err )
+		err = play( pl, 2, out );
+	gme_delete_playlist( pl );
+	if ( !err )
+		err = compare( out, expected, 0 );
+	return err;
+}
+
+static bool write_file( const char* path, void const* data, size_t size )
+{
+	FILE* f = fopen( path, "wb" );
+	if ( !f )
+		return false;
+	bool ok = fwrite( data, 1, size, f ) == size;
+	return !fclose( f ) && ok;
+}
+
+static const char* check_m3u( std::vector<Fixture> const& fixtures )
+{
+	Fixture const* f = find_fixture( fixtures, "nsf" );
+	if ( !f )
+		return 0;
+	track_t const t = { "nsf", 700, 300 };
+	samples_t s;
+	if ( const char* err = render( *f, t, s ) )
+		return err;
+	samples_t expected( s );
+	expected.insert( expected.end(), s.begin(), s.end() );
+
+	// NSF tracks in m3u start at 1, and missing file gets skipped
+	static char const m3u [] =
+		"gme_playlist_test.nsf::NSF,1,First,0.7,,0.3\n"
+		"gme_playlist_test_missing.nsf::NSF,1,Missing,0.7,,0.3\n"
+		"gme_playlist_test.nsf::NSF,1,Again,0.7,,0.3\n";
+	if ( !write_file( "gme_playlist_test.nsf", &f->data [0], f->data.size() ) ||
+			!write_file( "gme_playlist_test.m3u", m3u, sizeof m3u - 1 ) )
+		return "couldn't write files";
+
+	gme_playlist_t* pl = gme_new_playlist( rate );
+	const char* err = pl ? gme_playlist_load_m3u( pl, "gme_playlist_test.m3u" ) : "Out of memory";
+	samples_t out;
+	if ( !err )
+		err = play( pl, 3, out );
+	if ( !err && !gme_playlist_warning( pl ) )
+		err = "no warning for missing file";
+	gme_delete_playlist( pl );
+	remove( "gme_playlist_test.nsf" );
+	remove( "gme_playlist_test.m3u" );
+	if ( !err )
+		err = compare( out, expected, 0 );
+	return err;
+}
+
+int main()
+{
+	std::vector<Fixture> fixtures;
+	make_fixtures( fixtures );
+	report( "gapless",   check_gapless( fixtures ) );
+	report( "crossfade", check_crossfade( fixtures ) );
+	report( "m3u",       check_m3u( fixtures ) );
+	return finish_tests();
+}
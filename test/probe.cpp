@@ -0,0 +1,225 @@
+// Checks that gme_probe_info() reports the same information as gme_track_info()
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_probe [file ...]
+
+Checks the generated fixtures in test/Fixtures.h, copies of some of them with
+every kind of metadata added, and any files named. For each, every track's
+information from gme_probe_info() must match what gme_open_data() with
+gme_info_only then gme_track_info() gives. Every truncated copy of each is also
+probed, to catch reads past the end of data when run with a memory checker. */
+
+#include "gme/gme.h"
+#include "Fixtures.h"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+typedef std::vector<unsigned char> bytes_t;
+
+static std::string str( gme_str_t const& s ) { return std::string( s.str, s.len ); }
+
+static int record( void* user_data, gme_probe_t const* info )
+{
+	std::vector<std::string>* strs = (std::vector<std::string>*) user_data;
+	gme_str_t const* fields [] = { &info->system, &info->game, &info->song, &info->author,
+			&info->copyright, &info->comment, &info->dumper };
+	char times [64];
+	snprintf( times, sizeof times, "%d %d %d %d %d %d", info->track, info->track_count,
+			info->length, info->intro_length, info->loop_length, info->fade_length );
+	strs->push_back( times );
+	for ( gme_str_t const* f : fields )
+		strs->push_back( str( *f ) );
+	return 0;
+}
+
+static int stop_after_first( void* user_data, gme_probe_t const* )
+{
+	++*(int*) user_data;
+	return 1;
+}
+
+static void check( const char* name, bytes_t const& data )
+{
+	// probed strings are only valid during callback, so record copies
+	std::vector<std::string> probed;
+	if ( gme_err_t err = gme_probe_info( &data [0], (long) data.size(), record, &probed ) )
+	{
+		report( name, err );
+		return;
+	}
+
+	Music_Emu* emu;
+	if ( gme_err_t err = gme_open_data( &data [0], (long) data.size(), &emu, gme_info_only ) )
+	{
+		fail( "%-12s can't open: %s", name, err );
+		return;
+	}
+	int const track_count = gme_track_count( emu );
+	size_t const per_track = 8;
+	if ( probed.size() != track_count * per_track )
+		fail( "%-12s reported %d tracks (expected %d)", name,
+				(int) (probed.size() / per_track), track_count );
+	for ( int i = 0; i < track_count && (i + 1) * per_track <= probed.size(); i++ )
+	{
+		gme_info_t* info;
+		if ( gme_err_t err = gme_track_info( emu, &info, i ) )
+		{
+			fail( "%-12s track %d: %s", name, i, err );
+			continue;
+		}
+		char times [64];
+		snprintf( times, sizeof times, "%d %d %d %d %d %d", i, track_count,
+				info->length, info->intro_length, info->loop_length, info->fade_length );
+		const char* fields [] = { times, info->system, info->game, info->song, info->author,
+				info->copyright, info->comment, info->dumper };
+		const char* names [] = { "track/times", "system", "game", "song", "author",
+				"copyright", "comment", "dumper" };
+		for ( size_t f = 0; f < per_track; f++ )
+			if ( probed [i * per_track + f] != fields [f] )
+				fail( "%-12s track %d %s: \"%s\" (expected \"%s\")", name, i, names [f],
+						probed [i * per_track + f].c_str(), fields [f] );
+		gme_free_info( info );
+	}
+	gme_delete( emu );
+
+	int calls = 0;
+	gme_probe_info( &data [0], (long) data.size(), stop_after_first, &calls );
+	if ( calls != (track_count ? 1 : 0) )
+		fail( "%-12s callback called %d times after asking to stop", name, calls );
+
+	// must not read past end; exact copy so a memory checker sees the end. Headers
+	// and trailers are what get parsed, so only truncate within those.
+	size_t const edge = 2048;
+	for ( size_t size = 0; size < data.size(); size++ )
+	{
+		if ( size == edge && data.size() > edge * 2 )
+			size = data.size() - edge;
+		bytes_t part( data.begin(), data.begin() + size );
+		std::vector<std::string> ignored;
+		gme_probe_info( size ? &part [0] : 0, (long) size, record, &ignored );
+	}
+
+	pass( "%-12s %d tracks", name, track_count );
+}
+
+static void set_le32( bytes_t& f, size_t pos, unsigned long n )
+{
+	for ( int i = 0; i < 4; i++ )
+		f [pos + i] = (unsigned char) (n >> (i * 8));
+}
+
+static void add_block( bytes_t& f, const char* tag, std::string const& data )
+{
+	size_t pos = f.size();
+	f.resize( pos + 8 );
+	set_le32( f, pos, data.size() );
+	memcpy( &f [pos + 4], tag, 4 );
+	f.insert( f.end(), data.begin(), data.end() );
+}
+
+static bytes_t tagged_nsfe( bytes_t f )
+{
+	f.resize( f.size() - 8 ); // NEND
+	add_block( f, "auth", std::string( "Game\0  Author \0?\0Dumper", 23 ) );
+	add_block( f, "tlbl", std::string( "First\0Second\0\0Fourth", 20 ) );
+	std::string times( 12, 0 );
+	times [1] = 0x10; // 4096 msec
+	times [4] = 1;
+	add_block( f, "time", times );
+	add_block( f, "plst", std::string( "\3\1\0\2\7", 5 ) );
+	add_block( f, "NEND", std::string() );
+	f [0x14] = 4; // track count in INFO
+	return f;
+}
+
+static void add_utf16( std::string& out, const char* in )
+{
+	do
+	{
+		out += *in;
+		out += (*in == '^' ? '\x30' : '\0'); // ^ stands for non-ASCII character
+	}
+	while ( *in++ );
+}
+
+static bytes_t tagged_vgm( bytes_t f )
+{
+	std::string gd3;
+	const char* strs [] = { "Song", "", "Game ", "", "System", "", "Author^", "",
+			"2006", "Dumper", "Comment" };
+	for ( const char* s : strs )
+		add_utf16( gd3, s );
+	std::string h( "Gd3 \0\1\0\0", 8 );
+	h.resize( 12 );
+	bytes_t header( h.begin(), h.end() );
+	set_le32( header, 8, gd3.size() );
+	set_le32( f, 0x14, f.size() - 0x14 ); // GD3 offset
+	f.insert( f.end(), header.begin(), header.end() );
+	f.insert( f.end(), gd3.begin(), gd3.end() );
+	set_le32( f, 0x04, f.size() - 4 ); // EOF offset
+	return f;
+}
+
+static bytes_t tagged_spc( bytes_t f )
+{
+	f.resize( 0x10200 );
+	memcpy( &f [0x2E], "  Song  ", 8 );
+	memcpy( &f [0x4E], "Game", 4 );
+	memcpy( &f [0x6E], "<?>", 3 );
+	memcpy( &f [0x7E], "Comment", 7 );
+	memcpy( &f [0xA9], "123", 3 ); // length in seconds
+	memcpy( &f [0xB1], "Author", 6 );
+
+	std::string xid6;
+	xid6 += std::string( "\1\1\x09\0xid6 song", 13 ) + std::string( 3, 0 );
+	xid6 += std::string( "\x14\0\xD6\7", 4 ); // year 2006
+	xid6 += std::string( "\x13\1\x0A\0Publisher\0", 14 ) + std::string( 2, 0 );
+	xid6 += std::string( "\7\1\x04\0\0\0\0\0", 8 ); // empty, so ID666 comment stays
+	std::string h( "xid6", 4 );
+	h += std::string( 4, 0 );
+	bytes_t header( h.begin(), h.end() );
+	set_le32( header, 4, xid6.size() );
+	f.insert( f.end(), header.begin(), header.end() );
+	f.insert( f.end(), xid6.begin(), xid6.end() );
+	return f;
+}
+
+int main( int argc, char** argv )
+{
+	std::vector<Fixture> fixtures;
+	make_fixtures( fixtures );
+	std::vector<Test_Source> sources;
+	if ( const char* err = make_sources( fixtures, argc, argv, sources ) )
+	{
+		fail( "%s", err );
+		return finish_tests();
+	}
+
+	for ( Test_Source const& src : sources )
+	{
+		if ( !src.type )
+			continue;
+		bytes_t data;
+		if ( const char* err = read_source( src, data ) )
+		{
+			report( src.name.c_str(), err );
+			continue;
+		}
+		check( src.name.c_str(), data );
+		if ( !src.fixture )
+			continue;
+		std::string tagged = src.name + "+tags";
+		if ( src.name == "nsfe" )
+			check( tagged.c_str(), tagged_nsfe( data ) );
+		if ( src.name == "vgm" )
+			check( tagged.c_str(), tagged_vgm( data ) );
+		if ( src.name == "spc" )
+			check( tagged.c_str(), tagged_spc( data ) );
+	}
+
+	return finish_tests();
+}
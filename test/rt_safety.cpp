@@ -0,0 +1,269 @@
+// Checks that calls made on a real-time audio thread are safe there
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_rt_safety [file ...]
+
+For the generated fixtures in test/Fixtures.h and any files named, starts a track
+with various settings, then plays while changing fade, muting, tempo and equalizer.
+None of gme_play(), gme_play_planar(), gme_set_fade(), gme_set_fade_msecs(),
+gme_mute_voice(), gme_mute_voices(), gme_set_tempo() and gme_set_equalizer() may
+allocate memory, which is caught by replacing malloc() etc. where possible. If the
+library was built with GME_RT_CHECK, gme_rt_report() must also show that they took
+no locks and did no file I/O. With a max latency set or background lookahead, they
+also mustn't emulate far ahead of what they output; otherwise silence detection may
+still do that, which is just noted. */
+
+#include "gme/gme.h"
+#include "Fixtures.h"
+
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool lib_checks = true; // library built with GME_RT_CHECK
+static long lookahead_overruns = 0; // overruns allowed without max latency
+
+// Allocation checking
+
+// Set while in a call that must not allocate
+static thread_local const char* rt_call;
+static thread_local const char* rt_alloc; // first call that allocated
+
+#if defined (__GLIBC__)
+	#define RT_INTERPOSE 1
+
+extern "C" {
+	void* __libc_malloc( size_t );
+	void* __libc_calloc( size_t, size_t );
+	void* __libc_realloc( void*, size_t );
+	void __libc_free( void* );
+
+	static void note_alloc()
+	{
+		if ( rt_call && !rt_alloc )
+			rt_alloc = rt_call;
+	}
+
+	void* malloc( size_t n )
+	{
+		note_alloc();
+		return __libc_malloc( n );
+	}
+
+	void* calloc( size_t n, size_t size )
+	{
+		note_alloc();
+		return __libc_calloc( n, size );
+	}
+
+	void* realloc( void* p, size_t n )
+	{
+		note_alloc();
+		return __libc_realloc( p, n );
+	}
+
+	void free( void* p )
+	{
+		if ( p )
+			note_alloc();
+		__libc_free( p );
+	}
+}
+#else
+	#define RT_INTERPOSE 0
+#endif
+
+// Marks rest of scope as a real-time call
+struct Rt_Call
+{
+	explicit Rt_Call( const char* name ) { rt_call = name; }
+	~Rt_Call() { rt_call = 0; }
+};
+
+// Session
+
+struct setup_t
+{
+	const char* name;
+	bool multi;
+	double depth;   // stereo depth
+	int latency;    // msec, or 0
+	bool background; // gme_set_background_lookahead()
+};
+
+static setup_t const setups [] = {
+	{ "stereo",     false, 0.0,  0, false },
+	{ "effects",    false, 0.8,  0, false },
+	{ "multi",      true,  0.0,  0, false },
+	{ "latency",    false, 0.0, 10, false },
+	{ "background", false, 0.0,  0, true  },
+};
+
+static gme_err_t play( Music_Emu* emu, long frames )
+{
+	Rt_Call rt( "gme_play" );
+	static short buf [4096];
+	int const channels = gme_channel_count( emu );
+	static int const sizes [] = { 1024, 2, 512, 80, 2048 };
+	for ( int i = 0; frames > 0; i++ )
+	{
+		long n = sizes [i % 5];
+		if ( n * channels > (long) (sizeof buf / sizeof *buf) )
+			n = sizeof buf / sizeof *buf / channels;
+		if ( gme_err_t err = gme_play( emu, (int) (n * channels), buf ) )
+			return err;
+		frames -= n;
+	}
+	return 0;
+}
+
+static gme_err_t play_planar( Music_Emu* emu, long frames )
+{
+	int const channels = gme_channel_count( emu );
+	std::vector<float> data( frames * channels );
+	std::vector<float*> planes( channels );
+	for ( int c = 0; c < channels; c++ )
+		planes [c] = &data [c * frames];
+	Rt_Call rt( "gme_play_planar" );
+	return gme_play_planar( emu, (int) frames, &planes [0] );
+}
+
+// Runs real-time calls on started emulator. Returns error or description of problem.
+static const char* exercise( Music_Emu* emu )
+{
+	long const block = 4410;
+	#define PLAY() do { if ( gme_err_t err = play( emu, block ) ) return err; } while ( 0 )
+	#define RT( call ) do { Rt_Call rt( #call ); call; } while ( 0 )
+
+	PLAY();
+	if ( gme_err_t err = play_planar( emu, block ) )
+		return err;
+
+	int const voices = gme_voice_count( emu );
+	RT( gme_mute_voices( emu, 0x55 ) );
+	PLAY();
+	RT( gme_mute_voice( emu, 0, 0 ) );
+	RT( gme_mute_voice( emu, voices - 1, 1 ) );
+	PLAY();
+	RT( gme_mute_voices( emu, -1 ) );
+	PLAY();
+	RT( gme_mute_voices( emu, 0 ) );
+	PLAY();
+
+	static double const tempos [] = { 0.5, 1.7, 0.02, 4.0, 1.0 };
+	for ( double t : tempos )
+	{
+		RT( gme_set_tempo( emu, t ) );
+		PLAY();
+	}
+
+	static double const eqs [] [2] = { // treble, bass
+		{ -14.0, 80.0 }, { 0.0, 15.0 }, { -47.0, 16000.0 }, { 5.0, 1.0 }, { -1.0, 60.0 }
+	};
+	for ( auto const& e : eqs )
+	{
+		gme_equalizer_t eq = gme_equalizer_t();
+		eq.treble = e [0];
+		eq.bass   = e [1];
+		RT( gme_set_equalizer( emu, &eq ) );
+		PLAY();
+	}
+
+	RT( gme_set_fade( emu, 500 ) );
+	PLAY();
+	RT( gme_set_fade_msecs( emu, 100, 200 ) );
+	for ( int i = 0; i < 4; i++ ) // plays through end of fade
+		PLAY();
+
+	#undef RT
+	#undef PLAY
+	return 0;
+}
+
+static const char* check_setup( Test_Source const& src, setup_t const& s )
+{
+	int const rate = 44100;
+	Music_Emu* emu = s.multi ? gme_new_emu_multi_channel( src.type, rate ) :
+			gme_new_emu( src.type, rate );
+	if ( !emu )
+		return "Out of memory";
+	gme_err_t err = load_source( emu, src );
+	if ( !err )
+	{
+		gme_set_stereo_depth( emu, s.depth );
+		if ( s.latency )
+			gme_set_max_latency( emu, s.latency );
+		if ( s.background )
+			err = gme_set_background_lookahead( emu, 1 );
+		if ( !err )
+			err = gme_start_track( emu, 0 );
+	}
+
+	rt_alloc = 0;
+	if ( !err )
+		err = exercise( emu );
+
+	static char problem [256];
+	if ( !err && rt_alloc )
+	{
+		snprintf( problem, sizeof problem, "%s allocated memory", rt_alloc );
+		err = problem;
+	}
+
+	gme_rt_report_t r;
+	if ( gme_rt_report( emu, &r ) )
+		lib_checks = false;
+	else if ( !err && !s.latency && !s.background && !(r.allocs | r.locks | r.file_io) )
+	{
+		lookahead_overruns += r.overruns;
+	}
+	else if ( !err && (r.allocs | r.locks | r.file_io | r.overruns) )
+	{
+		snprintf( problem, sizeof problem, "%ld allocs, %ld locks, %ld file I/O, "
+				"%ld overruns; last: %s", r.allocs, r.locks, r.file_io, r.overruns, r.last );
+		err = problem;
+	}
+	gme_delete( emu );
+	return err;
+}
+
+static void check( Test_Source const& src )
+{
+	if ( !src.type )
+		return;
+	int const prev_failures = test_failures();
+	int checked = 0;
+	for ( setup_t const& s : setups )
+	{
+		gme_err_t err = check_setup( src, s );
+		if ( err && !strcmp( err, "unsupported for this emulator type" ) )
+			continue; // no multi-channel
+		checked++;
+		if ( err )
+			fail( "%-12s %-10s %s", src.name.c_str(), s.name, err );
+	}
+	if ( test_failures() == prev_failures )
+		pass( "%-12s %d setups", src.name.c_str(), checked );
+}
+
+int main( int argc, char** argv )
+{
+	std::vector<Fixture> fixtures;
+	make_fixtures( fixtures );
+	std::vector<Test_Source> sources;
+	if ( const char* err = make_sources( fixtures, argc, argv, sources ) )
+		fail( "%s", err );
+	for ( Test_Source const& src : sources )
+		check( src );
+
+	if ( !RT_INTERPOSE )
+		printf( "note: can't catch allocation on this platform\n" );
+	if ( !lib_checks )
+		printf( "note: library built without GME_RT_CHECK, so only allocation was checked\n" );
+	if ( lookahead_overruns )
+		printf( "note: %ld plays without max latency emulated far ahead while looking "
+				"for silence\n", lookahead_overruns );
+	return finish_tests();
+}
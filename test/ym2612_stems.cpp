@@ -0,0 +1,137 @@
+// Checks that a YM2612 core's run_channels() gives each FM voice its own stereo pair
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_ym2612_stems_<core>
+
+Built once for each YM2612 core, whichever one the library uses, with that core's
+VGM_YM2612_* defined. Plays a note on all six voices and checks that each voice's
+pair from run_channels() matches what run() gives with every other voice muted,
+and that no voice is silent. */
+
+#include "Ym2612_Emu.h"
+
+#include <vector>
+#include <stdio.h>
+
+#if defined(VGM_YM2612_GENS)
+	static const char core_name [] = "GENS";
+#elif defined(VGM_YM2612_MAME)
+	static const char core_name [] = "MAME";
+#else
+	static const char core_name [] = "Nuked";
+#endif
+
+static int failures;
+
+static void fail( const char* what, int voice )
+{
+	failures++;
+	printf( "FAIL  %-6s voice %d %s\n", core_name, voice + 1, what );
+}
+
+double const sample_rate = 44100;
+double const clock_rate  = 7670453; // NTSC Genesis
+int const pair_count = 8192;
+
+// Output is run in blocks of this many pairs, to check that cores keep each
+// voice's state between calls
+int const block_size = 500;
+
+static void write( Ym2612_Emu& ym, int voice, int addr, int data )
+{
+	addr += voice % 3;
+	if ( voice < 3 )
+		ym.write0( addr, data );
+	else
+		ym.write1( addr, data );
+}
+
+// Starts a note of a different pitch on each voice
+static void start_notes( Ym2612_Emu& ym )
+{
+	ym.write0( 0x22, 0 ); // LFO off
+	ym.write0( 0x27, 0 ); // normal channel 3 mode
+	ym.write0( 0x2B, 0 ); // DAC off
+	for ( int v = 0; v < Ym2612_Emu::channel_count; v++ )
+	{
+		write( ym, v, 0xB0, 0x07 ); // all operators go to output, no feedback
+		write( ym, v, 0xB4, 0xC0 ); // both sides
+		for ( int op = 0; op < 16; op += 4 )
+		{
+			write( ym, v, 0x30 + op, 0x01 ); // multiple 1
+			write( ym, v, 0x40 + op, 0x18 ); // total level
+			write( ym, v, 0x50 + op, 0x1F ); // fastest attack
+			write( ym, v, 0x60 + op, 0x00 );
+			write( ym, v, 0x70 + op, 0x00 );
+			write( ym, v, 0x80 + op, 0x0F );
+		}
+		int const fnum = 0x269 + v * 0x40;
+		write( ym, v, 0xA4, 4 << 3 | fnum >> 8 );
+		write( ym, v, 0xA0, fnum & 0xFF );
+		ym.write0( 0x28, 0xF0 | (v / 3) << 2 | v % 3 );
+	}
+}
+
+static bool start( Ym2612_Emu& ym, int mute_mask )
+{
+	if ( const char* err = ym.set_rate( sample_rate, clock_rate ) )
+	{
+		printf( "FAIL  %-6s %s\n", core_name, err );
+		failures++;
+		return false;
+	}
+	ym.reset();
+	ym.mute_voices( mute_mask );
+	start_notes( ym );
+	return true;
+}
+
+int main()
+{
+	int const channel_count = Ym2612_Emu::channel_count;
+	typedef Ym2612_Emu::sample_t sample_t;
+
+	Ym2612_Emu all;
+	if ( !start( all, 0 ) )
+		return 1;
+	std::vector<sample_t> stems( pair_count * channel_count * 2, 0 );
+	for ( int n = 0; n < pair_count; n += block_size )
+	{
+		int count = pair_count - n < block_size ? pair_count - n : block_size;
+		all.run_channels( count, &stems [n * channel_count * 2] );
+	}
+
+	for ( int v = 0; v < channel_count; v++ )
+	{
+		Ym2612_Emu solo;
+		if ( !start( solo, ((1 << channel_count) - 1) & ~(1 << v) ) )
+			return 1;
+		std::vector<sample_t> out( pair_count * 2, 0 );
+		for ( int n = 0; n < pair_count; n += block_size )
+		{
+			int count = pair_count - n < block_size ? pair_count - n : block_size;
+			solo.run( count, &out [n * 2] );
+		}
+
+		bool heard = false;
+		bool same = true;
+		for ( int i = 0; i < pair_count * 2; i++ )
+		{
+			sample_t s = stems [i / 2 * channel_count * 2 + v * 2 + i % 2];
+			if ( s )
+				heard = true;
+			if ( s != out [i] )
+				same = false;
+		}
+		if ( !heard )
+			fail( "is silent", v );
+		else if ( !same )
+			fail( "differs from solo render", v );
+		else
+			printf( "ok    %-6s voice %d\n", core_name, v + 1 );
+	}
+
+	printf( "%d failed\n", failures );
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,786 @@
+// Builds and incrementally updates an index of track information for a music
+// library, in a compact file that can be memory-mapped and read in place
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+/* Usage: gme_index [-v] index path ...
+       gme_index -l index
+       gme_index -q index file ...
+
+The first form scans each path (file or directory, recursively) for music files
+and writes the index, reusing what an existing index already holds. Files are
+recognized by extension or by header, so headerless GYM files and misnamed
+files are both found. A file whose size and modification time match its entry
+in the old index isn't read at all; otherwise it's read and hashed, and only
+if its contents aren't already indexed (e.g. it was moved, touched or copied)
+is its information extracted. Extraction uses gme_probe_info() where the
+format supports it, otherwise an info-only emulator. Files that fail to load
+are recorded with their error so that they aren't retried until they change.
+Entries for files that no longer exist are dropped. With -v, each file that
+had to be read is listed.
+
+-l lists everything in an index. -q looks files up by contents, wherever they
+are now, and lists their tracks.
+
+Index file format
+
+All integers are little-endian, and every table starts at a multiple of 8
+bytes, so the file can be mapped and read in place on any platform. Strings
+are offsets into the string table, which holds NUL-terminated strings and
+starts with "" at offset 0.
+
+offset  size  header
+0       8     "GMEINDX1"
+8       4     number of files
+12      4     number of contents
+16      4     number of tracks
+20      4     size of string table
+24      8     unused, 0
+
+file (24 bytes each, sorted by path as bytes)
+0       4     path string
+4       4     index of content
+8       8     file size
+16      8     modification time, in seconds since 1970
+
+content (24 bytes each, sorted by hash, unique)
+0       8     hash of file contents (64-bit FNV-1a)
+8       4     type string, as gme_type_extension() (e.g. "NSF")
+12      4     error string, "" if file loaded
+16      4     index of first track
+20      4     number of tracks
+
+track (48 bytes each, grouped by content)
+0       20    length, intro_length, loop_length, fade_length, play_length;
+              times in milliseconds as signed 32-bit, -1 if unknown. play_length
+              is always set, as gme_info_t describes.
+20      28    system, game, song, author, copyright, comment, dumper strings
+
+then the string table. */
+
+#include "gme/gme.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	typedef struct _stat64 stat_t;
+	#define stat_file _stat64
+#else
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+	typedef struct stat stat_t;
+	#define stat_file stat
+#endif
+
+static const char index_tag [8] = { 'G','M','E','I','N','D','X','1' };
+enum { header_size = 32 };
+enum { file_size = 24 };
+enum { content_size = 24 };
+enum { track_size = 48 };
+enum { time_count = 5 };
+enum { str_count = 7 };
+
+static uint32_t get_le32( uint8_t const* p )
+{
+	return (uint32_t) p [3] << 24 | (uint32_t) p [2] << 16 | (uint32_t) p [1] << 8 | p [0];
+}
+
+static uint64_t get_le64( uint8_t const* p )
+{
+	return (uint64_t) get_le32( p + 4 ) << 32 | get_le32( p );
+}
+
+static void put_le32( std::string& out, uint32_t n )
+{
+	for ( int i = 0; i < 4; i++ )
+		out += (char) (n >> (i * 8));
+}
+
+static void put_le64( std::string& out, uint64_t n )
+{
+	put_le32( out, (uint32_t) n );
+	put_le32( out, (uint32_t) (n >> 32) );
+}
+
+// FNV-1a
+static uint64_t hash_data( uint8_t const* p, size_t n )
+{
+	uint64_t h = 0xCBF29CE484222325ull;
+	for ( size_t i = 0; i < n; i++ )
+		h = (h ^ p [i]) * 0x100000001B3ull;
+	return h;
+}
+
+// Reading index
+
+// Whole file, mapped if possible
+class Mapped_File {
+public:
+	uint8_t const* data;
+	size_t size;
+
+	Mapped_File() : data( 0 ), size( 0 ), mapped( false ) { }
+	~Mapped_File() { close(); }
+
+	// Returns errno value, or 0 if OK
+	int open( const char* path );
+	void close();
+private:
+	bool mapped;
+	std::vector<uint8_t> copy;
+};
+
+int Mapped_File::open( const char* path )
+{
+	close();
+#ifndef _WIN32
+	int fd = ::open( path, O_RDONLY );
+	if ( fd < 0 )
+		return errno;
+	stat_t st;
+	if ( fstat( fd, &st ) == 0 && st.st_size > 0 )
+	{
+		void* p = mmap( 0, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+		if ( p != MAP_FAILED )
+		{
+			::close( fd );
+			data   = (uint8_t const*) p;
+			size   = (size_t) st.st_size;
+			mapped = true;
+			return 0;
+		}
+	}
+	::close( fd );
+#endif
+	FILE* in = fopen( path, "rb" );
+	if ( !in )
+		return errno;
+	uint8_t buf [4096];
+	for ( size_t n; (n = fread( buf, 1, sizeof buf, in )) > 0; )
+		copy.insert( copy.end(), buf, buf + n );
+	int err = ferror( in ) ? EIO : 0;
+	fclose( in );
+	data = copy.empty() ? 0 : &copy [0];
+	size = copy.size();
+	return err;
+}
+
+void Mapped_File::close()
+{
+#ifndef _WIN32
+	if ( mapped )
+		munmap( (void*) data, size );
+#endif
+	mapped = false;
+	copy.clear();
+	data = 0;
+	size = 0;
+}
+
+// Index file contents, read in place
+class Index_View {
+public:
+	Index_View() : file_count( 0 ), content_count( 0 ), track_count( 0 ) { }
+
+	// Returns error string, or NULL if index is valid
+	const char* set( uint8_t const* data, size_t size );
+
+	uint32_t file_count, content_count, track_count;
+
+	const char* file_path   ( uint32_t i ) const { return str( files + i * file_size ); }
+	uint32_t    file_content( uint32_t i ) const { return get_le32( files + i * file_size + 4 ); }
+	uint64_t    file_bytes  ( uint32_t i ) const { return get_le64( files + i * file_size + 8 ); }
+	int64_t     file_mtime  ( uint32_t i ) const { return (int64_t) get_le64( files + i * file_size + 16 ); }
+
+	uint64_t    content_hash ( uint32_t i ) const { return get_le64( contents + i * content_size ); }
+	const char* content_type ( uint32_t i ) const { return str( contents + i * content_size + 8 ); }
+	const char* content_error( uint32_t i ) const { return str( contents + i * content_size + 12 ); }
+	uint32_t    content_first( uint32_t i ) const { return get_le32( contents + i * content_size + 16 ); }
+	uint32_t    content_count_tracks( uint32_t i ) const { return get_le32( contents + i * content_size + 20 ); }
+
+	// n is 0 to time_count-1, in the order stored
+	int         track_time( uint32_t i, int n ) const { return (int32_t) get_le32( tracks + i * track_size + n * 4 ); }
+	// n is 0 to str_count-1, in the order stored
+	const char* track_str ( uint32_t i, int n ) const { return str( tracks + i * track_size + 20 + n * 4 ); }
+
+	// Index of file with path, or -1 if none
+	long find_file( const char* path ) const;
+
+	// Index of content with hash, or -1 if none
+	long find_content( uint64_t hash ) const;
+
+private:
+	uint8_t const* files;
+	uint8_t const* contents;
+	uint8_t const* tracks;
+	const char* strings;
+	const char* str( uint8_t const* p ) const { return strings + get_le32( p ); }
+};
+
+const char* Index_View::set( uint8_t const* data, size_t size )
+{
+	file_count = content_count = track_count = 0;
+	if ( size < header_size || memcmp( data, index_tag, sizeof index_tag ) )
+		return "Not an index file";
+
+	uint32_t files_n    = get_le32( data + 8 );
+	uint32_t contents_n = get_le32( data + 12 );
+	uint32_t tracks_n   = get_le32( data + 16 );
+	uint64_t strs_size  = get_le32( data + 20 );
+	uint64_t expected = header_size + (uint64_t) files_n * file_size +
+			(uint64_t) contents_n * content_size + (uint64_t) tracks_n * track_size + strs_size;
+	if ( expected != size || !strs_size || data [size - 1] )
+		return "Corrupt index file";
+
+	files    = data + header_size;
+	contents = files + files_n * file_size;
+	tracks   = contents + contents_n * content_size;
+	strings  = (const char*) tracks + tracks_n * track_size;
+
+	// check every reference so that accessors don't have to
+	for ( uint32_t i = 0; i < files_n; i++ )
+	{
+		uint8_t const* f = files + i * file_size;
+		if ( get_le32( f ) >= strs_size || get_le32( f + 4 ) >= contents_n )
+			return "Corrupt index file";
+	}
+	for ( uint32_t i = 0; i < contents_n; i++ )
+	{
+		uint8_t const* c = contents + i * content_size;
+		uint64_t first = get_le32( c + 16 );
+		if ( get_le32( c + 8 ) >= strs_size || get_le32( c + 12 ) >= strs_size ||
+				first + get_le32( c + 20 ) > tracks_n )
+			return "Corrupt index file";
+	}
+	for ( uint32_t i = 0; i < tracks_n; i++ )
+		for ( int n = 0; n < str_count; n++ )
+			if ( get_le32( tracks + i * track_size + 20 + n * 4 ) >= strs_size )
+				return "Corrupt index file";
+
+	file_count    = files_n;
+	content_count = contents_n;
+	track_count   = tracks_n;
+	return 0;
+}
+
+long Index_View::find_file( const char* path ) const
+{
+	long lo = 0, hi = file_count;
+	while ( lo < hi )
+	{
+		long mid = (lo + hi) / 2;
+		int cmp = strcmp( file_path( mid ), path );
+		if ( !cmp )
+			return mid;
+		if ( cmp < 0 )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+
+long Index_View::find_content( uint64_t hash ) const
+{
+	long lo = 0, hi = content_count;
+	while ( lo < hi )
+	{
+		long mid = (lo + hi) / 2;
+		uint64_t h = content_hash( mid );
+		if ( h == hash )
+			return mid;
+		if ( h < hash )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+
+// Building index
+
+struct Track
+{
+	int times [time_count];
+	std::string strs [str_count];
+};
+
+struct Content
+{
+	std::string type;
+	std::string error;
+	std::vector<Track> tracks;
+};
+
+struct File_Entry
+{
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash;
+};
+
+// Length if available, otherwise intro_length+loop_length*2 if available,
+// otherwise a default of 150000 (2.5 minutes), as gme_info_t describes
+static int play_length( int length, int intro, int loop )
+{
+	if ( length > 0 )
+		return length;
+	if ( loop > 0 )
+		return (intro > 0 ? intro : 0) + loop * 2;
+	return 150000;
+}
+
+static void set_times( Track& t, int length, int intro, int loop, int fade )
+{
+	t.times [0] = length;
+	t.times [1] = intro;
+	t.times [2] = loop;
+	t.times [3] = fade;
+	t.times [4] = play_length( length, intro, loop );
+}
+
+static int add_probed( void* user_data, gme_probe_t const* info )
+{
+	Content* c = (Content*) user_data;
+	c->tracks.push_back( Track() );
+	Track& t = c->tracks.back();
+	set_times( t, info->length, info->intro_length, info->loop_length, info->fade_length );
+	gme_str_t const* strs [str_count] = { &info->system, &info->game, &info->song,
+			&info->author, &info->copyright, &info->comment, &info->dumper };
+	for ( int n = 0; n < str_count; n++ )
+		t.strs [n].assign( strs [n]->str, strs [n]->len );
+	return 0;
+}
+
+// Extracts information for file of given type
+static void extract( Content& c, gme_type_t type, uint8_t const* data, long size )
+{
+	c.type = gme_type_extension( type );
+	c.tracks.clear();
+	gme_err_t err = gme_probe_info( data, size, add_probed, &c );
+	if ( !err )
+		return;
+
+	// not supported by probe, or not identifiable from header (e.g. GYM without one)
+	c.tracks.clear();
+	Music_Emu* emu = gme_new_emu( type, gme_info_only );
+	if ( !emu )
+	{
+		c.error = "Out of memory";
+		return;
+	}
+	err = gme_load_data( emu, data, size );
+	for ( int i = 0; !err && i < gme_track_count( emu ); i++ )
+	{
+		gme_info_t* info;
+		err = gme_track_info( emu, &info, i );
+		if ( err )
+			break;
+		c.tracks.push_back( Track() );
+		Track& t = c.tracks.back();
+		set_times( t, info->length, info->intro_length, info->loop_length, info->fade_length );
+		const char* strs [str_count] = { info->system, info->game, info->song,
+				info->author, info->copyright, info->comment, info->dumper };
+		for ( int n = 0; n < str_count; n++ )
+			t.strs [n] = strs [n];
+		gme_free_info( info );
+	}
+	gme_delete( emu );
+	if ( err )
+	{
+		c.error = err;
+		c.tracks.clear();
+	}
+}
+
+class Indexer {
+public:
+	Indexer( Index_View const& old, bool verbose ) : old( old ), verbose( verbose )
+	{
+		unchanged = reused = extracted = failed = 0;
+	}
+
+	void add_path( std::string const& path );
+
+	// Returns errno value, or 0 if OK
+	int write( const char* path ) const;
+
+	void print_stats() const;
+
+private:
+	Index_View const& old;
+	bool verbose;
+	std::map<std::string,File_Entry> files;
+	std::map<uint64_t,Content> contents;
+	int unchanged, reused, extracted, failed;
+
+	void add_file( std::string const& path, stat_t const& );
+	void add_dir( std::string const& path );
+	void copy_old_content( long i );
+};
+
+void Indexer::copy_old_content( long i )
+{
+	Content& c = contents [old.content_hash( i )];
+	c.type  = old.content_type( i );
+	c.error = old.content_error( i );
+	c.tracks.resize( old.content_count_tracks( i ) );
+	for ( uint32_t t = 0; t < c.tracks.size(); t++ )
+	{
+		uint32_t from = old.content_first( i ) + t;
+		for ( int n = 0; n < time_count; n++ )
+			c.tracks [t].times [n] = old.track_time( from, n );
+		for ( int n = 0; n < str_count; n++ )
+			c.tracks [t].strs [n] = old.track_str( from, n );
+	}
+}
+
+void Indexer::add_file( std::string const& path, stat_t const& st )
+{
+	File_Entry e;
+	e.size  = (uint64_t) st.st_size;
+	e.mtime = (int64_t) st.st_mtime;
+
+	long old_file = old.find_file( path.c_str() );
+	if ( old_file >= 0 && old.file_bytes( old_file ) == e.size &&
+			old.file_mtime( old_file ) == e.mtime )
+	{
+		long c = old.file_content( old_file );
+		e.hash = old.content_hash( c );
+		if ( !contents.count( e.hash ) )
+			copy_old_content( c );
+		files [path] = e;
+		unchanged++;
+		return;
+	}
+
+	// only read files that look like music
+	gme_type_t type = gme_identify_extension( path.c_str() );
+	if ( !type )
+	{
+		gme_err_t err = gme_identify_file( path.c_str(), &type );
+		if ( err || !type )
+			return;
+	}
+
+	Mapped_File in;
+	if ( int err = in.open( path.c_str() ) )
+	{
+		fprintf( stderr, "%s: %s\n", path.c_str(), strerror( err ) );
+		failed++;
+		return;
+	}
+	// header overrides extension
+	if ( in.size >= 4 )
+	{
+		gme_type_t header_type = gme_identify_extension( gme_identify_header( in.data ) );
+		if ( header_type )
+			type = header_type;
+	}
+
+	e.hash = hash_data( in.data, in.size );
+	files [path] = e;
+	if ( contents.count( e.hash ) )
+	{
+		reused++;
+		return;
+	}
+	long c = old.find_content( e.hash );
+	if ( c >= 0 )
+	{
+		copy_old_content( c );
+		reused++;
+		return;
+	}
+
+	Content& content = contents [e.hash];
+	extract( content, type, in.data, (long) in.size );
+	extracted++;
+	if ( !content.error.empty() )
+		failed++;
+	if ( verbose )
+		printf( "%s: %s\n", path.c_str(), content.error.empty() ? "ok" : content.error.c_str() );
+}
+
+void Indexer::add_dir( std::string const& path )
+{
+	std::vector<std::string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE h = FindFirstFileA( (path + "\\*").c_str(), &found );
+	if ( h == INVALID_HANDLE_VALUE )
+	{
+		fprintf( stderr, "%s: can't read directory\n", path.c_str() );
+		failed++;
+		return;
+	}
+	do
+		names.push_back( found.cFileName );
+	while ( FindNextFileA( h, &found ) );
+	FindClose( h );
+#else
+	DIR* dir = opendir( path.c_str() );
+	if ( !dir )
+	{
+		fprintf( stderr, "%s: %s\n", path.c_str(), strerror( errno ) );
+		failed++;
+		return;
+	}
+	while ( dirent* ent = readdir( dir ) )
+		names.push_back( ent->d_name );
+	closedir( dir );
+#endif
+
+	for ( size_t i = 0; i < names.size(); i++ )
+	{
+		if ( names [i] == "." || names [i] == ".." )
+			continue;
+		add_path( path + "/" + names [i] );
+	}
+}
+
+void Indexer::add_path( std::string const& path )
+{
+	stat_t st;
+	if ( stat_file( path.c_str(), &st ) )
+	{
+		fprintf( stderr, "%s: %s\n", path.c_str(), strerror( errno ) );
+		failed++;
+		return;
+	}
+	if ( (st.st_mode & S_IFMT) == S_IFDIR )
+		add_dir( path );
+	else if ( (st.st_mode & S_IFMT) == S_IFREG )
+		add_file( path, st );
+}
+
+int Indexer::write( const char* path ) const
+{
+	std::string strings( 1, '\0' );
+	std::map<std::string,uint32_t> string_offsets;
+	string_offsets [""] = 0;
+	struct local {
+		static uint32_t add( std::string& strings, std::map<std::string,uint32_t>& offsets,
+				std::string const& s )
+		{
+			std::map<std::string,uint32_t>::iterator it = offsets.find( s );
+			if ( it != offsets.end() )
+				return it->second;
+			uint32_t offset = (uint32_t) strings.size();
+			strings.append( s.c_str(), s.size() + 1 );
+			offsets [s] = offset;
+			return offset;
+		}
+	};
+
+	// contents and tracks, both in hash order
+	std::string content_table, track_table;
+	std::map<uint64_t,uint32_t> content_index;
+	uint32_t track_count = 0;
+	for ( std::map<uint64_t,Content>::const_iterator it = contents.begin(); it != contents.end(); ++it )
+	{
+		Content const& c = it->second;
+		content_index [it->first] = (uint32_t) content_index.size();
+		put_le64( content_table, it->first );
+		put_le32( content_table, local::add( strings, string_offsets, c.type ) );
+		put_le32( content_table, local::add( strings, string_offsets, c.error ) );
+		put_le32( content_table, track_count );
+		put_le32( content_table, (uint32_t) c.tracks.size() );
+		for ( size_t t = 0; t < c.tracks.size(); t++ )
+		{
+			for ( int n = 0; n < time_count; n++ )
+				put_le32( track_table, (uint32_t) c.tracks [t].times [n] );
+			for ( int n = 0; n < str_count; n++ )
+				put_le32( track_table, local::add( strings, string_offsets, c.tracks [t].strs [n] ) );
+		}
+		track_count += (uint32_t) c.tracks.size();
+	}
+
+	// std::map orders by std::string, which compares as bytes like strcmp()
+	std::string file_table;
+	for ( std::map<std::string,File_Entry>::const_iterator it = files.begin(); it != files.end(); ++it )
+	{
+		put_le32( file_table, local::add( strings, string_offsets, it->first ) );
+		put_le32( file_table, content_index [it->second.hash] );
+		put_le64( file_table, it->second.size );
+		put_le64( file_table, (uint64_t) it->second.mtime );
+	}
+
+	while ( strings.size() % 8 )
+		strings += '\0';
+
+	std::string header( index_tag, sizeof index_tag );
+	put_le32( header, (uint32_t) files.size() );
+	put_le32( header, (uint32_t) contents.size() );
+	put_le32( header, track_count );
+	put_le32( header, (uint32_t) strings.size() );
+	put_le64( header, 0 );
+
+	// write to temporary file then replace, so readers never see partial index
+	std::string temp = std::string( path ) + ".tmp";
+	FILE* out = fopen( temp.c_str(), "wb" );
+	if ( !out )
+		return errno;
+	std::string const* parts [] = { &header, &file_table, &content_table, &track_table, &strings };
+	bool ok = true;
+	for ( size_t i = 0; i < sizeof parts / sizeof *parts; i++ )
+		ok = ok && fwrite( parts [i]->data(), 1, parts [i]->size(), out ) == parts [i]->size();
+	ok = !fclose( out ) && ok;
+	int err = ok ? 0 : EIO;
+#ifdef _WIN32
+	if ( !err )
+		remove( path );
+#endif
+	if ( !err && rename( temp.c_str(), path ) )
+		err = errno;
+	if ( err )
+		remove( temp.c_str() );
+	return err;
+}
+
+void Indexer::print_stats() const
+{
+	int dropped = 0;
+	for ( uint32_t i = 0; i < old.file_count; i++ )
+		dropped += !files.count( old.file_path( i ) );
+	printf( "%d files: %d unchanged, %d reused by contents, %d read, %d failed, %d dropped\n",
+			(int) files.size(), unchanged, reused, extracted, failed, dropped );
+}
+
+// Listing
+
+static void print_time( int msec )
+{
+	if ( msec < 0 )
+		printf( "    -" );
+	else
+		printf( " %2d:%02d", msec / 60000, msec / 1000 % 60 );
+}
+
+static void print_content( Index_View const& index, uint32_t c )
+{
+	if ( *index.content_error( c ) )
+	{
+		printf( "  %s error: %s\n", index.content_type( c ), index.content_error( c ) );
+		return;
+	}
+	uint32_t first = index.content_first( c );
+	for ( uint32_t t = 0; t < index.content_count_tracks( c ); t++ )
+	{
+		uint32_t i = first + t;
+		printf( "  %-4s %3d", index.content_type( c ), (int) t + 1 );
+		print_time( index.track_time( i, 4 ) );
+		const char* game = index.track_str( i, 1 );
+		const char* song = index.track_str( i, 2 );
+		printf( "  %s%s%s", game, (*game && *song ? " - " : ""), song );
+		if ( *index.track_str( i, 3 ) )
+			printf( " (%s)", index.track_str( i, 3 ) ); // author
+		printf( "\n" );
+	}
+}
+
+static int usage()
+{
+	fprintf( stderr, "Usage: gme_index [-v] index path ...\n"
+			"       gme_index -l index\n"
+			"       gme_index -q index file ...\n" );
+	return 1;
+}
+
+int main( int argc, char** argv )
+{
+	char mode = 'u';
+	bool verbose = false;
+	int arg = 1;
+	for ( ; arg < argc && argv [arg] [0] == '-' && argv [arg] [1]; arg++ )
+	{
+		const char* opt = argv [arg];
+		if ( !strcmp( opt, "-l" ) || !strcmp( opt, "-q" ) )
+			mode = opt [1];
+		else if ( !strcmp( opt, "-v" ) )
+			verbose = true;
+		else
+			return usage();
+	}
+	if ( arg >= argc || (mode != 'l' && arg + 1 >= argc) )
+		return usage();
+	const char* index_path = argv [arg++];
+
+	Mapped_File index_file;
+	Index_View index;
+	int open_err = index_file.open( index_path );
+	if ( !open_err )
+	{
+		if ( const char* err = index.set( index_file.data, index_file.size ) )
+		{
+			fprintf( stderr, "%s: %s\n", index_path, err );
+			return 1;
+		}
+	}
+	else if ( mode != 'u' || open_err != ENOENT )
+	{
+		fprintf( stderr, "%s: %s\n", index_path, strerror( open_err ) );
+		return 1;
+	}
+
+	if ( mode == 'l' )
+	{
+		for ( uint32_t f = 0; f < index.file_count; f++ )
+		{
+			printf( "%s\n", index.file_path( f ) );
+			print_content( index, index.file_content( f ) );
+		}
+		return 0;
+	}
+
+	if ( mode == 'q' )
+	{
+		int missing = 0;
+		for ( ; arg < argc; arg++ )
+		{
+			Mapped_File in;
+			if ( int err = in.open( argv [arg] ) )
+			{
+				fprintf( stderr, "%s: %s\n", argv [arg], strerror( err ) );
+				missing++;
+				continue;
+			}
+			long c = index.find_content( hash_data( in.data, in.size ) );
+			printf( "%s\n", argv [arg] );
+			if ( c < 0 )
+			{
+				printf( "  not in index\n" );
+				missing++;
+				continue;
+			}
+			print_content( index, (uint32_t) c );
+		}
+		return missing ? 1 : 0;
+	}
+
+	Indexer indexer( index, verbose );
+	for ( ; arg < argc; arg++ )
+		indexer.add_path( argv [arg] );
+
+	// old index stays mapped; replacing file doesn't affect mapping
+	int err = indexer.write( index_path );
+	if ( err )
+	{
+		fprintf( stderr, "%s: %s\n", index_path, strerror( err ) );
+		return 1;
+	}
+	indexer.print_stats();
+	return 0;
+}